@@ -37,6 +37,7 @@
 #include "memory_pages.h"
 #include "ui/ui.h"
 #include "utils.h"
+#include "z80/z80.h"
 
 /* The current breakpoints */
 GSList *debugger_breakpoints;
@@ -235,6 +236,11 @@ debugger_check( debugger_breakpoint_type type, libspectrum_dword value )
 
   int signal_breakpoints_updated = 0;
 
+#ifdef Z80_LAZY_FLAGS
+  /* A breakpoint's condition may test the flags */
+  if( debugger_mode != DEBUGGER_MODE_INACTIVE ) z80_update_flags();
+#endif
+
   switch( debugger_mode ) {
 
   case DEBUGGER_MODE_INACTIVE: return 0;
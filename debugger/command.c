@@ -41,6 +41,11 @@ static char *command_buffer = NULL;
 /* And a pointer as to how much we've parsed */
 static char *command_ptr;
 
+/* Set while parsing a lone expression */
+int debugger_command_expression_only = 0;
+static debugger_expression *parsed_expression;
+static int parse_failed;
+
 int yyparse( void );
 int yywrap( void );
 
@@ -66,6 +71,38 @@ debugger_command_evaluate( const char *command )
   ui_debugger_update();
 }
 
+/* Parse 'text' as an expression on its own, without evaluating it; returns
+   NULL if it is not one */
+debugger_expression*
+debugger_expression_parse( const char *text )
+{
+  debugger_expression *exp;
+
+  if( command_buffer ) libspectrum_free( command_buffer );
+
+  command_buffer = utils_safe_strdup( text );
+  command_ptr = command_buffer;
+
+  parsed_expression = NULL;
+  parse_failed = 0;
+  debugger_command_expression_only = 1;
+
+  if( yyparse() ) parse_failed = 1;
+
+  debugger_command_expression_only = 0;
+  mempool_free( debugger_memory_pool );
+
+  exp = parsed_expression;
+  parsed_expression = NULL;
+
+  if( parse_failed && exp ) {
+    debugger_expression_delete( exp );
+    exp = NULL;
+  }
+
+  return exp;
+}
+
 /* Utility functions called from the flex scanner */
 
 int
@@ -99,5 +136,14 @@ debugger_command_input( char *buf, int *result, int max_size )
 void
 yyerror( const char *s )
 {
+  parse_failed = 1;
   ui_error( UI_ERROR_ERROR, "Invalid debugger command: %s", s );
 }
+
+/* Keep a copy of the expression parsed by debugger_expression_parse() */
+void
+debugger_command_expression( debugger_expression *exp )
+{
+  if( parsed_expression ) debugger_expression_delete( parsed_expression );
+  parsed_expression = debugger_expression_copy( exp );
+}
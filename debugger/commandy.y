@@ -101,6 +101,7 @@
 %token <string>	 VARIABLE
 
 %token		 DEBUGGER_ERROR
+%token		 DEBUGGER_EXPRESSION	/* Only from debugger_expression_parse() */
 
 /* Derived types */
 
@@ -143,6 +144,7 @@ input:	 /* empty */
        | command
        | error
        | input '\n' command
+       | DEBUGGER_EXPRESSION expression { debugger_command_expression( $2 ); }
 ;
 
 command:   BASE number { debugger_output_base = $2; }
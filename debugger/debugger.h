@@ -76,6 +76,18 @@ void debugger_command_evaluate( const char *command );
 int debugger_expression_deparse( char *buffer, size_t length,
 				 const debugger_expression *exp );
 
+/* An expression compiled to a flat list of steps, for expressions which
+   are evaluated very often.  Variables named in 'values' are taken from the
+   array given to debugger_program_run() rather than looked up by name */
+typedef struct debugger_program debugger_program;
+
+debugger_program* debugger_program_compile( const char *text,
+                                            const char * const *values,
+                                            size_t value_count );
+libspectrum_dword debugger_program_run( const debugger_program *program,
+                                        const libspectrum_dword *values );
+void debugger_program_free( debugger_program *program );
+
 /* Register an event type with the debugger */
 int debugger_event_register( const char *type, const char *detail );
 
@@ -103,6 +115,7 @@ void debugger_system_variable_register(
 
 /* Unit tests */
 int debugger_disassemble_unittest( void );
+int debugger_program_unittest( void );
 int gdbserver_unittest( void );
 
 #endif				/* #ifndef FUSE_DEBUGGER_H */
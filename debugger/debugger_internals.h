@@ -53,6 +53,12 @@ int debugger_command_input( char *buf, int *result, int max_size );
 int yylex( void );
 void yyerror( const char *s );
 
+/* Set to have the scanner start with DEBUGGER_EXPRESSION, so that the
+   parser takes a lone expression and gives it to
+   debugger_command_expression() */
+extern int debugger_command_expression_only;
+void debugger_command_expression( debugger_expression *exp );
+
 /* The semantic values of some tokens */
 
 typedef enum debugger_token {
@@ -87,6 +93,7 @@ debugger_expression_new_system_variable( const char *type, const char *detail,
 debugger_expression*
 debugger_expression_new_variable( const char *name, int pool );
 
+debugger_expression* debugger_expression_parse( const char *text );
 debugger_expression* debugger_expression_copy( debugger_expression *src );
 void debugger_expression_delete( debugger_expression* expression );
 
@@ -92,6 +92,39 @@ struct debugger_expression {
 
 };
 
+/* A step of a compiled program.  The operands of each operator come
+   before it, so the program runs on a stack */
+typedef enum program_step_type {
+
+  PROGRAM_STEP_NUMBER,
+  PROGRAM_STEP_UNARYOP,
+  PROGRAM_STEP_BINARYOP,
+  PROGRAM_STEP_SYSVAR,
+  PROGRAM_STEP_VARIABLE,
+  PROGRAM_STEP_VALUE,
+
+} program_step_type;
+
+typedef struct program_step {
+
+  program_step_type type;
+  int operation;		/* Operator, system variable or value index */
+  libspectrum_dword number;
+  char *variable;
+
+} program_step;
+
+/* Deep enough for any expression which fits in a debugger command */
+#define PROGRAM_MAX_DEPTH 64
+
+struct debugger_program {
+
+  program_step *steps;
+  size_t count;
+  size_t allocated;
+
+};
+
 static libspectrum_dword evaluate_unaryop( struct unaryop_type *unaryop );
 static libspectrum_dword evaluate_binaryop( struct binaryop_type *binary );
 
@@ -647,3 +680,261 @@ is_non_associative( int operation )
   fuse_abort();
 }
 
+static program_step*
+program_add_step( debugger_program *program, program_step_type type )
+{
+  program_step *step;
+
+  if( program->count == program->allocated ) {
+    program->allocated = program->allocated ? 2 * program->allocated : 16;
+    program->steps = libspectrum_renew( program_step, program->steps,
+                                        program->allocated );
+  }
+
+  step = &program->steps[ program->count++ ];
+  step->type = type;
+  step->operation = 0;
+  step->number = 0;
+  step->variable = NULL;
+
+  return step;
+}
+
+/* Add the steps for 'exp' to 'program'; returns the stack depth needed */
+static size_t
+program_compile( debugger_program *program, const debugger_expression *exp,
+                 const char * const *values, size_t value_count )
+{
+  program_step *step;
+  size_t i, depth, depth2;
+
+  switch( exp->type ) {
+
+  case DEBUGGER_EXPRESSION_TYPE_INTEGER:
+    step = program_add_step( program, PROGRAM_STEP_NUMBER );
+    step->number = exp->types.integer;
+    return 1;
+
+  case DEBUGGER_EXPRESSION_TYPE_UNARYOP:
+    depth = program_compile( program, exp->types.unaryop.op, values,
+                             value_count );
+    step = program_add_step( program, PROGRAM_STEP_UNARYOP );
+    step->operation = exp->types.unaryop.operation;
+    return depth;
+
+  case DEBUGGER_EXPRESSION_TYPE_BINARYOP:
+    depth = program_compile( program, exp->types.binaryop.op1, values,
+                             value_count );
+    depth2 = program_compile( program, exp->types.binaryop.op2, values,
+                              value_count ) + 1;
+    step = program_add_step( program, PROGRAM_STEP_BINARYOP );
+    step->operation = exp->types.binaryop.operation;
+    return depth > depth2 ? depth : depth2;
+
+  case DEBUGGER_EXPRESSION_TYPE_SYSVAR:
+    step = program_add_step( program, PROGRAM_STEP_SYSVAR );
+    step->operation = exp->types.system_variable;
+    return 1;
+
+  case DEBUGGER_EXPRESSION_TYPE_VARIABLE:
+    for( i = 0; i < value_count; i++ ) {
+      if( !strcmp( exp->types.variable, values[i] ) ) {
+        step = program_add_step( program, PROGRAM_STEP_VALUE );
+        step->operation = i;
+        return 1;
+      }
+    }
+    step = program_add_step( program, PROGRAM_STEP_VARIABLE );
+    step->variable = utils_safe_strdup( exp->types.variable );
+    return 1;
+
+  }
+
+  ui_error( UI_ERROR_ERROR, "unknown expression type %d", exp->type );
+  fuse_abort();
+}
+
+debugger_program*
+debugger_program_compile( const char *text, const char * const *values,
+                          size_t value_count )
+{
+  debugger_expression *exp;
+  debugger_program *program;
+  size_t depth;
+
+  exp = debugger_expression_parse( text );
+  if( !exp ) return NULL;
+
+  program = libspectrum_new( debugger_program, 1 );
+  program->steps = NULL;
+  program->count = program->allocated = 0;
+
+  depth = program_compile( program, exp, values, value_count );
+  debugger_expression_delete( exp );
+
+  if( depth > PROGRAM_MAX_DEPTH ) {
+    ui_error( UI_ERROR_ERROR, "expression too deeply nested" );
+    debugger_program_free( program );
+    return NULL;
+  }
+
+  return program;
+}
+
+/* As evaluate_binaryop(), except that both operands have already been
+   evaluated, even for && and ||, so division by zero gives 0 quietly */
+static libspectrum_dword
+program_binaryop( int operation, libspectrum_dword op1, libspectrum_dword op2 )
+{
+  switch( operation ) {
+
+  case '+': return op1 + op2;
+  case '-': return op1 - op2;
+  case '*': return op1 * op2;
+  case '/': return op2 ? op1 / op2 : 0;
+
+  case DEBUGGER_TOKEN_EQUAL_TO: return op1 == op2;
+  case DEBUGGER_TOKEN_NOT_EQUAL_TO: return op1 != op2;
+  case '>': return op1 > op2;
+  case '<': return op1 < op2;
+  case DEBUGGER_TOKEN_LESS_THAN_OR_EQUAL_TO: return op1 <= op2;
+  case DEBUGGER_TOKEN_GREATER_THAN_OR_EQUAL_TO: return op1 >= op2;
+
+  case '&': return op1 & op2;
+  case '^': return op1 ^ op2;
+  case '|': return op1 | op2;
+
+  case DEBUGGER_TOKEN_LOGICAL_AND: return op1 && op2;
+  case DEBUGGER_TOKEN_LOGICAL_OR: return op1 || op2;
+
+  }
+
+  ui_error( UI_ERROR_ERROR, "unknown binary operator %d", operation );
+  fuse_abort();
+}
+
+libspectrum_dword
+debugger_program_run( const debugger_program *program,
+                      const libspectrum_dword *values )
+{
+  libspectrum_dword stack[ PROGRAM_MAX_DEPTH ], *top = stack - 1;
+  const program_step *step, *end = program->steps + program->count;
+
+  for( step = program->steps; step < end; step++ ) {
+
+    switch( step->type ) {
+
+    case PROGRAM_STEP_NUMBER: *++top = step->number; break;
+    case PROGRAM_STEP_VALUE: *++top = values[ step->operation ]; break;
+
+    case PROGRAM_STEP_SYSVAR:
+      *++top = debugger_system_variable_get( step->operation );
+      break;
+
+    case PROGRAM_STEP_VARIABLE:
+      *++top = debugger_variable_get( step->variable );
+      break;
+
+    case PROGRAM_STEP_UNARYOP:
+      switch( step->operation ) {
+      case '!': *top = !*top; break;
+      case '~': *top = ~*top; break;
+      case '-': *top = -*top; break;
+      case DEBUGGER_TOKEN_DEREFERENCE: *top = readbyte_internal( *top ); break;
+      }
+      break;
+
+    case PROGRAM_STEP_BINARYOP:
+      top--;
+      *top = program_binaryop( step->operation, top[0], top[1] );
+      break;
+
+    }
+  }
+
+  return *top;
+}
+
+void
+debugger_program_free( debugger_program *program )
+{
+  size_t i;
+
+  if( !program ) return;
+
+  for( i = 0; i < program->count; i++ )
+    libspectrum_free( program->steps[i].variable );
+
+  libspectrum_free( program->steps );
+  libspectrum_free( program );
+}
+
+static int
+program_test( const char *text, const libspectrum_dword *values,
+              libspectrum_dword expected )
+{
+  static const char * const names[] = { "lives", "score" };
+  debugger_program *program;
+  libspectrum_dword result;
+
+  program = debugger_program_compile( text, names, ARRAY_SIZE( names ) );
+  if( !program ) {
+    printf( "%s: could not compile \"%s\"\n", fuse_progname, text );
+    return 1;
+  }
+
+  result = debugger_program_run( program, values );
+  debugger_program_free( program );
+
+  if( result != expected ) {
+    printf( "%s: \"%s\" gave %u, expected %u\n", fuse_progname, text,
+            (unsigned)result, (unsigned)expected );
+    return 1;
+  }
+
+  return 0;
+}
+
+int
+debugger_program_unittest( void )
+{
+  static const char * const names[] = { "lives", "score" };
+  const libspectrum_dword values1[] = { 3, 1500 };
+  const libspectrum_dword values2[] = { 0, 7 };
+  debugger_program *program;
+  int r = 0;
+
+  /* Precedence and associativity */
+  r += program_test( "2 + 3 * 4", values1, 14 );
+  r += program_test( "(2 + 3) * 4", values1, 20 );
+  r += program_test( "10 - 4 - 3", values1, 3 );
+  r += program_test( "100 / 10 / 5", values1, 2 );
+  r += program_test( "1 + 2 == 3", values1, 1 );
+  r += program_test( "6 & 3 | 8", values1, 10 );
+  r += program_test( "6 | 3 & 8", values1, 6 );
+  r += program_test( "1 || 0 && 0", values1, 1 );
+  r += program_test( "2 < 3 && 3 < 2", values1, 0 );
+  r += program_test( "-2 + 5", values1, 3 );
+  r += program_test( "!0 + 1", values1, 2 );
+
+  /* Both sides are evaluated, and division by zero gives 0 */
+  r += program_test( "0 && 1 / 0", values1, 0 );
+  r += program_test( "7 / 0", values1, 0 );
+
+  /* Values are bound by position, and read afresh on each run */
+  r += program_test( "$score + $lives * 100", values1, 1800 );
+  r += program_test( "$score + $lives * 100", values2, 7 );
+  r += program_test( "$lives == 0 || $score > 1000", values1, 1 );
+  r += program_test( "$lives == 0 || $score > 1000", values2, 1 );
+  r += program_test( "$lives == 1 || $score > 1000", values2, 0 );
+
+  /* A program is only compiled from a complete expression */
+  program = debugger_program_compile( "2 +", names, ARRAY_SIZE( names ) );
+  if( program ) {
+    printf( "%s: compiled an incomplete expression\n", fuse_progname );
+    debugger_program_free( program );
+    r++;
+  }
+
+  return r;
+}
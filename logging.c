@@ -4,7 +4,7 @@
 #include "logging.h"
 
 
-static LOG_LEVEL min_level_to_log = INFO;
+LOG_LEVEL min_level_to_log = INFO;
 
 static const char *get_log_level_name(LOG_LEVEL level);
 
@@ -13,11 +13,8 @@ void set_log_level(LOG_LEVEL level) {
     min_level_to_log = level;
 }
 
+//  The level has already been checked by the logging macros
 void log_message(const char *filename, unsigned int line, const char *function, LOG_LEVEL level, const char *message, ...) {
-    if (level < min_level_to_log) {
-        return;
-    }
-
     va_list args;
     va_start(args, message);
 
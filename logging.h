@@ -11,11 +11,29 @@ typedef enum {
     FATAL
 } LOG_LEVEL;
 
-#define DEBUG(...) log_message(__FILE__, __LINE__, __func__, DEBUG, ##__VA_ARGS__)
-#define INFO(...) log_message(__FILE__, __LINE__, __func__, INFO, ##__VA_ARGS__)
-#define WARNING(...) log_message(__FILE__, __LINE__, __func__, WARNING, ##__VA_ARGS__)
-#define ERROR(...) log_message(__FILE__, __LINE__, __func__, ERROR, ##__VA_ARGS__)
-#define FATAL(...) log_message(__FILE__, __LINE__, __func__, FATAL, ##__VA_ARGS__)
+/*
+ *  Messages below this level are not compiled in at all, e.g. -DLOG_COMPILED_LEVEL=1 leaves out DEBUG;
+ *  configure --disable-debug-log sets this
+ */
+#ifndef LOG_COMPILED_LEVEL
+#define LOG_COMPILED_LEVEL 0
+#endif
+
+extern LOG_LEVEL min_level_to_log;
+
+//  The level is checked before the arguments are evaluated, so a message which is not logged costs a compare
+#define LOG_AT_LEVEL(level, ...) \
+    do { \
+        if ((level) >= LOG_COMPILED_LEVEL && (level) >= min_level_to_log) { \
+            log_message(__FILE__, __LINE__, __func__, level, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define DEBUG(...) LOG_AT_LEVEL(DEBUG, ##__VA_ARGS__)
+#define INFO(...) LOG_AT_LEVEL(INFO, ##__VA_ARGS__)
+#define WARNING(...) LOG_AT_LEVEL(WARNING, ##__VA_ARGS__)
+#define ERROR(...) LOG_AT_LEVEL(ERROR, ##__VA_ARGS__)
+#define FATAL(...) LOG_AT_LEVEL(FATAL, ##__VA_ARGS__)
 
 
 void set_log_level(LOG_LEVEL level);
@@ -119,7 +119,8 @@ static const periph_t beta128_pentagon = {
   NULL,
   beta128_pentagon_ports,
   0,
-  NULL
+  NULL,
+  beta_pc_traps
 };
 
 static const periph_port_t beta128_pentagon_late_ports[] = {
@@ -135,7 +136,8 @@ static const periph_t beta128_pentagon_late = {
   NULL,
   beta128_pentagon_late_ports,
   0,
-  NULL
+  NULL,
+  beta_pc_traps
 };
 
 static const periph_port_t pentagon1024_memory_ports[] = {
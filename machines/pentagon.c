@@ -155,6 +155,7 @@ pentagon_reset(void)
 
   beta_builtin = 1;
   beta_active = 1;
+  periph_pc_traps_update();
 
   machine_current->ram.last_byte2 = 0;
   machine_current->ram.special = 0;
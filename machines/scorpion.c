@@ -109,6 +109,7 @@ scorpion_reset(void)
 
   beta_builtin = 1;
   beta_active = 0;
+  periph_pc_traps_update();
 
   spec48_common_display_setup();
 
@@ -49,6 +49,11 @@
 #include "spectrum.h"
 #include "ui/ui.h"
 #include "utils.h"
+#include "z80/z80_block_cache.h"
+
+libspectrum_byte memory_ram_dirty[SPECTRUM_RAM_PAGES * MEMORY_PAGES_IN_16K];
+
+int memory_snapshot_ram = 1;
 
 /* The various sources of memory available to us */
 static GArray *memory_sources;
@@ -65,6 +70,8 @@ int memory_source_none; /* No memory attached here */
 memory_page memory_map_read[MEMORY_PAGES_IN_64K];
 memory_page memory_map_write[MEMORY_PAGES_IN_64K];
 
+libspectrum_dword memory_contended_reads = 0;
+
 /* Standard mappings for the 'normal' RAM */
 memory_page memory_map_ram[SPECTRUM_RAM_PAGES * MEMORY_PAGES_IN_16K];
 
@@ -332,6 +339,11 @@ memory_map_2k_read_write( libspectrum_word address, memory_page source[],
     if( map_read ) memory_map_read[ page_offset ] = *page;
     if( map_write ) memory_map_write[ page_offset ] = *page;
   }
+
+#ifdef Z80_BLOCK_CACHE
+  /* The rest of the block may now be read from other memory */
+  if( map_read ) z80_block_break = 1;
+#endif
 }
 
 /* Map one page of memory */
@@ -340,6 +352,10 @@ memory_map_page( memory_page *source[], int page_num )
 {
   memory_map_read[ page_num ] = memory_map_write[ page_num ] =
     *source[ page_num ];
+
+#ifdef Z80_BLOCK_CACHE
+  z80_block_break = 1;
+#endif
 }
 
 /* Page in 16k from /ROMCS */
@@ -382,7 +398,10 @@ readbyte( libspectrum_word address )
   if( debugger_mode != DEBUGGER_MODE_INACTIVE )
     debugger_check( DEBUGGER_BREAKPOINT_TYPE_READ, address );
 
-  if( mapping->contended ) tstates += ula_contention[ tstates ];
+  if( mapping->contended ) {
+    tstates += ula_contention[ tstates ];
+    memory_contended_reads++;
+  }
   tstates += 3;
 
   if( address < 0x4000 ) {
@@ -509,14 +528,38 @@ writebyte_internal( libspectrum_word address, libspectrum_byte b )
 
     memory_display_dirty( address, b );
 
+    if( mapping->source == memory_source_ram )
+      memory_ram_dirty[ mapping->page_num * MEMORY_PAGES_IN_16K +
+                        ( mapping->offset >> MEMORY_PAGE_SIZE_LOGARITHM ) ] = 1;
+
+#ifdef Z80_BLOCK_CACHE
+    z80_block_cache_write( mapping, address );
+#endif
+
     memory[ offset ] = b;
   }
 }
 
+void
+memory_ram_set_dirty( int page_num, libspectrum_word offset, size_t length )
+{
+  size_t chunk, last;
+
+  if( !length ) return;
+
+  chunk = page_num * MEMORY_PAGES_IN_16K +
+          ( offset >> MEMORY_PAGE_SIZE_LOGARITHM );
+  last = page_num * MEMORY_PAGES_IN_16K +
+         ( ( offset + length - 1 ) >> MEMORY_PAGE_SIZE_LOGARITHM );
+
+  for( ; chunk <= last; chunk++ ) memory_ram_dirty[ chunk ] = 1;
+}
+
 void
 perform_contend_read(libspectrum_word address, time_t time) {
     if (memory_map_read[(address) >> MEMORY_PAGE_SIZE_LOGARITHM].contended) {
         tstates += ula_contention[tstates];
+        memory_contended_reads++;
     }
 
     tstates += (time);
@@ -526,6 +569,7 @@ void
 perform_contend_read_no_mreq(libspectrum_word address, time_t time) {
     if (memory_map_read[(address) >> MEMORY_PAGE_SIZE_LOGARITHM ].contended ) {
         tstates += ula_contention_no_mreq[tstates];
+        memory_contended_reads++;
     }
 
     tstates += (time);
@@ -590,8 +634,10 @@ memory_from_snapshot( libspectrum_snap *snap )
   }
 
   for( i = 0; i < 64; i++ )
-    if( libspectrum_snap_pages( snap, i ) )
+    if( libspectrum_snap_pages( snap, i ) ) {
       memcpy( RAM[i], libspectrum_snap_pages( snap, i ), 0x4000 );
+      memory_ram_set_dirty( i, 0, 0x4000 );
+    }
 
   if( libspectrum_snap_custom_rom( snap ) ) {
     for( i = 0; i < libspectrum_snap_custom_rom_pages( snap ) && i < 4; i++ ) {
@@ -602,6 +648,11 @@ memory_from_snapshot( libspectrum_snap *snap )
       }
     }
   }
+
+#ifdef Z80_BLOCK_CACHE
+  /* The memory has been replaced without being written through the map */
+  z80_block_cache_flush();
+#endif
 }
 
 static void
@@ -693,7 +744,7 @@ memory_to_snapshot( libspectrum_snap *snap )
   libspectrum_snap_set_out_plus3_memoryport( snap,
 					     machine_current->ram.last_byte2 );
 
-  for( i = 0; i < 64; i++ ) {
+  for( i = 0; memory_snapshot_ram && i < 64; i++ ) {
       buffer = libspectrum_new( libspectrum_byte, 0x4000 );
 
       memcpy( buffer, RAM[i], 0x4000 );
@@ -66,9 +66,27 @@ typedef struct memory_page {
 extern memory_page memory_map_read[MEMORY_PAGES_IN_64K];
 extern memory_page memory_map_write[MEMORY_PAGES_IN_64K];
 
+/* Counts the reads from contended memory; only compared, to tell whether some
+   code has read from contended memory */
+extern libspectrum_dword memory_contended_reads;
+
 extern memory_page memory_map_ram[SPECTRUM_RAM_PAGES * MEMORY_PAGES_IN_16K];
 extern memory_page memory_map_rom[SPECTRUM_ROM_PAGES * MEMORY_PAGES_IN_16K];
 
+/* Which 2K chunks of RAM[] have been changed since they were last marked
+   clean; chunk n is the MEMORY_PAGE_SIZE bytes at
+   RAM[ n / MEMORY_PAGES_IN_16K ][ ( n % MEMORY_PAGES_IN_16K ) * MEMORY_PAGE_SIZE ] */
+extern libspectrum_byte memory_ram_dirty[SPECTRUM_RAM_PAGES * MEMORY_PAGES_IN_16K];
+
+/* Mark the chunks of RAM[ page_num ] written other than through
+   writebyte_internal() as dirty */
+void memory_ram_set_dirty( int page_num, libspectrum_word offset,
+                           size_t length );
+
+/* If zero, RAM is not copied into snapshots; used by callers which keep
+   their own copy of the RAM */
+extern int memory_snapshot_ram;
+
 /* Which RAM page contains the current screen */
 extern int memory_current_screen;
 
@@ -0,0 +1,275 @@
+/* ml_branch.c: copy-on-write machine states for the ML bridge
+   Copyright (c) 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "display.h"
+#include "memory_pages.h"
+#include "snapshot.h"
+#include "spectrum.h"
+#include "z80/z80_block_cache.h"
+
+#include "ml_branch.h"
+
+/* The RAM pages which are saved in snapshots, split into chunks */
+#define FUSE_ML_BRANCH_CHUNKS ( 64 * MEMORY_PAGES_IN_16K )
+
+/* A copy of one chunk of RAM, shared by every branch in which the chunk
+   held these contents */
+typedef struct fuse_ml_branch_chunk {
+  size_t refcount;
+  libspectrum_byte data[ MEMORY_PAGE_SIZE ];
+} fuse_ml_branch_chunk;
+
+/* Everything but the RAM is kept in a snapshot made without the RAM */
+typedef struct fuse_ml_branch {
+  libspectrum_snap *snap;
+  fuse_ml_branch_chunk *chunks[ FUSE_ML_BRANCH_CHUNKS ];
+} fuse_ml_branch;
+
+/* The chunks which RAM last matched; a chunk of RAM still matches unless it
+   has been marked as dirty since */
+static fuse_ml_branch_chunk *fuse_ml_branch_ram[ FUSE_ML_BRANCH_CHUNKS ];
+
+/* Branches by id; dropped branches leave a NULL for the id to be reused */
+static fuse_ml_branch **fuse_ml_branches = NULL;
+static size_t fuse_ml_branch_count = 0;
+static size_t fuse_ml_branch_size = 0;
+
+/* How many chunks are allocated */
+static size_t fuse_ml_branch_chunk_count = 0;
+
+static libspectrum_byte*
+fuse_ml_branch_chunk_ram( size_t chunk )
+{
+  return &RAM[ chunk / MEMORY_PAGES_IN_16K ]
+             [ ( chunk % MEMORY_PAGES_IN_16K ) * MEMORY_PAGE_SIZE ];
+}
+
+static void
+fuse_ml_branch_chunk_release( fuse_ml_branch_chunk *chunk )
+{
+  if( chunk && !--chunk->refcount ) {
+    libspectrum_free( chunk );
+    fuse_ml_branch_chunk_count--;
+  }
+}
+
+/* Point fuse_ml_branch_ram[] at the current contents of every chunk of RAM,
+   copying only those which have changed */
+static void
+fuse_ml_branch_update_ram( void )
+{
+  fuse_ml_branch_chunk *chunk;
+  size_t i;
+
+  for( i = 0; i < FUSE_ML_BRANCH_CHUNKS; i++ ) {
+    if( fuse_ml_branch_ram[i] && !memory_ram_dirty[i] ) continue;
+
+    chunk = libspectrum_new( fuse_ml_branch_chunk, 1 );
+    chunk->refcount = 1;
+    memcpy( chunk->data, fuse_ml_branch_chunk_ram( i ), MEMORY_PAGE_SIZE );
+    fuse_ml_branch_chunk_count++;
+
+    fuse_ml_branch_chunk_release( fuse_ml_branch_ram[i] );
+    fuse_ml_branch_ram[i] = chunk;
+    memory_ram_dirty[i] = 0;
+  }
+}
+
+static void
+fuse_ml_branch_free( fuse_ml_branch *branch )
+{
+  size_t i;
+
+  for( i = 0; i < FUSE_ML_BRANCH_CHUNKS; i++ )
+    fuse_ml_branch_chunk_release( branch->chunks[i] );
+
+  libspectrum_snap_free( branch->snap );
+  libspectrum_free( branch );
+}
+
+/* Make a branch from the current state */
+static fuse_ml_branch*
+fuse_ml_branch_make( const char **error_text )
+{
+  fuse_ml_branch *branch;
+  libspectrum_snap *snap;
+  size_t i;
+  int error;
+
+  snap = libspectrum_snap_alloc();
+
+  memory_snapshot_ram = 0;
+  error = snapshot_copy_to( snap );
+  memory_snapshot_ram = 1;
+
+  if( error ) {
+    libspectrum_snap_free( snap );
+    *error_text = "ERR clone failed\n";
+    return NULL;
+  }
+
+  fuse_ml_branch_update_ram();
+
+  branch = libspectrum_new( fuse_ml_branch, 1 );
+  branch->snap = snap;
+  for( i = 0; i < FUSE_ML_BRANCH_CHUNKS; i++ ) {
+    branch->chunks[i] = fuse_ml_branch_ram[i];
+    branch->chunks[i]->refcount++;
+  }
+
+  return branch;
+}
+
+int
+fuse_ml_branch_clone( unsigned long *id, const char **error_text )
+{
+  fuse_ml_branch *branch;
+  size_t slot;
+
+  branch = fuse_ml_branch_make( error_text );
+  if( !branch ) return 1;
+
+  for( slot = 0; slot < fuse_ml_branch_count; slot++ )
+    if( !fuse_ml_branches[ slot ] ) break;
+
+  if( slot == fuse_ml_branch_count ) {
+    if( fuse_ml_branch_count == fuse_ml_branch_size ) {
+      fuse_ml_branch_size = fuse_ml_branch_size ? 2 * fuse_ml_branch_size : 64;
+      fuse_ml_branches = libspectrum_renew( fuse_ml_branch*, fuse_ml_branches,
+                                            fuse_ml_branch_size );
+    }
+    fuse_ml_branch_count++;
+  }
+
+  fuse_ml_branches[ slot ] = branch;
+  *id = slot;
+
+  return 0;
+}
+
+static fuse_ml_branch*
+fuse_ml_branch_find( unsigned long id, const char **error_text )
+{
+  if( id >= fuse_ml_branch_count || !fuse_ml_branches[ id ] ) {
+    *error_text = "ERR no such branch\n";
+    return NULL;
+  }
+
+  return fuse_ml_branches[ id ];
+}
+
+int
+fuse_ml_branch_restore( unsigned long id, const char **error_text )
+{
+  fuse_ml_branch *branch;
+  fuse_ml_branch_chunk *chunk;
+  size_t i;
+
+  branch = fuse_ml_branch_find( id, error_text );
+  if( !branch ) return 1;
+
+  /* The snapshot has no RAM pages, so this leaves RAM alone */
+  if( snapshot_copy_from( branch->snap ) ) {
+    *error_text = "ERR restore failed\n";
+    return 1;
+  }
+
+  for( i = 0; i < FUSE_ML_BRANCH_CHUNKS; i++ ) {
+    chunk = branch->chunks[i];
+
+    if( chunk != fuse_ml_branch_ram[i] || memory_ram_dirty[i] ) {
+      memcpy( fuse_ml_branch_chunk_ram( i ), chunk->data, MEMORY_PAGE_SIZE );
+#ifdef Z80_BLOCK_CACHE
+      z80_block_cache_invalidate( i );
+#endif
+    }
+
+    chunk->refcount++;
+    fuse_ml_branch_chunk_release( fuse_ml_branch_ram[i] );
+    fuse_ml_branch_ram[i] = chunk;
+    memory_ram_dirty[i] = 0;
+  }
+
+  display_refresh_all();
+
+  return 0;
+}
+
+int
+fuse_ml_branch_save( unsigned long id, const char **error_text )
+{
+  fuse_ml_branch *branch;
+
+  if( !fuse_ml_branch_find( id, error_text ) ) return 1;
+
+  branch = fuse_ml_branch_make( error_text );
+  if( !branch ) return 1;
+
+  fuse_ml_branch_free( fuse_ml_branches[ id ] );
+  fuse_ml_branches[ id ] = branch;
+
+  return 0;
+}
+
+int
+fuse_ml_branch_drop( unsigned long id, const char **error_text )
+{
+  fuse_ml_branch *branch;
+
+  branch = fuse_ml_branch_find( id, error_text );
+  if( !branch ) return 1;
+
+  fuse_ml_branch_free( branch );
+  fuse_ml_branches[ id ] = NULL;
+
+  while( fuse_ml_branch_count && !fuse_ml_branches[ fuse_ml_branch_count - 1 ] )
+    fuse_ml_branch_count--;
+
+  return 0;
+}
+
+void
+fuse_ml_branch_stats( size_t *branches, size_t *chunks )
+{
+  size_t i;
+
+  *branches = 0;
+  for( i = 0; i < fuse_ml_branch_count; i++ )
+    if( fuse_ml_branches[i] ) (*branches)++;
+
+  *chunks = fuse_ml_branch_chunk_count;
+}
+
+void
+fuse_ml_branch_end( void )
+{
+  size_t i;
+
+  for( i = 0; i < fuse_ml_branch_count; i++ )
+    if( fuse_ml_branches[i] ) fuse_ml_branch_free( fuse_ml_branches[i] );
+
+  libspectrum_free( fuse_ml_branches );
+  fuse_ml_branches = NULL;
+  fuse_ml_branch_count = fuse_ml_branch_size = 0;
+
+  for( i = 0; i < FUSE_ML_BRANCH_CHUNKS; i++ ) {
+    fuse_ml_branch_chunk_release( fuse_ml_branch_ram[i] );
+    fuse_ml_branch_ram[i] = NULL;
+  }
+}
@@ -0,0 +1,41 @@
+/* ml_branch.h: copy-on-write machine states for the ML bridge
+   Copyright (c) 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+*/
+
+#ifndef FUSE_ML_BRANCH_H
+#define FUSE_ML_BRANCH_H
+
+#include <stdlib.h>
+
+/* Save the current machine state as a new branch and return its id in
+   *id. RAM is shared with the other branches a MEMORY_PAGE_SIZE chunk at
+   a time, so only the chunks written since the last branch was made or
+   restored are copied */
+int fuse_ml_branch_clone( unsigned long *id, const char **error_text );
+
+/* Put the machine back into the state saved in branch id */
+int fuse_ml_branch_restore( unsigned long id, const char **error_text );
+
+/* Replace the state saved in branch id with the current state */
+int fuse_ml_branch_save( unsigned long id, const char **error_text );
+
+/* Free branch id so its id can be used again */
+int fuse_ml_branch_drop( unsigned long id, const char **error_text );
+
+/* How many branches are held, and how many distinct RAM chunks they share */
+void fuse_ml_branch_stats( size_t *branches, size_t *chunks );
+
+/* Free all the branches */
+void fuse_ml_branch_end( void );
+
+#endif			/* #ifndef FUSE_ML_BRANCH_H */
@@ -20,8 +20,11 @@
 #include <string.h>
 
 #ifndef WIN32
+#include <signal.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 #endif
 
@@ -30,7 +33,14 @@
 #include "input.h"
 #include "machine.h"
 #include "memory_pages.h"
+#include "ml_branch.h"
 #include "ml_game_adapter.h"
+#include "ml_obs.h"
+#include "ml_record.h"
+#include "ml_shm.h"
+#include "ml_stats.h"
+#include "ml_watch.h"
+#include "rzx.h"
 #include "settings.h"
 #include "snapshot.h"
 #include "spectrum.h"
@@ -39,6 +49,7 @@
 #include "utils.h"
 
 #include "z80/z80.h"
+#include "z80/z80_trace.h"
 
 #include "ml_bridge.h"
 
@@ -48,16 +59,162 @@ static int fuse_ml_visual_pace_ms = 0;
 static char *fuse_ml_socket_path = NULL;
 static char *fuse_ml_reset_snapshot = NULL;
 static int fuse_ml_server_fd = -1;
+static int fuse_ml_binary_default = 0;
+
+/* With FUSE_ML_WORKERS set, the first process only keeps that many workers
+   running */
+#define FUSE_ML_MAX_WORKERS 256
+
+static unsigned long fuse_ml_worker_target = 0;
 
 #ifndef WIN32
 
+/* The binary protocol: each request and response is a fixed header of a
+   byte for the command, a byte for the status, two reserved bytes and the
+   length of the payload as a 32 bit word, followed by the payload itself.
+   All words are little-endian. */
+
+#define FUSE_ML_BINARY_HEADER_LENGTH 8
+
+/* The largest request is a WRITE of the whole 64K address space */
+#define FUSE_ML_BINARY_MAX_REQUEST ( 2 + 0x10000 )
+
+#define FUSE_ML_ATTR_BASE 0x5800
+#define FUSE_ML_ATTR_COUNT 768
+
+typedef enum fuse_ml_binary_command {
+  FUSE_ML_BINARY_READY = 0x00,
+  FUSE_ML_BINARY_PING = 0x01,
+  FUSE_ML_BINARY_RESET = 0x02,
+  FUSE_ML_BINARY_KEYDOWN = 0x03,
+  FUSE_ML_BINARY_KEYUP = 0x04,
+  FUSE_ML_BINARY_STEP = 0x05,
+  FUSE_ML_BINARY_READ = 0x06,
+  FUSE_ML_BINARY_WRITE = 0x07,
+  FUSE_ML_BINARY_GETINFO = 0x08,
+  FUSE_ML_BINARY_GETSCREEN = 0x09,
+  FUSE_ML_BINARY_GETATTRS = 0x0a,
+  FUSE_ML_BINARY_ACT = 0x0b,
+  FUSE_ML_BINARY_EPISODE_STEP = 0x0c,
+  FUSE_ML_BINARY_EPISODE_STEP_KEYS = 0x0d,
+  FUSE_ML_BINARY_STEP_ATTRS = 0x0e,
+  FUSE_ML_BINARY_PROTO_TEXT = 0x0f,
+  FUSE_ML_BINARY_QUIT = 0x10,
+  FUSE_ML_BINARY_SHM_EPISODE_STEP = 0x11,
+  FUSE_ML_BINARY_SHM_EPISODE_STEP_KEYS = 0x12,
+  FUSE_ML_BINARY_SHM_OBS = 0x13,
+  FUSE_ML_BINARY_SAVESTATE = 0x14,
+  FUSE_ML_BINARY_LOADSTATE = 0x15,
+  FUSE_ML_BINARY_CLONE = 0x16,
+  FUSE_ML_BINARY_RESTORE = 0x17,
+  FUSE_ML_BINARY_DROP = 0x18,
+  FUSE_ML_BINARY_BRANCHES = 0x19,
+  FUSE_ML_BINARY_FORK = 0x1a,
+  FUSE_ML_BINARY_ENVS = 0x1b,
+  FUSE_ML_BINARY_ENV = 0x1c,
+  FUSE_ML_BINARY_STEP_BATCH = 0x1d,
+  FUSE_ML_BINARY_OBS = 0x1e,
+  FUSE_ML_BINARY_OBS_EPISODE_STEP = 0x1f,
+  FUSE_ML_BINARY_WATCH = 0x20,
+  FUSE_ML_BINARY_RECORD = 0x21,
+  FUSE_ML_BINARY_STEP_ASYNC = 0x22,
+  FUSE_ML_BINARY_WAIT = 0x23,
+  FUSE_ML_BINARY_STATS = 0x24,
+} fuse_ml_binary_command;
+
+typedef enum fuse_ml_binary_status {
+  FUSE_ML_BINARY_STATUS_OK = 0,
+  FUSE_ML_BINARY_STATUS_ERROR = 1,
+} fuse_ml_binary_status;
+
+/* Whether the current connection is using the binary protocol */
+static int fuse_ml_binary_protocol = 0;
+
+/* Commands are read from the socket a buffer at a time, and responses are
+   gathered and only written out when the next command has to wait for more
+   to be read, so a batch of commands written at once is answered at once */
+
+#define FUSE_ML_INPUT_BUFFER_SIZE 65536
+
+/* Responses bigger than this are written out as they are made */
+#define FUSE_ML_OUTPUT_FLUSH_SIZE 262144
+
+static char fuse_ml_input[ FUSE_ML_INPUT_BUFFER_SIZE ];
+static size_t fuse_ml_input_start = 0;
+static size_t fuse_ml_input_end = 0;
+
+static char *fuse_ml_output = NULL;
+static size_t fuse_ml_output_length = 0;
+static size_t fuse_ml_output_size = 0;
+
+/* Steps queued by STEP_ASYNC, in the slot given by their ticket.  Queued
+   steps are run once there is nothing left to read, while the client is
+   busy with something else, or before any other command; what each would
+   have sent is kept until WAIT asks for it */
+
+#define FUSE_ML_ASYNC_SLOTS 64
+
+typedef enum fuse_ml_async_state {
+  FUSE_ML_ASYNC_FREE,
+  FUSE_ML_ASYNC_QUEUED,
+  FUSE_ML_ASYNC_FINISHED,
+} fuse_ml_async_state;
+
+typedef struct fuse_ml_async_step {
+  fuse_ml_async_state state;
+  libspectrum_dword ticket;
+  int binary;
+  unsigned long action;
+  unsigned long frames;
+  int auto_reset;
+  long instance;		/* -1 for whichever is live */
+  char *response;
+  size_t response_length;
+  size_t response_size;
+} fuse_ml_async_step;
+
+static fuse_ml_async_step fuse_ml_async_steps[ FUSE_ML_ASYNC_SLOTS ];
+static libspectrum_dword fuse_ml_async_next_ticket = 0;
+static libspectrum_dword fuse_ml_async_next_run = 0;
+
+/* The step being run, whose response is kept rather than sent */
+static fuse_ml_async_step *fuse_ml_async_capture = NULL;
+
+/* Machine states kept in memory by SAVESTATE, and the reset snapshot once
+   it has been read, so neither has to be read from a file again */
+
+#define FUSE_ML_STATE_SLOTS 16
+
+static libspectrum_snap *fuse_ml_state_slots[ FUSE_ML_STATE_SLOTS ];
+static libspectrum_snap *fuse_ml_reset_state = NULL;
+
+/* Workers are forked copies of the emulator, numbered in the order they
+   are made, each listening on the socket path with ".<worker>" added */
+static unsigned long fuse_ml_next_worker = 0;
+
 static int fuse_ml_apply_action( unsigned long action, unsigned long frames,
                                  long *reward, int *done,
                                  const char **error_text );
+static int fuse_ml_fork_workers( unsigned long count, int *worker,
+                                 const char **error_text );
+static void fuse_ml_async_clear( void );
+static int fuse_ml_async_queue( unsigned long action, unsigned long frames,
+                                int auto_reset, long instance, int binary,
+                                libspectrum_dword *ticket,
+                                const char **error_text );
+static void fuse_ml_async_run( int fd, libspectrum_dword until );
+static int fuse_ml_async_wait( int fd, unsigned long ticket, int binary,
+                               const char **error_text );
 
 static int
-fuse_ml_send( int fd, const char *data, size_t length )
+fuse_ml_write( int fd, const char *data, size_t length )
 {
+  libspectrum_qword start;
+
+  if( !length ) return 0;
+
+  start = fuse_ml_stats_now();
+
   while( length ) {
     ssize_t written = write( fd, data, length );
     if( written < 0 ) {
@@ -66,11 +223,91 @@ fuse_ml_send( int fd, const char *data, size_t length )
     }
     data += written;
     length -= written;
+    fuse_ml_stats_count( FUSE_ML_STATS_BYTES_SENT, written );
+  }
+
+  fuse_ml_stats_time( FUSE_ML_STATS_IO, start );
+
+  return 0;
+}
+
+static int
+fuse_ml_flush( int fd )
+{
+  int error = fuse_ml_write( fd, fuse_ml_output, fuse_ml_output_length );
+
+  fuse_ml_output_length = 0;
+
+  return error;
+}
+
+static int
+fuse_ml_send( int fd, const char *data, size_t length )
+{
+  fuse_ml_async_step *step = fuse_ml_async_capture;
+
+  if( step ) {
+    if( step->response_length + length > step->response_size ) {
+      step->response_size = 2 * ( step->response_length + length );
+      step->response = libspectrum_renew( char, step->response,
+                                          step->response_size );
+    }
+
+    memcpy( step->response + step->response_length, data, length );
+    step->response_length += length;
+
+    return 0;
+  }
+
+  if( fuse_ml_output_length + length > FUSE_ML_OUTPUT_FLUSH_SIZE ) {
+    if( fuse_ml_flush( fd ) ) return 1;
+    if( length >= FUSE_ML_OUTPUT_FLUSH_SIZE )
+      return fuse_ml_write( fd, data, length );
+  }
+
+  if( fuse_ml_output_length + length > fuse_ml_output_size ) {
+    fuse_ml_output_size = FUSE_ML_OUTPUT_FLUSH_SIZE;
+    fuse_ml_output = libspectrum_renew( char, fuse_ml_output,
+                                        fuse_ml_output_size );
   }
 
+  memcpy( fuse_ml_output + fuse_ml_output_length, data, length );
+  fuse_ml_output_length += length;
+
   return 0;
 }
 
+/* Write out the responses so far and read more from the socket; returns
+   the number of bytes read, 0 on end of file and -1 on error */
+static ssize_t
+fuse_ml_fill( int fd )
+{
+  ssize_t read_result;
+
+  if( fuse_ml_flush( fd ) ) return -1;
+
+  /* The client has its answers, so get on with the queued steps */
+  fuse_ml_async_run( fd, fuse_ml_async_next_ticket );
+
+  if( fuse_ml_input_start == fuse_ml_input_end ) {
+    fuse_ml_input_start = fuse_ml_input_end = 0;
+  } else if( fuse_ml_input_start ) {
+    memmove( fuse_ml_input, fuse_ml_input + fuse_ml_input_start,
+             fuse_ml_input_end - fuse_ml_input_start );
+    fuse_ml_input_end -= fuse_ml_input_start;
+    fuse_ml_input_start = 0;
+  }
+
+  do {
+    read_result = read( fd, fuse_ml_input + fuse_ml_input_end,
+                        sizeof( fuse_ml_input ) - fuse_ml_input_end );
+  } while( read_result < 0 && errno == EINTR && !fuse_exiting );
+
+  if( read_result > 0 ) fuse_ml_input_end += read_result;
+
+  return read_result;
+}
+
 static int
 fuse_ml_send_text( int fd, const char *text )
 {
@@ -81,38 +318,71 @@ static int
 fuse_ml_read_line( int fd, char *buffer, size_t length )
 {
   size_t pos = 0;
+  int too_long = 0;
 
   if( !length ) return -1;
 
   while( 1 ) {
     char c;
-    ssize_t read_result = read( fd, &c, 1 );
 
-    if( read_result == 0 ) {
-      if( pos == 0 ) return 0;
-      break;
-    } else if( read_result < 0 ) {
-      if( errno == EINTR ) continue;
-      return -1;
+    if( fuse_ml_input_start == fuse_ml_input_end ) {
+      ssize_t read_result = fuse_ml_fill( fd );
+
+      if( read_result == 0 ) {
+        if( pos == 0 && !too_long ) return 0;
+        break;
+      } else if( read_result < 0 ) {
+        return -1;
+      }
     }
 
+    c = fuse_ml_input[ fuse_ml_input_start++ ];
+
     if( c == '\n' ) break;
-    if( c == '\r' ) continue;
+    if( c == '\r' || too_long ) continue;
 
     if( pos + 1 >= length ) {
-      do {
-        read_result = read( fd, &c, 1 );
-      } while( read_result == 1 && c != '\n' );
-      return -2;
+      too_long = 1;
+      continue;
     }
 
     buffer[pos++] = c;
   }
 
+  if( too_long ) return -2;
+
   buffer[pos] = '\0';
   return 1;
 }
 
+/* Returns 1 once length bytes have been read, 0 on end of file before the
+   first byte and -1 on error or end of file part way through */
+static int
+fuse_ml_read_exact( int fd, libspectrum_byte *buffer, size_t length )
+{
+  size_t pos = 0;
+
+  while( pos < length ) {
+    size_t count = fuse_ml_input_end - fuse_ml_input_start;
+
+    if( !count ) {
+      ssize_t read_result = fuse_ml_fill( fd );
+
+      if( read_result == 0 ) return pos == 0 ? 0 : -1;
+      if( read_result < 0 ) return -1;
+      continue;
+    }
+
+    if( count > length - pos ) count = length - pos;
+
+    memcpy( buffer + pos, fuse_ml_input + fuse_ml_input_start, count );
+    fuse_ml_input_start += count;
+    pos += count;
+  }
+
+  return 1;
+}
+
 static int
 fuse_ml_parse_ulong( const char *text, unsigned long *value )
 {
@@ -140,28 +410,298 @@ fuse_ml_key_event( input_event_type type, unsigned long key )
   return input_event( &event );
 }
 
+static int
+fuse_ml_read_reset_state( void )
+{
+  utils_file file;
+  libspectrum_snap *snap;
+  int error;
+
+  error = utils_read_file( fuse_ml_reset_snapshot, &file );
+  if( error ) return error;
+
+  snap = libspectrum_snap_alloc();
+
+  error = libspectrum_snap_read( snap, file.buffer, file.length,
+                                 LIBSPECTRUM_ID_UNKNOWN,
+                                 fuse_ml_reset_snapshot );
+  utils_close_file( &file );
+  if( error ) {
+    libspectrum_snap_free( snap );
+    return error;
+  }
+
+  fuse_ml_reset_state = snap;
+
+  return 0;
+}
+
 static int
 fuse_ml_reset( void )
 {
   int error;
 
-  if( fuse_ml_reset_snapshot && *fuse_ml_reset_snapshot )
-    error = snapshot_read( fuse_ml_reset_snapshot );
+  /* snapshot_copy_from() only selects a new machine if the snapshot is for
+     a different one, so this is just a reset and a copy of the state */
+  if( fuse_ml_reset_state )
+    error = snapshot_copy_from( fuse_ml_reset_state );
   else
     error = machine_reset( 1 );
 
-  if( !error ) fuse_ml_game_resync();
+  if( !error ) {
+    fuse_ml_game_resync();
+    fuse_ml_obs_restart();
+    fuse_ml_record_mark();
+    fuse_ml_stats_count( FUSE_ML_STATS_RESETS, 1 );
+  }
 
   return error;
 }
 
 static int
-fuse_ml_step_frames( unsigned long frame_count )
+fuse_ml_save_state( unsigned long slot, const char **error_text )
+{
+  libspectrum_snap *snap;
+
+  if( slot >= FUSE_ML_STATE_SLOTS ) {
+    *error_text = "ERR invalid state slot\n";
+    return 1;
+  }
+
+  snap = libspectrum_snap_alloc();
+
+  if( snapshot_copy_to( snap ) ) {
+    libspectrum_snap_free( snap );
+    *error_text = "ERR save state failed\n";
+    return 1;
+  }
+
+  if( fuse_ml_state_slots[ slot ] )
+    libspectrum_snap_free( fuse_ml_state_slots[ slot ] );
+  fuse_ml_state_slots[ slot ] = snap;
+
+  return 0;
+}
+
+static int
+fuse_ml_load_state( unsigned long slot, const char **error_text )
+{
+  if( slot >= FUSE_ML_STATE_SLOTS ) {
+    *error_text = "ERR invalid state slot\n";
+    return 1;
+  }
+
+  if( !fuse_ml_state_slots[ slot ] ) {
+    *error_text = "ERR state slot empty\n";
+    return 1;
+  }
+
+  if( snapshot_copy_from( fuse_ml_state_slots[ slot ] ) ) {
+    *error_text = "ERR load state failed\n";
+    return 1;
+  }
+
+  fuse_ml_game_resync();
+  fuse_ml_obs_restart();
+  fuse_ml_record_mark();
+
+  return 0;
+}
+
+/* Instances for STEP_BATCH.  Each is kept as a branch, apart from the live
+   one, which is whatever state the machine is in; switching instances saves
+   the live one and restores the other, which only copies the RAM which
+   differs.  Each instance also has its own observation frame stack */
+
+#define FUSE_ML_MAX_ENVS 256
+
+static unsigned long fuse_ml_envs[ FUSE_ML_MAX_ENVS ];
+static unsigned long fuse_ml_env_count = 0;
+static unsigned long fuse_ml_env_live = 0;
+
+static void
+fuse_ml_free_envs( void )
+{
+  const char *error_text;
+  unsigned long i;
+
+  for( i = 0; i < fuse_ml_env_count; i++ )
+    fuse_ml_branch_drop( fuse_ml_envs[i], &error_text );
+
+  fuse_ml_env_count = fuse_ml_env_live = 0;
+  fuse_ml_obs_set_stacks( 1 );
+  fuse_ml_record_select( 0 );
+}
+
+/* Start count instances in the current state, with the first one live */
+static int
+fuse_ml_make_envs( unsigned long count, const char **error_text )
+{
+  unsigned long i;
+
+  if( count > FUSE_ML_MAX_ENVS ) {
+    *error_text = "ERR invalid instance count\n";
+    return 1;
+  }
+
+  fuse_ml_free_envs();
+
+  for( i = 0; i < count; i++ ) {
+    if( fuse_ml_branch_clone( &fuse_ml_envs[i], error_text ) ) {
+      fuse_ml_env_count = i;
+      fuse_ml_free_envs();
+      return 1;
+    }
+  }
+
+  fuse_ml_env_count = count;
+  fuse_ml_obs_set_stacks( count );
+  fuse_ml_record_mark_all();
+
+  return 0;
+}
+
+static int
+fuse_ml_switch_env( unsigned long env, const char **error_text )
+{
+  if( env >= fuse_ml_env_count ) {
+    *error_text = "ERR no such instance\n";
+    return 1;
+  }
+
+  if( env == fuse_ml_env_live ) return 0;
+
+  /* Not fuse_ml_restore_branch(), which would restart the frame stack */
+  if( fuse_ml_branch_save( fuse_ml_envs[ fuse_ml_env_live ], error_text ) ||
+      fuse_ml_branch_restore( fuse_ml_envs[ env ], error_text ) )
+    return 1;
+
+  fuse_ml_game_resync();
+  fuse_ml_obs_select( env );
+  fuse_ml_record_select( env );
+  fuse_ml_env_live = env;
+
+  return 0;
+}
+
+/* The branches holding the instances are not the client's to restore or
+   drop, so are treated as if they were not there */
+static int
+fuse_ml_client_branch( unsigned long id, const char **error_text )
+{
+  unsigned long i;
+
+  for( i = 0; i < fuse_ml_env_count; i++ ) {
+    if( fuse_ml_envs[i] == id ) {
+      *error_text = "ERR no such branch\n";
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static int
+fuse_ml_restore_branch( unsigned long id, const char **error_text )
+{
+  if( fuse_ml_client_branch( id, error_text ) ||
+      fuse_ml_branch_restore( id, error_text ) ) return 1;
+
+  fuse_ml_game_resync();
+  fuse_ml_obs_restart();
+  fuse_ml_record_mark();
+
+  return 0;
+}
+
+static int
+fuse_ml_drop_branch( unsigned long id, const char **error_text )
+{
+  if( fuse_ml_client_branch( id, error_text ) ) return 1;
+
+  return fuse_ml_branch_drop( id, error_text );
+}
+
+int
+fuse_ml_bridge_unittest( void )
+{
+  const char *error_text;
+  unsigned long id, i;
+  int r = 0;
+
+  if( fuse_ml_make_envs( 2, &error_text ) ) {
+    printf( "%s: could not start instances\n", fuse_progname );
+    return 1;
+  }
+
+  for( i = 0; i < fuse_ml_env_count; i++ ) {
+    if( !fuse_ml_restore_branch( fuse_ml_envs[i], &error_text ) ||
+        !fuse_ml_drop_branch( fuse_ml_envs[i], &error_text ) ) {
+      printf( "%s: instance %lu's branch not refused\n", fuse_progname, i );
+      r++;
+    }
+  }
+
+  /* Switching instances still works, and leaves the client's own branches
+     alone */
+  if( fuse_ml_branch_clone( &id, &error_text ) ) {
+    fuse_ml_free_envs();
+    return r + 1;
+  }
+
+  if( fuse_ml_switch_env( 1, &error_text ) ||
+      fuse_ml_switch_env( 0, &error_text ) ||
+      fuse_ml_restore_branch( id, &error_text ) ||
+      fuse_ml_drop_branch( id, &error_text ) ) {
+    printf( "%s: branch beside instances: %s", fuse_progname, error_text );
+    r++;
+  }
+
+  fuse_ml_free_envs();
+
+  return r;
+}
+
+static void
+fuse_ml_free_states( void )
+{
+  size_t i;
+
+  for( i = 0; i < FUSE_ML_STATE_SLOTS; i++ ) {
+    if( fuse_ml_state_slots[i] ) {
+      libspectrum_snap_free( fuse_ml_state_slots[i] );
+      fuse_ml_state_slots[i] = NULL;
+    }
+  }
+
+  if( fuse_ml_reset_state ) {
+    libspectrum_snap_free( fuse_ml_reset_state );
+    fuse_ml_reset_state = NULL;
+  }
+}
+
+/* The instruction fetches so far, as counted for RZX files: R, with
+   rzx_instructions_offset making up for anything other than a fetch which
+   changes it, such as LD R,A or accepting a maskable interrupt */
+#define FUSE_ML_FETCHES ( z80.r + rzx_instructions_offset )
+
+/* With reward and done given and the game adapter on, the adapter is
+   checked at the end of every frame, so nothing in the middle of a step is
+   missed: the rewards are added up, and the step ends with the frame in
+   which the episode did */
+static int
+fuse_ml_step_frames( unsigned long frame_count, long *reward, int *done )
 {
+  int evaluate = reward && done && fuse_ml_game_enabled();
+  libspectrum_qword start = fuse_ml_stats_now();
   unsigned long i;
 
+  if( reward ) *reward = 0;
+  if( done ) *done = 0;
+
   for( i = 0; i < frame_count && !fuse_exiting; i++ ) {
     libspectrum_dword current_frame = spectrum_frame_count();
+    int fetches = FUSE_ML_FETCHES;
     size_t watchdog = 0;
 
     while( !fuse_exiting && spectrum_frame_count() == current_frame ) {
@@ -171,10 +711,42 @@ fuse_ml_step_frames( unsigned long frame_count )
       if( ++watchdog > 20000000 ) return 1;
     }
 
+    /* A frame is far fewer fetches than R counts up to */
+    fuse_ml_stats_count( FUSE_ML_STATS_INSTRUCTIONS,
+                         (libspectrum_word)( FUSE_ML_FETCHES - fetches ) );
+    fuse_ml_stats_count( FUSE_ML_STATS_FRAMES, 1 );
+
+    /* Only the last two frames of a step are max-pooled */
+    if( i + 2 >= frame_count ) fuse_ml_obs_capture();
+
     if( fuse_ml_visual_mode && fuse_ml_visual_pace_ms > 0 )
       timer_sleep( fuse_ml_visual_pace_ms );
+
+    if( evaluate ) {
+      long frame_reward;
+
+      if( fuse_ml_game_evaluate( &frame_reward, done ) ) return 1;
+      *reward += frame_reward;
+
+      if( *done ) {
+        /* The episode's last frame is the one to observe.  Unless it is
+           the first or last frame of the step, the frame before it was not
+           captured, so it must not be max-pooled with an older one */
+        if( i && i + 1 < frame_count ) {
+          fuse_ml_obs_forget();
+          fuse_ml_obs_capture();
+        } else if( i + 2 < frame_count ) {
+          fuse_ml_obs_capture();
+        }
+        break;
+      }
+    }
   }
 
+  if( frame_count ) fuse_ml_obs_push();
+
+  fuse_ml_stats_time( FUSE_ML_STATS_STEP, start );
+
   return 0;
 }
 
@@ -237,6 +809,8 @@ fuse_ml_write_memory( int fd, unsigned long address, const char *hexdata )
     writebyte_internal( (libspectrum_word)( address + i ), (libspectrum_byte)( (hi_val << 4) | lo_val ) );
   }
 
+  fuse_ml_record_mark();
+
   return fuse_ml_send_text( fd, "OK\n" );
 }
 
@@ -312,6 +886,7 @@ fuse_ml_send_screen( int fd )
   int width, height;
   int x, y;
   size_t used = 0;
+  libspectrum_qword start;
 
   fuse_ml_get_frame_dimensions( &width, &height );
 
@@ -319,6 +894,8 @@ fuse_ml_send_screen( int fd )
             width, height );
   if( fuse_ml_send_text( fd, header ) ) return 1;
 
+  start = fuse_ml_stats_now();
+
   for( y = 0; y < height; y++ ) {
     for( x = 0; x < width; x++ ) {
       int pixel = display_getpixel( x, y ) & 0xff;
@@ -335,42 +912,173 @@ fuse_ml_send_screen( int fd )
 
   if( used && fuse_ml_send( fd, chunk, used ) ) return 1;
 
+  fuse_ml_stats_time( FUSE_ML_STATS_OBS, start );
+
   return fuse_ml_send_text( fd, "\n" );
 }
 
 static int
-fuse_ml_action_step( int fd, unsigned long action, unsigned long frames )
+fuse_ml_send_obs( int fd )
 {
-  long reward = 0;
-  int done = 0;
-  const char *error_text = NULL;
-  char response[96];
+  static const char hex[] = "0123456789abcdef";
+  const libspectrum_byte *obs;
+  char header[80];
+  char chunk[4096];
+  int width, height, stack;
+  size_t i, length, used = 0;
+  libspectrum_qword start;
 
-  if( fuse_ml_apply_action( action, frames, &reward, &done, &error_text ) )
-    return fuse_ml_send_text( fd, error_text );
+  if( !fuse_ml_obs_enabled() )
+    return fuse_ml_send_text( fd, "ERR observations are off\n" );
 
-  snprintf( response, sizeof( response ), "ACT %u %ld %d\n",
-            (unsigned int)spectrum_frame_count(), reward, done );
-  return fuse_ml_send_text( fd, response );
+  fuse_ml_obs_dimensions( &width, &height, &stack );
+  start = fuse_ml_stats_now();
+  obs = fuse_ml_obs_get();
+  length = fuse_ml_obs_size();
+
+  snprintf( header, sizeof( header ), "OBS %d %d %d ", width, height, stack );
+  if( fuse_ml_send_text( fd, header ) ) return 1;
+
+  for( i = 0; i < length; i++ ) {
+    chunk[used++] = hex[ obs[i] >> 4 ];
+    chunk[used++] = hex[ obs[i] & 0x0f ];
+
+    if( used >= sizeof( chunk ) - 2 ) {
+      if( fuse_ml_send( fd, chunk, used ) ) return 1;
+      used = 0;
+    }
+  }
+
+  if( used && fuse_ml_send( fd, chunk, used ) ) return 1;
+
+  fuse_ml_stats_time( FUSE_ML_STATS_OBS, start );
+
+  return fuse_ml_send_text( fd, "\n" );
 }
 
+/* Send the STATS line and a HIST line for each timer */
 static int
-fuse_ml_parse_bool( const char *text, int *value )
+fuse_ml_send_stats( int fd )
 {
-  unsigned long parsed = 0;
-
-  if( !text || !value ) return 1;
-  if( fuse_ml_parse_ulong( text, &parsed ) ) return 1;
-  if( parsed > 1 ) return 1;
+  char response[ 40 + 21 * ( FUSE_ML_STATS_BUCKETS + 2 ) ];
+  fuse_ml_stats_timer timer;
+  size_t i, used;
+
+  snprintf( response, sizeof( response ), "STATS %llu %llu %llu %llu %llu\n",
+    (unsigned long long)fuse_ml_stats_counter_value( FUSE_ML_STATS_COMMANDS ),
+    (unsigned long long)fuse_ml_stats_counter_value( FUSE_ML_STATS_FRAMES ),
+    (unsigned long long)
+      fuse_ml_stats_counter_value( FUSE_ML_STATS_INSTRUCTIONS ),
+    (unsigned long long)fuse_ml_stats_counter_value( FUSE_ML_STATS_RESETS ),
+    (unsigned long long)
+      fuse_ml_stats_counter_value( FUSE_ML_STATS_BYTES_SENT ) );
+  if( fuse_ml_send_text( fd, response ) ) return 1;
+
+  for( timer = 0; timer < FUSE_ML_STATS_TIMERS; timer++ ) {
+    const fuse_ml_stats_histogram *histogram =
+      fuse_ml_stats_histogram_get( timer );
+
+    used = snprintf( response, sizeof( response ), "HIST %s %llu %llu",
+                     fuse_ml_stats_timer_name( timer ),
+                     (unsigned long long)histogram->count,
+                     (unsigned long long)histogram->total );
+
+    for( i = 0; i < FUSE_ML_STATS_BUCKETS; i++ )
+      used += snprintf( response + used, sizeof( response ) - used, " %llu",
+                        (unsigned long long)histogram->buckets[i] );
+
+    snprintf( response + used, sizeof( response ) - used, "\n" );
+    if( fuse_ml_send_text( fd, response ) ) return 1;
+  }
 
-  *value = parsed ? 1 : 0;
   return 0;
 }
 
+/* Send the WATCH line which follows a step, if there is a watch list */
 static int
-fuse_ml_parse_key_name( const char *text, unsigned long *key )
+fuse_ml_send_watch( int fd )
 {
-  size_t length;
+  static const char hex[] = "0123456789abcdef";
+  const libspectrum_byte *values;
+  char chunk[4096];
+  size_t i, entry, offset, length, used;
+
+  if( !fuse_ml_watch_count() ) return 0;
+
+  values = fuse_ml_watch_gather();
+
+  memcpy( chunk, "WATCH", 5 );
+  used = 5;
+
+  for( entry = 0; entry < fuse_ml_watch_count(); entry++ ) {
+    if( !fuse_ml_watch_changed( entry, &offset, &length ) &&
+        fuse_ml_watch_changes() )
+      continue;
+
+    /* Every value is run together unless only changes are sent */
+    if( fuse_ml_watch_changes() ) {
+      used += snprintf( &chunk[ used ], sizeof( chunk ) - used, " %lu:",
+                        (unsigned long)entry );
+    } else if( !entry ) {
+      chunk[ used++ ] = ' ';
+    }
+
+    for( i = 0; i < length; i++ ) {
+      chunk[ used++ ] = hex[ values[ offset + i ] >> 4 ];
+      chunk[ used++ ] = hex[ values[ offset + i ] & 0x0f ];
+
+      if( used >= sizeof( chunk ) - 2 ) {
+        if( fuse_ml_send( fd, chunk, used ) ) return 1;
+        used = 0;
+      }
+    }
+
+    if( used >= sizeof( chunk ) - 16 ) {
+      if( fuse_ml_send( fd, chunk, used ) ) return 1;
+      used = 0;
+    }
+  }
+
+  chunk[ used++ ] = '\n';
+
+  return fuse_ml_send( fd, chunk, used );
+}
+
+static int
+fuse_ml_action_step( int fd, unsigned long action, unsigned long frames )
+{
+  long reward = 0;
+  int done = 0;
+  const char *error_text = NULL;
+  char response[96];
+
+  if( fuse_ml_apply_action( action, frames, &reward, &done, &error_text ) )
+    return fuse_ml_send_text( fd, error_text );
+
+  snprintf( response, sizeof( response ), "ACT %u %ld %d\n",
+            (unsigned int)spectrum_frame_count(), reward, done );
+  if( fuse_ml_send_text( fd, response ) ) return 1;
+
+  return fuse_ml_send_watch( fd );
+}
+
+static int
+fuse_ml_parse_bool( const char *text, int *value )
+{
+  unsigned long parsed = 0;
+
+  if( !text || !value ) return 1;
+  if( fuse_ml_parse_ulong( text, &parsed ) ) return 1;
+  if( parsed > 1 ) return 1;
+
+  *value = parsed ? 1 : 0;
+  return 0;
+}
+
+static int
+fuse_ml_parse_key_name( const char *text, unsigned long *key )
+{
+  size_t length;
 
   if( !text || !*text || !key ) return 1;
 
@@ -471,10 +1179,43 @@ fuse_ml_parse_key_chord( const char *text, unsigned long *keys,
   return 0;
 }
 
+/* Parse a list of actions separated by commas, one for each instance */
 static int
-fuse_ml_apply_keys( const unsigned long *action_keys, size_t action_key_count,
-                    unsigned long frames, long *reward, int *done,
-                    const char **error_text, int require_game_adapter )
+fuse_ml_parse_actions( const char *text, unsigned long *actions,
+                       size_t max_actions, size_t *action_count )
+{
+  const char *cursor = text;
+  size_t count = 0;
+
+  while( 1 ) {
+    const char *sep = strchr( cursor, ',' );
+    size_t token_length = sep ? (size_t)( sep - cursor ) : strlen( cursor );
+    char token[32];
+
+    if( !token_length || token_length >= sizeof( token ) ||
+        count >= max_actions )
+      return 1;
+
+    memcpy( token, cursor, token_length );
+    token[token_length] = '\0';
+
+    if( fuse_ml_parse_ulong( token, &actions[ count++ ] ) ) return 1;
+
+    if( !sep ) break;
+    cursor = sep + 1;
+  }
+
+  *action_count = count;
+  return 0;
+}
+
+/* Press the keys, run the frames and let go, recording the step as action
+   if a recording is being made */
+static int
+fuse_ml_step_keys( unsigned long action, const unsigned long *action_keys,
+                   size_t action_key_count, unsigned long frames,
+                   long *reward, int *done, const char **error_text,
+                   int require_game_adapter )
 {
   unsigned long pressed_keys[ FUSE_ML_GAME_MAX_KEYS_PER_ACTION ];
   size_t pressed_count = 0;
@@ -490,6 +1231,11 @@ fuse_ml_apply_keys( const unsigned long *action_keys, size_t action_key_count,
     return 1;
   }
 
+  if( fuse_ml_record_prepare() ) {
+    if( error_text ) *error_text = "ERR recording keyframe failed\n";
+    return 1;
+  }
+
   for( i = 0; i < action_key_count; i++ ) {
     unsigned long key = action_keys[i];
 
@@ -508,7 +1254,7 @@ fuse_ml_apply_keys( const unsigned long *action_keys, size_t action_key_count,
     pressed_keys[pressed_count++] = key;
   }
 
-  if( fuse_ml_step_frames( frames ) ) {
+  if( fuse_ml_step_frames( frames, reward, done ) ) {
     for( i = pressed_count; i > 0; i-- )
       fuse_ml_key_event( INPUT_EVENT_KEYRELEASE, pressed_keys[i - 1] );
     if( error_text ) *error_text = "ERR step failed\n";
@@ -525,19 +1271,26 @@ fuse_ml_apply_keys( const unsigned long *action_keys, size_t action_key_count,
     return 1;
   }
 
-  if( fuse_ml_game_enabled() ) {
-    if( fuse_ml_game_evaluate( reward, done ) ) {
-      if( error_text ) *error_text = "ERR game evaluate failed\n";
-      return 1;
-    }
-  } else {
-    if( reward ) *reward = 0;
-    if( done ) *done = 0;
-  }
+  /* Keep the adapter's last values up to date for the next step */
+  if( !done && fuse_ml_game_enabled() ) fuse_ml_game_evaluate( NULL, NULL );
+
+  fuse_ml_record_step( action, action_keys, action_key_count, frames,
+                       spectrum_frame_count(), reward ? *reward : 0,
+                       done ? *done : 0 );
 
   return 0;
 }
 
+static int
+fuse_ml_apply_keys( const unsigned long *action_keys, size_t action_key_count,
+                    unsigned long frames, long *reward, int *done,
+                    const char **error_text, int require_game_adapter )
+{
+  return fuse_ml_step_keys( FUSE_ML_RECORD_NO_ACTION, action_keys,
+                            action_key_count, frames, reward, done,
+                            error_text, require_game_adapter );
+}
+
 static int
 fuse_ml_apply_action( unsigned long action, unsigned long frames,
                       long *reward, int *done, const char **error_text )
@@ -561,24 +1314,20 @@ fuse_ml_apply_action( unsigned long action, unsigned long frames,
     return 1;
   }
 
-  return fuse_ml_apply_keys( action_keys, action_key_count, frames,
-                             reward, done, error_text, 1 );
+  return fuse_ml_step_keys( action, action_keys, action_key_count, frames,
+                            reward, done, error_text, 1 );
 }
 
+/* Reset if asked to at the end of an episode and send the EPISODE line,
+   and the WATCH line if watch is set */
 static int
-fuse_ml_episode_step( int fd, unsigned long action, unsigned long frames,
-                      int auto_reset )
+fuse_ml_send_episode( int fd, long reward, int done, int auto_reset,
+                      int watch )
 {
-  long reward = 0;
-  int done = 0;
   int reset_performed = 0;
   int width, height;
-  const char *error_text = NULL;
   char response[160];
 
-  if( fuse_ml_apply_action( action, frames, &reward, &done, &error_text ) )
-    return fuse_ml_send_text( fd, error_text );
-
   if( done && auto_reset ) {
     if( fuse_ml_reset() ) return fuse_ml_send_text( fd, "ERR reset failed\n" );
     reset_performed = 1;
@@ -589,7 +1338,23 @@ fuse_ml_episode_step( int fd, unsigned long action, unsigned long frames,
   snprintf( response, sizeof( response ), "EPISODE %u %u %d %d %ld %d %d\n",
             (unsigned int)spectrum_frame_count(), (unsigned int)tstates,
             width, height, reward, done, reset_performed );
-  return fuse_ml_send_text( fd, response );
+  if( fuse_ml_send_text( fd, response ) ) return 1;
+
+  return watch ? fuse_ml_send_watch( fd ) : 0;
+}
+
+static int
+fuse_ml_episode_step( int fd, unsigned long action, unsigned long frames,
+                      int auto_reset )
+{
+  long reward = 0;
+  int done = 0;
+  const char *error_text = NULL;
+
+  if( fuse_ml_apply_action( action, frames, &reward, &done, &error_text ) )
+    return fuse_ml_send_text( fd, error_text );
+
+  return fuse_ml_send_episode( fd, reward, done, auto_reset, 1 );
 }
 
 static int
@@ -598,28 +1363,141 @@ fuse_ml_episode_step_keys( int fd, const unsigned long *keys, size_t key_count,
 {
   long reward = 0;
   int done = 0;
-  int reset_performed = 0;
-  int width, height;
   const char *error_text = NULL;
-  char response[160];
 
   if( fuse_ml_apply_keys( keys, key_count, frames, &reward, &done,
                           &error_text, 0 ) )
     return fuse_ml_send_text( fd, error_text );
 
+  return fuse_ml_send_episode( fd, reward, done, auto_reset, 1 );
+}
+
+/* Reset if asked to at the end of an episode and write the observation to
+   the shared memory ring */
+static int
+fuse_ml_shm_observe( long reward, int done, int auto_reset,
+                     libspectrum_dword *slot, libspectrum_dword *sequence,
+                     const char **error_text )
+{
+  int reset_performed = 0;
+  int width, height;
+  libspectrum_qword start;
+
   if( done && auto_reset ) {
-    if( fuse_ml_reset() ) return fuse_ml_send_text( fd, "ERR reset failed\n" );
+    if( fuse_ml_reset() ) {
+      *error_text = "ERR reset failed\n";
+      return 1;
+    }
     reset_performed = 1;
   }
 
   fuse_ml_get_frame_dimensions( &width, &height );
 
-  snprintf( response, sizeof( response ), "EPISODE %u %u %d %d %ld %d %d\n",
-            (unsigned int)spectrum_frame_count(), (unsigned int)tstates,
-            width, height, reward, done, reset_performed );
+  start = fuse_ml_stats_now();
+  if( fuse_ml_shm_publish( width, height, reward, done, reset_performed,
+                           slot, sequence ) ) {
+    *error_text = "ERR shared memory is off\n";
+    return 1;
+  }
+  fuse_ml_stats_time( FUSE_ML_STATS_OBS, start );
+
+  fuse_ml_record_observation( *sequence );
+
+  return 0;
+}
+
+static int
+fuse_ml_send_slot( int fd, long reward, int done, int auto_reset )
+{
+  libspectrum_dword slot, sequence;
+  const char *error_text = NULL;
+  char response[64];
+
+  if( fuse_ml_shm_observe( reward, done, auto_reset, &slot, &sequence,
+                           &error_text ) )
+    return fuse_ml_send_text( fd, error_text );
+
+  snprintf( response, sizeof( response ), "SLOT %lu %lu\n",
+            (unsigned long)slot, (unsigned long)sequence );
   return fuse_ml_send_text( fd, response );
 }
 
+/* Check each instance has an action and that the actions are valid before
+   any instance is stepped */
+static int
+fuse_ml_check_batch( const unsigned long *actions, size_t action_count,
+                     const char **error_text )
+{
+  unsigned long keys[ FUSE_ML_GAME_MAX_KEYS_PER_ACTION ];
+  size_t i, key_count;
+
+  if( !fuse_ml_env_count ) {
+    *error_text = "ERR no instances\n";
+    return 1;
+  }
+
+  if( action_count != fuse_ml_env_count ) {
+    *error_text = "ERR need an action for each instance\n";
+    return 1;
+  }
+
+  if( !fuse_ml_game_enabled() ) {
+    *error_text = "ERR game adapter disabled\n";
+    return 1;
+  }
+
+  for( i = 0; i < action_count; i++ ) {
+    if( fuse_ml_game_get_action_keys( actions[i], keys, ARRAY_SIZE( keys ),
+                                      &key_count ) ) {
+      *error_text = "ERR invalid action\n";
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Step each instance in turn, answering with a BATCH line and then an
+   EPISODE, SLOT or ERR line for each instance.  The last instance is left
+   live */
+static int
+fuse_ml_step_batch( int fd, const unsigned long *actions, size_t action_count,
+                    unsigned long frames, int auto_reset, int shm )
+{
+  const char *error_text = NULL;
+  char response[40];
+  size_t i;
+
+  if( shm && !fuse_ml_shm_enabled() )
+    return fuse_ml_send_text( fd, "ERR shared memory is off\n" );
+
+  if( fuse_ml_check_batch( actions, action_count, &error_text ) )
+    return fuse_ml_send_text( fd, error_text );
+
+  snprintf( response, sizeof( response ), "BATCH %lu\n",
+            (unsigned long)action_count );
+  if( fuse_ml_send_text( fd, response ) ) return 1;
+
+  for( i = 0; i < action_count; i++ ) {
+    long reward = 0;
+    int done = 0;
+    int error;
+
+    if( fuse_ml_switch_env( i, &error_text ) ||
+        fuse_ml_apply_action( actions[i], frames, &reward, &done,
+                              &error_text ) ) {
+      error = fuse_ml_send_text( fd, error_text );
+    } else {
+      error = shm ? fuse_ml_send_slot( fd, reward, done, auto_reset ) :
+                    fuse_ml_send_episode( fd, reward, done, auto_reset, 0 );
+    }
+
+    if( error ) return 1;
+  }
+
+  return 0;
+}
+
 static int
 fuse_ml_step_attrs( int fd, const unsigned long *keys, size_t key_count,
                     unsigned long frames )
@@ -651,7 +1529,10 @@ fuse_ml_step_attrs( int fd, const unsigned long *keys, size_t key_count,
   response[ prefix_len + ATTR_COUNT * 2 ]     = '\n';
   response[ prefix_len + ATTR_COUNT * 2 + 1 ] = '\0';
 
-  return fuse_ml_send( fd, response, prefix_len + ATTR_COUNT * 2 + 1 );
+  if( fuse_ml_send( fd, response, prefix_len + ATTR_COUNT * 2 + 1 ) )
+    return 1;
+
+  return fuse_ml_send_watch( fd );
 }
 
 static int
@@ -665,12 +1546,97 @@ fuse_ml_handle_command( int fd, char *line, int *disconnect )
 
   if( !command ) return 0;
 
+  fuse_ml_stats_count( FUSE_ML_STATS_COMMANDS, 1 );
+
+  /* Anything else sees the state left by the steps queued before it */
+  if( strcmp( command, "STEP_ASYNC" ) && strcmp( command, "WAIT" ) )
+    fuse_ml_async_run( fd, fuse_ml_async_next_ticket );
+
   if( !strcmp( command, "PING" ) ) {
     return fuse_ml_send_text( fd, "OK PONG\n" );
   } else if( !strcmp( command, "RESET" ) ) {
     if( arg1 || arg2 || arg3 || extra ) return fuse_ml_send_text( fd, "ERR usage: RESET\n" );
     if( fuse_ml_reset() ) return fuse_ml_send_text( fd, "ERR reset failed\n" );
     return fuse_ml_send_text( fd, "OK\n" );
+  } else if( !strcmp( command, "SAVESTATE" ) || !strcmp( command, "LOADSTATE" ) ) {
+    unsigned long slot;
+    const char *error_text = NULL;
+    int save = !strcmp( command, "SAVESTATE" );
+
+    if( !arg1 || arg2 || arg3 || extra )
+      return fuse_ml_send_text( fd, "ERR usage: SAVESTATE|LOADSTATE <slot>\n" );
+    if( fuse_ml_parse_ulong( arg1, &slot ) )
+      return fuse_ml_send_text( fd, "ERR invalid state slot\n" );
+
+    if( save ? fuse_ml_save_state( slot, &error_text ) :
+               fuse_ml_load_state( slot, &error_text ) )
+      return fuse_ml_send_text( fd, error_text );
+    return fuse_ml_send_text( fd, "OK\n" );
+  } else if( !strcmp( command, "CLONE" ) ) {
+    unsigned long id;
+    const char *error_text = NULL;
+    char response[40];
+
+    if( arg1 || arg2 || arg3 || extra ) return fuse_ml_send_text( fd, "ERR usage: CLONE\n" );
+    if( fuse_ml_branch_clone( &id, &error_text ) )
+      return fuse_ml_send_text( fd, error_text );
+
+    snprintf( response, sizeof( response ), "OK %lu\n", id );
+    return fuse_ml_send_text( fd, response );
+  } else if( !strcmp( command, "RESTORE" ) || !strcmp( command, "DROP" ) ) {
+    unsigned long id;
+    const char *error_text = NULL;
+    int restore = !strcmp( command, "RESTORE" );
+
+    if( !arg1 || arg2 || arg3 || extra )
+      return fuse_ml_send_text( fd, "ERR usage: RESTORE|DROP <id>\n" );
+    if( fuse_ml_parse_ulong( arg1, &id ) )
+      return fuse_ml_send_text( fd, "ERR no such branch\n" );
+
+    if( restore ? fuse_ml_restore_branch( id, &error_text ) :
+                  fuse_ml_drop_branch( id, &error_text ) )
+      return fuse_ml_send_text( fd, error_text );
+    return fuse_ml_send_text( fd, "OK\n" );
+  } else if( !strcmp( command, "BRANCHES" ) ) {
+    size_t branches, chunks;
+    char response[80];
+
+    if( arg1 || arg2 || arg3 || extra ) return fuse_ml_send_text( fd, "ERR usage: BRANCHES\n" );
+
+    fuse_ml_branch_stats( &branches, &chunks );
+    snprintf( response, sizeof( response ), "OK %lu %lu\n",
+              (unsigned long)branches, (unsigned long)chunks );
+    return fuse_ml_send_text( fd, response );
+  } else if( !strcmp( command, "FORK" ) ) {
+    unsigned long count, first, i;
+    const char *error_text = NULL;
+    char response[40];
+    int worker;
+
+    if( !arg1 || arg2 || arg3 || extra ) return fuse_ml_send_text( fd, "ERR usage: FORK <count>\n" );
+    if( fuse_ml_parse_ulong( arg1, &count ) || !count ||
+        count > FUSE_ML_MAX_WORKERS )
+      return fuse_ml_send_text( fd, "ERR invalid worker count\n" );
+
+    first = fuse_ml_next_worker;
+    if( fuse_ml_fork_workers( count, &worker, &error_text ) )
+      return fuse_ml_send_text( fd, error_text );
+
+    /* A new worker leaves this connection to its parent */
+    if( worker ) {
+      *disconnect = 1;
+      return 0;
+    }
+
+    if( fuse_ml_send_text( fd, "OK" ) ) return 1;
+    for( i = first; i < first + count; i++ ) {
+      snprintf( response, sizeof( response ), ".%lu", i );
+      if( fuse_ml_send_text( fd, " " ) ||
+          fuse_ml_send_text( fd, fuse_ml_socket_path ) ||
+          fuse_ml_send_text( fd, response ) )
+        return 1;
+    }
+    return fuse_ml_send_text( fd, "\n" );
   } else if( !strcmp( command, "KEYDOWN" ) || !strcmp( command, "KEYUP" ) ) {
     unsigned long key;
     input_event_type type =
@@ -679,6 +1645,7 @@ fuse_ml_handle_command( int fd, char *line, int *disconnect )
     if( !arg1 || arg2 || arg3 || extra ) return fuse_ml_send_text( fd, "ERR usage: KEYDOWN|KEYUP <key>\n" );
     if( fuse_ml_parse_ulong( arg1, &key ) ) return fuse_ml_send_text( fd, "ERR invalid key\n" );
     if( fuse_ml_key_event( type, key ) ) return fuse_ml_send_text( fd, "ERR key event failed\n" );
+    fuse_ml_record_mark();
     return fuse_ml_send_text( fd, "OK\n" );
   } else if( !strcmp( command, "STEP" ) ) {
     unsigned long frames;
@@ -686,7 +1653,8 @@ fuse_ml_handle_command( int fd, char *line, int *disconnect )
 
     if( !arg1 || arg2 || arg3 || extra ) return fuse_ml_send_text( fd, "ERR usage: STEP <frames>\n" );
     if( fuse_ml_parse_ulong( arg1, &frames ) ) return fuse_ml_send_text( fd, "ERR invalid frame count\n" );
-    if( fuse_ml_step_frames( frames ) ) return fuse_ml_send_text( fd, "ERR step failed\n" );
+    if( fuse_ml_step_frames( frames, NULL, NULL ) ) return fuse_ml_send_text( fd, "ERR step failed\n" );
+    fuse_ml_record_mark();
 
     snprintf( response, sizeof( response ), "OK %u\n",
               (unsigned int)spectrum_frame_count() );
@@ -756,27 +1724,205 @@ fuse_ml_handle_command( int fd, char *line, int *disconnect )
       return fuse_ml_send_text( fd, "ERR invalid action or frame count\n" );
 
     return fuse_ml_action_step( fd, action, frames );
-  } else if( !strcmp( command, "EPISODE_STEP" ) ) {
+  } else if( !strcmp( command, "EPISODE_STEP" ) ||
+             !strcmp( command, "SHM_EPISODE_STEP" ) ||
+             !strcmp( command, "OBS_EPISODE_STEP" ) ) {
     unsigned long action, frames;
     int auto_reset = 0;
+    int shm = !strcmp( command, "SHM_EPISODE_STEP" );
+    int obs = !strcmp( command, "OBS_EPISODE_STEP" );
+    long reward = 0;
+    int done = 0;
+    const char *error_text = NULL;
 
     if( !arg1 || !arg2 || extra )
-      return fuse_ml_send_text( fd, "ERR usage: EPISODE_STEP <action> <frames> [auto_reset_0_or_1]\n" );
+      return fuse_ml_send_text( fd, shm ?
+        "ERR usage: SHM_EPISODE_STEP <action> <frames> [auto_reset_0_or_1]\n" :
+        obs ?
+        "ERR usage: OBS_EPISODE_STEP <action> <frames> [auto_reset_0_or_1]\n" :
+        "ERR usage: EPISODE_STEP <action> <frames> [auto_reset_0_or_1]\n" );
+    if( fuse_ml_parse_ulong( arg1, &action ) ||
+        fuse_ml_parse_ulong( arg2, &frames ) )
+      return fuse_ml_send_text( fd, "ERR invalid action or frame count\n" );
+    if( arg3 && fuse_ml_parse_bool( arg3, &auto_reset ) )
+      return fuse_ml_send_text( fd, "ERR invalid auto_reset value\n" );
+
+    if( obs ) {
+      if( !fuse_ml_obs_enabled() )
+        return fuse_ml_send_text( fd, "ERR observations are off\n" );
+      if( fuse_ml_apply_action( action, frames, &reward, &done, &error_text ) )
+        return fuse_ml_send_text( fd, error_text );
+      if( fuse_ml_send_episode( fd, reward, done, auto_reset, 0 ) ||
+          fuse_ml_send_obs( fd ) )
+        return 1;
+      return fuse_ml_send_watch( fd );
+    }
+
+    if( !shm ) return fuse_ml_episode_step( fd, action, frames, auto_reset );
+
+    if( !fuse_ml_shm_enabled() )
+      return fuse_ml_send_text( fd, "ERR shared memory is off\n" );
+    if( fuse_ml_apply_action( action, frames, &reward, &done, &error_text ) )
+      return fuse_ml_send_text( fd, error_text );
+
+    return fuse_ml_send_slot( fd, reward, done, auto_reset );
+  } else if( !strcmp( command, "STEP_ASYNC" ) ) {
+    unsigned long action, frames, instance;
+    int auto_reset = 0;
+    libspectrum_dword ticket;
+    const char *error_text = NULL;
+    char response[40];
+
+    if( !arg1 || !arg2 )
+      return fuse_ml_send_text( fd, "ERR usage: STEP_ASYNC <action> <frames> [auto_reset_0_or_1] [instance]\n" );
     if( fuse_ml_parse_ulong( arg1, &action ) ||
         fuse_ml_parse_ulong( arg2, &frames ) )
       return fuse_ml_send_text( fd, "ERR invalid action or frame count\n" );
     if( arg3 && fuse_ml_parse_bool( arg3, &auto_reset ) )
       return fuse_ml_send_text( fd, "ERR invalid auto_reset value\n" );
+    if( extra && ( fuse_ml_parse_ulong( extra, &instance ) ||
+                   instance >= FUSE_ML_MAX_ENVS ) )
+      return fuse_ml_send_text( fd, "ERR no such instance\n" );
+
+    if( fuse_ml_async_queue( action, frames, auto_reset,
+                             extra ? (long)instance : -1, 0, &ticket,
+                             &error_text ) )
+      return fuse_ml_send_text( fd, error_text );
+
+    snprintf( response, sizeof( response ), "TICKET %lu\n",
+              (unsigned long)ticket );
+    return fuse_ml_send_text( fd, response );
+  } else if( !strcmp( command, "WAIT" ) ) {
+    unsigned long ticket;
+    const char *error_text = NULL;
+    int error;
+
+    if( !arg1 || arg2 ) return fuse_ml_send_text( fd, "ERR usage: WAIT <ticket>\n" );
+    if( fuse_ml_parse_ulong( arg1, &ticket ) )
+      return fuse_ml_send_text( fd, "ERR no such ticket\n" );
+
+    error = fuse_ml_async_wait( fd, ticket, 0, &error_text );
+    if( error < 0 ) return fuse_ml_send_text( fd, error_text );
+
+    return error;
+  } else if( !strcmp( command, "STEP_BATCH" ) ||
+             !strcmp( command, "SHM_STEP_BATCH" ) ) {
+    unsigned long actions[ FUSE_ML_MAX_ENVS ];
+    size_t action_count;
+    unsigned long frames;
+    int auto_reset = 0;
+    int shm = !strcmp( command, "SHM_STEP_BATCH" );
+
+    if( !arg1 || !arg2 || extra )
+      return fuse_ml_send_text( fd, shm ?
+        "ERR usage: SHM_STEP_BATCH <action,...> <frames> [auto_reset_0_or_1]\n" :
+        "ERR usage: STEP_BATCH <action,...> <frames> [auto_reset_0_or_1]\n" );
+    if( fuse_ml_parse_actions( arg1, actions, ARRAY_SIZE( actions ),
+                               &action_count ) ||
+        fuse_ml_parse_ulong( arg2, &frames ) )
+      return fuse_ml_send_text( fd, "ERR invalid action or frame count\n" );
+    if( arg3 && fuse_ml_parse_bool( arg3, &auto_reset ) )
+      return fuse_ml_send_text( fd, "ERR invalid auto_reset value\n" );
+
+    return fuse_ml_step_batch( fd, actions, action_count, frames, auto_reset,
+                               shm );
+  } else if( !strcmp( command, "WATCH" ) ) {
+    fuse_ml_watch_entry entries[ FUSE_ML_WATCH_MAX_ENTRIES ];
+    size_t count = 0;
+    int changes = 0;
+    const char *error_text = NULL;
+    char response[40];
+
+    if( !arg1 || arg3 || extra )
+      return fuse_ml_send_text( fd, "ERR usage: WATCH <address:length[@bank],...|OFF> [changes_0_or_1]\n" );
+    if( strcmp( arg1, "OFF" ) &&
+        fuse_ml_watch_parse( arg1, entries, &count ) )
+      return fuse_ml_send_text( fd, "ERR invalid watch entry\n" );
+    if( arg2 && fuse_ml_parse_bool( arg2, &changes ) )
+      return fuse_ml_send_text( fd, "ERR invalid changes value\n" );
+    if( fuse_ml_watch_set( entries, count, changes, &error_text ) )
+      return fuse_ml_send_text( fd, error_text );
+
+    snprintf( response, sizeof( response ), "OK %lu\n",
+              (unsigned long)fuse_ml_watch_length() );
+    return fuse_ml_send_text( fd, response );
+  } else if( !strcmp( command, "RECORD" ) ) {
+    unsigned long interval = FUSE_ML_RECORD_DEFAULT_INTERVAL, steps, keyframes;
+    const char *error_text = NULL;
+    char response[40];
+
+    if( !arg1 || arg3 || extra )
+      return fuse_ml_send_text( fd, "ERR usage: RECORD <file|OFF> [keyframe_interval]\n" );
+
+    if( !strcmp( arg1, "OFF" ) ) {
+      if( arg2 ) return fuse_ml_send_text( fd, "ERR usage: RECORD OFF\n" );
+      if( fuse_ml_record_stop( &steps, &keyframes, &error_text ) )
+        return fuse_ml_send_text( fd, error_text );
+
+      snprintf( response, sizeof( response ), "OK %lu %lu\n", steps,
+                keyframes );
+      return fuse_ml_send_text( fd, response );
+    }
+
+    if( arg2 && fuse_ml_parse_ulong( arg2, &interval ) )
+      return fuse_ml_send_text( fd, "ERR invalid keyframe interval\n" );
+    if( fuse_ml_record_start( arg1, interval, &error_text ) )
+      return fuse_ml_send_text( fd, error_text );
+    fuse_ml_record_select( fuse_ml_env_live );
+
+    return fuse_ml_send_text( fd, "OK\n" );
+  } else if( !strcmp( command, "STATS" ) ) {
+    if( arg2 || arg3 || extra || ( arg1 && strcmp( arg1, "RESET" ) ) )
+      return fuse_ml_send_text( fd, "ERR usage: STATS [RESET]\n" );
+
+    if( fuse_ml_send_stats( fd ) ) return 1;
+    if( arg1 ) fuse_ml_stats_clear();
+
+    return 0;
+  } else if( !strcmp( command, "ENVS" ) ) {
+    unsigned long count;
+    const char *error_text = NULL;
+    char response[40];
+
+    if( !arg1 || arg2 || arg3 || extra ) return fuse_ml_send_text( fd, "ERR usage: ENVS <count>\n" );
+    if( fuse_ml_parse_ulong( arg1, &count ) )
+      return fuse_ml_send_text( fd, "ERR invalid instance count\n" );
+    if( fuse_ml_make_envs( count, &error_text ) )
+      return fuse_ml_send_text( fd, error_text );
+
+    snprintf( response, sizeof( response ), "OK %lu\n", count );
+    return fuse_ml_send_text( fd, response );
+  } else if( !strcmp( command, "ENV" ) ) {
+    unsigned long env;
+    const char *error_text = NULL;
+    char response[64];
+
+    if( arg2 || arg3 || extra ) return fuse_ml_send_text( fd, "ERR usage: ENV [instance]\n" );
+    if( arg1 ) {
+      if( fuse_ml_parse_ulong( arg1, &env ) )
+        return fuse_ml_send_text( fd, "ERR no such instance\n" );
+      if( fuse_ml_switch_env( env, &error_text ) )
+        return fuse_ml_send_text( fd, error_text );
+    }
 
-    return fuse_ml_episode_step( fd, action, frames, auto_reset );
-  } else if( !strcmp( command, "EPISODE_STEP_KEYS" ) ) {
+    snprintf( response, sizeof( response ), "OK %lu %lu\n",
+              fuse_ml_env_live, fuse_ml_env_count );
+    return fuse_ml_send_text( fd, response );
+  } else if( !strcmp( command, "EPISODE_STEP_KEYS" ) ||
+             !strcmp( command, "SHM_EPISODE_STEP_KEYS" ) ) {
     unsigned long keys[ FUSE_ML_GAME_MAX_KEYS_PER_ACTION ];
     size_t key_count = 0;
     unsigned long frames;
     int auto_reset = 0;
+    int shm = !strcmp( command, "SHM_EPISODE_STEP_KEYS" );
+    long reward = 0;
+    int done = 0;
+    const char *error_text = NULL;
 
     if( !arg1 || !arg2 || extra )
-      return fuse_ml_send_text( fd, "ERR usage: EPISODE_STEP_KEYS <key_chord> <frames> [auto_reset_0_or_1]\n" );
+      return fuse_ml_send_text( fd, shm ?
+        "ERR usage: SHM_EPISODE_STEP_KEYS <key_chord> <frames> [auto_reset_0_or_1]\n" :
+        "ERR usage: EPISODE_STEP_KEYS <key_chord> <frames> [auto_reset_0_or_1]\n" );
     if( fuse_ml_parse_key_chord( arg1, keys, ARRAY_SIZE( keys ), &key_count ) )
       return fuse_ml_send_text( fd, "ERR invalid key chord\n" );
     if( fuse_ml_parse_ulong( arg2, &frames ) )
@@ -784,7 +1930,29 @@ fuse_ml_handle_command( int fd, char *line, int *disconnect )
     if( arg3 && fuse_ml_parse_bool( arg3, &auto_reset ) )
       return fuse_ml_send_text( fd, "ERR invalid auto_reset value\n" );
 
-    return fuse_ml_episode_step_keys( fd, keys, key_count, frames, auto_reset );
+    if( !shm )
+      return fuse_ml_episode_step_keys( fd, keys, key_count, frames, auto_reset );
+
+    if( !fuse_ml_shm_enabled() )
+      return fuse_ml_send_text( fd, "ERR shared memory is off\n" );
+    if( fuse_ml_apply_keys( keys, key_count, frames, &reward, &done,
+                            &error_text, 0 ) )
+      return fuse_ml_send_text( fd, error_text );
+
+    return fuse_ml_send_slot( fd, reward, done, auto_reset );
+  } else if( !strcmp( command, "SHM" ) ) {
+    char response[ 128 ];
+
+    if( arg1 || arg2 || arg3 || extra ) return fuse_ml_send_text( fd, "ERR usage: SHM\n" );
+    if( fuse_ml_shm_info( response, sizeof( response ) ) )
+      return fuse_ml_send_text( fd, "ERR shared memory info unavailable\n" );
+    return fuse_ml_send_text( fd, response );
+  } else if( !strcmp( command, "SHM_OBS" ) ) {
+    if( arg1 || arg2 || arg3 || extra ) return fuse_ml_send_text( fd, "ERR usage: SHM_OBS\n" );
+    return fuse_ml_send_slot( fd, 0, 0, 0 );
+  } else if( !strcmp( command, "OBS" ) ) {
+    if( arg1 || arg2 || arg3 || extra ) return fuse_ml_send_text( fd, "ERR usage: OBS\n" );
+    return fuse_ml_send_obs( fd );
   } else if( !strcmp( command, "GETATTRS" ) ) {
     if( arg1 || arg2 || arg3 || extra ) return fuse_ml_send_text( fd, "ERR usage: GETATTRS\n" );
     return fuse_ml_send_attrs( fd );
@@ -801,6 +1969,31 @@ fuse_ml_handle_command( int fd, char *line, int *disconnect )
       return fuse_ml_send_text( fd, "ERR invalid frame count\n" );
 
     return fuse_ml_step_attrs( fd, keys, key_count, frames );
+  } else if( !strcmp( command, "TRACE" ) ) {
+    size_t records;
+    char response[80];
+
+    if( !arg1 || arg2 || arg3 || extra ) return fuse_ml_send_text( fd, "ERR usage: TRACE <path>\n" );
+    if( !z80_trace_records ) return fuse_ml_send_text( fd, "ERR tracing is off\n" );
+    if( !z80_trace_dump_file( arg1, &records ) )
+      return fuse_ml_send_text( fd, "ERR trace write failed\n" );
+
+    snprintf( response, sizeof( response ), "OK %lu\n", (unsigned long)records );
+    return fuse_ml_send_text( fd, response );
+  } else if( !strcmp( command, "PROTO" ) ) {
+    if( !arg1 ) return fuse_ml_send_text( fd, "PROTO TEXT\n" );
+    if( arg2 || arg3 || extra ) return fuse_ml_send_text( fd, "ERR usage: PROTO [TEXT|BINARY]\n" );
+
+    if( !strcmp( arg1, "TEXT" ) ) return fuse_ml_send_text( fd, "OK PROTO TEXT\n" );
+
+    if( !strcmp( arg1, "BINARY" ) ) {
+      /* Everything after this response is framed */
+      if( fuse_ml_send_text( fd, "OK PROTO BINARY\n" ) ) return 1;
+      fuse_ml_binary_protocol = 1;
+      return 0;
+    }
+
+    return fuse_ml_send_text( fd, "ERR protocol must be TEXT or BINARY\n" );
   } else if( !strcmp( command, "QUIT" ) ) {
     fuse_exiting = 1;
     *disconnect = 1;
@@ -810,66 +2003,1131 @@ fuse_ml_handle_command( int fd, char *line, int *disconnect )
   return fuse_ml_send_text( fd, "ERR unknown command\n" );
 }
 
-int
-fuse_ml_init_socket( void )
+static libspectrum_byte*
+fuse_ml_put_word( libspectrum_byte *buffer, libspectrum_word value )
 {
-  struct sockaddr_un addr;
+  *buffer++ = value & 0xff;
+  *buffer++ = value >> 8;
 
-  if( !fuse_ml_mode ) return 0;
+  return buffer;
+}
 
-  fuse_ml_server_fd = socket( AF_UNIX, SOCK_STREAM, 0 );
-  if( fuse_ml_server_fd < 0 ) {
-    ui_error( UI_ERROR_ERROR, "ML bridge failed to create socket: %s",
-              strerror( errno ) );
-    return 1;
-  }
+static libspectrum_byte*
+fuse_ml_put_dword( libspectrum_byte *buffer, libspectrum_dword value )
+{
+  buffer = fuse_ml_put_word( buffer, value & 0xffff );
+  return fuse_ml_put_word( buffer, value >> 16 );
+}
 
-  memset( &addr, 0, sizeof( addr ) );
-  addr.sun_family = AF_UNIX;
+static libspectrum_byte*
+fuse_ml_put_qword( libspectrum_byte *buffer, libspectrum_qword value )
+{
+  buffer = fuse_ml_put_dword( buffer, value & 0xffffffff );
+  return fuse_ml_put_dword( buffer, value >> 32 );
+}
 
-  if( strlen( fuse_ml_socket_path ) >= sizeof( addr.sun_path ) ) {
-    ui_error( UI_ERROR_ERROR, "ML bridge socket path too long: %s",
-              fuse_ml_socket_path );
-    close( fuse_ml_server_fd );
-    fuse_ml_server_fd = -1;
+static libspectrum_word
+fuse_ml_get_word( const libspectrum_byte *buffer )
+{
+  return buffer[0] | ( buffer[1] << 8 );
+}
+
+static libspectrum_dword
+fuse_ml_get_dword( const libspectrum_byte *buffer )
+{
+  return fuse_ml_get_word( buffer ) |
+         ( (libspectrum_dword)fuse_ml_get_word( buffer + 2 ) << 16 );
+}
+
+static int
+fuse_ml_binary_send_header( int fd, fuse_ml_binary_command command,
+                            fuse_ml_binary_status status, size_t length )
+{
+  libspectrum_byte header[ FUSE_ML_BINARY_HEADER_LENGTH ];
+
+  header[0] = command;
+  header[1] = status;
+  header[2] = header[3] = 0;
+  fuse_ml_put_dword( &header[4], length );
+
+  return fuse_ml_send( fd, (const char*)header, sizeof( header ) );
+}
+
+static int
+fuse_ml_binary_send( int fd, fuse_ml_binary_command command,
+                     const libspectrum_byte *payload, size_t length )
+{
+  if( fuse_ml_binary_send_header( fd, command, FUSE_ML_BINARY_STATUS_OK,
+                                  length ) )
+    return 1;
+
+  return length ? fuse_ml_send( fd, (const char*)payload, length ) : 0;
+}
+
+/* Errors carry the same message as the text protocol, without the "ERR "
+   and the newline */
+static int
+fuse_ml_binary_send_error( int fd, fuse_ml_binary_command command,
+                           const char *error_text )
+{
+  size_t length;
+
+  if( !strncmp( error_text, "ERR ", 4 ) ) error_text += 4;
+
+  length = strlen( error_text );
+  if( length && error_text[ length - 1 ] == '\n' ) length--;
+
+  if( fuse_ml_binary_send_header( fd, command, FUSE_ML_BINARY_STATUS_ERROR,
+                                  length ) )
+    return 1;
+
+  return fuse_ml_send( fd, error_text, length );
+}
+
+static void
+fuse_ml_read_attrs( libspectrum_byte *buffer )
+{
+  int i;
+
+  for( i = 0; i < FUSE_ML_ATTR_COUNT; i++ )
+    buffer[i] = readbyte_internal( (libspectrum_word)( FUSE_ML_ATTR_BASE + i ) );
+}
+
+static int
+fuse_ml_binary_send_screen( int fd )
+{
+  libspectrum_byte chunk[4096];
+  int width, height;
+  int x, y;
+  size_t used = 0;
+  libspectrum_qword start = fuse_ml_stats_now();
+
+  fuse_ml_get_frame_dimensions( &width, &height );
+
+  if( fuse_ml_binary_send_header( fd, FUSE_ML_BINARY_GETSCREEN,
+                                  FUSE_ML_BINARY_STATUS_OK,
+                                  4 + (size_t)width * height ) )
+    return 1;
+
+  fuse_ml_put_word( &chunk[0], width );
+  fuse_ml_put_word( &chunk[2], height );
+  used = 4;
+
+  for( y = 0; y < height; y++ ) {
+    for( x = 0; x < width; x++ ) {
+      chunk[used++] = display_getpixel( x, y ) & 0xff;
+
+      if( used == sizeof( chunk ) ) {
+        if( fuse_ml_send( fd, (const char*)chunk, used ) ) return 1;
+        used = 0;
+      }
+    }
+  }
+
+  if( used && fuse_ml_send( fd, (const char*)chunk, used ) ) return 1;
+
+  fuse_ml_stats_time( FUSE_ML_STATS_OBS, start );
+
+  return 0;
+}
+
+#define FUSE_ML_BINARY_STATS_LENGTH \
+  ( 8 * ( FUSE_ML_STATS_COUNTERS + \
+          FUSE_ML_STATS_TIMERS * ( FUSE_ML_STATS_BUCKETS + 2 ) ) )
+
+static int
+fuse_ml_binary_send_stats( int fd )
+{
+  libspectrum_byte response[ FUSE_ML_BINARY_STATS_LENGTH ], *ptr = response;
+  fuse_ml_stats_counter counter;
+  fuse_ml_stats_timer timer;
+  size_t i;
+
+  for( counter = 0; counter < FUSE_ML_STATS_COUNTERS; counter++ )
+    ptr = fuse_ml_put_qword( ptr, fuse_ml_stats_counter_value( counter ) );
+
+  for( timer = 0; timer < FUSE_ML_STATS_TIMERS; timer++ ) {
+    const fuse_ml_stats_histogram *histogram =
+      fuse_ml_stats_histogram_get( timer );
+
+    ptr = fuse_ml_put_qword( ptr, histogram->count );
+    ptr = fuse_ml_put_qword( ptr, histogram->total );
+    for( i = 0; i < FUSE_ML_STATS_BUCKETS; i++ )
+      ptr = fuse_ml_put_qword( ptr, histogram->buckets[i] );
+  }
+
+  return fuse_ml_binary_send( fd, FUSE_ML_BINARY_STATS, response,
+                              ptr - response );
+}
+
+/* The keys of a chord are a count byte followed by a word for each key */
+static int
+fuse_ml_binary_get_keys( const libspectrum_byte *payload, size_t length,
+                         unsigned long *keys, size_t *key_count )
+{
+  size_t i;
+
+  if( length < 1 ) return 1;
+
+  *key_count = payload[0];
+  if( *key_count > FUSE_ML_GAME_MAX_KEYS_PER_ACTION ||
+      length != 1 + *key_count * 4 )
     return 1;
+
+  for( i = 0; i < *key_count; i++ )
+    keys[i] = fuse_ml_get_dword( &payload[ 1 + i * 4 ] );
+
+  return 0;
+}
+
+#define FUSE_ML_BINARY_EPISODE_LENGTH 18
+
+#define FUSE_ML_BINARY_WATCH_LENGTH \
+  ( 1 + FUSE_ML_WATCH_MAX_ENTRIES + FUSE_ML_WATCH_MAX_LENGTH )
+
+/* Write the watched values which follow a step to buffer: all of them, or
+   a count of those which changed then the index and value of each */
+static size_t
+fuse_ml_binary_put_watch( libspectrum_byte *buffer )
+{
+  const libspectrum_byte *values;
+  libspectrum_byte *ptr = buffer + 1;
+  size_t entry, offset, length;
+
+  if( !fuse_ml_watch_count() ) return 0;
+
+  values = fuse_ml_watch_gather();
+
+  if( !fuse_ml_watch_changes() ) {
+    memcpy( buffer, values, fuse_ml_watch_length() );
+    return fuse_ml_watch_length();
   }
 
-  strcpy( addr.sun_path, fuse_ml_socket_path );
+  buffer[0] = 0;
+  for( entry = 0; entry < fuse_ml_watch_count(); entry++ ) {
+    if( !fuse_ml_watch_changed( entry, &offset, &length ) ) continue;
 
-  unlink( fuse_ml_socket_path );
+    buffer[0]++;
+    *ptr++ = entry;
+    memcpy( ptr, values + offset, length );
+    ptr += length;
+  }
 
-  if( bind( fuse_ml_server_fd, (struct sockaddr*)&addr, sizeof( addr ) ) ) {
-    ui_error( UI_ERROR_ERROR, "ML bridge bind failed for %s: %s",
-              fuse_ml_socket_path, strerror( errno ) );
-    close( fuse_ml_server_fd );
-    fuse_ml_server_fd = -1;
+  return ptr - buffer;
+}
+
+/* As fuse_ml_binary_send(), with the watched values after the response */
+static int
+fuse_ml_binary_send_step( int fd, fuse_ml_binary_command command,
+                          const libspectrum_byte *payload, size_t length )
+{
+  static libspectrum_byte watch[ FUSE_ML_BINARY_WATCH_LENGTH ];
+  size_t watch_length = fuse_ml_binary_put_watch( watch );
+
+  if( fuse_ml_binary_send_header( fd, command, FUSE_ML_BINARY_STATUS_OK,
+                                  length + watch_length ) ||
+      fuse_ml_send( fd, (const char*)payload, length ) )
     return 1;
+
+  return watch_length ? fuse_ml_send( fd, (const char*)watch, watch_length ) :
+                        0;
+}
+
+/* Reset if asked to at the end of an episode and write the episode result
+   to buffer; returns NULL if the reset fails */
+static libspectrum_byte*
+fuse_ml_binary_put_episode( libspectrum_byte *buffer, long reward, int done,
+                            int auto_reset )
+{
+  int reset_performed = 0;
+  int width, height;
+
+  if( done && auto_reset ) {
+    if( fuse_ml_reset() ) return NULL;
+    reset_performed = 1;
+  }
+
+  fuse_ml_get_frame_dimensions( &width, &height );
+
+  buffer = fuse_ml_put_dword( buffer, spectrum_frame_count() );
+  buffer = fuse_ml_put_dword( buffer, tstates );
+  buffer = fuse_ml_put_word( buffer, width );
+  buffer = fuse_ml_put_word( buffer, height );
+  buffer = fuse_ml_put_dword( buffer, (libspectrum_dword)reward );
+  *buffer++ = done;
+  *buffer++ = reset_performed;
+
+  return buffer;
+}
+
+static int
+fuse_ml_binary_send_episode( int fd, fuse_ml_binary_command command,
+                             long reward, int done, int auto_reset )
+{
+  libspectrum_byte response[ FUSE_ML_BINARY_EPISODE_LENGTH ];
+
+  if( !fuse_ml_binary_put_episode( response, reward, done, auto_reset ) )
+    return fuse_ml_binary_send_error( fd, command, "ERR reset failed\n" );
+
+  return fuse_ml_binary_send_step( fd, command, response, sizeof( response ) );
+}
+
+static void
+fuse_ml_async_clear( void )
+{
+  size_t i;
+
+  for( i = 0; i < FUSE_ML_ASYNC_SLOTS; i++ )
+    fuse_ml_async_steps[i].state = FUSE_ML_ASYNC_FREE;
+
+  fuse_ml_async_next_ticket = fuse_ml_async_next_run = 0;
+}
+
+static int
+fuse_ml_async_queue( unsigned long action, unsigned long frames,
+                     int auto_reset, long instance, int binary,
+                     libspectrum_dword *ticket, const char **error_text )
+{
+  fuse_ml_async_step *step =
+    &fuse_ml_async_steps[ fuse_ml_async_next_ticket % FUSE_ML_ASYNC_SLOTS ];
+
+  if( step->state != FUSE_ML_ASYNC_FREE ) {
+    *error_text = "ERR too many steps pending\n";
+    return 1;
+  }
+
+  if( instance >= 0 && (unsigned long)instance >= fuse_ml_env_count ) {
+    *error_text = "ERR no such instance\n";
+    return 1;
+  }
+
+  step->state = FUSE_ML_ASYNC_QUEUED;
+  step->ticket = fuse_ml_async_next_ticket++;
+  step->binary = binary;
+  step->action = action;
+  step->frames = frames;
+  step->auto_reset = auto_reset;
+  step->instance = instance;
+
+  *ticket = step->ticket;
+
+  return 0;
+}
+
+/* Run the queued steps with tickets before until, keeping their responses */
+static void
+fuse_ml_async_run( int fd, libspectrum_dword until )
+{
+  while( fuse_ml_async_next_run != until ) {
+    fuse_ml_async_step *step =
+      &fuse_ml_async_steps[ fuse_ml_async_next_run++ % FUSE_ML_ASYNC_SLOTS ];
+    const char *error_text = NULL;
+    long reward = 0;
+    int done = 0;
+
+    step->response_length = 0;
+    fuse_ml_async_capture = step;
+
+    if( step->instance >= 0 &&
+        fuse_ml_switch_env( step->instance, &error_text ) ) {
+      if( step->binary )
+        fuse_ml_binary_send_error( fd, FUSE_ML_BINARY_WAIT, error_text );
+      else
+        fuse_ml_send_text( fd, error_text );
+    } else if( !step->binary ) {
+      fuse_ml_episode_step( fd, step->action, step->frames,
+                            step->auto_reset );
+    } else if( fuse_ml_apply_action( step->action, step->frames, &reward,
+                                     &done, &error_text ) ) {
+      fuse_ml_binary_send_error( fd, FUSE_ML_BINARY_WAIT, error_text );
+    } else {
+      fuse_ml_binary_send_episode( fd, FUSE_ML_BINARY_WAIT, reward, done,
+                                   step->auto_reset );
+    }
+
+    fuse_ml_async_capture = NULL;
+    step->state = FUSE_ML_ASYNC_FINISHED;
+  }
+}
+
+/* Send the response of a step, running it first if need be */
+static int
+fuse_ml_async_wait( int fd, unsigned long ticket, int binary,
+                    const char **error_text )
+{
+  fuse_ml_async_step *step =
+    &fuse_ml_async_steps[ ticket % FUSE_ML_ASYNC_SLOTS ];
+
+  if( step->state == FUSE_ML_ASYNC_FREE || step->ticket != ticket ) {
+    *error_text = "ERR no such ticket\n";
+    return -1;
+  }
+
+  if( step->binary != binary ) {
+    *error_text = "ERR ticket is for the other protocol\n";
+    return -1;
+  }
+
+  if( step->state == FUSE_ML_ASYNC_QUEUED )
+    fuse_ml_async_run( fd, step->ticket + 1 );
+
+  step->state = FUSE_ML_ASYNC_FREE;
+
+  return fuse_ml_send( fd, step->response, step->response_length );
+}
+
+/* Send the observation; after a step, it comes between the episode result
+   and the watched values */
+static int
+fuse_ml_binary_send_obs( int fd, fuse_ml_binary_command command,
+                         const libspectrum_byte *episode )
+{
+  static libspectrum_byte watch[ FUSE_ML_BINARY_WATCH_LENGTH ];
+  libspectrum_byte header[ FUSE_ML_BINARY_EPISODE_LENGTH + 5 ], *buffer;
+  const libspectrum_byte *obs;
+  int width, height, stack;
+  size_t length, watch_length = 0;
+  libspectrum_qword start;
+
+  if( !fuse_ml_obs_enabled() )
+    return fuse_ml_binary_send_error( fd, command,
+                                      "ERR observations are off\n" );
+
+  fuse_ml_obs_dimensions( &width, &height, &stack );
+
+  buffer = header;
+  if( episode ) {
+    memcpy( buffer, episode, FUSE_ML_BINARY_EPISODE_LENGTH );
+    buffer += FUSE_ML_BINARY_EPISODE_LENGTH;
+  }
+  buffer = fuse_ml_put_word( buffer, width );
+  buffer = fuse_ml_put_word( buffer, height );
+  *buffer++ = stack;
+
+  length = buffer - header;
+
+  if( episode ) watch_length = fuse_ml_binary_put_watch( watch );
+
+  start = fuse_ml_stats_now();
+  obs = fuse_ml_obs_get();
+  fuse_ml_stats_time( FUSE_ML_STATS_OBS, start );
+
+  if( fuse_ml_binary_send_header( fd, command, FUSE_ML_BINARY_STATUS_OK,
+                                  length + fuse_ml_obs_size() +
+                                  watch_length ) ||
+      fuse_ml_send( fd, (const char*)header, length ) ||
+      fuse_ml_send( fd, (const char*)obs, fuse_ml_obs_size() ) )
+    return 1;
+
+  return watch_length ? fuse_ml_send( fd, (const char*)watch, watch_length ) :
+                        0;
+}
+
+/* As fuse_ml_step_batch(), but any error is sent in place of all the
+   results */
+static int
+fuse_ml_binary_step_batch( int fd, const libspectrum_byte *payload,
+                           size_t length )
+{
+  static libspectrum_byte
+    response[ FUSE_ML_MAX_ENVS * FUSE_ML_BINARY_EPISODE_LENGTH ];
+  unsigned long actions[ FUSE_ML_MAX_ENVS ];
+  const char *error_text = NULL;
+  libspectrum_byte *ptr = response;
+  unsigned long frames;
+  size_t i, action_count;
+  int auto_reset;
+
+  frames = fuse_ml_get_dword( payload );
+  auto_reset = payload[4];
+  action_count = ( length - 5 ) / 4;
+
+  if( action_count > FUSE_ML_MAX_ENVS )
+    return fuse_ml_binary_send_error( fd, FUSE_ML_BINARY_STEP_BATCH,
+                                      "ERR need an action for each instance\n" );
+
+  for( i = 0; i < action_count; i++ )
+    actions[i] = fuse_ml_get_dword( payload + 5 + 4 * i );
+
+  if( fuse_ml_check_batch( actions, action_count, &error_text ) )
+    return fuse_ml_binary_send_error( fd, FUSE_ML_BINARY_STEP_BATCH,
+                                      error_text );
+
+  for( i = 0; i < action_count; i++ ) {
+    long reward = 0;
+    int done = 0;
+
+    if( fuse_ml_switch_env( i, &error_text ) ||
+        fuse_ml_apply_action( actions[i], frames, &reward, &done,
+                              &error_text ) )
+      return fuse_ml_binary_send_error( fd, FUSE_ML_BINARY_STEP_BATCH,
+                                        error_text );
+
+    ptr = fuse_ml_binary_put_episode( ptr, reward, done, auto_reset );
+    if( !ptr )
+      return fuse_ml_binary_send_error( fd, FUSE_ML_BINARY_STEP_BATCH,
+                                        "ERR reset failed\n" );
+  }
+
+  return fuse_ml_binary_send( fd, FUSE_ML_BINARY_STEP_BATCH, response,
+                              ptr - response );
+}
+
+static int
+fuse_ml_handle_binary_command( int fd, fuse_ml_binary_command command,
+                               const libspectrum_byte *payload, size_t length,
+                               int *disconnect )
+{
+  libspectrum_byte response[ 4 + FUSE_ML_ATTR_COUNT ], *ptr = response;
+  unsigned long keys[ FUSE_ML_GAME_MAX_KEYS_PER_ACTION ];
+  size_t key_count = 0;
+  const char *error_text = NULL;
+  long reward = 0;
+  int done = 0;
+
+  fuse_ml_stats_count( FUSE_ML_STATS_COMMANDS, 1 );
+
+  /* Anything else sees the state left by the steps queued before it */
+  if( command != FUSE_ML_BINARY_STEP_ASYNC && command != FUSE_ML_BINARY_WAIT )
+    fuse_ml_async_run( fd, fuse_ml_async_next_ticket );
+
+  switch( command ) {
+
+  case FUSE_ML_BINARY_PING:
+    if( length ) break;
+    return fuse_ml_binary_send( fd, command, NULL, 0 );
+
+  case FUSE_ML_BINARY_RESET:
+    if( length ) break;
+    if( fuse_ml_reset() )
+      return fuse_ml_binary_send_error( fd, command, "ERR reset failed\n" );
+    return fuse_ml_binary_send( fd, command, NULL, 0 );
+
+  case FUSE_ML_BINARY_SAVESTATE:
+  case FUSE_ML_BINARY_LOADSTATE:
+    if( length != 1 ) break;
+    if( command == FUSE_ML_BINARY_SAVESTATE ?
+          fuse_ml_save_state( payload[0], &error_text ) :
+          fuse_ml_load_state( payload[0], &error_text ) )
+      return fuse_ml_binary_send_error( fd, command, error_text );
+    return fuse_ml_binary_send( fd, command, NULL, 0 );
+
+  case FUSE_ML_BINARY_CLONE:
+    {
+      unsigned long id;
+
+      if( length ) break;
+      if( fuse_ml_branch_clone( &id, &error_text ) )
+        return fuse_ml_binary_send_error( fd, command, error_text );
+
+      fuse_ml_put_dword( response, id );
+      return fuse_ml_binary_send( fd, command, response, 4 );
+    }
+
+  case FUSE_ML_BINARY_RESTORE:
+  case FUSE_ML_BINARY_DROP:
+    if( length != 4 ) break;
+    if( command == FUSE_ML_BINARY_RESTORE ?
+          fuse_ml_restore_branch( fuse_ml_get_dword( payload ), &error_text ) :
+          fuse_ml_drop_branch( fuse_ml_get_dword( payload ), &error_text ) )
+      return fuse_ml_binary_send_error( fd, command, error_text );
+    return fuse_ml_binary_send( fd, command, NULL, 0 );
+
+  case FUSE_ML_BINARY_BRANCHES:
+    {
+      size_t branches, chunks;
+
+      if( length ) break;
+
+      fuse_ml_branch_stats( &branches, &chunks );
+      fuse_ml_put_dword( response, branches );
+      fuse_ml_put_dword( response + 4, chunks );
+      return fuse_ml_binary_send( fd, command, response, 8 );
+    }
+
+  case FUSE_ML_BINARY_FORK:
+    {
+      unsigned long first = fuse_ml_next_worker;
+      int worker;
+
+      if( length != 1 ) break;
+      if( !payload[0] )
+        return fuse_ml_binary_send_error( fd, command,
+                                          "ERR invalid worker count\n" );
+      if( fuse_ml_fork_workers( payload[0], &worker, &error_text ) )
+        return fuse_ml_binary_send_error( fd, command, error_text );
+
+      /* A new worker leaves this connection to its parent */
+      if( worker ) {
+        *disconnect = 1;
+        return 0;
+      }
+
+      fuse_ml_put_dword( response, first );
+      fuse_ml_put_dword( response + 4, payload[0] );
+      return fuse_ml_binary_send( fd, command, response, 8 );
+    }
+
+  case FUSE_ML_BINARY_WATCH:
+    {
+      fuse_ml_watch_entry entries[ FUSE_ML_WATCH_MAX_ENTRIES ];
+      size_t i, count;
+
+      if( length < 1 || payload[0] > 1 || ( length - 1 ) % 5 ) break;
+
+      count = ( length - 1 ) / 5;
+      if( count > FUSE_ML_WATCH_MAX_ENTRIES )
+        return fuse_ml_binary_send_error( fd, command,
+                                          "ERR too many watch entries\n" );
+
+      for( i = 0; i < count; i++ ) {
+        const libspectrum_byte *entry = payload + 1 + i * 5;
+
+        entries[i].address = fuse_ml_get_word( entry );
+        entries[i].length = fuse_ml_get_word( entry + 2 );
+        entries[i].bank = entry[4] == 0xff ? -1 : entry[4];
+      }
+
+      if( fuse_ml_watch_set( entries, count, payload[0], &error_text ) )
+        return fuse_ml_binary_send_error( fd, command, error_text );
+
+      fuse_ml_put_dword( response, fuse_ml_watch_length() );
+      return fuse_ml_binary_send( fd, command, response, 4 );
+    }
+
+  case FUSE_ML_BINARY_RECORD:
+    {
+      unsigned long steps, keyframes;
+      char *filename;
+      int error;
+
+      if( !length ) {
+        if( fuse_ml_record_stop( &steps, &keyframes, &error_text ) )
+          return fuse_ml_binary_send_error( fd, command, error_text );
+        fuse_ml_put_dword( response, steps );
+        fuse_ml_put_dword( response + 4, keyframes );
+        return fuse_ml_binary_send( fd, command, response, 8 );
+      }
+
+      if( length < 5 ) break;
+
+      filename = libspectrum_new( char, length - 4 + 1 );
+      memcpy( filename, payload + 4, length - 4 );
+      filename[ length - 4 ] = '\0';
+
+      error = fuse_ml_record_start( filename, fuse_ml_get_dword( payload ),
+                                    &error_text );
+      libspectrum_free( filename );
+      if( error ) return fuse_ml_binary_send_error( fd, command, error_text );
+      fuse_ml_record_select( fuse_ml_env_live );
+
+      return fuse_ml_binary_send( fd, command, NULL, 0 );
+    }
+
+  case FUSE_ML_BINARY_STEP_ASYNC:
+    {
+      libspectrum_dword ticket, instance = 0;
+
+      if( ( length != 9 && length != 13 ) || payload[8] > 1 ) break;
+      if( length == 13 ) {
+        instance = fuse_ml_get_dword( payload + 9 );
+        if( instance >= FUSE_ML_MAX_ENVS )
+          return fuse_ml_binary_send_error( fd, command,
+                                            "ERR no such instance\n" );
+      }
+
+      if( fuse_ml_async_queue( fuse_ml_get_dword( payload ),
+                               fuse_ml_get_dword( payload + 4 ), payload[8],
+                               length == 13 ? (long)instance : -1, 1,
+                               &ticket, &error_text ) )
+        return fuse_ml_binary_send_error( fd, command, error_text );
+
+      fuse_ml_put_dword( response, ticket );
+      return fuse_ml_binary_send( fd, command, response, 4 );
+    }
+
+  case FUSE_ML_BINARY_WAIT:
+    {
+      int error;
+
+      if( length != 4 ) break;
+      error = fuse_ml_async_wait( fd, fuse_ml_get_dword( payload ), 1,
+                                  &error_text );
+      if( error < 0 )
+        return fuse_ml_binary_send_error( fd, command, error_text );
+
+      return error;
+    }
+
+  case FUSE_ML_BINARY_STATS:
+    if( length > 1 || ( length && payload[0] > 1 ) ) break;
+    if( fuse_ml_binary_send_stats( fd ) ) return 1;
+    if( length && payload[0] ) fuse_ml_stats_clear();
+    return 0;
+
+  case FUSE_ML_BINARY_ENVS:
+    if( length != 4 ) break;
+    if( fuse_ml_make_envs( fuse_ml_get_dword( payload ), &error_text ) )
+      return fuse_ml_binary_send_error( fd, command, error_text );
+    fuse_ml_put_dword( response, fuse_ml_env_count );
+    return fuse_ml_binary_send( fd, command, response, 4 );
+
+  case FUSE_ML_BINARY_ENV:
+    if( length != 0 && length != 4 ) break;
+    if( length && fuse_ml_switch_env( fuse_ml_get_dword( payload ),
+                                      &error_text ) )
+      return fuse_ml_binary_send_error( fd, command, error_text );
+    fuse_ml_put_dword( response, fuse_ml_env_live );
+    fuse_ml_put_dword( response + 4, fuse_ml_env_count );
+    return fuse_ml_binary_send( fd, command, response, 8 );
+
+  case FUSE_ML_BINARY_STEP_BATCH:
+    if( length < 5 || ( length - 5 ) % 4 ) break;
+    return fuse_ml_binary_step_batch( fd, payload, length );
+
+  case FUSE_ML_BINARY_KEYDOWN:
+  case FUSE_ML_BINARY_KEYUP:
+    if( length != 4 ) break;
+    if( fuse_ml_key_event( command == FUSE_ML_BINARY_KEYDOWN ?
+                             INPUT_EVENT_KEYPRESS : INPUT_EVENT_KEYRELEASE,
+                           fuse_ml_get_dword( payload ) ) )
+      return fuse_ml_binary_send_error( fd, command, "ERR key event failed\n" );
+    fuse_ml_record_mark();
+    return fuse_ml_binary_send( fd, command, NULL, 0 );
+
+  case FUSE_ML_BINARY_STEP:
+    if( length != 4 ) break;
+    if( fuse_ml_step_frames( fuse_ml_get_dword( payload ), NULL, NULL ) )
+      return fuse_ml_binary_send_error( fd, command, "ERR step failed\n" );
+    fuse_ml_record_mark();
+    ptr = fuse_ml_put_dword( ptr, spectrum_frame_count() );
+    return fuse_ml_binary_send( fd, command, response, ptr - response );
+
+  case FUSE_ML_BINARY_READ:
+    {
+      libspectrum_word address;
+      libspectrum_dword read_length, i;
+
+      if( length != 6 ) break;
+
+      address = fuse_ml_get_word( payload );
+      read_length = fuse_ml_get_dword( payload + 2 );
+      if( read_length > 0x10000 )
+        return fuse_ml_binary_send_error( fd, command, "ERR length too large\n" );
+
+      if( fuse_ml_binary_send_header( fd, command, FUSE_ML_BINARY_STATUS_OK,
+                                      read_length ) )
+        return 1;
+
+      for( i = 0; i < read_length; i += sizeof( response ) ) {
+        libspectrum_dword j, count = read_length - i;
+
+        if( count > sizeof( response ) ) count = sizeof( response );
+        for( j = 0; j < count; j++ )
+          response[j] = readbyte_internal( (libspectrum_word)( address + i + j ) );
+
+        if( fuse_ml_send( fd, (const char*)response, count ) ) return 1;
+      }
+
+      return 0;
+    }
+
+  case FUSE_ML_BINARY_WRITE:
+    {
+      libspectrum_word address;
+      size_t i;
+
+      if( length < 3 ) break;
+
+      address = fuse_ml_get_word( payload );
+      for( i = 2; i < length; i++ )
+        writebyte_internal( (libspectrum_word)( address + i - 2 ), payload[i] );
+
+      fuse_ml_record_mark();
+      return fuse_ml_binary_send( fd, command, NULL, 0 );
+    }
+
+  case FUSE_ML_BINARY_GETINFO:
+    {
+      int width, height;
+
+      if( length ) break;
+
+      fuse_ml_get_frame_dimensions( &width, &height );
+
+      ptr = fuse_ml_put_dword( ptr, spectrum_frame_count() );
+      ptr = fuse_ml_put_dword( ptr, tstates );
+      ptr = fuse_ml_put_word( ptr, width );
+      ptr = fuse_ml_put_word( ptr, height );
+      return fuse_ml_binary_send( fd, command, response, ptr - response );
+    }
+
+  case FUSE_ML_BINARY_GETSCREEN:
+    if( length ) break;
+    return fuse_ml_binary_send_screen( fd );
+
+  case FUSE_ML_BINARY_GETATTRS:
+    if( length ) break;
+    fuse_ml_read_attrs( response );
+    return fuse_ml_binary_send( fd, command, response, FUSE_ML_ATTR_COUNT );
+
+  case FUSE_ML_BINARY_ACT:
+    if( length != 8 ) break;
+    if( fuse_ml_apply_action( fuse_ml_get_dword( payload ),
+                              fuse_ml_get_dword( payload + 4 ),
+                              &reward, &done, &error_text ) )
+      return fuse_ml_binary_send_error( fd, command, error_text );
+
+    ptr = fuse_ml_put_dword( ptr, spectrum_frame_count() );
+    ptr = fuse_ml_put_dword( ptr, (libspectrum_dword)reward );
+    *ptr++ = done;
+    return fuse_ml_binary_send_step( fd, command, response, ptr - response );
+
+  case FUSE_ML_BINARY_EPISODE_STEP:
+    if( length != 9 || payload[8] > 1 ) break;
+    if( fuse_ml_apply_action( fuse_ml_get_dword( payload ),
+                              fuse_ml_get_dword( payload + 4 ),
+                              &reward, &done, &error_text ) )
+      return fuse_ml_binary_send_error( fd, command, error_text );
+
+    return fuse_ml_binary_send_episode( fd, command, reward, done,
+                                        payload[8] );
+
+  case FUSE_ML_BINARY_OBS:
+    if( length ) break;
+    return fuse_ml_binary_send_obs( fd, command, NULL );
+
+  case FUSE_ML_BINARY_OBS_EPISODE_STEP:
+    if( length != 9 || payload[8] > 1 ) break;
+    if( !fuse_ml_obs_enabled() )
+      return fuse_ml_binary_send_error( fd, command,
+                                        "ERR observations are off\n" );
+    if( fuse_ml_apply_action( fuse_ml_get_dword( payload ),
+                              fuse_ml_get_dword( payload + 4 ),
+                              &reward, &done, &error_text ) )
+      return fuse_ml_binary_send_error( fd, command, error_text );
+    if( !fuse_ml_binary_put_episode( response, reward, done, payload[8] ) )
+      return fuse_ml_binary_send_error( fd, command, "ERR reset failed\n" );
+
+    return fuse_ml_binary_send_obs( fd, command, response );
+
+  case FUSE_ML_BINARY_EPISODE_STEP_KEYS:
+    if( length < 5 || payload[4] > 1 ||
+        fuse_ml_binary_get_keys( payload + 5, length - 5, keys, &key_count ) )
+      break;
+    if( fuse_ml_apply_keys( keys, key_count, fuse_ml_get_dword( payload ),
+                            &reward, &done, &error_text, 0 ) )
+      return fuse_ml_binary_send_error( fd, command, error_text );
+
+    return fuse_ml_binary_send_episode( fd, command, reward, done,
+                                        payload[4] );
+
+  case FUSE_ML_BINARY_STEP_ATTRS:
+    if( length < 4 ||
+        fuse_ml_binary_get_keys( payload + 4, length - 4, keys, &key_count ) )
+      break;
+    if( fuse_ml_apply_keys( keys, key_count, fuse_ml_get_dword( payload ),
+                            NULL, NULL, &error_text, 0 ) )
+      return fuse_ml_binary_send_error( fd, command, error_text );
+
+    ptr = fuse_ml_put_dword( ptr, spectrum_frame_count() );
+    fuse_ml_read_attrs( ptr );
+    return fuse_ml_binary_send_step( fd, command, response,
+                                     4 + FUSE_ML_ATTR_COUNT );
+
+  case FUSE_ML_BINARY_SHM_EPISODE_STEP:
+  case FUSE_ML_BINARY_SHM_EPISODE_STEP_KEYS:
+  case FUSE_ML_BINARY_SHM_OBS:
+    {
+      libspectrum_dword slot, sequence;
+      int auto_reset = 0;
+
+      if( command == FUSE_ML_BINARY_SHM_EPISODE_STEP ) {
+        if( length != 9 || payload[8] > 1 ) break;
+      } else if( command == FUSE_ML_BINARY_SHM_EPISODE_STEP_KEYS ) {
+        if( length < 5 || payload[4] > 1 ||
+            fuse_ml_binary_get_keys( payload + 5, length - 5, keys,
+                                     &key_count ) )
+          break;
+      } else if( length ) {
+        break;
+      }
+
+      if( !fuse_ml_shm_enabled() )
+        return fuse_ml_binary_send_error( fd, command,
+                                          "ERR shared memory is off\n" );
+
+      if( command == FUSE_ML_BINARY_SHM_EPISODE_STEP ) {
+        auto_reset = payload[8];
+        if( fuse_ml_apply_action( fuse_ml_get_dword( payload ),
+                                  fuse_ml_get_dword( payload + 4 ),
+                                  &reward, &done, &error_text ) )
+          return fuse_ml_binary_send_error( fd, command, error_text );
+      } else if( command == FUSE_ML_BINARY_SHM_EPISODE_STEP_KEYS ) {
+        auto_reset = payload[4];
+        if( fuse_ml_apply_keys( keys, key_count, fuse_ml_get_dword( payload ),
+                                &reward, &done, &error_text, 0 ) )
+          return fuse_ml_binary_send_error( fd, command, error_text );
+      }
+
+      if( fuse_ml_shm_observe( reward, done, auto_reset, &slot, &sequence,
+                               &error_text ) )
+        return fuse_ml_binary_send_error( fd, command, error_text );
+
+      ptr = fuse_ml_put_dword( ptr, slot );
+      ptr = fuse_ml_put_dword( ptr, sequence );
+      return fuse_ml_binary_send( fd, command, response, ptr - response );
+    }
+
+  case FUSE_ML_BINARY_PROTO_TEXT:
+    if( length ) break;
+    if( fuse_ml_binary_send( fd, command, NULL, 0 ) ) return 1;
+    fuse_ml_binary_protocol = 0;
+    return 0;
+
+  case FUSE_ML_BINARY_QUIT:
+    fuse_exiting = 1;
+    *disconnect = 1;
+    return fuse_ml_binary_send( fd, command, NULL, 0 );
+
+  default:
+    return fuse_ml_binary_send_error( fd, command, "ERR unknown command\n" );
+
   }
 
-  if( listen( fuse_ml_server_fd, 1 ) ) {
+  return fuse_ml_binary_send_error( fd, command, "ERR invalid payload\n" );
+}
+
+/* Read one framed request and act on it; returns non-zero when the
+   connection should be dropped */
+static int
+fuse_ml_binary_read_command( int fd, int *disconnect )
+{
+  static libspectrum_byte payload[ FUSE_ML_BINARY_MAX_REQUEST ];
+  libspectrum_byte header[ FUSE_ML_BINARY_HEADER_LENGTH ];
+  libspectrum_dword length;
+  int read_status;
+
+  read_status = fuse_ml_read_exact( fd, header, sizeof( header ) );
+  if( read_status == 0 ) {
+    *disconnect = 1;
+    return 0;
+  }
+  if( read_status < 0 ) return 1;
+
+  length = fuse_ml_get_dword( &header[4] );
+
+  if( length > sizeof( payload ) ) {
+    /* Skip over the payload so the next request can still be read */
+    while( length ) {
+      size_t count = length > sizeof( payload ) ? sizeof( payload ) : length;
+      if( fuse_ml_read_exact( fd, payload, count ) != 1 ) return 1;
+      length -= count;
+    }
+
+    return fuse_ml_binary_send_error( fd, header[0], "ERR request too long\n" );
+  }
+
+  if( length && fuse_ml_read_exact( fd, payload, length ) != 1 ) return 1;
+
+  return fuse_ml_handle_binary_command( fd, header[0], payload, length,
+                                        disconnect );
+}
+
+/* Make a socket listening on path; returns the socket, or -1 on error */
+static int
+fuse_ml_listen( const char *path )
+{
+  struct sockaddr_un addr;
+  int fd;
+
+  fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if( fd < 0 ) {
+    ui_error( UI_ERROR_ERROR, "ML bridge failed to create socket: %s",
+              strerror( errno ) );
+    return -1;
+  }
+
+  memset( &addr, 0, sizeof( addr ) );
+  addr.sun_family = AF_UNIX;
+
+  if( strlen( path ) >= sizeof( addr.sun_path ) ) {
+    ui_error( UI_ERROR_ERROR, "ML bridge socket path too long: %s", path );
+    close( fd );
+    return -1;
+  }
+
+  strcpy( addr.sun_path, path );
+
+  unlink( path );
+
+  if( bind( fd, (struct sockaddr*)&addr, sizeof( addr ) ) ) {
+    ui_error( UI_ERROR_ERROR, "ML bridge bind failed for %s: %s",
+              path, strerror( errno ) );
+    close( fd );
+    return -1;
+  }
+
+  if( listen( fd, 1 ) ) {
     ui_error( UI_ERROR_ERROR, "ML bridge listen failed for %s: %s",
-              fuse_ml_socket_path, strerror( errno ) );
+              path, strerror( errno ) );
+    close( fd );
+    unlink( path );
+    return -1;
+  }
+
+  return fd;
+}
+
+/* Fork a worker from the current state.  Its socket is made first, so it
+   is ready for a client as soon as this returns.  Returns the worker's pid
+   in the parent, 0 in the worker and -1 on error */
+static pid_t
+fuse_ml_fork_worker( unsigned long worker )
+{
+  char *path;
+  size_t length;
+  pid_t pid;
+  int fd;
+
+  length = strlen( fuse_ml_socket_path ) + 24;
+  path = libspectrum_new( char, length );
+  snprintf( path, length, "%s.%lu", fuse_ml_socket_path, worker );
+
+  fd = fuse_ml_listen( path );
+  if( fd < 0 ) {
+    libspectrum_free( path );
+    return -1;
+  }
+
+  pid = fork();
+
+  if( pid ) {
+    if( pid < 0 ) {
+      ui_error( UI_ERROR_ERROR, "ML bridge failed to fork worker: %s",
+                strerror( errno ) );
+      unlink( path );
+    }
+    close( fd );
+    libspectrum_free( path );
+    return pid;
+  }
+
+  /* In the worker: everything is as it was in the parent apart from the
+     socket and the shared memory, which are the worker's own */
+  if( fuse_ml_server_fd >= 0 ) close( fuse_ml_server_fd );
+  fuse_ml_server_fd = fd;
+
+  libspectrum_free( fuse_ml_socket_path );
+  fuse_ml_socket_path = path;
+
+  fuse_ml_input_start = fuse_ml_input_end = 0;
+  fuse_ml_output_length = 0;
+  fuse_ml_async_clear();
+  fuse_ml_stats_clear();
+  fuse_ml_next_worker = 0;
+  fuse_ml_worker_target = 0;
+
+  /* Better no worker than one quietly serving without its shared memory;
+     a supervisor will try again */
+  if( fuse_ml_shm_fork( worker ) ) {
+    ui_error( UI_ERROR_ERROR,
+              "ML bridge worker %lu failed to set up shared memory", worker );
     close( fuse_ml_server_fd );
-    fuse_ml_server_fd = -1;
     unlink( fuse_ml_socket_path );
+    _exit( 1 );
+  }
+
+  ui_error( UI_ERROR_INFO, "ML bridge worker listening on %s",
+            fuse_ml_socket_path );
+
+  return 0;
+}
+
+/* Collect the exit status of workers made by FORK which have finished */
+static void
+fuse_ml_reap_workers( void )
+{
+  while( waitpid( -1, NULL, WNOHANG ) > 0 )
+    ;
+}
+
+static int
+fuse_ml_fork_workers( unsigned long count, int *worker,
+                      const char **error_text )
+{
+  unsigned long i;
+  pid_t pid;
+
+  *worker = 0;
+
+  if( fuse_ml_visual_mode ) {
+    *error_text = "ERR fork unavailable in visual mode\n";
     return 1;
   }
 
-  ui_error( UI_ERROR_INFO, "ML bridge listening on %s", fuse_ml_socket_path );
+  /* A worker would not have the writer thread */
+  if( fuse_ml_record_active() ) {
+    *error_text = "ERR fork unavailable while recording\n";
+    return 1;
+  }
+
+  fuse_ml_reap_workers();
+
+  for( i = 0; i < count; i++ ) {
+    pid = fuse_ml_fork_worker( fuse_ml_next_worker );
+
+    if( pid < 0 ) {
+      *error_text = "ERR fork failed\n";
+      return 1;
+    }
+
+    if( !pid ) {
+      *worker = 1;
+      return 0;
+    }
+
+    fuse_ml_next_worker++;
+  }
 
   return 0;
 }
 
 int
-fuse_ml_loop( void )
+fuse_ml_init_socket( void )
 {
   if( !fuse_ml_mode ) return 0;
 
-  fuse_ml_game_resync();
+  /* Read here rather than with the environment, as libspectrum has to have
+     been initialised first */
+  if( fuse_ml_reset_snapshot && *fuse_ml_reset_snapshot &&
+      fuse_ml_read_reset_state() ) {
+    ui_error( UI_ERROR_ERROR, "ML bridge failed to read reset snapshot %s",
+              fuse_ml_reset_snapshot );
+    return 1;
+  }
+
+  if( fuse_ml_game_init() ) return 1;
+
+  if( fuse_ml_shm_init() ) return 1;
+
+  fuse_ml_server_fd = fuse_ml_listen( fuse_ml_socket_path );
+  if( fuse_ml_server_fd < 0 ) return 1;
 
+  ui_error( UI_ERROR_INFO, "ML bridge listening on %s", fuse_ml_socket_path );
+
+  return 0;
+}
+
+static int
+fuse_ml_serve( void )
+{
   while( !fuse_exiting ) {
-    int client_fd = accept( fuse_ml_server_fd, NULL, NULL );
+    int client_fd;
+
+    fuse_ml_reap_workers();
+
+    client_fd = accept( fuse_ml_server_fd, NULL, NULL );
 
     if( client_fd < 0 ) {
       if( errno == EINTR ) continue;
@@ -877,16 +3135,30 @@ fuse_ml_loop( void )
       return 1;
     }
 
-    if( fuse_ml_send_text( client_fd, "OK READY\n" ) ) {
+    fuse_ml_binary_protocol = fuse_ml_binary_default;
+    fuse_ml_input_start = fuse_ml_input_end = 0;
+    fuse_ml_output_length = 0;
+    fuse_ml_async_clear();
+
+    if( fuse_ml_binary_protocol ?
+          fuse_ml_binary_send( client_fd, FUSE_ML_BINARY_READY, NULL, 0 ) :
+          fuse_ml_send_text( client_fd, "OK READY\n" ) ) {
       close( client_fd );
       continue;
     }
 
     while( !fuse_exiting ) {
       char line[1024];
-      int read_status = fuse_ml_read_line( client_fd, line, sizeof( line ) );
+      int read_status;
       int disconnect = 0;
 
+      if( fuse_ml_binary_protocol ) {
+        if( fuse_ml_binary_read_command( client_fd, &disconnect ) ) break;
+        if( disconnect ) break;
+        continue;
+      }
+
+      read_status = fuse_ml_read_line( client_fd, line, sizeof( line ) );
       if( read_status == 0 ) break;
       if( read_status == -2 ) {
         if( fuse_ml_send_text( client_fd, "ERR command too long\n" ) ) break;
@@ -899,15 +3171,125 @@ fuse_ml_loop( void )
       if( disconnect ) break;
     }
 
+    /* Answer whatever was done before the connection went */
+    fuse_ml_flush( client_fd );
     close( client_fd );
   }
 
   return 0;
 }
 
+static void
+fuse_ml_stop_signal( int signal_number GCC_UNUSED )
+{
+  fuse_exiting = 1;
+}
+
+/* Keep fuse_ml_worker_target workers running, starting another in place of
+   any which exits or could not be started, until told to stop by SIGTERM or SIGINT; the workers are
+   then stopped too.  Returns in a worker as fuse_ml_serve() would */
+static int
+fuse_ml_supervise( void )
+{
+  struct sigaction handler;
+  unsigned long target = fuse_ml_worker_target, i;
+  pid_t *workers, pid;
+  time_t *started;
+  int worker = 0;
+
+  /* Clients only talk to the workers */
+  close( fuse_ml_server_fd );
+  fuse_ml_server_fd = -1;
+  unlink( fuse_ml_socket_path );
+
+  /* Not restarted, so waitpid() returns to check fuse_exiting.  The workers
+     inherit this, and shut down cleanly when stopped */
+  memset( &handler, 0, sizeof( handler ) );
+  handler.sa_handler = fuse_ml_stop_signal;
+  sigemptyset( &handler.sa_mask );
+  sigaction( SIGTERM, &handler, NULL );
+  sigaction( SIGINT, &handler, NULL );
+
+  workers = libspectrum_new( pid_t, target );
+  started = libspectrum_new( time_t, target );
+
+  for( i = 0; i < target; i++ ) {
+    workers[i] = -1;
+    started[i] = 0;
+  }
+
+  while( !worker && !fuse_exiting ) {
+    int missing = 0;
+
+    /* Start a worker in each slot without one, whether its worker exited
+       or could not be started; but don't spin on a worker which can't get
+       going, so leave any tried in the last second for the next pass */
+    for( i = 0; i < target && !worker; i++ ) {
+      if( workers[i] > 0 ) continue;
+
+      if( started[i] && time( NULL ) - started[i] < 1 ) {
+        missing = 1;
+        continue;
+      }
+
+      workers[i] = fuse_ml_fork_worker( i );
+      started[i] = time( NULL );
+      worker = !workers[i];
+      if( workers[i] < 0 ) missing = 1;
+    }
+    if( worker ) break;
+
+    /* With a slot to fill again, only wait a while for a worker to exit */
+    pid = waitpid( -1, NULL, missing ? WNOHANG : 0 );
+    if( pid < 0 ) {
+      if( errno == EINTR ) continue;
+      if( errno != ECHILD || !missing ) break;
+    }
+    if( pid <= 0 ) {
+      sleep( 1 );
+      continue;
+    }
+
+    for( i = 0; i < target && workers[i] != pid; i++ )
+      ;
+    if( i == target ) continue;
+
+    ui_error( UI_ERROR_INFO, "ML bridge worker %lu exited, starting another",
+              i );
+    workers[i] = -1;
+  }
+
+  if( !worker ) {
+    for( i = 0; i < target; i++ )
+      if( workers[i] > 0 ) kill( workers[i], SIGTERM );
+    for( i = 0; i < target; i++ )
+      if( workers[i] > 0 ) waitpid( workers[i], NULL, 0 );
+  }
+
+  libspectrum_free( workers );
+  libspectrum_free( started );
+
+  return worker ? fuse_ml_serve() : 0;
+}
+
+int
+fuse_ml_loop( void )
+{
+  if( !fuse_ml_mode ) return 0;
+
+  fuse_ml_game_resync();
+  fuse_ml_obs_restart();
+
+  if( fuse_ml_worker_target ) return fuse_ml_supervise();
+
+  return fuse_ml_serve();
+}
+
 void
 fuse_ml_shutdown( void )
 {
+  size_t i;
+
   if( fuse_ml_server_fd >= 0 ) {
     close( fuse_ml_server_fd );
     fuse_ml_server_fd = -1;
@@ -924,6 +3306,26 @@ fuse_ml_shutdown( void )
     fuse_ml_reset_snapshot = NULL;
   }
 
+  fuse_ml_free_states();
+  fuse_ml_free_envs();
+  fuse_ml_branch_end();
+
+  if( fuse_ml_output ) {
+    libspectrum_free( fuse_ml_output );
+    fuse_ml_output = NULL;
+    fuse_ml_output_size = 0;
+  }
+
+  for( i = 0; i < FUSE_ML_ASYNC_SLOTS; i++ ) {
+    libspectrum_free( fuse_ml_async_steps[i].response );
+    fuse_ml_async_steps[i].response = NULL;
+    fuse_ml_async_steps[i].response_size = 0;
+  }
+  fuse_ml_async_clear();
+
+  fuse_ml_record_shutdown();
+  fuse_ml_obs_shutdown();
+  fuse_ml_shm_shutdown();
   fuse_ml_game_shutdown();
 }
 
@@ -949,6 +3351,9 @@ fuse_ml_loop( void )
 void
 fuse_ml_shutdown( void )
 {
+  fuse_ml_record_shutdown();
+  fuse_ml_obs_shutdown();
+  fuse_ml_shm_shutdown();
   fuse_ml_game_shutdown();
 }
 
@@ -962,6 +3367,8 @@ fuse_ml_configure_from_env( void )
   const char *visual_pace = getenv( "FUSE_ML_VISUAL_PACE_MS" );
   const char *socket_path = getenv( "FUSE_ML_SOCKET" );
   const char *reset_snapshot = getenv( "FUSE_ML_RESET_SNAPSHOT" );
+  const char *protocol = getenv( "FUSE_ML_PROTOCOL" );
+  const char *workers = getenv( "FUSE_ML_WORKERS" );
   unsigned long parsed_pace = 0;
 
   if( !mode || !*mode || !strcmp( mode, "0" ) ) return 0;
@@ -989,7 +3396,28 @@ fuse_ml_configure_from_env( void )
   if( reset_snapshot && *reset_snapshot )
     fuse_ml_reset_snapshot = utils_safe_strdup( reset_snapshot );
 
+  if( protocol && *protocol ) {
+    if( !strcmp( protocol, "binary" ) ) {
+      fuse_ml_binary_default = 1;
+    } else if( strcmp( protocol, "text" ) ) {
+      ui_error( UI_ERROR_ERROR, "ML bridge protocol must be text or binary: %s",
+                protocol );
+      return 1;
+    }
+  }
+
+  if( workers && *workers ) {
+    if( fuse_ml_parse_ulong( workers, &fuse_ml_worker_target ) ||
+        fuse_ml_worker_target > FUSE_ML_MAX_WORKERS ||
+        ( fuse_ml_worker_target && fuse_ml_visual_mode ) ) {
+      ui_error( UI_ERROR_ERROR, "Invalid FUSE_ML_WORKERS: %s", workers );
+      return 1;
+    }
+  }
+
   if( fuse_ml_game_configure_from_env() ) return 1;
+  if( fuse_ml_shm_configure_from_env() ) return 1;
+  if( fuse_ml_obs_configure_from_env() ) return 1;
 
   settings_current.sound = 0;
   settings_current.sound_load = 0;
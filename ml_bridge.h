@@ -22,4 +22,7 @@ int fuse_ml_init_socket( void );
 int fuse_ml_loop( void );
 void fuse_ml_shutdown( void );
 
+/* Unit tests */
+int fuse_ml_bridge_unittest( void );
+
 #endif			/* #ifndef FUSE_ML_BRIDGE_H */
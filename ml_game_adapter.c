@@ -14,11 +14,14 @@
 
 #include "config.h"
 
+#include <ctype.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "debugger/debugger.h"
+#include "fuse.h"
 #include "input.h"
 #include "memory_pages.h"
 #include "ui/ui.h"
@@ -27,6 +30,9 @@
 #include "ml_game_adapter.h"
 
 #define FUSE_ML_GAME_MAX_ACTIONS 32
+#define FUSE_ML_GAME_MAX_VALUES 32
+#define FUSE_ML_GAME_MAX_TERMS 16
+#define FUSE_ML_GAME_MAX_DONE 8
 
 static int fuse_ml_game_active = 0;
 static char *fuse_ml_game_name = NULL;
@@ -45,6 +51,43 @@ static int fuse_ml_done_enabled = 0;
 static libspectrum_word fuse_ml_done_addr = 0;
 static unsigned long fuse_ml_done_value = 0;
 
+/* How a value from a game definition file is stored in memory */
+typedef enum fuse_ml_game_value_type {
+  FUSE_ML_GAME_VALUE_LE,	/* Little-endian binary */
+  FUSE_ML_GAME_VALUE_BE,	/* Big-endian binary */
+  FUSE_ML_GAME_VALUE_BCD,	/* Packed BCD, most significant byte first */
+  FUSE_ML_GAME_VALUE_DIGITS,	/* One digit per byte, in the low nibble */
+} fuse_ml_game_value_type;
+
+typedef struct fuse_ml_game_value {
+  char *name;
+  fuse_ml_game_value_type type;
+  libspectrum_word address;
+  size_t length;
+} fuse_ml_game_value;
+
+/* A reward term adds weight times the change in its expression since the
+   last step; a penalty term only counts decreases */
+typedef struct fuse_ml_game_term {
+  debugger_program *program;
+  long weight;
+  int penalty;
+  libspectrum_dword last;
+} fuse_ml_game_term;
+
+static char *fuse_ml_game_file = NULL;
+static int fuse_ml_game_file_actions = 0;
+
+static fuse_ml_game_value fuse_ml_game_values[ FUSE_ML_GAME_MAX_VALUES ];
+static size_t fuse_ml_game_value_count = 0;
+
+static fuse_ml_game_term fuse_ml_game_terms[ FUSE_ML_GAME_MAX_TERMS ];
+static size_t fuse_ml_game_term_count = 0;
+static int fuse_ml_game_terms_valid = 0;
+
+static debugger_program *fuse_ml_game_done[ FUSE_ML_GAME_MAX_DONE ];
+static size_t fuse_ml_game_done_count = 0;
+
 static int
 fuse_ml_parse_ulong( const char *text, unsigned long *value )
 {
@@ -166,19 +209,32 @@ fuse_ml_game_configure_from_env( void )
   const char *reward_addr = getenv( "FUSE_ML_REWARD_ADDR" );
   const char *done_addr = getenv( "FUSE_ML_DONE_ADDR" );
   const char *done_value = getenv( "FUSE_ML_DONE_VALUE" );
+  const char *game_file = getenv( "FUSE_ML_GAME_FILE" );
   unsigned long parsed_value;
 
-  if( fuse_ml_game_name ) {
-    libspectrum_free( fuse_ml_game_name );
-    fuse_ml_game_name = NULL;
-  }
+  fuse_ml_game_shutdown();
+
+  /* The file itself is read by fuse_ml_game_init() once the debugger,
+     which compiles its expressions, is ready */
+  if( game_file && *game_file ) {
+    fuse_ml_game_file = utils_safe_strdup( game_file );
+    fuse_ml_game_name = utils_safe_strdup( "CUSTOM" );
+    fuse_ml_game_active = 1;
+
+    if( action_keys && *action_keys ) {
+      if( fuse_ml_game_parse_action_keys( action_keys ) ) {
+        ui_error( UI_ERROR_ERROR, "Invalid FUSE_ML_ACTION_KEYS: %s",
+                  action_keys );
+        fuse_ml_game_shutdown();
+        return 1;
+      }
+    } else {
+      fuse_ml_game_set_default_actions();
+      fuse_ml_game_file_actions = 1;
+    }
 
-  fuse_ml_game_active = 0;
-  fuse_ml_action_count = 0;
-  memset( fuse_ml_action_key_counts, 0, sizeof( fuse_ml_action_key_counts ) );
-  fuse_ml_reward_enabled = 0;
-  fuse_ml_reward_last_valid = 0;
-  fuse_ml_done_enabled = 0;
+    return 0;
+  }
 
   if( !game_name || !*game_name ) return 0;
   if( !fuse_ml_game_is_manic_miner( game_name ) ) return 0;
@@ -219,14 +275,243 @@ fuse_ml_game_configure_from_env( void )
   return 0;
 }
 
+/* Split off the next word of a line; returns NULL if there is none */
+static char*
+fuse_ml_game_next_word( char **cursor )
+{
+  char *word = *cursor;
+
+  while( *word == ' ' ) word++;
+  if( !*word ) return NULL;
+
+  *cursor = word;
+  while( **cursor && **cursor != ' ' ) (*cursor)++;
+  if( **cursor ) *(*cursor)++ = '\0';
+
+  return word;
+}
+
+/* Value names have to be something the debugger will read as a variable
+   rather than as a hex number after the '$' */
+static int
+fuse_ml_game_valid_name( const char *name )
+{
+  const char *c;
+  int hex = 1;
+
+  if( !isalpha( (unsigned char)*name ) ) return 0;
+
+  for( c = name; *c; c++ ) {
+    if( !isalnum( (unsigned char)*c ) ) return 0;
+    if( !isxdigit( (unsigned char)*c ) ) hex = 0;
+  }
+
+  return !hex;
+}
+
+static int
+fuse_ml_game_parse_value( char *cursor )
+{
+  static const struct {
+    const char *name;
+    fuse_ml_game_value_type type;
+    size_t max_length;
+  } types[] = {
+    { "byte", FUSE_ML_GAME_VALUE_LE, 1 },
+    { "le", FUSE_ML_GAME_VALUE_LE, 4 },
+    { "be", FUSE_ML_GAME_VALUE_BE, 4 },
+    { "bcd", FUSE_ML_GAME_VALUE_BCD, 4 },
+    { "digits", FUSE_ML_GAME_VALUE_DIGITS, 9 },
+  };
+  fuse_ml_game_value *value;
+  char *name, *type, *address, *length;
+  unsigned long parsed_address, parsed_length = 1;
+  size_t i;
+
+  name = fuse_ml_game_next_word( &cursor );
+  type = fuse_ml_game_next_word( &cursor );
+  address = fuse_ml_game_next_word( &cursor );
+  length = fuse_ml_game_next_word( &cursor );
+
+  if( !address || fuse_ml_game_next_word( &cursor ) ) return 1;
+  if( !fuse_ml_game_valid_name( name ) ) return 1;
+  if( fuse_ml_game_value_count >= FUSE_ML_GAME_MAX_VALUES ) return 1;
+
+  for( i = 0; i < fuse_ml_game_value_count; i++ )
+    if( !strcmp( fuse_ml_game_values[i].name, name ) ) return 1;
+
+  for( i = 0; i < ARRAY_SIZE( types ); i++ )
+    if( !strcmp( types[i].name, type ) ) break;
+  if( i == ARRAY_SIZE( types ) ) return 1;
+
+  if( fuse_ml_parse_ulong( address, &parsed_address ) ||
+      parsed_address > 0xffff ) return 1;
+  if( length && fuse_ml_parse_ulong( length, &parsed_length ) ) return 1;
+  if( !parsed_length || parsed_length > types[i].max_length ) return 1;
+
+  value = &fuse_ml_game_values[ fuse_ml_game_value_count++ ];
+  value->name = utils_safe_strdup( name );
+  value->type = types[i].type;
+  value->address = parsed_address;
+  value->length = parsed_length;
+
+  return 0;
+}
+
+static debugger_program*
+fuse_ml_game_compile( const char *text )
+{
+  const char *names[ FUSE_ML_GAME_MAX_VALUES ];
+  size_t i;
+
+  for( i = 0; i < fuse_ml_game_value_count; i++ )
+    names[i] = fuse_ml_game_values[i].name;
+
+  return debugger_program_compile( text, names, fuse_ml_game_value_count );
+}
+
+static int
+fuse_ml_game_parse_term( char *cursor, int penalty )
+{
+  fuse_ml_game_term *term;
+  char *weight, *endptr;
+  long parsed;
+
+  weight = fuse_ml_game_next_word( &cursor );
+  if( !weight ) return 1;
+
+  errno = 0;
+  parsed = strtol( weight, &endptr, 0 );
+  if( errno || endptr == weight || *endptr ) return 1;
+
+  if( fuse_ml_game_term_count >= FUSE_ML_GAME_MAX_TERMS ) return 1;
+
+  term = &fuse_ml_game_terms[ fuse_ml_game_term_count ];
+  term->program = fuse_ml_game_compile( cursor );
+  if( !term->program ) return 1;
+
+  term->weight = parsed;
+  term->penalty = penalty;
+  term->last = 0;
+  fuse_ml_game_term_count++;
+
+  return 0;
+}
+
+static int
+fuse_ml_game_parse_line( char *line )
+{
+  char *cursor = line, *keyword;
+  size_t i;
+
+  /* The debugger only takes spaces between tokens */
+  for( i = 0; line[i]; i++ )
+    if( line[i] == '\t' || line[i] == '\r' ) line[i] = ' ';
+
+  keyword = fuse_ml_game_next_word( &cursor );
+  if( !keyword || *keyword == '#' ) return 0;
+
+  if( !strcmp( keyword, "name" ) ) {
+    keyword = fuse_ml_game_next_word( &cursor );
+    if( !keyword || fuse_ml_game_next_word( &cursor ) ) return 1;
+    libspectrum_free( fuse_ml_game_name );
+    fuse_ml_game_name = utils_safe_strdup( keyword );
+    return 0;
+  }
+
+  /* FUSE_ML_ACTION_KEYS overrides the file */
+  if( !strcmp( keyword, "actions" ) ) {
+    return fuse_ml_game_file_actions ?
+           fuse_ml_game_parse_action_keys( cursor ) : 0;
+  }
+
+  if( !strcmp( keyword, "value" ) ) return fuse_ml_game_parse_value( cursor );
+  if( !strcmp( keyword, "reward" ) ) return fuse_ml_game_parse_term( cursor, 0 );
+  if( !strcmp( keyword, "penalty" ) ) return fuse_ml_game_parse_term( cursor, 1 );
+
+  if( !strcmp( keyword, "done" ) ) {
+    if( fuse_ml_game_done_count >= FUSE_ML_GAME_MAX_DONE ) return 1;
+    fuse_ml_game_done[ fuse_ml_game_done_count ] =
+      fuse_ml_game_compile( cursor );
+    if( !fuse_ml_game_done[ fuse_ml_game_done_count ] ) return 1;
+    fuse_ml_game_done_count++;
+    return 0;
+  }
+
+  return 1;
+}
+
+int
+fuse_ml_game_init( void )
+{
+  utils_file file;
+  char *text, *line, *next;
+  size_t line_number = 0;
+  int error = 0;
+
+  if( !fuse_ml_game_file ) return 0;
+
+  if( utils_read_file( fuse_ml_game_file, &file ) ) {
+    fuse_ml_game_shutdown();
+    return 1;
+  }
+
+  text = libspectrum_new( char, file.length + 1 );
+  memcpy( text, file.buffer, file.length );
+  text[ file.length ] = '\0';
+  utils_close_file( &file );
+
+  for( line = text; line && !error; line = next ) {
+    next = strchr( line, '\n' );
+    if( next ) *next++ = '\0';
+    line_number++;
+
+    if( fuse_ml_game_parse_line( line ) ) {
+      ui_error( UI_ERROR_ERROR, "%s:%lu: invalid game definition",
+                fuse_ml_game_file, (unsigned long)line_number );
+      error = 1;
+    }
+  }
+
+  libspectrum_free( text );
+
+  if( error ) {
+    fuse_ml_game_shutdown();
+    return 1;
+  }
+
+  return 0;
+}
+
 void
 fuse_ml_game_shutdown( void )
 {
+  size_t i;
+
   if( fuse_ml_game_name ) {
     libspectrum_free( fuse_ml_game_name );
     fuse_ml_game_name = NULL;
   }
 
+  if( fuse_ml_game_file ) {
+    libspectrum_free( fuse_ml_game_file );
+    fuse_ml_game_file = NULL;
+  }
+  fuse_ml_game_file_actions = 0;
+
+  for( i = 0; i < fuse_ml_game_value_count; i++ )
+    libspectrum_free( fuse_ml_game_values[i].name );
+  fuse_ml_game_value_count = 0;
+
+  for( i = 0; i < fuse_ml_game_term_count; i++ )
+    debugger_program_free( fuse_ml_game_terms[i].program );
+  fuse_ml_game_term_count = 0;
+  fuse_ml_game_terms_valid = 0;
+
+  for( i = 0; i < fuse_ml_game_done_count; i++ )
+    debugger_program_free( fuse_ml_game_done[i] );
+  fuse_ml_game_done_count = 0;
+
   fuse_ml_game_active = 0;
   fuse_ml_action_count = 0;
   memset( fuse_ml_action_key_counts, 0, sizeof( fuse_ml_action_key_counts ) );
@@ -259,6 +544,71 @@ fuse_ml_game_get_action_keys( unsigned long action, unsigned long *keys,
   return 0;
 }
 
+static libspectrum_dword
+fuse_ml_game_read_value( const fuse_ml_game_value *value )
+{
+  libspectrum_dword result = 0;
+  libspectrum_byte byte;
+  size_t i;
+
+  for( i = 0; i < value->length; i++ ) {
+    byte = readbyte_internal( ( value->address + i ) & 0xffff );
+
+    switch( value->type ) {
+    case FUSE_ML_GAME_VALUE_LE: result |= (libspectrum_dword)byte << ( 8 * i );
+      break;
+    case FUSE_ML_GAME_VALUE_BE: result = ( result << 8 ) | byte; break;
+    case FUSE_ML_GAME_VALUE_BCD:
+      result = result * 100 + ( byte >> 4 ) * 10 + ( byte & 0x0f );
+      break;
+    case FUSE_ML_GAME_VALUE_DIGITS: result = result * 10 + ( byte & 0x0f );
+      break;
+    }
+  }
+
+  return result;
+}
+
+static void
+fuse_ml_game_read_values( libspectrum_dword *values )
+{
+  size_t i;
+
+  for( i = 0; i < fuse_ml_game_value_count; i++ )
+    values[i] = fuse_ml_game_read_value( &fuse_ml_game_values[i] );
+}
+
+static void
+fuse_ml_game_file_evaluate( long *reward, int *done )
+{
+  libspectrum_dword values[ FUSE_ML_GAME_MAX_VALUES ];
+  size_t i;
+
+  fuse_ml_game_read_values( values );
+
+  for( i = 0; i < fuse_ml_game_term_count; i++ ) {
+    fuse_ml_game_term *term = &fuse_ml_game_terms[i];
+    libspectrum_dword current = debugger_program_run( term->program, values );
+    libspectrum_signed_dword delta = current - term->last;
+
+    if( reward && fuse_ml_game_terms_valid &&
+        ( !term->penalty || delta < 0 ) )
+      *reward += term->weight * delta;
+
+    term->last = current;
+  }
+  fuse_ml_game_terms_valid = 1;
+
+  if( done ) {
+    for( i = 0; i < fuse_ml_game_done_count; i++ ) {
+      if( debugger_program_run( fuse_ml_game_done[i], values ) ) {
+        *done = 1;
+        break;
+      }
+    }
+  }
+}
+
 int
 fuse_ml_game_evaluate( long *reward, int *done )
 {
@@ -266,6 +616,13 @@ fuse_ml_game_evaluate( long *reward, int *done )
 
   if( !fuse_ml_game_active ) return 1;
 
+  if( fuse_ml_game_file ) {
+    if( reward ) *reward = 0;
+    if( done ) *done = 0;
+    fuse_ml_game_file_evaluate( reward, done );
+    return 0;
+  }
+
   if( reward ) *reward = 0;
   if( done ) *done = 0;
 
@@ -298,6 +655,18 @@ fuse_ml_game_resync( void )
 {
   if( !fuse_ml_game_active ) return;
 
+  if( fuse_ml_game_file ) {
+    libspectrum_dword values[ FUSE_ML_GAME_MAX_VALUES ];
+    size_t i;
+
+    fuse_ml_game_read_values( values );
+    for( i = 0; i < fuse_ml_game_term_count; i++ )
+      fuse_ml_game_terms[i].last =
+        debugger_program_run( fuse_ml_game_terms[i].program, values );
+    fuse_ml_game_terms_valid = 1;
+    return;
+  }
+
   if( fuse_ml_reward_enabled ) {
     fuse_ml_reward_last = readbyte_internal( fuse_ml_reward_addr );
     fuse_ml_reward_last_valid = 1;
@@ -343,3 +712,140 @@ fuse_ml_game_info( char *buffer, size_t length )
                       fuse_ml_done_value );
   return ( written < 0 || (size_t)written >= length ) ? 1 : 0;
 }
+
+/* Parse one line of a game definition; the parser writes into its input,
+   so it gets a copy */
+static int
+fuse_ml_game_test_line( const char *line )
+{
+  char buffer[ 128 ];
+
+  snprintf( buffer, sizeof( buffer ), "%s", line );
+  return fuse_ml_game_parse_line( buffer );
+}
+
+static int
+fuse_ml_game_value_test( const char *line, const libspectrum_byte *data,
+                         size_t data_length, libspectrum_dword expected )
+{
+  libspectrum_dword result;
+
+  memcpy( memory_map_read[8].page, data, data_length );
+
+  if( fuse_ml_game_test_line( line ) || fuse_ml_game_value_count != 1 ) {
+    printf( "%s: could not parse \"%s\"\n", fuse_progname, line );
+    fuse_ml_game_shutdown();
+    return 1;
+  }
+
+  result = fuse_ml_game_read_value( &fuse_ml_game_values[0] );
+  fuse_ml_game_shutdown();
+
+  if( result != expected ) {
+    printf( "%s: \"%s\" read %u, expected %u\n", fuse_progname, line,
+            (unsigned)result, (unsigned)expected );
+    return 1;
+  }
+
+  return 0;
+}
+
+int
+fuse_ml_game_unittest( void )
+{
+  static const libspectrum_byte binary[] = { 0x78, 0x56, 0x34, 0x12 };
+  static const libspectrum_byte bcd[] = { 0x01, 0x23, 0x45 };
+  static const libspectrum_byte digits[] = { 0x31, 0x32, 0x03, 0x34 };
+  static const char * const malformed[] = {
+    "bogus 1",
+    "name",
+    "name two words",
+    "value",
+    "value score byte",
+    "value score byte 0x4000 1 extra",
+    "value 12ab byte 0x4000",
+    "value 2up byte 0x4000",
+    "value score word 0x4000",
+    "value score le 0x10000",
+    "value score le 0x4000 0",
+    "value score byte 0x4000 2",
+    "value score le 0x4000 5",
+    "value score digits 0x4000 10",
+    "reward",
+    "reward x 1",
+    "reward 1",
+    "penalty 1 2 +",
+    "done (1",
+  };
+  libspectrum_byte *page = memory_map_read[8].page;
+  long reward;
+  int done;
+  size_t i;
+  int r = 0;
+
+  /* Each type of value, at 0x4000 */
+  r += fuse_ml_game_value_test( "value score byte 0x4000", binary,
+                                sizeof( binary ), 0x78 );
+  r += fuse_ml_game_value_test( "value score le 0x4000 2", binary,
+                                sizeof( binary ), 0x5678 );
+  r += fuse_ml_game_value_test( "value score le 0x4000 4", binary,
+                                sizeof( binary ), 0x12345678 );
+  r += fuse_ml_game_value_test( "value score be 0x4000 3", binary,
+                                sizeof( binary ), 0x785634 );
+  r += fuse_ml_game_value_test( "value score bcd 0x4000 3", bcd,
+                                sizeof( bcd ), 12345 );
+  r += fuse_ml_game_value_test( "value score digits 0x4000 4", digits,
+                                sizeof( digits ), 1234 );
+
+  for( i = 0; i < ARRAY_SIZE( malformed ); i++ ) {
+    if( !fuse_ml_game_test_line( malformed[i] ) ) {
+      printf( "%s: accepted \"%s\"\n", fuse_progname, malformed[i] );
+      r++;
+    }
+    fuse_ml_game_shutdown();
+  }
+
+  /* A name may only be used once */
+  if( fuse_ml_game_test_line( "value score byte 0x4000" ) ||
+      !fuse_ml_game_test_line( "value score byte 0x4001" ) ) {
+    printf( "%s: duplicate value name not rejected\n", fuse_progname );
+    r++;
+  }
+  fuse_ml_game_shutdown();
+
+  /* Values bound into reward and done expressions */
+  if( fuse_ml_game_test_line( "# A comment" ) ||
+      fuse_ml_game_test_line( "" ) ||
+      fuse_ml_game_test_line( "value score bcd 0x4000 2" ) ||
+      fuse_ml_game_test_line( "value lives byte 0x4002" ) ||
+      fuse_ml_game_test_line( "reward 10 $score" ) ||
+      fuse_ml_game_test_line( "penalty 100 $lives" ) ||
+      fuse_ml_game_test_line( "done $lives == 0" ) ) {
+    printf( "%s: could not parse game definition\n", fuse_progname );
+    fuse_ml_game_shutdown();
+    return r + 1;
+  }
+
+  page[0] = 0x00; page[1] = 0x50; page[2] = 2;
+  reward = 0; done = 0;
+  fuse_ml_game_file_evaluate( &reward, &done );
+  if( reward || done ) r++;
+
+  page[1] = 0x75;
+  fuse_ml_game_file_evaluate( &reward, &done );
+  if( reward != 250 || done ) r++;
+
+  page[2] = 1;
+  reward = 0;
+  fuse_ml_game_file_evaluate( &reward, &done );
+  if( reward != -100 || done ) r++;
+
+  page[0] = 0x01; page[2] = 0;
+  reward = 0;
+  fuse_ml_game_file_evaluate( &reward, &done );
+  if( reward != 1000 - 100 || !done ) r++;
+
+  fuse_ml_game_shutdown();
+
+  return r;
+}
@@ -20,6 +20,11 @@
 #define FUSE_ML_GAME_MAX_KEYS_PER_ACTION 4
 
 int fuse_ml_game_configure_from_env( void );
+
+/* Read the game definition file named by FUSE_ML_GAME_FILE, if any; this
+   needs the debugger to have been initialised */
+int fuse_ml_game_init( void );
+
 void fuse_ml_game_shutdown( void );
 int fuse_ml_game_enabled( void );
 int fuse_ml_game_get_action_keys( unsigned long action, unsigned long *keys,
@@ -28,4 +33,7 @@ int fuse_ml_game_evaluate( long *reward, int *done );
 void fuse_ml_game_resync( void );
 int fuse_ml_game_info( char *buffer, size_t length );
 
+/* Unit tests */
+int fuse_ml_game_unittest( void );
+
 #endif			/* #ifndef FUSE_ML_GAME_ADAPTER_H */
@@ -0,0 +1,463 @@
+/* ml_obs.c: observation preprocessing for the ML bridge
+   Copyright (c) 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "display.h"
+#include "machine.h"
+#include "ui/ui.h"
+
+#include "ml_obs.h"
+
+/* The Timex hi-res frame is the largest there is */
+#define FUSE_ML_OBS_MAX_WIDTH DISPLAY_SCREEN_WIDTH
+#define FUSE_ML_OBS_MAX_HEIGHT ( 2 * DISPLAY_SCREEN_HEIGHT )
+#define FUSE_ML_OBS_MAX_STACK 16
+
+/* The same palette as the GTK UI */
+static const libspectrum_byte fuse_ml_obs_rgb[16][3] = {
+  {   0,   0,   0 }, {   0,   0, 192 }, { 192,   0,   0 }, { 192,   0, 192 },
+  {   0, 192,   0 }, {   0, 192, 192 }, { 192, 192,   0 }, { 192, 192, 192 },
+  {   0,   0,   0 }, {   0,   0, 255 }, { 255,   0,   0 }, { 255,   0, 255 },
+  {   0, 255,   0 }, {   0, 255, 255 }, { 255, 255,   0 }, { 255, 255, 255 },
+};
+
+static libspectrum_byte fuse_ml_obs_luma[16];
+
+/* Observations are off while the width is 0 */
+static int fuse_ml_obs_width = 0;
+static int fuse_ml_obs_height = 0;
+static int fuse_ml_obs_stack = 4;
+static int fuse_ml_obs_grey = 1;
+static int fuse_ml_obs_maxpool = 1;
+
+/* A frame stack: stack frames, used as a ring with the newest at newest,
+   followed by the last two frames captured, the latest at latest */
+typedef struct fuse_ml_obs_frames {
+  libspectrum_byte *data;
+  int newest;
+  int latest;
+  int captured;
+} fuse_ml_obs_frames;
+
+static fuse_ml_obs_frames *fuse_ml_obs_stacks = NULL;
+static size_t fuse_ml_obs_stack_count = 0;
+static fuse_ml_obs_frames *fuse_ml_obs_current = NULL;
+
+/* The frames of the current stack in order, for fuse_ml_obs_get() */
+static libspectrum_byte *fuse_ml_obs_output = NULL;
+
+/* Which source columns and rows go into each observation pixel, for the
+   source frame size they were worked out for */
+static int fuse_ml_obs_source_width = 0;
+static int fuse_ml_obs_source_height = 0;
+static int fuse_ml_obs_x0[ FUSE_ML_OBS_MAX_WIDTH ];
+static int fuse_ml_obs_x1[ FUSE_ML_OBS_MAX_WIDTH ];
+static int fuse_ml_obs_y0[ FUSE_ML_OBS_MAX_HEIGHT ];
+static int fuse_ml_obs_y1[ FUSE_ML_OBS_MAX_HEIGHT ];
+
+static int
+fuse_ml_obs_parse_int( const char *text, int min, int max, int *value )
+{
+  char *endptr;
+  long parsed;
+
+  errno = 0;
+  parsed = strtol( text, &endptr, 0 );
+  if( errno || endptr == text || *endptr || parsed < min || parsed > max )
+    return 1;
+
+  *value = parsed;
+  return 0;
+}
+
+int
+fuse_ml_obs_configure_from_env( void )
+{
+  const char *size = getenv( "FUSE_ML_OBS_SIZE" );
+  const char *stack = getenv( "FUSE_ML_OBS_STACK" );
+  const char *colour = getenv( "FUSE_ML_OBS_COLOUR" );
+  const char *maxpool = getenv( "FUSE_ML_OBS_MAXPOOL" );
+  char width[16];
+  const char *cross;
+  size_t i;
+
+  if( !size || !*size ) return 0;
+
+  cross = strchr( size, 'x' );
+  if( !cross || (size_t)( cross - size ) >= sizeof( width ) ) {
+    ui_error( UI_ERROR_ERROR, "Invalid FUSE_ML_OBS_SIZE: %s", size );
+    return 1;
+  }
+  memcpy( width, size, cross - size );
+  width[ cross - size ] = '\0';
+
+  if( fuse_ml_obs_parse_int( width, 1, FUSE_ML_OBS_MAX_WIDTH,
+                             &fuse_ml_obs_width ) ||
+      fuse_ml_obs_parse_int( cross + 1, 1, FUSE_ML_OBS_MAX_HEIGHT,
+                             &fuse_ml_obs_height ) ) {
+    ui_error( UI_ERROR_ERROR, "Invalid FUSE_ML_OBS_SIZE: %s", size );
+    fuse_ml_obs_width = 0;
+    return 1;
+  }
+
+  if( stack && *stack &&
+      fuse_ml_obs_parse_int( stack, 1, FUSE_ML_OBS_MAX_STACK,
+                             &fuse_ml_obs_stack ) ) {
+    ui_error( UI_ERROR_ERROR, "Invalid FUSE_ML_OBS_STACK: %s", stack );
+    fuse_ml_obs_width = 0;
+    return 1;
+  }
+
+  if( colour && *colour ) {
+    if( !strcmp( colour, "grey" ) || !strcmp( colour, "gray" ) ) {
+      fuse_ml_obs_grey = 1;
+    } else if( !strcmp( colour, "index" ) ) {
+      fuse_ml_obs_grey = 0;
+    } else {
+      ui_error( UI_ERROR_ERROR, "Invalid FUSE_ML_OBS_COLOUR: %s", colour );
+      fuse_ml_obs_width = 0;
+      return 1;
+    }
+  }
+
+  if( maxpool && *maxpool )
+    fuse_ml_obs_maxpool = strcmp( maxpool, "0" ) != 0;
+
+  /* Addition of 0.5 is to avoid rounding errors */
+  for( i = 0; i < 16; i++ )
+    fuse_ml_obs_luma[i] = 0.299 * fuse_ml_obs_rgb[i][0] +
+                          0.587 * fuse_ml_obs_rgb[i][1] +
+                          0.114 * fuse_ml_obs_rgb[i][2] + 0.5;
+
+  return 0;
+}
+
+int
+fuse_ml_obs_enabled( void )
+{
+  return fuse_ml_obs_width != 0;
+}
+
+size_t
+fuse_ml_obs_size( void )
+{
+  return (size_t)fuse_ml_obs_width * fuse_ml_obs_height * fuse_ml_obs_stack;
+}
+
+static size_t
+fuse_ml_obs_frame_size( void )
+{
+  return (size_t)fuse_ml_obs_width * fuse_ml_obs_height;
+}
+
+static libspectrum_byte*
+fuse_ml_obs_frame( fuse_ml_obs_frames *frames, int index )
+{
+  return frames->data + index * fuse_ml_obs_frame_size();
+}
+
+static libspectrum_byte*
+fuse_ml_obs_captured( fuse_ml_obs_frames *frames, int latest )
+{
+  return fuse_ml_obs_frame( frames, fuse_ml_obs_stack +
+                                    ( latest ? frames->latest :
+                                               !frames->latest ) );
+}
+
+static void
+fuse_ml_obs_alloc( fuse_ml_obs_frames *frames )
+{
+  size_t length = ( fuse_ml_obs_stack + 2 ) * fuse_ml_obs_frame_size();
+
+  frames->data = libspectrum_new( libspectrum_byte, length );
+  memset( frames->data, 0, length );
+  frames->newest = 0;
+  frames->latest = 0;
+  frames->captured = 0;
+}
+
+/* The stack in use, made when first needed */
+static fuse_ml_obs_frames*
+fuse_ml_obs_frames_current( void )
+{
+  if( !fuse_ml_obs_current ) {
+    fuse_ml_obs_stacks = libspectrum_new( fuse_ml_obs_frames, 1 );
+    fuse_ml_obs_stack_count = 1;
+    fuse_ml_obs_alloc( fuse_ml_obs_stacks );
+    fuse_ml_obs_current = fuse_ml_obs_stacks;
+  }
+
+  return fuse_ml_obs_current;
+}
+
+/* Split the source into a range of columns and of rows for each pixel of
+   the observation; when scaling up, each range is a single pixel */
+static void
+fuse_ml_obs_set_source( int width, int height )
+{
+  int i;
+
+  if( width == fuse_ml_obs_source_width &&
+      height == fuse_ml_obs_source_height )
+    return;
+
+  for( i = 0; i < fuse_ml_obs_width; i++ ) {
+    fuse_ml_obs_x0[i] = i * width / fuse_ml_obs_width;
+    fuse_ml_obs_x1[i] = ( i + 1 ) * width / fuse_ml_obs_width;
+    if( fuse_ml_obs_x1[i] == fuse_ml_obs_x0[i] ) fuse_ml_obs_x1[i]++;
+  }
+
+  for( i = 0; i < fuse_ml_obs_height; i++ ) {
+    fuse_ml_obs_y0[i] = i * height / fuse_ml_obs_height;
+    fuse_ml_obs_y1[i] = ( i + 1 ) * height / fuse_ml_obs_height;
+    if( fuse_ml_obs_y1[i] == fuse_ml_obs_y0[i] ) fuse_ml_obs_y1[i]++;
+  }
+
+  fuse_ml_obs_source_width = width;
+  fuse_ml_obs_source_height = height;
+}
+
+/* Decode one line of the last frame into palette indices, or their luma,
+   straight from display_last_screen; the Timex modes go through
+   display_getpixel() */
+static void
+fuse_ml_obs_decode_row( int y, int width, libspectrum_byte *row )
+{
+  int x;
+
+  if( machine_current->timex ) {
+    for( x = 0; x < width; x++ )
+      row[x] = display_getpixel( x, y );
+  } else {
+    const libspectrum_dword *chunk =
+      &display_last_screen[ y * DISPLAY_SCREEN_WIDTH_COLS ];
+
+    for( x = 0; x < width; x += 8, chunk++ ) {
+      libspectrum_byte data = *chunk & 0xff;
+      libspectrum_byte ink, paper;
+      int bit;
+
+      display_parse_attr( ( *chunk >> 8 ) & 0xff, &ink, &paper );
+
+      for( bit = 0; bit < 8; bit++ )
+        row[ x + bit ] = ( data & ( 0x80 >> bit ) ) ? ink : paper;
+    }
+  }
+
+  if( fuse_ml_obs_grey )
+    for( x = 0; x < width; x++ ) row[x] = fuse_ml_obs_luma[ row[x] & 0x0f ];
+}
+
+/* Scale the last frame to the observation size: the mean of each area for
+   grey levels, and the pixel at its centre for palette indices */
+static void
+fuse_ml_obs_downscale( libspectrum_byte *output )
+{
+  static libspectrum_byte row[ FUSE_ML_OBS_MAX_WIDTH ];
+  static libspectrum_dword sums[ FUSE_ML_OBS_MAX_WIDTH ];
+  int width, height, x, y, ox, oy;
+
+  if( machine_current->timex ) {
+    width = DISPLAY_SCREEN_WIDTH;
+    height = 2 * DISPLAY_SCREEN_HEIGHT;
+  } else {
+    width = DISPLAY_ASPECT_WIDTH;
+    height = DISPLAY_SCREEN_HEIGHT;
+  }
+
+  fuse_ml_obs_set_source( width, height );
+
+  for( oy = 0; oy < fuse_ml_obs_height; oy++ ) {
+    int y0 = fuse_ml_obs_y0[ oy ], y1 = fuse_ml_obs_y1[ oy ];
+
+    if( !fuse_ml_obs_grey ) {
+      fuse_ml_obs_decode_row( ( y0 + y1 - 1 ) / 2, width, row );
+      for( ox = 0; ox < fuse_ml_obs_width; ox++ )
+        *output++ = row[ ( fuse_ml_obs_x0[ ox ] + fuse_ml_obs_x1[ ox ] - 1 ) / 2 ];
+      continue;
+    }
+
+    memset( sums, 0, fuse_ml_obs_width * sizeof( *sums ) );
+
+    for( y = y0; y < y1; y++ ) {
+      fuse_ml_obs_decode_row( y, width, row );
+      for( ox = 0; ox < fuse_ml_obs_width; ox++ )
+        for( x = fuse_ml_obs_x0[ ox ]; x < fuse_ml_obs_x1[ ox ]; x++ )
+          sums[ ox ] += row[x];
+    }
+
+    for( ox = 0; ox < fuse_ml_obs_width; ox++ ) {
+      libspectrum_dword area =
+        ( y1 - y0 ) * ( fuse_ml_obs_x1[ ox ] - fuse_ml_obs_x0[ ox ] );
+      *output++ = ( sums[ ox ] + area / 2 ) / area;
+    }
+  }
+}
+
+void
+fuse_ml_obs_capture( void )
+{
+  fuse_ml_obs_frames *frames;
+
+  if( !fuse_ml_obs_enabled() ) return;
+
+  frames = fuse_ml_obs_frames_current();
+
+  frames->latest = !frames->latest;
+  fuse_ml_obs_downscale( fuse_ml_obs_captured( frames, 1 ) );
+  if( frames->captured < 2 ) frames->captured++;
+}
+
+void
+fuse_ml_obs_forget( void )
+{
+  if( !fuse_ml_obs_enabled() ) return;
+
+  fuse_ml_obs_frames_current()->captured = 0;
+}
+
+void
+fuse_ml_obs_push( void )
+{
+  fuse_ml_obs_frames *frames;
+  const libspectrum_byte *latest, *previous;
+  libspectrum_byte *output;
+  size_t i, length = fuse_ml_obs_frame_size();
+
+  if( !fuse_ml_obs_enabled() ) return;
+
+  frames = fuse_ml_obs_frames_current();
+  if( !frames->captured ) fuse_ml_obs_capture();
+
+  frames->newest = ( frames->newest + 1 ) % fuse_ml_obs_stack;
+  output = fuse_ml_obs_frame( frames, frames->newest );
+  latest = fuse_ml_obs_captured( frames, 1 );
+  previous = fuse_ml_obs_captured( frames, 0 );
+
+  if( fuse_ml_obs_maxpool && frames->captured == 2 ) {
+    for( i = 0; i < length; i++ )
+      output[i] = latest[i] > previous[i] ? latest[i] : previous[i];
+  } else {
+    memcpy( output, latest, length );
+  }
+}
+
+void
+fuse_ml_obs_restart( void )
+{
+  fuse_ml_obs_frames *frames;
+  int i;
+
+  if( !fuse_ml_obs_enabled() ) return;
+
+  frames = fuse_ml_obs_frames_current();
+
+  frames->captured = 0;
+  fuse_ml_obs_capture();
+
+  for( i = 0; i < fuse_ml_obs_stack; i++ )
+    memcpy( fuse_ml_obs_frame( frames, i ), fuse_ml_obs_captured( frames, 1 ),
+            fuse_ml_obs_frame_size() );
+}
+
+void
+fuse_ml_obs_set_stacks( size_t count )
+{
+  fuse_ml_obs_frames *stacks, *current;
+  size_t i, length = ( fuse_ml_obs_stack + 2 ) * fuse_ml_obs_frame_size();
+
+  if( !fuse_ml_obs_enabled() ) return;
+
+  if( !count ) count = 1;
+
+  current = fuse_ml_obs_frames_current();
+
+  stacks = libspectrum_new( fuse_ml_obs_frames, count );
+  for( i = 0; i < count; i++ ) {
+    stacks[i] = *current;
+    stacks[i].data = libspectrum_new( libspectrum_byte, length );
+    memcpy( stacks[i].data, current->data, length );
+  }
+
+  for( i = 0; i < fuse_ml_obs_stack_count; i++ )
+    libspectrum_free( fuse_ml_obs_stacks[i].data );
+  libspectrum_free( fuse_ml_obs_stacks );
+
+  fuse_ml_obs_stacks = stacks;
+  fuse_ml_obs_stack_count = count;
+  fuse_ml_obs_current = stacks;
+}
+
+void
+fuse_ml_obs_select( size_t stack )
+{
+  if( !fuse_ml_obs_enabled() || stack >= fuse_ml_obs_stack_count ) return;
+
+  fuse_ml_obs_current = &fuse_ml_obs_stacks[ stack ];
+}
+
+void
+fuse_ml_obs_dimensions( int *width, int *height, int *stack )
+{
+  *width = fuse_ml_obs_width;
+  *height = fuse_ml_obs_height;
+  *stack = fuse_ml_obs_stack;
+}
+
+const libspectrum_byte*
+fuse_ml_obs_get( void )
+{
+  fuse_ml_obs_frames *frames = fuse_ml_obs_frames_current();
+  size_t length = fuse_ml_obs_frame_size();
+  libspectrum_byte *buffer;
+  int i;
+
+  if( !fuse_ml_obs_output )
+    fuse_ml_obs_output = libspectrum_new( libspectrum_byte,
+                                          fuse_ml_obs_size() );
+
+  buffer = fuse_ml_obs_output;
+  for( i = 1; i <= fuse_ml_obs_stack; i++ ) {
+    memcpy( buffer, fuse_ml_obs_frame( frames, ( frames->newest + i ) %
+                                               fuse_ml_obs_stack ),
+            length );
+    buffer += length;
+  }
+
+  return fuse_ml_obs_output;
+}
+
+void
+fuse_ml_obs_shutdown( void )
+{
+  size_t i;
+
+  for( i = 0; i < fuse_ml_obs_stack_count; i++ )
+    libspectrum_free( fuse_ml_obs_stacks[i].data );
+  libspectrum_free( fuse_ml_obs_stacks );
+
+  fuse_ml_obs_stacks = NULL;
+  fuse_ml_obs_stack_count = 0;
+  fuse_ml_obs_current = NULL;
+
+  libspectrum_free( fuse_ml_obs_output );
+  fuse_ml_obs_output = NULL;
+
+  fuse_ml_obs_width = 0;
+}
@@ -0,0 +1,53 @@
+/* ml_obs.h: observation preprocessing for the ML bridge
+   Copyright (c) 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+*/
+
+#ifndef FUSE_ML_OBS_H
+#define FUSE_ML_OBS_H
+
+#include <stdlib.h>
+
+#include "libspectrum.h"
+
+int fuse_ml_obs_configure_from_env( void );
+int fuse_ml_obs_enabled( void );
+
+/* Downscale the frame just emulated; the last two captured are max-pooled
+   when the observation is pushed */
+void fuse_ml_obs_capture( void );
+
+/* Drop the frames captured so far, so the next push uses only those
+   captured after this */
+void fuse_ml_obs_forget( void );
+
+/* Push the observation for the step just finished onto the frame stack */
+void fuse_ml_obs_push( void );
+
+/* Fill the frame stack with the current frame, as at the start of an
+   episode */
+void fuse_ml_obs_restart( void );
+
+/* Keep count frame stacks, each a copy of the current one, and make stack
+   0 current; and switch to another of them */
+void fuse_ml_obs_set_stacks( size_t count );
+void fuse_ml_obs_select( size_t stack );
+
+/* The dimensions of the observation, and its fuse_ml_obs_size() bytes,
+   the frames from oldest to newest; valid until the next call */
+void fuse_ml_obs_dimensions( int *width, int *height, int *stack );
+size_t fuse_ml_obs_size( void );
+const libspectrum_byte* fuse_ml_obs_get( void );
+
+void fuse_ml_obs_shutdown( void );
+
+#endif			/* #ifndef FUSE_ML_OBS_H */
@@ -0,0 +1,435 @@
+/* ml_record.c: trajectory recording for the ML bridge
+   Copyright (c) 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "fuse.h"
+#include "snapshot.h"
+#include "spectrum.h"
+
+#include "ml_record.h"
+
+#define FUSE_ML_RECORD_VERSION 1
+
+/* Chunks are handed to the writer once they are at least this long */
+#define FUSE_ML_RECORD_CHUNK_LENGTH 0x10000
+#define FUSE_ML_RECORD_CHUNK_HEADER 8
+
+#define FUSE_ML_RECORD_STEP_LENGTH 24
+#define FUSE_ML_RECORD_KEYFRAME_LENGTH 16
+
+#define FUSE_ML_RECORD_MAX_INSTANCES 256
+
+typedef struct fuse_ml_record_buffer {
+  libspectrum_byte *data;
+  size_t length;
+  size_t size;
+  libspectrum_dword records;
+} fuse_ml_record_buffer;
+
+static FILE *fuse_ml_record_file = NULL;
+static unsigned long fuse_ml_record_interval;
+
+/* Records are added to the current buffer while the other one is written */
+static fuse_ml_record_buffer fuse_ml_record_buffers[2];
+static fuse_ml_record_buffer *fuse_ml_record_current;
+
+/* Where the last step's observation sequence is, or 0 if it has gone */
+static size_t fuse_ml_record_observation_offset;
+
+static size_t fuse_ml_record_instance;
+static unsigned long fuse_ml_record_steps[ FUSE_ML_RECORD_MAX_INSTANCES ];
+static unsigned long
+  fuse_ml_record_since_keyframe[ FUSE_ML_RECORD_MAX_INSTANCES ];
+static int fuse_ml_record_stale[ FUSE_ML_RECORD_MAX_INSTANCES ];
+
+static unsigned long fuse_ml_record_step_count;
+static unsigned long fuse_ml_record_keyframe_count;
+
+/* Set if a write failed; reported when recording stops */
+static int fuse_ml_record_error;
+
+#ifdef HAVE_PTHREAD
+static pthread_t fuse_ml_record_thread;
+static pthread_mutex_t fuse_ml_record_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fuse_ml_record_cond = PTHREAD_COND_INITIALIZER;
+
+/* The buffer being written, if any */
+static fuse_ml_record_buffer *fuse_ml_record_pending;
+static int fuse_ml_record_quit;
+#endif
+
+static libspectrum_byte*
+fuse_ml_record_put_word( libspectrum_byte *ptr, libspectrum_word value )
+{
+  *ptr++ = value & 0xff;
+  *ptr++ = value >> 8;
+  return ptr;
+}
+
+static libspectrum_byte*
+fuse_ml_record_put_dword( libspectrum_byte *ptr, libspectrum_dword value )
+{
+  ptr = fuse_ml_record_put_word( ptr, value & 0xffff );
+  return fuse_ml_record_put_word( ptr, value >> 16 );
+}
+
+/* Room for a record of length bytes at the end of the current buffer */
+static libspectrum_byte*
+fuse_ml_record_add( size_t length )
+{
+  fuse_ml_record_buffer *buffer = fuse_ml_record_current;
+  libspectrum_byte *ptr;
+
+  if( buffer->length + length > buffer->size ) {
+    while( buffer->length + length > buffer->size ) buffer->size *= 2;
+    buffer->data = libspectrum_renew( libspectrum_byte, buffer->data,
+                                      buffer->size );
+  }
+
+  ptr = &buffer->data[ buffer->length ];
+  buffer->length += length;
+  buffer->records++;
+
+  return ptr;
+}
+
+/* Write a buffer out as a chunk and empty it */
+static void
+fuse_ml_record_write( fuse_ml_record_buffer *buffer )
+{
+  libspectrum_byte *ptr = buffer->data;
+
+  if( buffer->records ) {
+    ptr = fuse_ml_record_put_dword( ptr, buffer->length -
+                                         FUSE_ML_RECORD_CHUNK_HEADER );
+    fuse_ml_record_put_dword( ptr, buffer->records );
+
+    if( fwrite( buffer->data, 1, buffer->length, fuse_ml_record_file ) !=
+          buffer->length ||
+        fflush( fuse_ml_record_file ) )
+      fuse_ml_record_error = 1;
+  }
+
+  buffer->length = FUSE_ML_RECORD_CHUNK_HEADER;
+  buffer->records = 0;
+}
+
+#ifdef HAVE_PTHREAD
+
+static void*
+fuse_ml_record_writer( void *arg GCC_UNUSED )
+{
+  fuse_ml_record_buffer *buffer;
+
+  while( 1 ) {
+    pthread_mutex_lock( &fuse_ml_record_mutex );
+    while( !fuse_ml_record_pending && !fuse_ml_record_quit )
+      pthread_cond_wait( &fuse_ml_record_cond, &fuse_ml_record_mutex );
+    buffer = fuse_ml_record_pending;
+    pthread_mutex_unlock( &fuse_ml_record_mutex );
+
+    if( !buffer ) break;
+
+    fuse_ml_record_write( buffer );
+
+    pthread_mutex_lock( &fuse_ml_record_mutex );
+    fuse_ml_record_pending = NULL;
+    pthread_cond_broadcast( &fuse_ml_record_cond );
+    pthread_mutex_unlock( &fuse_ml_record_mutex );
+  }
+
+  return NULL;
+}
+
+#endif			/* #ifdef HAVE_PTHREAD */
+
+/* Give a full buffer to the writer.  If it is still busy with the other
+   one, the current buffer just keeps growing rather than waiting */
+static void
+fuse_ml_record_hand_off( void )
+{
+  if( fuse_ml_record_current->length < FUSE_ML_RECORD_CHUNK_LENGTH ) return;
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock( &fuse_ml_record_mutex );
+  if( !fuse_ml_record_pending ) {
+    fuse_ml_record_pending = fuse_ml_record_current;
+    fuse_ml_record_current =
+      fuse_ml_record_current == &fuse_ml_record_buffers[0] ?
+        &fuse_ml_record_buffers[1] : &fuse_ml_record_buffers[0];
+    fuse_ml_record_observation_offset = 0;
+    pthread_cond_broadcast( &fuse_ml_record_cond );
+  }
+  pthread_mutex_unlock( &fuse_ml_record_mutex );
+#else
+  fuse_ml_record_write( fuse_ml_record_current );
+  fuse_ml_record_observation_offset = 0;
+#endif
+}
+
+static void
+fuse_ml_record_free_buffers( void )
+{
+  size_t i;
+
+  for( i = 0; i < 2; i++ ) {
+    libspectrum_free( fuse_ml_record_buffers[i].data );
+    fuse_ml_record_buffers[i].data = NULL;
+  }
+}
+
+int
+fuse_ml_record_start( const char *filename, unsigned long interval,
+                      const char **error_text )
+{
+  libspectrum_byte header[16], *ptr;
+  size_t i;
+
+  if( fuse_ml_record_file ) {
+    *error_text = "ERR already recording\n";
+    return 1;
+  }
+
+  fuse_ml_record_file = fopen( filename, "wb" );
+  if( !fuse_ml_record_file ) {
+    *error_text = "ERR cannot open recording\n";
+    return 1;
+  }
+
+  memcpy( header, FUSE_ML_RECORD_MAGIC, 8 );
+  ptr = fuse_ml_record_put_dword( header + 8, FUSE_ML_RECORD_VERSION );
+  fuse_ml_record_put_dword( ptr, interval );
+
+  if( fwrite( header, 1, sizeof( header ), fuse_ml_record_file ) !=
+      sizeof( header ) ) {
+    fclose( fuse_ml_record_file );
+    fuse_ml_record_file = NULL;
+    *error_text = "ERR cannot write recording\n";
+    return 1;
+  }
+
+  for( i = 0; i < 2; i++ ) {
+    fuse_ml_record_buffers[i].size = 2 * FUSE_ML_RECORD_CHUNK_LENGTH;
+    fuse_ml_record_buffers[i].data =
+      libspectrum_new( libspectrum_byte, fuse_ml_record_buffers[i].size );
+    fuse_ml_record_buffers[i].length = FUSE_ML_RECORD_CHUNK_HEADER;
+    fuse_ml_record_buffers[i].records = 0;
+  }
+  fuse_ml_record_current = &fuse_ml_record_buffers[0];
+  fuse_ml_record_observation_offset = 0;
+
+  fuse_ml_record_interval = interval;
+  fuse_ml_record_instance = 0;
+  memset( fuse_ml_record_steps, 0, sizeof( fuse_ml_record_steps ) );
+  memset( fuse_ml_record_since_keyframe, 0,
+          sizeof( fuse_ml_record_since_keyframe ) );
+  fuse_ml_record_mark_all();
+  fuse_ml_record_step_count = fuse_ml_record_keyframe_count = 0;
+  fuse_ml_record_error = 0;
+
+#ifdef HAVE_PTHREAD
+  fuse_ml_record_pending = NULL;
+  fuse_ml_record_quit = 0;
+
+  if( pthread_create( &fuse_ml_record_thread, NULL, fuse_ml_record_writer,
+                      NULL ) ) {
+    fclose( fuse_ml_record_file );
+    fuse_ml_record_file = NULL;
+    fuse_ml_record_free_buffers();
+    *error_text = "ERR cannot start recording\n";
+    return 1;
+  }
+#endif
+
+  return 0;
+}
+
+int
+fuse_ml_record_stop( unsigned long *steps, unsigned long *keyframes,
+                     const char **error_text )
+{
+  if( !fuse_ml_record_file ) {
+    *error_text = "ERR not recording\n";
+    return 1;
+  }
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock( &fuse_ml_record_mutex );
+  fuse_ml_record_quit = 1;
+  pthread_cond_broadcast( &fuse_ml_record_cond );
+  pthread_mutex_unlock( &fuse_ml_record_mutex );
+
+  pthread_join( fuse_ml_record_thread, NULL );
+#endif
+
+  fuse_ml_record_write( fuse_ml_record_current );
+
+  if( fclose( fuse_ml_record_file ) ) fuse_ml_record_error = 1;
+  fuse_ml_record_file = NULL;
+  fuse_ml_record_free_buffers();
+
+  if( steps ) *steps = fuse_ml_record_step_count;
+  if( keyframes ) *keyframes = fuse_ml_record_keyframe_count;
+
+  if( fuse_ml_record_error ) {
+    *error_text = "ERR recording write failed\n";
+    return 1;
+  }
+
+  return 0;
+}
+
+int
+fuse_ml_record_active( void )
+{
+  return fuse_ml_record_file != NULL;
+}
+
+void
+fuse_ml_record_mark( void )
+{
+  fuse_ml_record_stale[ fuse_ml_record_instance ] = 1;
+}
+
+void
+fuse_ml_record_mark_all( void )
+{
+  size_t i;
+
+  for( i = 0; i < FUSE_ML_RECORD_MAX_INSTANCES; i++ )
+    fuse_ml_record_stale[i] = 1;
+}
+
+void
+fuse_ml_record_select( size_t instance )
+{
+  if( instance < FUSE_ML_RECORD_MAX_INSTANCES )
+    fuse_ml_record_instance = instance;
+}
+
+static int
+fuse_ml_record_keyframe( void )
+{
+  libspectrum_snap *snap;
+  libspectrum_byte *buffer = NULL, *ptr;
+  size_t length = 0;
+  int flags = 0, error;
+
+  snap = libspectrum_snap_alloc();
+
+  error = snapshot_copy_to( snap ) ||
+          libspectrum_snap_write( &buffer, &length, &flags, snap,
+                                  LIBSPECTRUM_ID_SNAPSHOT_SZX, fuse_creator,
+                                  0 );
+  libspectrum_snap_free( snap );
+
+  if( error ) {
+    libspectrum_free( buffer );
+    return 1;
+  }
+
+  ptr = fuse_ml_record_add( FUSE_ML_RECORD_KEYFRAME_LENGTH + length );
+  *ptr++ = FUSE_ML_RECORD_KEYFRAME;
+  *ptr++ = fuse_ml_record_instance;
+  ptr = fuse_ml_record_put_word( ptr, 0 );
+  ptr = fuse_ml_record_put_dword( ptr,
+                                  fuse_ml_record_steps[ fuse_ml_record_instance ] );
+  ptr = fuse_ml_record_put_dword( ptr, spectrum_frame_count() );
+  ptr = fuse_ml_record_put_dword( ptr, length );
+  memcpy( ptr, buffer, length );
+
+  libspectrum_free( buffer );
+
+  fuse_ml_record_stale[ fuse_ml_record_instance ] = 0;
+  fuse_ml_record_since_keyframe[ fuse_ml_record_instance ] = 0;
+  fuse_ml_record_keyframe_count++;
+
+  return 0;
+}
+
+int
+fuse_ml_record_prepare( void )
+{
+  size_t instance = fuse_ml_record_instance;
+
+  if( !fuse_ml_record_file ) return 0;
+
+  fuse_ml_record_hand_off();
+
+  if( fuse_ml_record_stale[ instance ] ||
+      ( fuse_ml_record_interval &&
+        fuse_ml_record_since_keyframe[ instance ] >= fuse_ml_record_interval ) )
+    return fuse_ml_record_keyframe();
+
+  return 0;
+}
+
+void
+fuse_ml_record_step( unsigned long action, const unsigned long *keys,
+                     size_t key_count, unsigned long frames,
+                     libspectrum_dword frame, long reward, int done )
+{
+  libspectrum_byte *ptr;
+  size_t i;
+
+  if( !fuse_ml_record_file ) return;
+
+  ptr = fuse_ml_record_add( FUSE_ML_RECORD_STEP_LENGTH + 2 * key_count );
+  *ptr++ = FUSE_ML_RECORD_STEP;
+  *ptr++ = fuse_ml_record_instance;
+  *ptr++ = done ? 1 : 0;
+  *ptr++ = key_count;
+  ptr = fuse_ml_record_put_dword( ptr, action );
+  ptr = fuse_ml_record_put_dword( ptr, frames );
+  ptr = fuse_ml_record_put_dword( ptr, frame );
+  ptr = fuse_ml_record_put_dword( ptr, reward );
+
+  fuse_ml_record_observation_offset = ptr - fuse_ml_record_current->data;
+  ptr = fuse_ml_record_put_dword( ptr, 0 );
+
+  for( i = 0; i < key_count; i++ )
+    ptr = fuse_ml_record_put_word( ptr, keys[i] );
+
+  fuse_ml_record_steps[ fuse_ml_record_instance ]++;
+  fuse_ml_record_since_keyframe[ fuse_ml_record_instance ]++;
+  fuse_ml_record_step_count++;
+}
+
+void
+fuse_ml_record_observation( libspectrum_dword sequence )
+{
+  if( !fuse_ml_record_file || !fuse_ml_record_observation_offset ) return;
+
+  fuse_ml_record_put_dword(
+    &fuse_ml_record_current->data[ fuse_ml_record_observation_offset ],
+    sequence
+  );
+}
+
+void
+fuse_ml_record_shutdown( void )
+{
+  const char *error_text;
+
+  if( fuse_ml_record_file ) fuse_ml_record_stop( NULL, NULL, &error_text );
+}
@@ -0,0 +1,74 @@
+/* ml_record.h: trajectory recording for the ML bridge
+   Copyright (c) 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+*/
+
+#ifndef FUSE_ML_RECORD_H
+#define FUSE_ML_RECORD_H
+
+#include <stdlib.h>
+
+#include "libspectrum.h"
+
+#define FUSE_ML_RECORD_MAGIC "FUSETRJ1"
+
+/* The action recorded for steps given as keys rather than an action */
+#define FUSE_ML_RECORD_NO_ACTION 0xffffffffUL
+
+/* Steps between keyframes unless asked otherwise */
+#define FUSE_ML_RECORD_DEFAULT_INTERVAL 1000
+
+/* The file is the magic, a u32 version and a u32 keyframe interval,
+   followed by chunks, each a u32 length and u32 record count followed by
+   that many records.  Records are one of:
+
+   'S' step: u8 instance, u8 done, u8 key count, u32 action, u32 frames
+       asked for, u32 frame count after the step, i32 reward, u32 shared
+       memory sequence of its observation (0 for none), u16 for each key
+
+   'K' keyframe: u8 instance, u16 reserved, u32 steps of the instance
+       before it, u32 frame count, u32 length, then an .szx snapshot of the
+       state before the next step
+
+   Everything is little-endian */
+
+#define FUSE_ML_RECORD_STEP 'S'
+#define FUSE_ML_RECORD_KEYFRAME 'K'
+
+int fuse_ml_record_start( const char *filename, unsigned long interval,
+                          const char **error_text );
+int fuse_ml_record_stop( unsigned long *steps, unsigned long *keyframes,
+                         const char **error_text );
+int fuse_ml_record_active( void );
+
+/* The state of the current instance changed other than by a step, so the
+   next step of it needs a keyframe; or all of the instances */
+void fuse_ml_record_mark( void );
+void fuse_ml_record_mark_all( void );
+
+/* Steps from now on are of this instance */
+void fuse_ml_record_select( size_t instance );
+
+/* Called before and after each step; the keyframe, if one is due, is
+   made before the step */
+int fuse_ml_record_prepare( void );
+void fuse_ml_record_step( unsigned long action, const unsigned long *keys,
+                          size_t key_count, unsigned long frames,
+                          libspectrum_dword frame, long reward, int done );
+
+/* The observation sent for the last step went into the shared memory ring
+   with this sequence number */
+void fuse_ml_record_observation( libspectrum_dword sequence );
+
+void fuse_ml_record_shutdown( void );
+
+#endif			/* #ifndef FUSE_ML_RECORD_H */
@@ -0,0 +1,372 @@
+/* ml_shm.c: shared memory observation ring for the ML bridge
+   Copyright (c) 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "display.h"
+#include "memory_pages.h"
+#include "spectrum.h"
+#include "ui/ui.h"
+#include "utils.h"
+
+#include "ml_shm.h"
+
+#define FUSE_ML_SHM_MAX_SLOTS 1024
+
+/* Slots and the parts of each start on a cache line */
+#define FUSE_ML_SHM_ALIGN( x ) ( ( (x) + 63 ) & ~(size_t)63 )
+
+/* Enough for the Timex hi-res screen, the largest there is */
+#define FUSE_ML_SHM_SCREEN_SIZE ( DISPLAY_SCREEN_WIDTH * 2 * DISPLAY_SCREEN_HEIGHT )
+
+#define FUSE_ML_SHM_ATTR_BASE 0x5800
+#define FUSE_ML_SHM_ATTR_COUNT 768
+
+static unsigned long fuse_ml_shm_slot_count = 0;
+static char *fuse_ml_shm_name = NULL;
+static fuse_ml_shm_window fuse_ml_shm_windows[ FUSE_ML_SHM_MAX_WINDOWS ];
+static size_t fuse_ml_shm_window_count = 0;
+
+static fuse_ml_shm_header *fuse_ml_shm_region = NULL;
+static size_t fuse_ml_shm_region_size = 0;
+
+/* Parse "address:length" pairs separated by commas */
+static int
+fuse_ml_shm_parse_windows( const char *text )
+{
+  const char *cursor = text;
+  unsigned long total = 0;
+
+  fuse_ml_shm_window_count = 0;
+
+  while( *cursor ) {
+    unsigned long address, length;
+    char *endptr;
+
+    if( fuse_ml_shm_window_count >= FUSE_ML_SHM_MAX_WINDOWS ) return 1;
+
+    errno = 0;
+    address = strtoul( cursor, &endptr, 0 );
+    if( errno || endptr == cursor || *endptr != ':' ) return 1;
+    cursor = endptr + 1;
+
+    length = strtoul( cursor, &endptr, 0 );
+    if( errno || endptr == cursor ) return 1;
+    cursor = endptr;
+
+    if( address > 0xffff || !length || length > 0x10000 - address ) return 1;
+
+    total += length;
+    if( total > 0x10000 ) return 1;
+
+    fuse_ml_shm_windows[ fuse_ml_shm_window_count ].address = address;
+    fuse_ml_shm_windows[ fuse_ml_shm_window_count ].length = length;
+    fuse_ml_shm_window_count++;
+
+    if( !*cursor ) break;
+    if( *cursor != ',' ) return 1;
+    cursor++;
+  }
+
+  return 0;
+}
+
+int
+fuse_ml_shm_configure_from_env( void )
+{
+  const char *slots = getenv( "FUSE_ML_SHM_SLOTS" );
+  const char *name = getenv( "FUSE_ML_SHM_NAME" );
+  const char *windows = getenv( "FUSE_ML_SHM_RAM" );
+  char *endptr;
+
+  fuse_ml_shm_slot_count = 0;
+  fuse_ml_shm_window_count = 0;
+
+  if( !slots || !*slots ) return 0;
+
+  errno = 0;
+  fuse_ml_shm_slot_count = strtoul( slots, &endptr, 0 );
+  if( errno || endptr == slots || *endptr ||
+      fuse_ml_shm_slot_count > FUSE_ML_SHM_MAX_SLOTS ) {
+    ui_error( UI_ERROR_ERROR, "Invalid FUSE_ML_SHM_SLOTS: %s", slots );
+    fuse_ml_shm_slot_count = 0;
+    return 1;
+  }
+
+  if( !fuse_ml_shm_slot_count ) return 0;
+
+  if( name && *name ) {
+    if( name[0] != '/' || strchr( name + 1, '/' ) ) {
+      ui_error( UI_ERROR_ERROR, "Invalid FUSE_ML_SHM_NAME: %s", name );
+      fuse_ml_shm_slot_count = 0;
+      return 1;
+    }
+    fuse_ml_shm_name = utils_safe_strdup( name );
+  } else {
+    fuse_ml_shm_name = utils_safe_strdup( "/fuse-ml" );
+  }
+
+  if( windows && *windows && fuse_ml_shm_parse_windows( windows ) ) {
+    ui_error( UI_ERROR_ERROR, "Invalid FUSE_ML_SHM_RAM: %s", windows );
+    fuse_ml_shm_shutdown();
+    return 1;
+  }
+
+  return 0;
+}
+
+int
+fuse_ml_shm_enabled( void )
+{
+  return fuse_ml_shm_region != NULL;
+}
+
+#ifndef WIN32
+
+int
+fuse_ml_shm_init( void )
+{
+  fuse_ml_shm_header header;
+  size_t i, ram_size = 0;
+  int fd;
+  void *region;
+
+  if( !fuse_ml_shm_slot_count ) return 0;
+
+  for( i = 0; i < fuse_ml_shm_window_count; i++ )
+    ram_size += fuse_ml_shm_windows[i].length;
+
+  memset( &header, 0, sizeof( header ) );
+  memcpy( header.magic, FUSE_ML_SHM_MAGIC, sizeof( header.magic ) );
+  header.header_size = FUSE_ML_SHM_ALIGN( sizeof( fuse_ml_shm_header ) );
+  header.slot_count = fuse_ml_shm_slot_count;
+  header.screen_offset = FUSE_ML_SHM_ALIGN( sizeof( fuse_ml_shm_slot ) );
+  header.screen_size = FUSE_ML_SHM_SCREEN_SIZE;
+  header.attrs_offset =
+    FUSE_ML_SHM_ALIGN( header.screen_offset + header.screen_size );
+  header.attrs_size = FUSE_ML_SHM_ATTR_COUNT;
+  header.ram_offset =
+    FUSE_ML_SHM_ALIGN( header.attrs_offset + header.attrs_size );
+  header.ram_size = ram_size;
+  header.slot_size = FUSE_ML_SHM_ALIGN( header.ram_offset + header.ram_size );
+  header.window_count = fuse_ml_shm_window_count;
+  memcpy( header.windows, fuse_ml_shm_windows, sizeof( header.windows ) );
+
+  fuse_ml_shm_region_size =
+    header.header_size + (size_t)header.slot_count * header.slot_size;
+
+  fd = shm_open( fuse_ml_shm_name, O_RDWR | O_CREAT | O_TRUNC, 0600 );
+  if( fd < 0 ) {
+    ui_error( UI_ERROR_ERROR, "ML bridge failed to create shared memory %s: %s",
+              fuse_ml_shm_name, strerror( errno ) );
+    return 1;
+  }
+
+  if( ftruncate( fd, fuse_ml_shm_region_size ) ) {
+    ui_error( UI_ERROR_ERROR, "ML bridge failed to size shared memory %s: %s",
+              fuse_ml_shm_name, strerror( errno ) );
+    close( fd );
+    shm_unlink( fuse_ml_shm_name );
+    return 1;
+  }
+
+  region = mmap( NULL, fuse_ml_shm_region_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, 0 );
+  close( fd );
+
+  if( region == MAP_FAILED ) {
+    ui_error( UI_ERROR_ERROR, "ML bridge failed to map shared memory %s: %s",
+              fuse_ml_shm_name, strerror( errno ) );
+    shm_unlink( fuse_ml_shm_name );
+    return 1;
+  }
+
+  fuse_ml_shm_region = region;
+  memcpy( fuse_ml_shm_region, &header, sizeof( header ) );
+
+  ui_error( UI_ERROR_INFO, "ML bridge observations in shared memory %s",
+            fuse_ml_shm_name );
+
+  return 0;
+}
+
+/* Write the current observation to the next slot.  The slot's sequence
+   number is cleared first and only set again once everything else has
+   been written, so a reader can tell a slot being overwritten */
+int
+fuse_ml_shm_publish( int width, int height, long reward, int done,
+                     int reset, libspectrum_dword *slot_index,
+                     libspectrum_dword *sequence )
+{
+  fuse_ml_shm_header *header = fuse_ml_shm_region;
+  fuse_ml_shm_slot *slot;
+  libspectrum_byte *base, *data;
+  libspectrum_dword next, index;
+  size_t i;
+  int x, y;
+
+  if( !header ) return 1;
+
+  next = header->sequence + 1;
+  if( !next ) next = 1;
+  index = ( next - 1 ) % header->slot_count;
+
+  base = (libspectrum_byte*)header + header->header_size +
+         (size_t)index * header->slot_size;
+  slot = (fuse_ml_shm_slot*)base;
+
+  slot->sequence = 0;
+  __sync_synchronize();
+
+  slot->frame = spectrum_frame_count();
+  slot->tstates = tstates;
+  slot->reward = reward;
+  slot->width = width;
+  slot->height = height;
+  slot->done = done;
+  slot->reset = reset;
+
+  data = base + header->screen_offset;
+  for( y = 0; y < height; y++ )
+    for( x = 0; x < width; x++ )
+      *data++ = display_getpixel( x, y );
+
+  data = base + header->attrs_offset;
+  for( i = 0; i < FUSE_ML_SHM_ATTR_COUNT; i++ )
+    data[i] = readbyte_internal( (libspectrum_word)( FUSE_ML_SHM_ATTR_BASE + i ) );
+
+  data = base + header->ram_offset;
+  for( i = 0; i < header->window_count; i++ ) {
+    libspectrum_word address = header->windows[i].address;
+    size_t j;
+
+    for( j = 0; j < header->windows[i].length; j++ )
+      *data++ = readbyte_internal( (libspectrum_word)( address + j ) );
+  }
+
+  __sync_synchronize();
+  slot->sequence = next;
+  header->sequence = next;
+
+  *slot_index = index;
+  *sequence = next;
+
+  return 0;
+}
+
+/* Called in a forked worker: leave the parent's region to the parent and
+   make a region of the worker's own, with ".<worker>" added to the name */
+int
+fuse_ml_shm_fork( unsigned long worker )
+{
+  char *name;
+  size_t length;
+
+  if( !fuse_ml_shm_region ) return 0;
+
+  munmap( fuse_ml_shm_region, fuse_ml_shm_region_size );
+  fuse_ml_shm_region = NULL;
+
+  length = strlen( fuse_ml_shm_name ) + 24;
+  name = libspectrum_new( char, length );
+  snprintf( name, length, "%s.%lu", fuse_ml_shm_name, worker );
+  libspectrum_free( fuse_ml_shm_name );
+  fuse_ml_shm_name = name;
+
+  return fuse_ml_shm_init();
+}
+
+void
+fuse_ml_shm_shutdown( void )
+{
+  if( fuse_ml_shm_region ) {
+    munmap( fuse_ml_shm_region, fuse_ml_shm_region_size );
+    fuse_ml_shm_region = NULL;
+    shm_unlink( fuse_ml_shm_name );
+  }
+
+  if( fuse_ml_shm_name ) {
+    libspectrum_free( fuse_ml_shm_name );
+    fuse_ml_shm_name = NULL;
+  }
+
+  fuse_ml_shm_slot_count = 0;
+}
+
+#else
+
+int
+fuse_ml_shm_init( void )
+{
+  if( fuse_ml_shm_slot_count ) {
+    ui_error( UI_ERROR_ERROR,
+              "ML bridge shared memory is unsupported on this platform" );
+    return 1;
+  }
+
+  return 0;
+}
+
+int
+fuse_ml_shm_publish( int width, int height, long reward, int done,
+                     int reset, libspectrum_dword *slot_index,
+                     libspectrum_dword *sequence )
+{
+  return 1;
+}
+
+void
+fuse_ml_shm_shutdown( void )
+{
+  if( fuse_ml_shm_name ) {
+    libspectrum_free( fuse_ml_shm_name );
+    fuse_ml_shm_name = NULL;
+  }
+
+  fuse_ml_shm_slot_count = 0;
+}
+
+#endif
+
+int
+fuse_ml_shm_info( char *buffer, size_t length )
+{
+  int written;
+
+  if( !buffer || !length ) return 1;
+
+  if( !fuse_ml_shm_region ) {
+    written = snprintf( buffer, length, "SHM OFF\n" );
+  } else {
+    written = snprintf( buffer, length, "SHM ON %s %lu %lu %lu\n",
+                        fuse_ml_shm_name,
+                        (unsigned long)fuse_ml_shm_region->slot_count,
+                        (unsigned long)fuse_ml_shm_region->slot_size,
+                        (unsigned long)fuse_ml_shm_region_size );
+  }
+
+  return ( written < 0 || (size_t)written >= length ) ? 1 : 0;
+}
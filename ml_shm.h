@@ -0,0 +1,80 @@
+/* ml_shm.h: shared memory observation ring for the ML bridge
+   Copyright (c) 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+*/
+
+#ifndef FUSE_ML_SHM_H
+#define FUSE_ML_SHM_H
+
+#include <stdlib.h>
+
+#include "libspectrum.h"
+
+#define FUSE_ML_SHM_MAGIC "FUSEOBS1"
+#define FUSE_ML_SHM_MAX_WINDOWS 8
+
+/* The region starts with this header, followed by the slots from
+   header_size on, each slot_size bytes long.  Everything is in the
+   host's byte order */
+
+typedef struct fuse_ml_shm_window {
+  libspectrum_word address;
+  libspectrum_word length;
+} fuse_ml_shm_window;
+
+typedef struct fuse_ml_shm_header {
+  char magic[8];
+  libspectrum_dword header_size;
+  libspectrum_dword slot_count;
+  libspectrum_dword slot_size;
+
+  /* Where each part of an observation is within a slot */
+  libspectrum_dword screen_offset;
+  libspectrum_dword screen_size;
+  libspectrum_dword attrs_offset;
+  libspectrum_dword attrs_size;
+  libspectrum_dword ram_offset;
+  libspectrum_dword ram_size;
+
+  /* The RAM windows, copied one after another from ram_offset */
+  libspectrum_dword window_count;
+  fuse_ml_shm_window windows[ FUSE_ML_SHM_MAX_WINDOWS ];
+
+  /* The sequence number of the last observation written */
+  volatile libspectrum_dword sequence;
+} fuse_ml_shm_header;
+
+/* The start of each slot; sequence is 0 while the slot is being written
+   and observation n is in slot ( n - 1 ) % slot_count */
+typedef struct fuse_ml_shm_slot {
+  volatile libspectrum_dword sequence;
+  libspectrum_dword frame;
+  libspectrum_dword tstates;
+  libspectrum_signed_dword reward;
+  libspectrum_word width;
+  libspectrum_word height;
+  libspectrum_byte done;
+  libspectrum_byte reset;
+  libspectrum_byte reserved[2];
+} fuse_ml_shm_slot;
+
+int fuse_ml_shm_configure_from_env( void );
+int fuse_ml_shm_init( void );
+int fuse_ml_shm_enabled( void );
+int fuse_ml_shm_publish( int width, int height, long reward, int done,
+                         int reset, libspectrum_dword *slot,
+                         libspectrum_dword *sequence );
+int fuse_ml_shm_info( char *buffer, size_t length );
+int fuse_ml_shm_fork( unsigned long worker );
+void fuse_ml_shm_shutdown( void );
+
+#endif			/* #ifndef FUSE_ML_SHM_H */
@@ -0,0 +1,99 @@
+/* ml_stats.c: counters and timings for the ML bridge
+   Copyright (c) 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+*/
+
+#include "config.h"
+
+#include <string.h>
+#ifdef HAVE_CLOCK_GETTIME
+#include <time.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include "ml_stats.h"
+
+static libspectrum_qword fuse_ml_stats_counters[ FUSE_ML_STATS_COUNTERS ];
+static fuse_ml_stats_histogram fuse_ml_stats_histograms[ FUSE_ML_STATS_TIMERS ];
+
+static const char * const fuse_ml_stats_timer_names[ FUSE_ML_STATS_TIMERS ] = {
+  "STEP", "OBS", "IO",
+};
+
+void
+fuse_ml_stats_count( fuse_ml_stats_counter counter, libspectrum_qword amount )
+{
+  fuse_ml_stats_counters[ counter ] += amount;
+}
+
+libspectrum_qword
+fuse_ml_stats_counter_value( fuse_ml_stats_counter counter )
+{
+  return fuse_ml_stats_counters[ counter ];
+}
+
+libspectrum_qword
+fuse_ml_stats_now( void )
+{
+#ifdef HAVE_CLOCK_GETTIME
+  struct timespec now;
+
+  if( clock_gettime( CLOCK_MONOTONIC, &now ) ) return 0;
+
+  return (libspectrum_qword)now.tv_sec * 1000000000 + now.tv_nsec;
+#else
+  struct timeval now;
+
+  if( gettimeofday( &now, NULL ) ) return 0;
+
+  return (libspectrum_qword)now.tv_sec * 1000000000 + now.tv_usec * 1000;
+#endif
+}
+
+void
+fuse_ml_stats_time( fuse_ml_stats_timer timer, libspectrum_qword start )
+{
+  fuse_ml_stats_histogram *histogram = &fuse_ml_stats_histograms[ timer ];
+  libspectrum_qword now = fuse_ml_stats_now();
+  libspectrum_qword elapsed = now > start ? now - start : 0;
+  libspectrum_qword microseconds = elapsed / 1000;
+  size_t bucket = 0;
+
+  while( microseconds && bucket < FUSE_ML_STATS_BUCKETS - 1 ) {
+    microseconds >>= 1;
+    bucket++;
+  }
+
+  histogram->count++;
+  histogram->total += elapsed;
+  histogram->buckets[ bucket ]++;
+}
+
+const fuse_ml_stats_histogram*
+fuse_ml_stats_histogram_get( fuse_ml_stats_timer timer )
+{
+  return &fuse_ml_stats_histograms[ timer ];
+}
+
+const char*
+fuse_ml_stats_timer_name( fuse_ml_stats_timer timer )
+{
+  return fuse_ml_stats_timer_names[ timer ];
+}
+
+void
+fuse_ml_stats_clear( void )
+{
+  memset( fuse_ml_stats_counters, 0, sizeof( fuse_ml_stats_counters ) );
+  memset( fuse_ml_stats_histograms, 0, sizeof( fuse_ml_stats_histograms ) );
+}
@@ -0,0 +1,63 @@
+/* ml_stats.h: counters and timings for the ML bridge
+   Copyright (c) 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+*/
+
+#ifndef FUSE_ML_STATS_H
+#define FUSE_ML_STATS_H
+
+#include "libspectrum.h"
+
+typedef enum fuse_ml_stats_counter {
+  FUSE_ML_STATS_COMMANDS,
+  FUSE_ML_STATS_FRAMES,
+  FUSE_ML_STATS_INSTRUCTIONS,
+  FUSE_ML_STATS_RESETS,
+  FUSE_ML_STATS_BYTES_SENT,
+
+  FUSE_ML_STATS_COUNTERS
+} fuse_ml_stats_counter;
+
+typedef enum fuse_ml_stats_timer {
+  FUSE_ML_STATS_STEP,		/* emulating the frames of a step */
+  FUSE_ML_STATS_OBS,		/* building an observation or screen */
+  FUSE_ML_STATS_IO,		/* each write to the socket */
+
+  FUSE_ML_STATS_TIMERS
+} fuse_ml_stats_timer;
+
+/* Bucket 0 counts times under a microsecond, bucket n those from 2^(n-1)
+   up to 2^n microseconds, and the last one everything longer */
+#define FUSE_ML_STATS_BUCKETS 24
+
+typedef struct fuse_ml_stats_histogram {
+  libspectrum_qword count;
+  libspectrum_qword total;	/* nanoseconds */
+  libspectrum_qword buckets[ FUSE_ML_STATS_BUCKETS ];
+} fuse_ml_stats_histogram;
+
+void fuse_ml_stats_count( fuse_ml_stats_counter counter,
+                          libspectrum_qword amount );
+libspectrum_qword fuse_ml_stats_counter_value( fuse_ml_stats_counter counter );
+
+/* A monotonic time in nanoseconds, to be given back to fuse_ml_stats_time()
+   once whatever is being timed is done */
+libspectrum_qword fuse_ml_stats_now( void );
+void fuse_ml_stats_time( fuse_ml_stats_timer timer, libspectrum_qword start );
+
+const fuse_ml_stats_histogram*
+fuse_ml_stats_histogram_get( fuse_ml_stats_timer timer );
+const char* fuse_ml_stats_timer_name( fuse_ml_stats_timer timer );
+
+void fuse_ml_stats_clear( void );
+
+#endif			/* #ifndef FUSE_ML_STATS_H */
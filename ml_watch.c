@@ -0,0 +1,352 @@
+/* ml_watch.c: memory watch list for the ML bridge
+   Copyright (c) 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fuse.h"
+#include "memory_pages.h"
+#include "spectrum.h"
+
+#include "ml_watch.h"
+
+/* An entry may start and end part way through a page, so may need two more
+   segments than the whole pages it covers; every entry may do so, however
+   short it is */
+#define FUSE_ML_WATCH_MAX_SEGMENTS \
+  ( 2 * FUSE_ML_WATCH_MAX_ENTRIES + \
+    FUSE_ML_WATCH_MAX_LENGTH / MEMORY_PAGE_SIZE )
+
+/* A run of bytes which can be copied in one go: from a RAM bank if data is
+   set, otherwise from whichever page is mapped in at page */
+typedef struct fuse_ml_watch_segment {
+  const libspectrum_byte *data;
+  size_t page;
+  size_t offset;
+  size_t length;
+} fuse_ml_watch_segment;
+
+static fuse_ml_watch_entry fuse_ml_watch_entries[ FUSE_ML_WATCH_MAX_ENTRIES ];
+static size_t fuse_ml_watch_entry_count = 0;
+static int fuse_ml_watch_changes_only = 0;
+
+static fuse_ml_watch_segment
+  fuse_ml_watch_segments[ FUSE_ML_WATCH_MAX_SEGMENTS ];
+static size_t fuse_ml_watch_segment_count = 0;
+
+/* The values last gathered and the ones before, and which entries differ
+   between them */
+static libspectrum_byte fuse_ml_watch_values[ FUSE_ML_WATCH_MAX_LENGTH ];
+static libspectrum_byte fuse_ml_watch_previous[ FUSE_ML_WATCH_MAX_LENGTH ];
+static size_t fuse_ml_watch_total = 0;
+static int fuse_ml_watch_differs[ FUSE_ML_WATCH_MAX_ENTRIES ];
+static int fuse_ml_watch_gathered = 0;
+
+int
+fuse_ml_watch_parse( const char *text, fuse_ml_watch_entry *entries,
+                     size_t *count )
+{
+  const char *cursor = text;
+
+  *count = 0;
+
+  while( *cursor ) {
+    unsigned long address, length, bank = 0;
+    char *endptr;
+    int banked = 0;
+
+    if( *count >= FUSE_ML_WATCH_MAX_ENTRIES ) return 1;
+
+    errno = 0;
+    address = strtoul( cursor, &endptr, 0 );
+    if( errno || endptr == cursor || *endptr != ':' ) return 1;
+    cursor = endptr + 1;
+
+    length = strtoul( cursor, &endptr, 0 );
+    if( errno || endptr == cursor ) return 1;
+    cursor = endptr;
+
+    if( *cursor == '@' ) {
+      cursor++;
+      bank = strtoul( cursor, &endptr, 0 );
+      if( errno || endptr == cursor ) return 1;
+      cursor = endptr;
+      banked = 1;
+    }
+
+    entries[ *count ].address = address;
+    entries[ *count ].length = length;
+    /* An out of range bank is left for fuse_ml_watch_set() to refuse */
+    entries[ *count ].bank = !banked ? -1 :
+                             bank < SPECTRUM_RAM_PAGES ? (int)bank :
+                                                         SPECTRUM_RAM_PAGES;
+    (*count)++;
+
+    if( !*cursor ) break;
+    if( *cursor != ',' ) return 1;
+    cursor++;
+  }
+
+  return 0;
+}
+
+static void
+fuse_ml_watch_add_segments( const fuse_ml_watch_entry *entry )
+{
+  fuse_ml_watch_segment *segment;
+  size_t address = entry->address, length = entry->length;
+
+  /* A bank is the same memory wherever it is paged in */
+  if( entry->bank >= 0 ) {
+    segment = &fuse_ml_watch_segments[ fuse_ml_watch_segment_count++ ];
+    segment->data = &RAM[ entry->bank ][ address ];
+    segment->length = length;
+    return;
+  }
+
+  while( length ) {
+    size_t offset = address & MEMORY_PAGE_SIZE_MASK;
+    size_t run = MEMORY_PAGE_SIZE - offset;
+
+    if( run > length ) run = length;
+
+    segment = &fuse_ml_watch_segments[ fuse_ml_watch_segment_count++ ];
+    segment->data = NULL;
+    segment->page = address >> MEMORY_PAGE_SIZE_LOGARITHM;
+    segment->offset = offset;
+    segment->length = run;
+
+    address += run;
+    length -= run;
+  }
+}
+
+int
+fuse_ml_watch_set( const fuse_ml_watch_entry *entries, size_t count,
+                   int changes, const char **error_text )
+{
+  size_t i, total = 0;
+
+  if( count > FUSE_ML_WATCH_MAX_ENTRIES ) {
+    *error_text = "ERR too many watch entries\n";
+    return 1;
+  }
+
+  for( i = 0; i < count; i++ ) {
+    size_t limit = entries[i].bank >= 0 ? 0x4000 : 0x10000;
+
+    if( !entries[i].length || entries[i].address >= limit ||
+        entries[i].length > limit - entries[i].address ||
+        entries[i].bank >= SPECTRUM_RAM_PAGES ) {
+      *error_text = "ERR invalid watch entry\n";
+      return 1;
+    }
+
+    total += entries[i].length;
+    if( total > FUSE_ML_WATCH_MAX_LENGTH ) {
+      *error_text = "ERR watch list too long\n";
+      return 1;
+    }
+  }
+
+  memcpy( fuse_ml_watch_entries, entries, count * sizeof( *entries ) );
+  fuse_ml_watch_entry_count = count;
+  fuse_ml_watch_changes_only = changes;
+  fuse_ml_watch_total = total;
+  fuse_ml_watch_gathered = 0;
+
+  fuse_ml_watch_segment_count = 0;
+  for( i = 0; i < count; i++ )
+    fuse_ml_watch_add_segments( &entries[i] );
+
+  return 0;
+}
+
+size_t
+fuse_ml_watch_count( void )
+{
+  return fuse_ml_watch_entry_count;
+}
+
+size_t
+fuse_ml_watch_length( void )
+{
+  return fuse_ml_watch_total;
+}
+
+int
+fuse_ml_watch_changes( void )
+{
+  return fuse_ml_watch_changes_only;
+}
+
+const libspectrum_byte*
+fuse_ml_watch_gather( void )
+{
+  libspectrum_byte *output = fuse_ml_watch_values;
+  size_t i, offset = 0;
+
+  memcpy( fuse_ml_watch_previous, fuse_ml_watch_values, fuse_ml_watch_total );
+
+  for( i = 0; i < fuse_ml_watch_segment_count; i++ ) {
+    const fuse_ml_watch_segment *segment = &fuse_ml_watch_segments[i];
+    const libspectrum_byte *data = segment->data ? segment->data :
+      memory_map_read[ segment->page ].page + segment->offset;
+
+    memcpy( output, data, segment->length );
+    output += segment->length;
+  }
+
+  for( i = 0; i < fuse_ml_watch_entry_count; i++ ) {
+    size_t length = fuse_ml_watch_entries[i].length;
+
+    fuse_ml_watch_differs[i] = !fuse_ml_watch_gathered ||
+      memcmp( &fuse_ml_watch_values[ offset ],
+              &fuse_ml_watch_previous[ offset ], length );
+    offset += length;
+  }
+
+  fuse_ml_watch_gathered = 1;
+
+  return fuse_ml_watch_values;
+}
+
+int
+fuse_ml_watch_changed( size_t entry, size_t *offset, size_t *length )
+{
+  size_t i;
+
+  *offset = 0;
+  for( i = 0; i < entry; i++ ) *offset += fuse_ml_watch_entries[i].length;
+  *length = fuse_ml_watch_entries[ entry ].length;
+
+  return fuse_ml_watch_differs[ entry ];
+}
+
+/* Check the values gathered for each entry against memory */
+static int
+fuse_ml_watch_test_gather( const fuse_ml_watch_entry *entries, size_t count )
+{
+  const libspectrum_byte *values = fuse_ml_watch_gather();
+  size_t i, j;
+
+  for( i = 0; i < count; i++ ) {
+    for( j = 0; j < entries[i].length; j++ ) {
+      libspectrum_byte expected = entries[i].bank >= 0 ?
+        RAM[ entries[i].bank ][ entries[i].address + j ] :
+        readbyte_internal( entries[i].address + j );
+
+      if( *values++ != expected ) return 1;
+    }
+  }
+
+  return 0;
+}
+
+int
+fuse_ml_watch_unittest( void )
+{
+  static const char * const malformed[] = {
+    "0x4000", "0x4000:", ":2", "0x4000:2;0x5000:1", "0x4000:2@", "x:1",
+  };
+  fuse_ml_watch_entry entries[ FUSE_ML_WATCH_MAX_ENTRIES + 1 ];
+  const char *error_text;
+  size_t count, offset, length, i;
+  libspectrum_byte saved;
+  int r = 0;
+
+  if( fuse_ml_watch_parse( "0x5c00:2,23560:1@5", entries, &count ) ||
+      count != 2 ||
+      entries[0].address != 0x5c00 || entries[0].length != 2 ||
+      entries[0].bank != -1 ||
+      entries[1].address != 23560 || entries[1].length != 1 ||
+      entries[1].bank != 5 ) {
+    printf( "%s: watch list not parsed\n", fuse_progname );
+    r++;
+  }
+
+  for( i = 0; i < ARRAY_SIZE( malformed ); i++ ) {
+    if( !fuse_ml_watch_parse( malformed[i], entries, &count ) ) {
+      printf( "%s: accepted watch list \"%s\"\n", fuse_progname,
+              malformed[i] );
+      r++;
+    }
+  }
+
+  /* Entries which cannot be read are refused, and leave the list as it
+     was */
+  entries[0].address = 0xffff; entries[0].length = 2; entries[0].bank = -1;
+  if( !fuse_ml_watch_set( entries, 1, 0, &error_text ) ) r++;
+  entries[0].address = 0x3fff; entries[0].length = 2; entries[0].bank = 5;
+  if( !fuse_ml_watch_set( entries, 1, 0, &error_text ) ) r++;
+  entries[0].address = 0; entries[0].length = 1;
+  entries[0].bank = SPECTRUM_RAM_PAGES;
+  if( !fuse_ml_watch_set( entries, 1, 0, &error_text ) ) r++;
+  entries[0].address = 0; entries[0].length = 0; entries[0].bank = -1;
+  if( !fuse_ml_watch_set( entries, 1, 0, &error_text ) ) r++;
+  entries[0].address = 0; entries[0].length = FUSE_ML_WATCH_MAX_LENGTH;
+  entries[1] = entries[0]; entries[1].length = 1;
+  if( !fuse_ml_watch_set( entries, 2, 0, &error_text ) ) r++;
+  if( !fuse_ml_watch_set( entries, FUSE_ML_WATCH_MAX_ENTRIES + 1, 0,
+                          &error_text ) ) r++;
+  if( fuse_ml_watch_count() ) r++;
+
+  /* As many entries as are allowed, each of them across a page boundary,
+     and the last across two */
+  for( i = 0; i < FUSE_ML_WATCH_MAX_ENTRIES - 1; i++ ) {
+    entries[i].address = MEMORY_PAGE_SIZE * ( i + 1 ) - 1;
+    entries[i].length = 2;
+    entries[i].bank = -1;
+  }
+  entries[i].address = 0x8000 - 1;
+  entries[i].length = MEMORY_PAGE_SIZE + 2;
+  entries[i].bank = -1;
+
+  if( fuse_ml_watch_set( entries, FUSE_ML_WATCH_MAX_ENTRIES, 0,
+                         &error_text ) ) {
+    printf( "%s: watch list across pages refused\n", fuse_progname );
+    r++;
+  } else if( fuse_ml_watch_test_gather( entries,
+                                        FUSE_ML_WATCH_MAX_ENTRIES ) ) {
+    printf( "%s: watch list across pages misread\n", fuse_progname );
+    r++;
+  }
+
+  /* Only the entry whose memory changes is reported as changed */
+  entries[0].address = 0x10; entries[0].length = 4; entries[0].bank = 5;
+  entries[1].address = 0x20; entries[1].length = 4; entries[1].bank = 5;
+
+  if( fuse_ml_watch_set( entries, 2, 1, &error_text ) ) {
+    r++;
+  } else {
+    fuse_ml_watch_gather();
+    if( !fuse_ml_watch_changed( 0, &offset, &length ) ) r++;
+
+    saved = RAM[5][0x22];
+    RAM[5][0x22] ^= 0xff;
+    if( fuse_ml_watch_test_gather( entries, 2 ) ) r++;
+    if( fuse_ml_watch_changed( 0, &offset, &length ) ) r++;
+    if( !fuse_ml_watch_changed( 1, &offset, &length ) ||
+        offset != 4 || length != 4 ) r++;
+    RAM[5][0x22] = saved;
+  }
+
+  fuse_ml_watch_set( NULL, 0, 0, &error_text );
+
+  return r;
+}
@@ -0,0 +1,56 @@
+/* ml_watch.h: memory watch list for the ML bridge
+   Copyright (c) 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+*/
+
+#ifndef FUSE_ML_WATCH_H
+#define FUSE_ML_WATCH_H
+
+#include <stdlib.h>
+
+#include "libspectrum.h"
+
+#define FUSE_ML_WATCH_MAX_ENTRIES 32
+#define FUSE_ML_WATCH_MAX_LENGTH 0x1000
+
+/* length bytes from address as currently mapped or, if bank is not -1,
+   from address within that RAM bank */
+typedef struct fuse_ml_watch_entry {
+  size_t address;
+  size_t length;
+  int bank;
+} fuse_ml_watch_entry;
+
+/* Parse "address:length[@bank]" entries separated by commas */
+int fuse_ml_watch_parse( const char *text, fuse_ml_watch_entry *entries,
+                         size_t *count );
+
+/* Watch count entries, or nothing if count is 0; with changes set, only
+   the entries which changed are reported */
+int fuse_ml_watch_set( const fuse_ml_watch_entry *entries, size_t count,
+                       int changes, const char **error_text );
+
+size_t fuse_ml_watch_count( void );
+size_t fuse_ml_watch_length( void );
+int fuse_ml_watch_changes( void );
+
+/* Read the values of every entry, one after another, and note which have
+   changed since the last time */
+const libspectrum_byte* fuse_ml_watch_gather( void );
+
+/* Whether an entry changed, and where its value is in the gathered values */
+int fuse_ml_watch_changed( size_t entry, size_t *offset, size_t *length );
+
+/* Unit tests */
+int fuse_ml_watch_unittest( void );
+
+#endif			/* #ifndef FUSE_ML_WATCH_H */
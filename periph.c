@@ -24,6 +24,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include "libspectrum.h"
 
 #include "debugger/debugger.h"
@@ -402,6 +404,49 @@ writeport_internal( libspectrum_word port, libspectrum_byte b )
   g_slist_foreach( ports, write_peripheral, &callback_info );
 }
 
+/*
+ * The instruction address traps
+ */
+
+libspectrum_byte periph_pc_traps[ 0x10000 ];
+
+/* Add the traps of one peripheral to the table. A peripheral which is
+   selected but not present still has its traps added, as the core checks
+   the options of some of them directly */
+static void
+add_pc_traps( gpointer key GCC_UNUSED, gpointer value,
+	      gpointer user_data GCC_UNUSED )
+{
+  periph_private_t *private = value;
+  const periph_pc_trap_t *trap;
+  libspectrum_word unmasked, bits;
+
+  if( !private->active &&
+      !( private->periph->option && *(private->periph->option) ) )
+    return;
+
+  for( trap = private->periph->pc_traps; trap && trap->when; trap++ ) {
+    if( trap->enabled && !*(trap->enabled) ) continue;
+
+    /* Step through every combination of the bits not in the mask */
+    unmasked = ~trap->mask;
+    bits = 0;
+    do {
+      periph_pc_traps[ ( trap->value & trap->mask ) | bits ] |= trap->when;
+      bits = ( bits - unmasked ) & unmasked;
+    } while( bits );
+  }
+}
+
+void
+periph_pc_traps_update( void )
+{
+  memset( periph_pc_traps, 0, sizeof( periph_pc_traps ) );
+
+  if( peripherals )
+    g_hash_table_foreach( peripherals, add_pc_traps, NULL );
+}
+
 /*
  * The more Fuse-specific peripheral handling routines
  */
@@ -486,6 +531,7 @@ periph_update( void )
   }
 
   g_hash_table_foreach( peripherals, set_activity, &needs_hard_reset );
+  periph_pc_traps_update();
 
   update_peripherals_status();
   machine_current->memory_map();
@@ -114,6 +114,27 @@ typedef struct periph_port_t {
 
 typedef void (*periph_activate_function)( void );
 
+/* When a peripheral wants to be told about an instruction: before its
+   opcode is fetched, and/or once the opcode has been read */
+#define PERIPH_PC_TRAP_PRE_FETCH  0x01
+#define PERIPH_PC_TRAP_POST_FETCH 0x02
+
+/* Information about a specific instruction address trap */
+typedef struct periph_pc_trap_t {
+
+  /* This peripheral wants to see all instructions where
+     <PC> & mask == value */
+  libspectrum_word mask;
+  libspectrum_word value;
+
+  /* PERIPH_PC_TRAP_PRE_FETCH and/or PERIPH_PC_TRAP_POST_FETCH */
+  int when;
+
+  /* If not NULL, the trap applies only while this is non-zero */
+  const int *enabled;
+
+} periph_pc_trap_t;
+
 /* Information about a peripheral */
 typedef struct periph_t {
   /* The preferences option which controls this peripheral */
@@ -124,6 +145,8 @@ typedef struct periph_t {
   int hard_reset;
   /* Function to be called when the peripheral is activated */
   periph_activate_function activate;
+  /* The list of instruction addresses this peripheral traps, if any */
+  const periph_pc_trap_t *pc_traps;
 } periph_t;
 
 /* Register a peripheral with the system */
@@ -155,6 +178,17 @@ libspectrum_byte readport_internal( libspectrum_word port );
 void writeport( libspectrum_word port, libspectrum_byte b );
 void writeport_internal( libspectrum_word port, libspectrum_byte b );
 
+/*
+ * The instruction address traps
+ */
+
+/* The PERIPH_PC_TRAP_* actions wanted by any peripheral at each address, so
+   the core needs only a single lookup per instruction in the common case */
+extern libspectrum_byte periph_pc_traps[ 0x10000 ];
+
+/* Rebuild periph_pc_traps[]; to be called whenever a trap is changed */
+void periph_pc_traps_update( void );
+
 /*
  * The more Fuse-specific peripheral handling routines
  */
@@ -176,6 +176,8 @@ dck_reset( void )
             } else {
               memset( page->page, 0, MEMORY_PAGE_SIZE );
             }
+            memory_ram_set_dirty( page->page_num, page->offset,
+                                  MEMORY_PAGE_SIZE );
           }
         } else {
           data = memory_pool_allocate( 0x2000 );
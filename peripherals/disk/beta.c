@@ -82,11 +82,21 @@ static const periph_port_t beta_ports[] = {
   { 0, 0, NULL, NULL }
 };
 
+/* Paging in is checked over both of the ranges which beta_pc_mask and
+   beta_pc_value can select, paging out above the ROM while paged in */
+const periph_pc_trap_t beta_pc_traps[] = {
+  { 0xfe00, 0x3c00, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0xc000, 0x4000, PERIPH_PC_TRAP_PRE_FETCH, &beta_active },
+  { 0x8000, 0x8000, PERIPH_PC_TRAP_PRE_FETCH, &beta_active },
+  { 0, 0, 0, NULL }
+};
+
 static const periph_t beta_peripheral = {
   /* .option = */ &settings_current.beta128,  
   /* .ports = */ beta_ports,
   /* .hard_reset = */ 1,
   /* .activate = */ NULL,
+  /* .pc_traps = */ beta_pc_traps,
 };
 
 /* Debugger events */
@@ -116,6 +126,7 @@ void
 beta_page( void )
 {
   beta_active = 1;
+  periph_pc_traps_update();
   machine_current->ram.romcs = 1;
   machine_current->memory_map();
   debugger_event( page_event );
@@ -125,6 +136,7 @@ void
 beta_unpage( void )
 {
   beta_active = 0;
+  periph_pc_traps_update();
   machine_current->ram.romcs = 0;
   machine_current->memory_map();
   debugger_event( unpage_event );
@@ -222,6 +234,7 @@ beta_reset( int hard_reset GCC_UNUSED )
     }
 
     beta_active = 0;
+    periph_pc_traps_update();
 
     if( !( machine_current->capabilities &
            LIBSPECTRUM_MACHINE_CAPABILITY_128_MEMORY ) ) {
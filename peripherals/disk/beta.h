@@ -31,6 +31,7 @@
 
 #include "memory_pages.h"
 #include "fdd.h"
+#include "periph.h"
 
 extern int beta_available;  /* Is the Beta disk interface available for use? */
 extern int beta_active;     /* Is the Beta disk interface enabled? */
@@ -42,6 +43,9 @@ extern memory_page beta_memory_map_romcs[MEMORY_PAGES_IN_16K];
 extern libspectrum_word beta_pc_mask; /* Bits to mask in PC for enable check */
 extern libspectrum_word beta_pc_value; /* Value to compare masked PC against */
 
+/* The instruction addresses trapped by all types of Beta 128 */
+extern const periph_pc_trap_t beta_pc_traps[];
+
 void beta_register_startup( void );
 
 void beta_page( void );
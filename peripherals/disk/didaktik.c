@@ -44,6 +44,7 @@
 #include "utils.h"
 #include "wd_fdc.h"
 #include "options.h"	/* needed for get combo options */
+#include "z80/process_z80_opcodes.h"
 #include "z80/z80.h"
 
 #define INTRQ_ENABLED  0x80
@@ -118,11 +119,19 @@ static const periph_port_t didaktik_ports[] = {
   { 0, 0, NULL, NULL }
 };
 
+static const periph_pc_trap_t didaktik_pc_traps[] = {
+  { 0xffff, DIDAKTIK80_PAGE_ADDR1, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0xffff, DIDAKTIK80_PAGE_ADDR2, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0xffff, DIDAKTIK80_UNPAGE_ADDR, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0, 0, 0, NULL }
+};
+
 static const periph_t didaktik_periph = {
   /* .option = */ &settings_current.didaktik80,
   /* .ports = */ didaktik_ports,
   /* .hard_reset = */ 1,
   /* .activate = */ NULL,
+  /* .pc_traps = */ didaktik_pc_traps,
 };
 
 /* Debugger events */
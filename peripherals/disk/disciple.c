@@ -43,6 +43,7 @@
 #include "unittests/unittests.h"
 #include "utils.h"
 #include "wd_fdc.h"
+#include "z80/process_z80_opcodes.h"
 #include "options.h"	/* needed for get combo options */
 
 /* Two 8 KiB memory chunks accessible by the Z80 when /ROMCS is low */
@@ -183,11 +184,20 @@ static const periph_port_t disciple_ports[] = {
   { 0, 0, NULL, NULL }
 };
 
+static const periph_pc_trap_t disciple_pc_traps[] = {
+  { 0xffff, DISCIPLE_PAGE_ADDR1, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0xffff, DISCIPLE_PAGE_ADDR2, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0xffff, DISCIPLE_PAGE_ADDR3, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0xffff, DISCIPLE_PAGE_ADDR4, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0, 0, 0, NULL }
+};
+
 static const periph_t disciple_periph = {
   /* .option = */ &settings_current.disciple,
   /* .ports = */ disciple_ports,
   /* .hard_reset = */ 1,
   /* .activate = */ disciple_activate,
+  /* .pc_traps = */ disciple_pc_traps,
 };
 
 static int
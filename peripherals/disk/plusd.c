@@ -43,6 +43,7 @@
 #include "unittests/unittests.h"
 #include "utils.h"
 #include "wd_fdc.h"
+#include "z80/process_z80_opcodes.h"
 #include "options.h"	/* needed for get combo options */
 
 /* 8KB ROM */
@@ -152,11 +153,20 @@ static const periph_port_t plusd_ports[] = {
   { 0, 0, NULL, NULL }
 };
 
+static const periph_pc_trap_t plusd_pc_traps[] = {
+  { 0xffff, PLUSD_PAGE_ADDR1, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0xffff, PLUSD_PAGE_ADDR2, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0xffff, PLUSD_PAGE_ADDR3, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0xffff, PLUSD_PAGE_ADDR4, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0, 0, 0, NULL }
+};
+
 static const periph_t plusd_periph = {
   /* .option = */ &settings_current.plusd,
   /* .ports = */ plusd_ports,
   /* .hard_reset = */ 1,
   /* .activate = */ plusd_activate,
+  /* .pc_traps = */ plusd_pc_traps,
 };
 
 static int
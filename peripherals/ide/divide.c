@@ -39,6 +39,7 @@
 #include "unittests/unittests.h"
 #include "divide.h"
 #include "divxxx.h"
+#include "z80/process_z80_opcodes.h"
 
 /* Private function prototypes */
 
@@ -56,11 +57,24 @@ static const periph_port_t divide_ports[] = {
   { 0, 0, NULL, NULL }
 };
 
+static const periph_pc_trap_t divide_pc_traps[] = {
+  { DIVIDE_AUTOMAP_ADDR_MASK, DIVIDE_AUTOMAP_ADDR, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { DIVIDE_UNPAGE_ADDR_MASK, DIVIDE_UNPAGE_ADDR, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0xffff, DIVIDE_PAGE_ADDR1, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0xffff, DIVIDE_PAGE_ADDR2, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0xffff, DIVIDE_PAGE_ADDR3, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0xffff, DIVIDE_PAGE_ADDR4, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0xffff, DIVIDE_PAGE_ADDR5, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0xffff, DIVIDE_PAGE_ADDR6, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0, 0, 0, NULL }
+};
+
 static const periph_t divide_periph = {
   /* .option = */ &settings_current.divide_enabled,
   /* .ports = */ divide_ports,
   /* .hard_reset = */ 1,
   /* .activate = */ divide_activate,
+  /* .pc_traps = */ divide_pc_traps,
 };
 
 int divide_automapping_enabled = 0;
@@ -39,6 +39,7 @@
 #include "unittests/unittests.h"
 #include "divmmc.h"
 #include "divxxx.h"
+#include "z80/process_z80_opcodes.h"
 
 /* Private function prototypes */
 
@@ -59,11 +60,24 @@ static const periph_port_t divmmc_ports[] = {
   { 0, 0, NULL, NULL }
 };
 
+static const periph_pc_trap_t divmmc_pc_traps[] = {
+  { DIVMMC_AUTOMAP_ADDR_MASK, DIVMMC_AUTOMAP_ADDR, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { DIVIDE_UNPAGE_ADDR_MASK, DIVIDE_UNPAGE_ADDR, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0xffff, DIVIDE_PAGE_ADDR1, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0xffff, DIVIDE_PAGE_ADDR2, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0xffff, DIVIDE_PAGE_ADDR3, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0xffff, DIVIDE_PAGE_ADDR4, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0xffff, DIVIDE_PAGE_ADDR5, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0xffff, DIVIDE_PAGE_ADDR6, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0, 0, 0, NULL }
+};
+
 static const periph_t divmmc_periph = {
   /* .option = */ &settings_current.divmmc_enabled,
   /* .ports = */ divmmc_ports,
   /* .hard_reset = */ 1,
   /* .activate = */ divmmc_activate,
+  /* .pc_traps = */ divmmc_pc_traps,
 };
 
 static divxxx_t *divmmc_state;
@@ -44,6 +44,7 @@
 #include "utils.h"
 #include "ui/ui.h"
 #include "unittests/unittests.h"
+#include "z80/process_z80_opcodes.h"
 
 #undef IF1_DEBUG_MDR
 #undef IF1_DEBUG_NET
@@ -224,11 +225,19 @@ static const periph_port_t if1_ports[] = {
   { 0, 0, NULL, NULL }
 };
 
+static const periph_pc_trap_t if1_pc_traps[] = {
+  { 0xffff, IF1_PAGE_ADDR1, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0xffff, IF1_PAGE_ADDR2, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0xffff, IF1_UNPAGE_ADDR, PERIPH_PC_TRAP_POST_FETCH, NULL },
+  { 0, 0, 0, NULL }
+};
+
 static const periph_t if1_periph = {
   /* .option = */ &settings_current.interface1,
   /* .ports = */ if1_ports,
   /* .hard_reset = */ 1,
   /* .activate = */ NULL,
+  /* .pc_traps = */ if1_pc_traps,
 };
 
 /* Memory source */
@@ -44,6 +44,7 @@
 #include "ui/ui.h"
 #include "unittests/unittests.h"
 #include "utils.h"
+#include "z80/process_z80_opcodes.h"
 #include "z80/z80.h"
 
 /* 8KB ROM */
@@ -158,25 +159,33 @@ static const periph_port_t multiface_ports_3[] = {
   { 0, 0, NULL, NULL }
 };
 
+static const periph_pc_trap_t multiface_pc_traps[] = {
+  { 0xffff, MULTIFACE_SETIC8_ADDR, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0, 0, 0, NULL }
+};
+
 static const periph_t multiface_periph_1 = {
   &settings_current.multiface1,
   multiface_ports_1,
   1,
-  NULL
+  NULL,
+  multiface_pc_traps
 };
 
 static const periph_t multiface_periph_128 = {
   &settings_current.multiface128,
   multiface_ports_128,
   1,
-  NULL
+  NULL,
+  multiface_pc_traps
 };
 
 static const periph_t multiface_periph_3 = {
   &settings_current.multiface3,
   multiface_ports_3,
   1,
-  NULL
+  NULL,
+  multiface_pc_traps
 };
 
 void
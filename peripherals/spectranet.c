@@ -40,6 +40,7 @@
 #include "spectranet.h"
 #include "utils.h"
 #include "ui/ui.h"
+#include "z80/process_z80_opcodes.h"
 
 #ifdef BUILD_SPECTRANET
 
@@ -85,6 +86,17 @@ static int trap_write_msb;
 /* Whether the Spectranet's "suppress NMI" flipflop is set */
 static int nmi_flipflop = 0;
 
+/* The instruction addresses trapped; the first entry follows the
+   programmable trap */
+static periph_pc_trap_t spectranet_pc_traps[] = {
+  { 0xffff, 0x0000, PERIPH_PC_TRAP_PRE_FETCH,
+    &spectranet_programmable_trap_active },
+  { 0xffff, SPECTRANET_PAGE_ADDR1, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { SPECTRANET_PAGE_ADDR_MASK, SPECTRANET_PAGE_ADDR2,
+    PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0, 0, 0, NULL }
+};
+
 static int spectranet_source;
 
 /* Debugger events */
@@ -153,6 +165,14 @@ spectranet_map_page( int dest, int source )
   }
 }
 
+/* Move the programmable trap in the core's instruction address traps */
+static void
+spectranet_programmable_trap_update( void )
+{
+  spectranet_pc_traps[0].value = spectranet_programmable_trap;
+  periph_pc_traps_update();
+}
+
 static void
 spectranet_hard_reset( void )
 {
@@ -162,6 +182,7 @@ spectranet_hard_reset( void )
   spectranet_programmable_trap = 0x0000;
   spectranet_programmable_trap_active = 0;
   trap_write_msb = 0;
+  spectranet_programmable_trap_update();
 
   nmi_flipflop = 0;
 }  
@@ -287,6 +308,7 @@ spectranet_from_snapshot( libspectrum_snap *snap )
       libspectrum_snap_spectranet_programmable_trap_active( snap );
     trap_write_msb =
       libspectrum_snap_spectranet_programmable_trap_msb( snap );
+    spectranet_programmable_trap_update();
 
     settings_current.spectranet_disable =
       libspectrum_snap_spectranet_all_traps_disabled( snap );
@@ -402,6 +424,9 @@ spectranet_trap( libspectrum_word port, libspectrum_byte data )
       (spectranet_programmable_trap & 0xff00) | data;
 
   trap_write_msb = !trap_write_msb;
+
+  if( spectranet_programmable_trap_active )
+    spectranet_programmable_trap_update();
 }
 
 static libspectrum_byte
@@ -428,7 +453,10 @@ spectranet_control_write( libspectrum_word port, libspectrum_byte data )
   else if( spectranet_paged_via_io )
     spectranet_unpage();
 
-  spectranet_programmable_trap_active = data & 0x08;
+  if( !spectranet_programmable_trap_active != !( data & 0x08 ) ) {
+    spectranet_programmable_trap_active = data & 0x08;
+    spectranet_programmable_trap_update();
+  }
 }
 
 static const periph_port_t spectranet_ports[] = {
@@ -444,6 +472,7 @@ static const periph_t spectranet_periph = {
   /* .ports = */ spectranet_ports,
   /* .hard_reset = */ 1,
   /* .activate = */ spectranet_activate,
+  /* .pc_traps = */ spectranet_pc_traps,
 };
 
 static int
@@ -39,6 +39,7 @@
 #include "settings.h"
 #include "unittests/unittests.h"
 #include "usource.h"
+#include "z80/process_z80_opcodes.h"
 
 /* An 8 KiB memory chunk accessible by the Z80 when /ROMCS is low
  * (mirrored in the second 8 KiB when active) */
@@ -75,11 +76,17 @@ static const periph_port_t usource_ports[] = {
   { 0, 0, NULL, NULL }
 };
 
+static const periph_pc_trap_t usource_pc_traps[] = {
+  { 0xffff, USOURCE_TOGGLE_ADDR, PERIPH_PC_TRAP_PRE_FETCH, NULL },
+  { 0, 0, 0, NULL }
+};
+
 static const periph_t usource_periph = {
   /* .option = */ &settings_current.usource,
   /* .ports = */ usource_ports,
   /* .hard_reset = */ 1,
   /* .activate = */ NULL,
+  /* .pc_traps = */ usource_pc_traps,
 };
 
 static int
@@ -32,6 +32,7 @@
 #include "pokemem.h"
 #include "spectrum.h"
 #include "utils.h"
+#include "z80/z80_block_cache.h"
 
 enum {
   POKEFILE_NEXT_TRAINER = 'N',
@@ -411,6 +412,11 @@ pokemem_poke_activate( gpointer data, gpointer user_data )
     address &= 0x3fff;
     poke->restore = RAM[ bank ][ address ];
     RAM[ bank ][ address ] = value;
+    memory_ram_set_dirty( bank, address, 1 );
+#ifdef Z80_BLOCK_CACHE
+    z80_block_cache_invalidate( bank * MEMORY_PAGES_IN_16K +
+                                ( address >> MEMORY_PAGE_SIZE_LOGARITHM ) );
+#endif
   }
 }
 
@@ -439,6 +445,12 @@ pokemem_poke_deactivate( gpointer data, gpointer user_data GCC_UNUSED )
     writebyte_internal( address, value );
   } else {
     RAM[ bank ][ address & 0x3fff ] = value;
+    memory_ram_set_dirty( bank, address & 0x3fff, 1 );
+#ifdef Z80_BLOCK_CACHE
+    z80_block_cache_invalidate( bank * MEMORY_PAGES_IN_16K +
+                                ( ( address & 0x3fff ) >>
+                                  MEMORY_PAGE_SIZE_LOGARITHM ) );
+#endif
   }
 
 }
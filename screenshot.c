@@ -32,6 +32,7 @@
 #include "display.h"
 #include "infrastructure/startup_manager.h"
 #include "machine.h"
+#include "memory_pages.h"
 #include "peripherals/scld.h"
 #include "screenshot.h"
 #include "settings.h"
@@ -657,6 +658,7 @@ screenshot_scr_read( const char *filename )
 
   utils_close_file( &screen );
 
+  memory_ram_set_dirty( memory_current_screen, 0, 0x4000 );
   display_refresh_all();
 
   return error;
@@ -700,6 +702,7 @@ screenshot_mlt_read( const char *filename )
 
   utils_close_file( &screen );
 
+  memory_ram_set_dirty( memory_current_screen, 0, 0x4000 );
   display_refresh_all();
 
   return error;
@@ -27,9 +27,14 @@
 #include "libspectrum.h"
 
 #include "debugger/debugger.h"
+#include "event.h"
 #include "fuse.h"
 #include "machine.h"
+#include "memory_pages.h"
 #include "mempool.h"
+#include "ml_bridge.h"
+#include "ml_game_adapter.h"
+#include "ml_watch.h"
 #include "periph.h"
 #include "peripherals/disk/beta.h"
 #include "peripherals/disk/didaktik.h"
@@ -48,7 +53,10 @@
 #include "peripherals/ula.h"
 #include "peripherals/usource.h"
 #include "settings.h"
+#include "spectrum.h"
 #include "unittests.h"
+#include "z80/z80.h"
+#include "z80/z80_block_cache.h"
 
 static int
 contention_test( void )
@@ -777,6 +785,215 @@ paging_test( void )
   return r;
 }
 
+#ifdef Z80_BLOCK_CACHE
+
+/* Write some code into memory through the memory map */
+static void
+block_cache_write_code( libspectrum_word address,
+                        const libspectrum_byte *code, size_t length )
+{
+  size_t i;
+
+  for( i = 0; i < length; i++ )
+    writebyte_internal( address + i, code[i] );
+}
+
+/* Run from 'pc' for a while; all the code ends in a JR $ */
+static void
+block_cache_run( libspectrum_word pc )
+{
+  z80.pc.w = pc;
+  event_next_event = tstates + 1000;
+  z80_do_opcodes();
+}
+
+static int
+block_cache_test( void )
+{
+  /* Writes an INC A over the NOP later in the same block */
+  static const libspectrum_byte self_modifying[] = {
+    0x3e, 0x3c,			/* 0x8000 LD A,0x3c */
+    0x32, 0x07, 0x80,		/* 0x8002 LD (0x8007),A */
+    0x06, 0x00,			/* 0x8005 LD B,0 */
+    0x00,			/* 0x8007 NOP */
+    0x18, 0xfe,			/* 0x8008 JR $ */
+  };
+  static const libspectrum_byte rewritten[] = {
+    0x06, 0x00,			/* 0x9000 LD B,0 */
+    0x18, 0xfe,			/* 0x9002 JR $ */
+  };
+  /* Pages RAM page 1 in at 0xc000 from the middle of a run of code */
+  static const libspectrum_byte paging[] = {
+    0x01, 0xfd, 0x7f,		/* 0x8800 LD BC,0x7ffd */
+    0x3e, 0x01,			/* 0x8803 LD A,1 */
+    0xc3, 0x00, 0xc0,		/* 0x8805 JP 0xc000 */
+  };
+  static const libspectrum_byte paging_page0[] = {
+    0xed, 0x79,			/* 0xc000 OUT (C),A */
+    0x06, 0x11,			/* 0xc002 LD B,0x11 */
+    0x18, 0xfe,			/* 0xc004 JR $ */
+  };
+  static const libspectrum_byte paging_page1[] = {
+    0x3e, 0x22,			/* 0xc002 LD A,0x22 */
+    0x18, 0xfe,			/* 0xc004 JR $ */
+  };
+  processor saved_z80 = z80;
+  libspectrum_dword saved_tstates = tstates;
+  libspectrum_dword saved_next_event = event_next_event;
+  const Z80_BLOCK *block;
+  int r = 0;
+
+  /* There is no RAM at 0x8000 on the 16K machine */
+  if( machine_current->machine == LIBSPECTRUM_MACHINE_16 ) return 0;
+
+  z80_block_cache_flush();
+  z80.iff1 = z80.iff2 = 0;
+
+  /* A write to code in the block being run ends it, and the rest of the
+     block is decoded again */
+  block_cache_write_code( 0x8000, self_modifying, sizeof( self_modifying ) );
+  block_cache_run( 0x8000 );
+  if( z80.af.b.h != 0x3d || z80.pc.w != 0x8008 ) {
+    printf( "%s: self-modifying code: A = 0x%02x, PC = 0x%04x\n",
+            fuse_progname, z80.af.b.h, z80.pc.w );
+    r++;
+  }
+
+  /* A write to code in a block which has already been run means it is
+     decoded again when next run */
+  block_cache_write_code( 0x9000, rewritten, sizeof( rewritten ) );
+  block_cache_run( 0x9000 );
+  writebyte_internal( 0x9000, 0x0e );	/* LD C,0 */
+  z80.bc.w = 0xffff;
+  block_cache_run( 0x9000 );
+  if( z80.bc.w != 0xff00 ) {
+    printf( "%s: rewritten code: BC = 0x%04x\n", fuse_progname, z80.bc.w );
+    r++;
+  }
+
+  /* A paging change leaves the block it was made from, and the code run
+     after it is the code from the new page */
+  switch( machine_current->machine ) {
+  case LIBSPECTRUM_MACHINE_128:
+  case LIBSPECTRUM_MACHINE_PLUS2:
+  case LIBSPECTRUM_MACHINE_PENT:
+    writeport_internal( 0x7ffd, 0x01 );
+    block_cache_write_code( 0xc002, paging_page1, sizeof( paging_page1 ) );
+    writeport_internal( 0x7ffd, 0x00 );
+    block_cache_write_code( 0xc000, paging_page0, sizeof( paging_page0 ) );
+    block_cache_write_code( 0x8800, paging, sizeof( paging ) );
+
+    /* Have the blocks from RAM page 0 cached first */
+    block_cache_run( 0xc002 );
+
+    block_cache_run( 0x8800 );
+    if( z80.af.b.h != 0x22 || z80.pc.w != 0xc004 ) {
+      printf( "%s: paging: A = 0x%02x, PC = 0x%04x\n",
+              fuse_progname, z80.af.b.h, z80.pc.w );
+      r++;
+    }
+
+    block = z80_block_cache_find( 0xc002 );
+    if( !block || block->page_num != 1 ) {
+      printf( "%s: paging: block not found from RAM page 1\n",
+              fuse_progname );
+      r++;
+    }
+
+    writeport_internal( 0x7ffd, 0x00 );
+    block_cache_run( 0xc002 );
+    if( z80.bc.b.h != 0x11 ) {
+      printf( "%s: paging back: B = 0x%02x\n", fuse_progname, z80.bc.b.h );
+      r++;
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  z80 = saved_z80;
+  tstates = saved_tstates;
+  event_next_event = saved_next_event;
+
+  return r;
+}
+
+#endif				/* #ifdef Z80_BLOCK_CACHE */
+
+/* Run an LDIR at 'pc' which copies zeroes from 0x9000 to 0x8800 onwards
+   until it writes over itself at 'code', the address it is written at */
+static int
+block_copy_run( const char *name, libspectrum_word pc, libspectrum_word code )
+{
+  /* Once the ED is written over, the 0xb0 is run as OR B */
+  static const libspectrum_byte ldir[] = {
+    0xed, 0xb0,			/* LDIR */
+    0x18, 0xfe,			/* JR $ */
+  };
+  libspectrum_word length = code - 0x8800 + 1;
+  size_t i;
+  int r = 0;
+
+  for( i = 0; i < 0x20; i++ ) writebyte_internal( 0x9000 + i, 0x00 );
+  for( i = 0; i < sizeof( ldir ); i++ )
+    writebyte_internal( code + i, ldir[i] );
+
+  z80.pc.w = pc;
+  z80.hl.w = 0x9000;
+  z80.de.w = 0x8800;
+  z80.bc.w = 0x20;
+  event_next_event = tstates + 1000;
+  z80_do_opcodes();
+
+  if( z80.pc.w != pc + 2 || z80.bc.w != 0x20 - length ||
+      z80.de.w != 0x8800 + length || readbyte_internal( pc + 1 ) != 0xb0 ) {
+    printf( "%s: %s: PC = 0x%04x, BC = 0x%04x, DE = 0x%04x\n",
+            fuse_progname, name, z80.pc.w, z80.bc.w, z80.de.w );
+    r++;
+  }
+
+  return r;
+}
+
+/* An LDIR which writes over itself stops repeating, even when it is copying
+   in bulk or is paged in at another address as well */
+static int
+block_copy_test( void )
+{
+  processor saved_z80 = z80;
+  libspectrum_dword saved_tstates = tstates;
+  libspectrum_dword saved_next_event = event_next_event;
+  int r = 0;
+
+  /* There is no RAM at 0x8000 on the 16K machine */
+  if( machine_current->machine == LIBSPECTRUM_MACHINE_16 ) return 0;
+
+  z80.iff1 = z80.iff2 = 0;
+
+  r += block_copy_run( "LDIR over itself", 0x8810, 0x8810 );
+
+  /* RAM page 2 is at 0x8000 and, paged in, at 0xc000 too */
+  switch( machine_current->machine ) {
+  case LIBSPECTRUM_MACHINE_128:
+  case LIBSPECTRUM_MACHINE_PLUS2:
+  case LIBSPECTRUM_MACHINE_PENT:
+    writeport_internal( 0x7ffd, 0x02 );
+    r += block_copy_run( "LDIR over itself paged in", 0xc810, 0x8810 );
+    writeport_internal( 0x7ffd, 0x00 );
+    break;
+
+  default:
+    break;
+  }
+
+  z80 = saved_z80;
+  tstates = saved_tstates;
+  event_next_event = saved_next_event;
+
+  return r;
+}
+
 int
 unittests_run( void )
 {
@@ -786,9 +1003,17 @@ unittests_run( void )
   r += floating_bus_test();
   r += floating_bus_merge_test();
   r += mempool_test();
+#ifdef Z80_BLOCK_CACHE
+  r += block_cache_test();
+#endif
+  r += block_copy_test();
   r += paging_test();
   r += debugger_disassemble_unittest();
+  r += debugger_program_unittest();
   r += gdbserver_unittest();
+  r += fuse_ml_game_unittest();
+  r += fuse_ml_watch_unittest();
+  r += fuse_ml_bridge_unittest();
 
   printf("Final return value: %d (should be 0)\n", r);
 
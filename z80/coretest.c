@@ -451,6 +451,9 @@ slt_trap( libspectrum_word address GCC_UNUSED, libspectrum_byte level GCC_UNUSED
   return 0;
 }
 
+/* No peripherals, so no instruction address is ever trapped */
+libspectrum_byte periph_pc_traps[ 0x10000 ];
+
 int beta_available = 0;
 int beta_active = 0;
 int if1_available = 0;
@@ -10,47 +10,40 @@
 #include "z80_macros.h"
 #include "parse_z80_operands.h"
 #include "execute_z80_command.h"
+#include "z80_flags.h"
 
 #include "../periph.h"  // Rerquired for readport
 #include "../memory_pages.h"
 #include "../logging.h"
 
-#define FLAG_C_MASK 0x100
 #define FLAG_C_MASK_16 0x10000
-#define FLAG_H_MASK 0x88
 #define FLAG_HL_MASK 0x8800
 
 #define FLAG_7 0x80     // Bit 7 of the result
 #define FLAG_11 0x0800  // Bit 11 of the result
 
 #define LOWER_THREE_BITS_MASK 0x07
-#define LOWER_NIBBLE_MASK 0x0F
 #define HIGHER_NIBBLE_MASK 0xF0
-#define HALF_CARRY_MASK 0x0F
-#define OVERFLOW_MASK 0x7F
 
 
 void _AND(libspectrum_byte value) {
+    libspectrum_byte a = A;
+
     A &= value;
-    F = FLAG_H | sz53p_table[A];
-    Q = F;
+    z80_flags_set(Z80_FLAGS_AND, a, value, A, 0);
 }
 
 void _ADC(libspectrum_byte value) {
-    libspectrum_word adctemp = A + value + ( F & FLAG_C );
-    libspectrum_byte lookup = ( (A & FLAG_H_MASK) >> 3 ) | 
-                              ( (value & FLAG_H_MASK) >> 2 ) | 
-                              ( (adctemp & FLAG_H_MASK) >> 1 );
+    libspectrum_word adctemp = A + value + z80_flags_carry();
+    libspectrum_byte a = A;
 
     A = adctemp;
-    F = ( (adctemp & FLAG_C_MASK) ? FLAG_C : 0 ) |
-        halfcarry_add_table[lookup & LOWER_THREE_BITS_MASK] |
-        overflow_add_table[lookup >> 4] |
-        sz53_table[A];
-    Q = F;
+    z80_flags_set(Z80_FLAGS_ADD, a, value, adctemp, 0);
 }
 
 void _ADC16(libspectrum_word value) {
+    Z80_FLAGS_SYNC();
+
     libspectrum_dword add16temp = HL + value + (F & FLAG_C);
     libspectrum_byte lookup = ((HL & FLAG_HL_MASK) >> 11) |
         ( (value & FLAG_HL_MASK) >> 10 ) |
@@ -69,17 +62,10 @@ void _ADC16(libspectrum_word value) {
 
 void _ADD(libspectrum_byte value) {
     libspectrum_word addtemp = A + value;
-    libspectrum_byte lookup = ( (A & FLAG_H_MASK) >> 3 ) |
-        ( (value & FLAG_H_MASK ) >> 2 ) |
-        ( (addtemp & FLAG_H_MASK) >> 1 );
+    libspectrum_byte a = A;
 
     A = addtemp;
-    F = ( (addtemp & FLAG_C_MASK) ? FLAG_C : 0 ) |
-        halfcarry_add_table[lookup & LOWER_THREE_BITS_MASK] |
-        overflow_add_table[lookup >> 4] |
-        sz53_table[A];
-
-    Q = F;
+    z80_flags_set(Z80_FLAGS_ADD, a, value, addtemp, 0);
 }
 
 /*
@@ -92,6 +78,8 @@ void _ADD16(libspectrum_word *value1, libspectrum_word value2) {
         ( (value2 & FLAG_11 ) >> 10 ) |
         ( (add16temp & FLAG_11) >>  9 );
 
+    Z80_FLAGS_SYNC();
+
     MEMPTR_W = *value1 + 1;
     *value1 = add16temp;
 
@@ -104,6 +92,8 @@ void _ADD16(libspectrum_word *value1, libspectrum_word value2) {
 }
 
 void _BIT(libspectrum_byte bit_position, libspectrum_byte value) {
+    Z80_FLAGS_SYNC();
+
     F = (F & FLAG_C) | FLAG_H | (value & (FLAG_3 | FLAG_5));
 
     if (!(value & (0x01 << bit_position))) {
@@ -118,6 +108,8 @@ void _BIT(libspectrum_byte bit_position, libspectrum_byte value) {
 }
 
 void _BIT_MEMPTR(libspectrum_byte bit_position, libspectrum_byte value) {
+    Z80_FLAGS_SYNC();
+
     F = (F & FLAG_C) | FLAG_H | ( MEMPTR_H & (FLAG_3 | FLAG_5) );
 
     if (!(value & (0x01 << bit_position))) {
@@ -142,17 +134,8 @@ void _CALL(void) {
 
 void _CP(libspectrum_byte value) {
     libspectrum_word cptemp = A - value;
-    libspectrum_byte lookup = ( (A & FLAG_H_MASK) >> 3 ) |
-        ( (value & FLAG_H_MASK) >> 2 ) |
-        ( (cptemp & FLAG_H_MASK) >> 1 );
 
-    F = ( (cptemp & FLAG_C_MASK) ? FLAG_C : (cptemp ? 0 : FLAG_Z) ) |
-        FLAG_N |
-        halfcarry_sub_table[lookup & LOWER_THREE_BITS_MASK] |
-        overflow_sub_table[lookup >> 4] |
-        (value & (FLAG_3 | FLAG_5)) |
-        (cptemp & FLAG_S);
-    Q = F;
+    z80_flags_set(Z80_FLAGS_CP, A, value, cptemp, 0);
 }
 
 /*
@@ -161,14 +144,16 @@ void _CP(libspectrum_byte value) {
  */
 
 void _DEC(libspectrum_byte *value) {
-    F = (F & FLAG_C) | ( (*value & HALF_CARRY_MASK) ? 0 : FLAG_H ) | FLAG_N;
-    (*value)--;
+    libspectrum_byte carry = z80_flags_carry();
+    libspectrum_byte a = *value;
 
-    F |= ( (*value == OVERFLOW_MASK) ? FLAG_V : 0 ) | sz53_table[*value];
-    Q = F;
+    (*value)--;
+    z80_flags_set(Z80_FLAGS_DEC, a, 1, *value, carry);
 }
 
 void _Z80_IN(libspectrum_byte *reg, libspectrum_word port) {
+    Z80_FLAGS_SYNC();
+
     MEMPTR_W = port + 1;
     *reg = readport(port);
 
@@ -177,13 +162,11 @@ void _Z80_IN(libspectrum_byte *reg, libspectrum_word port) {
 }
 
 void _INC(libspectrum_byte *value) {
-    (*value)++;
+    libspectrum_byte carry = z80_flags_carry();     // The Carry flag is preserved
+    libspectrum_byte a = *value;
 
-    F = (F & FLAG_C) |                      // Preserve the Carry flag
-        ( (*value == 0x80) ? FLAG_V : 0 ) | // Set the Overflow flag if the value is 0x80
-        ( (*value & LOWER_NIBBLE_MASK) ? 0 : FLAG_H ) |  // Set the Half Carry flag if the lower nibble is 0
-        sz53_table[*value];                 // Update the Sign, Zero, and Parity flags
-    Q = F;
+    (*value)++;
+    z80_flags_set(Z80_FLAGS_INC, a, 1, *value, carry);
 }
 
 void _LD16_NNRR(libspectrum_byte regl, libspectrum_byte regh) {
@@ -231,9 +214,10 @@ void _JR(void) {
 }
 
 void _OR(libspectrum_byte value) {
+    libspectrum_byte a = A;
+
     A |= value;
-    F = sz53p_table[A];
-    Q = F;
+    z80_flags_set(Z80_FLAGS_OR, a, value, A, 0);
 }
 
 void _POP16(libspectrum_byte *regl, libspectrum_byte *regh) {
@@ -252,6 +236,8 @@ void _RET(void) {
 }
 
 void _RL(libspectrum_byte *value) {
+    Z80_FLAGS_SYNC();
+
     libspectrum_byte rltemp = *value;
 
     *value = (*value << 1) | (F & FLAG_C);
@@ -261,6 +247,8 @@ void _RL(libspectrum_byte *value) {
 }
 
 void _RLC(libspectrum_byte *value) {
+    Z80_FLAGS_SYNC();
+
     *value = (*value << 1) | (*value >> 7);
 
     F = (*value & FLAG_C) | sz53p_table[*value];
@@ -268,6 +256,8 @@ void _RLC(libspectrum_byte *value) {
 }
 
 void _RR(libspectrum_byte *value) {
+    Z80_FLAGS_SYNC();
+
     libspectrum_byte rrtemp = *value;
 
     *value = (*value >> 1) | (F << 7);
@@ -276,6 +266,8 @@ void _RR(libspectrum_byte *value) {
 }
 
 void _RRC(libspectrum_byte *value) {
+    Z80_FLAGS_SYNC();
+
     F = *value & FLAG_C;
     *value = (*value >> 1) | (*value << 7);
 
@@ -291,21 +283,16 @@ void _RST(libspectrum_byte value) {
 }
 
 void _SBC(libspectrum_byte value) {
-    libspectrum_word sbctemp = A - value - (F & FLAG_C);
-    libspectrum_byte lookup = ( (A & FLAG_H_MASK) >> 3 ) |
-        ( (value & FLAG_H_MASK) >> 2 ) |
-        ( (sbctemp & FLAG_H_MASK) >> 1 );
+    libspectrum_word sbctemp = A - value - z80_flags_carry();
+    libspectrum_byte a = A;
 
     A = sbctemp;
-    F = ( (sbctemp & FLAG_C_MASK) ? FLAG_C : 0 ) |
-        FLAG_N |
-        halfcarry_sub_table[lookup & LOWER_THREE_BITS_MASK] |
-        overflow_sub_table[lookup >> 4] |
-        sz53_table[A];
-    Q = F;
+    z80_flags_set(Z80_FLAGS_SUB, a, value, sbctemp, 0);
 }
 
 void _SBC16(libspectrum_word value) {
+    Z80_FLAGS_SYNC();
+
     libspectrum_dword sub16temp = HL - value - (F & FLAG_C);
     libspectrum_byte lookup = ( (HL & FLAG_HL_MASK) >> 11 ) |
         ( (value & FLAG_HL_MASK) >> 10 ) |
@@ -323,6 +310,8 @@ void _SBC16(libspectrum_word value) {
 }
 
 void _SLA(libspectrum_byte *value) {
+    Z80_FLAGS_SYNC();
+
     F = *value >> 7;
     *value <<= 1;
 
@@ -331,6 +320,8 @@ void _SLA(libspectrum_byte *value) {
 }
 
 void _SLL(libspectrum_byte *value) {
+    Z80_FLAGS_SYNC();
+
     F = *value >> 7;
     *value = (*value << 1) | 0x01;
 
@@ -339,6 +330,8 @@ void _SLL(libspectrum_byte *value) {
 }
 
 void _SRA(libspectrum_byte *value) {
+    Z80_FLAGS_SYNC();
+
     F = *value & FLAG_C;
     *value = (*value & FLAG_7) | (*value >> 1);
 
@@ -347,6 +340,8 @@ void _SRA(libspectrum_byte *value) {
 }
 
 void _SRL(libspectrum_byte *value) {
+    Z80_FLAGS_SYNC();
+
     F = *value & FLAG_C;
     *value >>= 1;
 
@@ -356,21 +351,24 @@ void _SRL(libspectrum_byte *value) {
 
 void _SUB(libspectrum_byte value) {
     libspectrum_word subtemp = A - value;
-    libspectrum_byte lookup = ( (A & FLAG_H_MASK) >> 3 ) |
-        ( (value & FLAG_H_MASK) >> 2 ) |
-        ( (subtemp & FLAG_H_MASK) >>  1);
+    libspectrum_byte a = A;
 
     A = subtemp;
-    F = ( (subtemp & FLAG_C_MASK) ? FLAG_C : 0 ) |
-        FLAG_N |
-        halfcarry_sub_table[lookup & LOWER_THREE_BITS_MASK] |
-        overflow_sub_table[lookup >> 4] |
-        sz53_table[A];
-    Q = F;
+    z80_flags_set(Z80_FLAGS_SUB, a, value, subtemp, 0);
 }
 
 void _XOR(libspectrum_byte value) {
+    libspectrum_byte a = A;
+
     A ^= value;
-    F = sz53p_table[A];
-    Q = F;
+    z80_flags_set(Z80_FLAGS_OR, a, value, A, 0);
+}
+
+/*
+ *  Perform a read contention without a memory request for a number of iterations.
+ */
+void perform_contend_read_no_mreq_iterations(libspectrum_word address, int iterations) {
+    for(int i = 0; i < iterations; i++) {
+        perform_contend_read_no_mreq(address, 1);
+    }
 }
@@ -39,4 +39,6 @@ void _SRL(libspectrum_byte *value);
 void _SUB(libspectrum_byte value);
 void _XOR(libspectrum_byte value);
 
+void perform_contend_read_no_mreq_iterations(libspectrum_word address, int iterations);
+
 #endif // EXECUTE_Z80_COMMAND_H
@@ -1,4 +1,3 @@
-#include <string.h>
 #include <stdbool.h>
 
 #ifdef CORETEST
@@ -19,8 +18,11 @@
 #include "z80.h"
 #include "z80_macros.h"
 #include "z80_opcodes.h"
+#include "z80_trace.h"
+#include "z80_flags.h"
 
 #include "parse_z80_operands.h"
+#include "process_z80_opcodes.h"
 #include "execute_z80_opcode.h"
 #include "execute_z80_command.h"
 
@@ -41,71 +43,55 @@ typedef enum {
     CURRENT_OP_DDCB
 } CURRENT_OP;
 
-typedef struct {
-    const char *condition;
-    unsigned char flag;
-    bool is_not;
-} FLAG_MAPPING;
-
-static FLAG_MAPPING flag_lookup[] = {
-    { "C", FLAG_C, false },
-    { "NC", FLAG_C, true },
-    { "PE", FLAG_P, false },
-    { "PO", FLAG_P, true },
-    { "M", FLAG_S, false },
-    { "P", FLAG_S, true },
-    { "Z", FLAG_Z, false },
-    { "NZ", FLAG_Z, true },
-    { 0 }
-};
-
 static CURRENT_OP current_op = CURRENT_OP_BASE;
 
-static void ld_dest_byte(const char *operand_1, const char *operand_2);
-static void ld_dest_word(const char *operand_1, const char *operand_2);
-static void ld_dest_indirect(const char *operand_1, const char *operand_2);
-static void ld_dest_indirect_from_PC(const char *operand);
-static void ld_dest_DDFD_offset(const char *operand);
+static void ld_dest_byte(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2);
+static void ld_dest_word(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2);
+static void ld_dest_indirect(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2);
+static void ld_dest_indirect_from_PC(const Z80_OPERAND *operand);
+static void ld_dest_DDFD_offset(const Z80_OPERAND *operand);
 
-static void arithmetic_logical(Z80_MNEMONIC op, const char *operand_1, const char *operand_2);
-static void arithmetic_logical_byte(Z80_MNEMONIC op, const char *operand_2);
-static void arithmetic_logical_word(Z80_MNEMONIC op, const char *operand_1, const char *operand_2);
+static void arithmetic_logical(Z80_MNEMONIC op, const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2);
+static void arithmetic_logical_byte(Z80_MNEMONIC op, const Z80_OPERAND *operand);
+static void arithmetic_logical_word(Z80_MNEMONIC op, const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2);
 
-static void call_jp(Z80_MNEMONIC op, const char *operand_1, const char *operand_2);
+static void call_jp(Z80_MNEMONIC op, const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2);
 static void cpi_cpir_cpd_cpdr(Z80_MNEMONIC op);
-static void inc_dec(Z80_MNEMONIC op, const char *operand);
+static void inc_dec(Z80_MNEMONIC op, const Z80_OPERAND *operand);
 static void ini_inir_ind_indr(Z80_MNEMONIC op);
 static void ldi_ldd(Z80_MNEMONIC op);
 static void ldir_lddr(Z80_MNEMONIC op);
 static void otir_otdr(Z80_MNEMONIC op);
 static void outi_outd(Z80_MNEMONIC op);
-static void push_pop(Z80_MNEMONIC op, const char *operand);
-
-static void res_set(Z80_MNEMONIC op, const char *operand_1, const char *operand_2);
-static void res_set_for_reg(Z80_MNEMONIC op, char bit_char, libspectrum_byte *reg);
+static void push_pop(Z80_MNEMONIC op, const Z80_OPERAND *operand);
+static void repeat_block_op(Z80_MNEMONIC op, void (*block_op)(Z80_MNEMONIC op), void (*bulk_op)(Z80_MNEMONIC op));
+static void copy_block(Z80_MNEMONIC op);
+static void search_block(Z80_MNEMONIC op);
+static bool is_uncontended_repeat(libspectrum_word read, libspectrum_word write);
+static bool is_instruction_byte(libspectrum_word address);
+
+static void res_set(Z80_MNEMONIC op, const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2);
+static void res_set_for_reg(Z80_MNEMONIC op, libspectrum_byte bit_position, libspectrum_byte *reg);
 static unsigned char res_set_hexmask(Z80_MNEMONIC op, unsigned char bit_position);
 static bool is_res_set_op(Z80_MNEMONIC op);
 
-static void rotate_shift(Z80_MNEMONIC op, const char *operand);
+static void rotate_shift(Z80_MNEMONIC op, const Z80_OPERAND *operand);
 static void call_rotate_shift_offset_op(Z80_MNEMONIC op, libspectrum_word address);
 static void call_rotate_shift_offset_op_for_reg(Z80_MNEMONIC op, libspectrum_word address, libspectrum_byte *reg);
 static bool is_rotate_shift_op(Z80_MNEMONIC op);
 static void call_rotate_shift_op(Z80_MNEMONIC op, libspectrum_byte *reg);
 
-static bool is_byte_reg_from_operand(const char *operand);
-static libspectrum_byte *get_byte_reg_from_operand(const char *operand);
-static bool is_word_reg_from_operand(const char *operand);
-static libspectrum_word *get_word_reg_from_operand(const char *operand);
+static bool is_byte_reg_operand(const Z80_OPERAND *operand);
+static libspectrum_byte *get_operand_byte_reg(const Z80_OPERAND *operand);
+static libspectrum_word *get_operand_word_reg(const Z80_OPERAND *operand);
+static libspectrum_byte get_operand_byte_value(const Z80_OPERAND *operand);
 
-static bool is_DDFD_op(void);
-static libspectrum_byte *get_DDFD_byte_reg_from_operand(const char *operand);
-static libspectrum_byte get_DDFD_byte_reg_value_from_operand(const char *operand);
+static bool is_DD_op(void);
+static libspectrum_word get_DDFD_offset_address(void);
 static libspectrum_byte get_DDFD_offset_value(void);
 static libspectrum_word *get_DDFD_word_reg(void);
-static libspectrum_word get_DDFD_word_reg_value(void);
 
-static bool is_flag_true(const char *condition);
-static FLAG_MAPPING get_flag_mapping(const char *condition);
+static bool is_condition_true(const Z80_OPERAND *condition);
 
 static libspectrum_byte last_Q;
 
@@ -122,62 +108,55 @@ void op_set_last_Q(libspectrum_byte q_value) {
  *  indexed by their instruction identifier.
  */
 
-void op_ADC(const char *operand_1, const char *operand_2) {
+void op_ADC(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
     arithmetic_logical(ADC, operand_1, operand_2);
 }
 
-void op_ADD(const char *operand_1, const char *operand_2) {
+void op_ADD(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
     arithmetic_logical(ADD, operand_1, operand_2);
 }
 
-void op_AND(const char *operand_1, const char *operand_2) {
+void op_AND(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
     arithmetic_logical(AND, operand_1, operand_2);
 }
 
-void op_BIT(const char *operand_1, const char *operand_2) {
-    if (strlen(operand_1) != 1 || operand_1[0] < '0' || operand_1[0] > '7') {
-        ERROR("Expected bit position for operand 1 for BIT: Found this instead %s", operand_1);
-        return;
-    }
+void op_BIT(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
+    libspectrum_byte bit_position = operand_1->value;
 
-    unsigned char bit_position = operand_1[0] - '0';
-
-    if (strlen(operand_2) == 1) {
-        _BIT(bit_position, get_byte_reg_value(operand_2[0]));
+    if (operand_2->type == OPERAND_REG8) {
+        _BIT(bit_position, *z80_byte_regs[operand_2->reg]);
     }
-    else if (strcmp(operand_2, "(HL)") == 0) {
+    else if (operand_2->type == OPERAND_INDIRECT_REG16) {
         libspectrum_byte bytetemp = readbyte(HL);
 
 	    perform_contend_read_no_mreq(HL, 1);
 	    _BIT_MEMPTR(bit_position, bytetemp);
     }
-    else if (is_DDFD_op()) {
-        if (strcmp(operand_2, "(REGISTER+dd)") == 0) {
-            libspectrum_byte bytetemp = readbyte(MEMPTR_W);
+    else if (operand_2->type == OPERAND_INDEX_OFFSET) {
+        libspectrum_byte bytetemp = readbyte(MEMPTR_W);
 
-            perform_contend_read_no_mreq(MEMPTR_W, 1);
-            _BIT_MEMPTR(bit_position, bytetemp);
-        } else {
-            ERROR("Unexpected operand 2 for BIT: %s", operand_2);
-        }
+        perform_contend_read_no_mreq(MEMPTR_W, 1);
+        _BIT_MEMPTR(bit_position, bytetemp);
     }
     else {
-        ERROR("Unexpected operand 2 for BIT: %s", operand_2);
+        ERROR("Unexpected operand 2 for BIT: %d", operand_2->type);
     }
 }
 
-void op_CALL(const char *operand_1, const char *operand_2) {
+void op_CALL(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
     call_jp(CALL, operand_1, operand_2);
 }
 
 void op_CCF(void) {
+    Z80_FLAGS_SYNC();
+
     F = ( F & (FLAG_P | FLAG_Z | FLAG_S) ) |
         ( (F & FLAG_C) ? FLAG_H : FLAG_C ) |
         ( (settings_current.z80_is_cmos ? A : ((last_Q ^ F) | A)) & (FLAG_3 | FLAG_5) );
     Q = F;
 }
 
-void op_CP(const char *operand_1, const char *operand_2) {
+void op_CP(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
     arithmetic_logical(CP, operand_1, operand_2);
 }
 
@@ -186,7 +165,7 @@ void op_CPD(void) {
 }
 
 void op_CPDR(void) {
-    cpi_cpir_cpd_cpdr(CPDR);
+    repeat_block_op(CPDR, cpi_cpir_cpd_cpdr, search_block);
 }
 
 void op_CPI(void) {
@@ -194,10 +173,12 @@ void op_CPI(void) {
 }
 
 void op_CPIR(void) {
-    cpi_cpir_cpd_cpdr(CPIR);
+    repeat_block_op(CPIR, cpi_cpir_cpd_cpdr, search_block);
 }
 
 void op_CPL(void) {
+    Z80_FLAGS_SYNC();
+
     A ^= 0xff;
     F = ( F & (FLAG_C | FLAG_P | FLAG_Z | FLAG_S) ) |
         ( A & (FLAG_3 | FLAG_5) ) | (FLAG_N | FLAG_H);
@@ -205,32 +186,38 @@ void op_CPL(void) {
 }
 
 void op_DAA(void) {
-	libspectrum_byte add = 0;
-    libspectrum_byte carry = (F & FLAG_C);
+    libspectrum_byte add = 0;
+    libspectrum_byte carry;
+
+    Z80_FLAGS_SYNC();
 
-	if ((F & FLAG_H) || ((A & 0x0f) > 9)) {
+    carry = (F & FLAG_C);
+
+    if ((F & FLAG_H) || ((A & 0x0f) > 9)) {
         add = 6;
     }
 
-	if (carry || (A > 0x99)) {
+    if (carry || (A > 0x99)) {
         add |= 0x60;
     }
 
-	if (A > 0x99) {
+    if (A > 0x99) {
         carry = FLAG_C;
     }
 
-	if (F & FLAG_N) {
+    if (F & FLAG_N) {
         _SUB(add);
-	} else {
-	    _ADD(add);
-	}
+    } else {
+        _ADD(add);
+    }
 
-	F = ( F & ~(FLAG_C | FLAG_P) ) | carry | parity_table[A];
-	Q = F;
+    Z80_FLAGS_SYNC();
+
+    F = ( F & ~(FLAG_C | FLAG_P) ) | carry | parity_table[A];
+    Q = F;
 }
 
-void op_DEC(const char *operand) {
+void op_DEC(const Z80_OPERAND *operand) {
     inc_dec(DEC, operand);
 }
 
@@ -239,7 +226,7 @@ void op_DI(void) {
     IFF2 = 0;
 }
 
-void op_DJNZ(const char *offset) {
+void op_DJNZ(const Z80_OPERAND *offset) {
     //  The offset parameter is not used
     perform_contend_read_no_mreq(IR, 1);
     B--;
@@ -264,8 +251,10 @@ void op_EI(void) {
     event_add(tstates + 1, z80_interrupt_event);
 }
 
-void op_EX(const char *operand_1, const char *operand_2) {
-    if (strcmp(operand_1, "AF") == 0 && strcmp(operand_2, "AF'") == 0) {
+void op_EX(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
+    if (operand_2->type == OPERAND_REG16_ALTERNATE) {
+        Z80_FLAGS_SYNC();
+
         /*
          *  Tape saving trap: note this traps the EX AF,AF' at #04d0, not #04d1 as the PC has already been incremented.
          *  0x0076 is the Timex 2068 save routine in EXROM.
@@ -280,28 +269,16 @@ void op_EX(const char *operand_1, const char *operand_2) {
 
         AF = AF_;
         AF_ = wordtemp;
-    } else if (strcmp(operand_1, "(SP)") == 0) {
+    } else if (operand_1->type == OPERAND_INDIRECT_REG16) {
+        //  This is EX (SP),HL or EX (SP),REGISTER
         libspectrum_byte bytetempl = readbyte(SP);
         libspectrum_byte bytetemph = readbyte(SP + 1);
-        libspectrum_byte *reg_h;
-        libspectrum_byte *reg_l;
-
-        if (strcmp(operand_2, "HL") == 0) {
-            reg_h = &H;
-            reg_l = &L;
-        } else if (is_DDFD_op() && strcmp(operand_2, "REGISTER") == 0) {
-            reg_h = (current_op == CURRENT_OP_DD || current_op == CURRENT_OP_DDCB) ? &IXH  : &IYH;
-            reg_l = (current_op == CURRENT_OP_DD || current_op == CURRENT_OP_DDCB) ? &IXL : &IYL;
-        }
-        else {
-            ERROR("Unexpected operand 2 for EX with SP as operand 1: %s", operand_2);
-            return;
-        }
+        libspectrum_word *reg = get_operand_word_reg(operand_2);
 
         perform_contend_read_no_mreq(SP + 1, 1);
 
-        writebyte(SP + 1, *reg_h);
-        writebyte(SP, *reg_l);
+        writebyte(SP + 1, (*reg) >> 8);
+        writebyte(SP, (*reg) & 0xff);
 
         perform_contend_write_no_mreq(SP, 1);
         perform_contend_write_no_mreq(SP, 1);
@@ -309,15 +286,14 @@ void op_EX(const char *operand_1, const char *operand_2) {
         MEMPTR_H = bytetemph;
         MEMPTR_L = bytetempl;
 
-        *reg_h = bytetemph;
-        *reg_l = bytetempl;
-    } else if (strcmp(operand_1, "DE") == 0 && strcmp(operand_2, "HL") == 0) {
+        *reg = (bytetemph << 8) | bytetempl;
+    } else if (operand_1->type == OPERAND_REG16 && operand_2->type == OPERAND_REG16) {
         libspectrum_word wordtemp = DE;
 
         DE = HL;
         HL = wordtemp;
     } else {
-        ERROR("Unexpected operands for EX: %s, %s", operand_1, operand_2);
+        ERROR("Unexpected operands for EX: %d, %d", operand_1->type, operand_2->type);
     }
 }
 
@@ -340,41 +316,40 @@ void op_EXX(void) {
 void op_HALT(void) {
     HALTED = 1;
     PC--;
+
+#ifndef CORETEST
+    z80_skip_halt();
+#endif
 }
 
 /*
  * The IM instruction is used to set the interrupt mode to 0, 1 or 2 and is from the Extended Instruction Set (ED).
  */
-void op_IM(const char *operand) {
-    if (strlen(operand) != 1 || operand[0] < '0' || operand[0] > '2') {
-        ERROR("Expected 0, 1 or 2 for operand 1 for IM: Found this instead %s", operand);
-        return;
-    }
-
-    IMODE = operand[0] - '0';
+void op_IM(const Z80_OPERAND *operand) {
+    IMODE = operand->value;
 }
 
-void op_IN(const char *operand_1, const char *operand_2) {
-    if (strcmp(operand_1, "A") == 0 && strcmp(operand_2, "(nn)") == 0) {
+void op_IN(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
+    if (operand_2->type == OPERAND_PORT_IMMEDIATE) {
         libspectrum_word intemp = readbyte(PC++) + (A << 8);
 
         A = readport(intemp);
         MEMPTR_W = intemp + 1;  // Is this correct if (nn) was 0xff?
     }
-    else if (strcmp(operand_1, "F") == 0 && strcmp(operand_2, "(C)") == 0) {
+    else if (operand_2->type == OPERAND_PORT_C && operand_1->reg == Z80_REG_F) {
         libspectrum_byte bytetemp;
 
         _Z80_IN(&bytetemp, BC);  // Value is not used but address is for temporary storage
     }
-    else if (strlen(operand_1) == 1 && strcmp(operand_2, "(C)") == 0) {
-        _Z80_IN(get_byte_reg(operand_1[0]), BC);
+    else if (operand_2->type == OPERAND_PORT_C) {
+        _Z80_IN(z80_byte_regs[operand_1->reg], BC);
     }
     else {
-        ERROR("Unexpected operands for IN: %s, %s", operand_1, operand_2);
+        ERROR("Unexpected operands for IN: %d, %d", operand_1->type, operand_2->type);
     }
 }
 
-void op_INC(const char *operand) {
+void op_INC(const Z80_OPERAND *operand) {
     inc_dec(INC, operand);
 }
 
@@ -383,7 +358,7 @@ void op_IND(void) {
 }
 
 void op_INDR(void) {
-    ini_inir_ind_indr(INDR);
+    repeat_block_op(INDR, ini_inir_ind_indr, NULL);
 }
 
 void op_INI(void) {
@@ -391,16 +366,24 @@ void op_INI(void) {
 }
 
 void op_INIR(void) {
-    ini_inir_ind_indr(INIR);
+    repeat_block_op(INIR, ini_inir_ind_indr, NULL);
 }
 
-void op_JP(const char *operand_1, const char *operand_2) {
-    if (strcmp(operand_1, "HL") == 0) {
-        PC = HL;  // Not indirect
-    } else if (is_DDFD_op()) {
-        PC = (current_op == CURRENT_OP_DD || current_op == CURRENT_OP_DDCB) ? IX : IY;
+void op_JP(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
+    if (operand_1->type == OPERAND_REG16 || operand_1->type == OPERAND_INDEX_REG16) {
+        PC = *get_operand_word_reg(operand_1);  // Not indirect
     } else {
+#ifndef CORETEST
+        libspectrum_word address = PC - 1;
+#endif
+
         call_jp(JP, operand_1, operand_2);
+
+#ifndef CORETEST
+        if (PC <= address && settings_current.z80_idle_skip) {
+            z80_skip_idle_loop(address);
+        }
+#endif
     }
 }
 
@@ -408,20 +391,31 @@ void op_JP(const char *operand_1, const char *operand_2) {
  *  The original Perl code checks for no second operand (offset) and if so, it transfer the first operand (condition) to the second (offset) and
  *  blanks out the first (condition).
  * 
- *  This has been updated to just check for "offset" as the first operand.
+ *  This has been updated to just check for an offset as the first operand.
  */
-void op_JR(const char *operand_1, const char *operand_2) {
-    if (strcmp(operand_1, "offset") == 0) {
+void op_JR(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
+#ifndef CORETEST
+    libspectrum_word address = PC - 1;
+#endif
+
+    if (operand_1->type == OPERAND_RELATIVE_OFFSET) {
         _JR();
     }
     else {
-        if (is_flag_true(operand_1)) {
+        if (is_condition_true(operand_1)) {
             _JR();
         } else {
             perform_contend_read(PC, 3);
             PC++;
         }
     }
+
+#ifndef CORETEST
+    //  A jump back may be to a loop which is waiting for an interrupt
+    if (PC <= address && settings_current.z80_idle_skip) {
+        z80_skip_idle_loop(address);
+    }
+#endif
 }
 
 /*
@@ -429,23 +423,34 @@ void op_JR(const char *operand_1, const char *operand_2) {
  *  most frequently used instruction in the Z80 instruction set and has the greatest
  *  variance in operands to be catered for.
  */
-void op_LD(const char *operand_1, const char *operand_2) {
-    const char *dest = operand_1;
-    const char *src = operand_2;
-
-    if (is_byte_reg_from_operand(dest)) {
-        //  This call encompasses DD and FD instructions
-        ld_dest_byte(dest, src);
-    } else if (is_word_reg_from_operand(dest)) {
-        ld_dest_word(dest, src);
-    } else if (is_indirect_word_reg(dest)) {
-        ld_dest_indirect(dest, src);
-    } else if (strcmp(dest, "(nnnn)") == 0) {
-        ld_dest_indirect_from_PC(src);
-    } else if (is_DDFD_op() && strcmp(dest, "(REGISTER+dd)") == 0) {
-        ld_dest_DDFD_offset(src);
-    } else {
-        ERROR("Unexpected operands for LD: %s, %s", dest, src);
+void op_LD(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
+    const Z80_OPERAND *dest = operand_1;
+    const Z80_OPERAND *src = operand_2;
+
+    switch (dest->type) {
+        case OPERAND_REG8:
+        case OPERAND_REG_I:
+        case OPERAND_REG_R:
+        case OPERAND_INDEX_REG8_HIGH:
+        case OPERAND_INDEX_REG8_LOW:
+            //  This call encompasses DD and FD instructions
+            ld_dest_byte(dest, src);
+            break;
+        case OPERAND_REG16:
+        case OPERAND_INDEX_REG16:
+            ld_dest_word(dest, src);
+            break;
+        case OPERAND_INDIRECT_REG16:
+            ld_dest_indirect(dest, src);
+            break;
+        case OPERAND_INDIRECT_IMMEDIATE_WORD:
+            ld_dest_indirect_from_PC(src);
+            break;
+        case OPERAND_INDEX_OFFSET:
+            ld_dest_DDFD_offset(src);
+            break;
+        default:
+            ERROR("Unexpected operands for LD: %d, %d", dest->type, src->type);
     }
 }
 
@@ -454,7 +459,7 @@ void op_LDD(void) {
 }
 
 void op_LDDR(void) {
-    ldir_lddr(LDDR);
+    repeat_block_op(LDDR, ldir_lddr, copy_block);
 }
 
 void op_LDI(void) {
@@ -462,7 +467,7 @@ void op_LDI(void) {
 }
 
 void op_LDIR(void) {
-    ldir_lddr(LDIR);
+    repeat_block_op(LDIR, ldir_lddr, copy_block);
 }
 
 void op_NEG(void) {
@@ -476,23 +481,23 @@ void op_NOP(void) {
     //  No operation
 }
 
-void op_OR(const char *operand_1, const char *operand_2) {
+void op_OR(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
     arithmetic_logical(OR, operand_1, operand_2);
 }
 
 void op_OTDR(void) {
-    otir_otdr(OTDR);
+    repeat_block_op(OTDR, otir_otdr, NULL);
 }
 
 void op_OTIR(void) {
-    otir_otdr(OTIR);
+    repeat_block_op(OTIR, otir_otdr, NULL);
 }
 
-void op_OUT(const char *operand_1, const char *operand_2) {
-    const char *port = operand_1;
-    const char *reg = operand_2;
+void op_OUT(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
+    const Z80_OPERAND *port = operand_1;
+    const Z80_OPERAND *reg = operand_2;
 
-    if (strcmp(port, "(nn)") == 0 && strcmp(reg, "A") == 0) {
+    if (port->type == OPERAND_PORT_IMMEDIATE) {
         libspectrum_byte nn = readbyte(PC++);
         libspectrum_word outtemp = nn | (A << 8);
 
@@ -501,17 +506,17 @@ void op_OUT(const char *operand_1, const char *operand_2) {
 
         writeport(outtemp, A);
     }
-    else if (strcmp(port, "(C)") == 0 && strlen(reg) == 1) {
-        if (reg[0] == '0' ) {
+    else if (port->type == OPERAND_PORT_C) {
+        if (reg->type == OPERAND_NUMBER) {
             writeport(BC, settings_current.z80_is_cmos ? 0xff : 0 );
         } else {
-            writeport(BC, get_byte_reg_value(reg[0]));
+            writeport(BC, *z80_byte_regs[reg->reg]);
         }
 
         MEMPTR_W = BC + 1;
     }
     else {
-        ERROR("Unexpected operands for OUT: %s, %s", port, reg);
+        ERROR("Unexpected operands for OUT: %d, %d", port->type, reg->type);
     }
 }
 
@@ -523,34 +528,36 @@ void op_OUTI(void) {
     outi_outd(OUTI);
 }
 
-void op_POP(const char *operand) {
+void op_POP(const Z80_OPERAND *operand) {
     push_pop(POP, operand);
 }
 
-void op_PUSH(const char *operand) {
+void op_PUSH(const Z80_OPERAND *operand) {
     perform_contend_read_no_mreq(IR, 1);
     push_pop(PUSH, operand);
 }
 
-void op_RES(const char *operand_1, const char *operand_2) {
+void op_RES(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
     res_set(RES, operand_1, operand_2);
 }
 
-void op_RET(const char *operand) {
-    if (operand == NULL || strlen(operand) == 0) {
+void op_RET(const Z80_OPERAND *operand) {
+    if (operand->type == OPERAND_NONE) {
         _RET();
     } else {
         perform_contend_read_no_mreq(IR, 1);
 
-        if (strcmp(operand, "NZ") == 0) {
+        if (operand->value == FLAG_Z && operand->is_not) {
             if (PC == 0x056c || PC == 0x0112) {  // There is no indication of what these addresses represent
+                Z80_FLAGS_SYNC();
+
                 if (tape_load_trap() == 0) {
                     return;
                 }
             }
         }
 
-        if (is_flag_true(operand)) {
+        if (is_condition_true(operand)) {
             _RET();
         }
     }
@@ -563,11 +570,13 @@ void op_RETN(void) {
     z80_retn();
 }
 
-void op_RL(const char *operand) {
+void op_RL(const Z80_OPERAND *operand) {
     rotate_shift(RL, operand);
 }
 
 void op_RLA(void) {
+    Z80_FLAGS_SYNC();
+
 	libspectrum_byte bytetemp = A;
 
 	A = (A << 1) | (F & FLAG_C);
@@ -576,11 +585,13 @@ void op_RLA(void) {
 	Q = F;
 }
 
-void op_RLC(const char *operand) {
+void op_RLC(const Z80_OPERAND *operand) {
     rotate_shift(RLC, operand);
 }
 
 void op_RLCA(void) {
+    Z80_FLAGS_SYNC();
+
     A = (A << 1) | (A >> 7);
     F = (F & (FLAG_P | FLAG_Z | FLAG_S)) |
         (A & (FLAG_C | FLAG_3 | FLAG_5));
@@ -588,6 +599,8 @@ void op_RLCA(void) {
 }
 
 void op_RLD(void) {
+    Z80_FLAGS_SYNC();
+
 	libspectrum_byte bytetemp = readbyte(HL);
 
     perform_contend_read_no_mreq_iterations(HL, 4);
@@ -600,11 +613,13 @@ void op_RLD(void) {
 	MEMPTR_W = HL + 1;
 }
 
-void op_RR(const char *operand) {
+void op_RR(const Z80_OPERAND *operand) {
     rotate_shift(RR, operand);
 }
 
 void op_RRA(void) {
+    Z80_FLAGS_SYNC();
+
 	libspectrum_byte bytetemp = A;
 
 	A = (A >> 1) | (F << 7);
@@ -613,11 +628,13 @@ void op_RRA(void) {
 	Q = F;
 }
 
-void op_RRC(const char *operand) {
+void op_RRC(const Z80_OPERAND *operand) {
     rotate_shift(RRC, operand);
 }
 
 void op_RRCA(void) {
+    Z80_FLAGS_SYNC();
+
     F = (F & (FLAG_P | FLAG_Z | FLAG_S)) |
         (A & FLAG_C);
     A = (A >> 1) | (A << 7);
@@ -626,6 +643,8 @@ void op_RRCA(void) {
 }
 
 void op_RRD(void) {
+    Z80_FLAGS_SYNC();
+
 	libspectrum_byte bytetemp = readbyte(HL);
 
     perform_contend_read_no_mreq_iterations(HL, 4);
@@ -638,49 +657,49 @@ void op_RRD(void) {
 	MEMPTR_W = HL + 1;
 }
 
-void op_RST(const char *operand) {
-    libspectrum_byte hex_value = (libspectrum_byte)strtol(operand, NULL, 16);
-
+void op_RST(const Z80_OPERAND *operand) {
     perform_contend_read_no_mreq(IR, 1);
-    _RST(hex_value);
+    _RST(operand->value);
 }
 
-void op_SBC(const char *operand_1, const char *operand_2) {
+void op_SBC(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
     arithmetic_logical(SBC, operand_1, operand_2);
 }
 
 void op_SCF(void) {
+    Z80_FLAGS_SYNC();
+
     F = (F & ( FLAG_P | FLAG_Z | FLAG_S)) |
         ((settings_current.z80_is_cmos ? A : ((last_Q ^ F) | A)) & (FLAG_3 | FLAG_5)) |
         FLAG_C;
     Q = F;
 }
 
-void op_SET(const char *operand_1, const char *operand_2) {
+void op_SET(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
     res_set(SET, operand_1, operand_2);
 }
 
-void op_SLA(const char *operand) {
+void op_SLA(const Z80_OPERAND *operand) {
     rotate_shift(SLA, operand);
 }
 
-void op_SLL(const char *operand) {
+void op_SLL(const Z80_OPERAND *operand) {
     rotate_shift(SLL, operand);
 }
 
-void op_SRA(const char *operand) {
+void op_SRA(const Z80_OPERAND *operand) {
     rotate_shift(SRA, operand);
 }
 
-void op_SRL(const char *operand) {
+void op_SRL(const Z80_OPERAND *operand) {
     rotate_shift(SRL, operand);
 }
 
-void op_SUB(const char *operand_1, const char *operand_2) {
+void op_SUB(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
     arithmetic_logical(SUB, operand_1, operand_2);
 }
 
-void op_XOR(const char *operand_1, const char *operand_2) {
+void op_XOR(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
     arithmetic_logical(XOR, operand_1, operand_2);
 }
 
@@ -697,12 +716,12 @@ void op_SLTTRAP(void) {
  *
  *  DD or FD can also shift again to use CB instructions.
  */
-void op_SHIFT(const char *value) {
-    if (strcmp(value, "DDFDCB") == 0) {
+void op_SHIFT(const Z80_OPERAND *operand) {
+    if (operand->value == PREFIX_DDFDCB) {
         //  This is only called by the DD or FD instruction set to utilise the CB instruction set.
         libspectrum_word register_value = (current_op == CURRENT_OP_DD) ? IX : IY;
-        Z80_OP op;
-        Z80_MNEMONIC cb_op_mnemonic;
+        const Z80_OP *op;
+        const Z80_OP_TEXT *op_text;
 
 	    perform_contend_read(PC, 3);
 	    MEMPTR_W = register_value + (libspectrum_signed_byte)readbyte_internal(PC);
@@ -715,62 +734,71 @@ void op_SHIFT(const char *value) {
         PC++;
 
         current_op = (current_op == CURRENT_OP_DD) ? CURRENT_OP_DDCB : CURRENT_OP_FDCB;
-        op = z80_ops_set[OP_SET_DDFDCB].op_codes[opcode_id];
+        op = &z80_ops_set[OP_SET_DDFDCB].op_codes[opcode_id];
+        op_text = &z80_ops_text[OP_SET_DDFDCB].op_texts[opcode_id];
+
+        z80_trace_op(PC - 1, OP_SET_DDFDCB, opcode_id);
 
-        if ((cb_op_mnemonic = get_mnemonic_enum(op.operand_2)) != UNKNOWN_MNEMONIC) {
-            DEBUG("PC:0x%04x, shifted id (%d):0x%02x, op:%s %s,%s %s", (PC - 1), (int)current_op, opcode_id, get_mnemonic_name(cb_op_mnemonic), op.operand_1, op.operand_2, op.extras);
+        if (op->operand_2.type == OPERAND_MNEMONIC) {
+            Z80_MNEMONIC cb_op_mnemonic = (Z80_MNEMONIC)op->operand_2.value;
 
             //  When the second operand is a CB mnemonic, the first operand is the register to be shifted.
-            libspectrum_byte *reg = get_byte_reg_from_operand(op.operand_1);
+            libspectrum_byte *reg = get_operand_byte_reg(&op->operand_1);
 
             if (is_rotate_shift_op(cb_op_mnemonic)) {
                 call_rotate_shift_offset_op_for_reg(cb_op_mnemonic, MEMPTR_W, reg);
             } else if (is_res_set_op(cb_op_mnemonic)) {
-                char bit_char = op.extras[0];
-
-                res_set_for_reg(cb_op_mnemonic, bit_char, reg);
+                res_set_for_reg(cb_op_mnemonic, op->extras.value, reg);
             } else {
-                ERROR("Unexpected CB op found for op_SHIFT: %s", op.operand_2);
+                ERROR("Unexpected CB op found for op_SHIFT: %s", op_text->operand_2_text);
             }
         } else {
-            DEBUG("PC:0x%04x, shifted id (%d):0x%02x, op:%s %s,%s", (PC - 1), (int)current_op, opcode_id, get_mnemonic_name(op.op), op.operand_1, op.operand_2);
             call_z80_op_func(op);
         }
     } else {
 	    perform_contend_read(PC, 4);
 
 	    libspectrum_byte opcode_id = readbyte_internal(PC);
-        Z80_OP op;
+        Z80_OP_SET_TYPE op_set;
+        const Z80_OP *op;
 
         PC++;
 	    R++;
 
-        if (strcmp(value, "DD") == 0) {
-            current_op = CURRENT_OP_DD;
-            op = z80_ops_set[OP_SET_DDFD].op_codes[opcode_id];
-
-            if (op.op == NOP) {
-                WARNING("DD instruction found with NOP opcode: id %02x", opcode_id);
-            }
-        } else if (strcmp(value, "FD") == 0) {
-            current_op = CURRENT_OP_FD;
-            op = z80_ops_set[OP_SET_DDFD].op_codes[opcode_id];
+        switch (operand->value) {
+            case PREFIX_DD:
+                current_op = CURRENT_OP_DD;
+                op_set = OP_SET_DDFD;
+                break;
+            case PREFIX_FD:
+                current_op = CURRENT_OP_FD;
+                op_set = OP_SET_DDFD;
+                break;
+            case PREFIX_CB:
+                current_op = CURRENT_OP_CB;
+                op_set = OP_SET_CB;
+                break;
+            case PREFIX_ED:
+                current_op = CURRENT_OP_ED;
+                op_set = OP_SET_ED;
+                break;
+            default:
+                ERROR("Unexpected value found for op_SHIFT: %d", operand->value);
+                return;
+        }
 
-            if (op.op == NOP) {
-                WARNING("FD instruction found with NOP opcode: id %02x", opcode_id);
-            }
-        } else if (strcmp(value, "CB") == 0) {
-            current_op = CURRENT_OP_CB;
-            op = z80_ops_set[OP_SET_CB].op_codes[opcode_id];
-        } else if (strcmp(value, "ED") == 0) {
-            current_op = CURRENT_OP_ED;
-            op = z80_ops_set[OP_SET_ED].op_codes[opcode_id];
-        } else {
-            ERROR("Unexpected value found for op_SHIFT: %s", value);
-            return;
+        /*
+         *  The DDFD set only has the instructions that use the index registers; any other instruction
+         *  following a DD or FD prefix is executed from the base set as if there was no prefix.
+         */
+        if (op_set == OP_SET_DDFD && z80_ops_set[OP_SET_DDFD].op_codes[opcode_id].op == NOP) {
+            current_op = CURRENT_OP_BASE;
+            op_set = OP_SET_BASE;
         }
 
-        DEBUG("PC:0x%04x, shifted id (%d):0x%02x, op:%s %s,%s", (PC - 1), (int)current_op, opcode_id, get_mnemonic_name(op.op), op.operand_1, op.operand_2);
+        op = &z80_ops_set[op_set].op_codes[opcode_id];
+
+        z80_trace_op(PC - 1, op_set, opcode_id);
         call_z80_op_func(op);
 
         //  The shift is complete, so reset the current_op to the base set.
@@ -783,43 +811,37 @@ void op_SHIFT(const char *value) {
  *  by calling the commands in `execute_z80_command.c`.
  * 
  *  This can be called for DD and FD instructions to set the IX or IY register high or low bytes;
- *  so the initial name for the register is checked to ensure it is a single character before being
- *  assigned to the src or dest fields.
+ *  the operand type identifies these, so the register is resolved from the current shift.
  */
 
-static void ld_dest_byte(const char *operand_1, const char *operand_2) {
-    char dest = 'X';
-    libspectrum_byte *dest_reg = get_byte_reg_from_operand(operand_1);
-    const char *word_reg;
+static void ld_dest_byte(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
+    const Z80_OPERAND *dest = operand_1;
+    const Z80_OPERAND *src = operand_2;
+    libspectrum_byte *dest_reg = get_operand_byte_reg(dest);
 
-    if (strlen(operand_1) == 1) {
-        dest = operand_1[0];
-    }
+    if (is_byte_reg_operand(src)) {
+        bool is_dest_special = (dest->type == OPERAND_REG_I || dest->type == OPERAND_REG_R);
+        bool is_src_special = (src->type == OPERAND_REG_I || src->type == OPERAND_REG_R);
 
-    if (is_byte_reg_from_operand(operand_2)) {
-        char src = 'Y';
-
-        if (strlen(operand_2) == 1) {
-            src = operand_2[0];
-        }
-
-        if (dest == 'R' || dest == 'I' || src == 'R' || src == 'I') {
+        if (is_dest_special || is_src_special) {
             perform_contend_read_no_mreq(IR, 1);
         }
 
-        if (dest == 'R' && src == 'A') {
+        if (dest->type == OPERAND_REG_R) {
             //  Keep the RZX instruction counter aligned
             rzx_instructions_offset += (R - A);
 
             R = A;
             R7 = A;
-        } else if (dest == 'A' && src == 'R') {
+        } else if (src->type == OPERAND_REG_R) {
             A = (R & LOWER_SEVEN_BITS_MASK) | (R7 & BIT_7);
-        } else if (dest != src) {
-            *dest_reg = *get_byte_reg_from_operand(operand_2);
+        } else {
+            *dest_reg = *get_operand_byte_reg(src);
         }
 
-        if (dest == 'A' && (src == 'I' || src == 'R')) {
+        if (is_src_special) {
+            Z80_FLAGS_SYNC();
+
             F = (F & FLAG_C) |
                 sz53_table[A] |
                 (IFF2 ? FLAG_V : 0);
@@ -828,102 +850,77 @@ static void ld_dest_byte(const char *operand_1, const char *operand_2) {
             z80.iff2_read = 1;
             event_add(tstates, z80_nmos_iff2_event);
         }
-    } else if (strcmp(operand_2, "nn") == 0) {
+    } else if (src->type == OPERAND_IMMEDIATE_BYTE) {
         *dest_reg = readbyte(PC++);
-    } else if ((word_reg = get_indirect_word_reg_name(operand_2)) != NULL) {
-        if (strcmp(word_reg, "BC") == 0 || strcmp(word_reg, "DE") == 0) {
-            MEMPTR_W = get_word_reg_value(word_reg) + 1;
+    } else if (src->type == OPERAND_INDIRECT_REG16) {
+        if (src->reg != Z80_REG_HL) {
+            MEMPTR_W = (*z80_word_regs[src->reg]) + 1;
         }
         
-        *dest_reg = readbyte(get_word_reg_value(word_reg));
-    } else if (strcmp(operand_2, "(nnnn)") == 0) {
+        *dest_reg = readbyte(*z80_word_regs[src->reg]);
+    } else if (src->type == OPERAND_INDIRECT_IMMEDIATE_WORD) {
         MEMPTR_L = readbyte(PC++);
         MEMPTR_H = readbyte(PC++);
-        A = readbyte(MEMPTR_W++);
-    } else if (is_DDFD_op()) {
-        if (strcmp(operand_2, "(REGISTER+dd)") == 0) {
-            if (strlen(operand_1) == 1) {
-                *get_byte_reg_from_operand(operand_1) = get_DDFD_byte_reg_value_from_operand(operand_2);
-            } else {
-                ERROR("Unexpected (REGISTER+dd) operand 1 source byte register found for LD: %s", operand_1);
-            }
-        } else {
-            ERROR("Unexpected DDFD operand 2 source word register found for LD: %s", operand_2);
-        }
+        *dest_reg = readbyte(MEMPTR_W++);
+    } else if (src->type == OPERAND_INDEX_OFFSET) {
+        *dest_reg = get_DDFD_offset_value();
     } else {
-        ERROR("Unexpected operand 2 found for LD: %s", operand_2);
+        ERROR("Unexpected operand 2 found for LD: %d", src->type);
     }
 }
 
-static void ld_dest_word(const char *operand_1, const char *operand_2) {
-    const char *dest = operand_1;
-    const char *src = operand_2;
+static void ld_dest_word(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
+    const Z80_OPERAND *src = operand_2;
+    libspectrum_word *dest_reg = get_operand_word_reg(operand_1);
     regpair dest_word_union;
 
-    dest_word_union.w = *get_word_reg_from_operand(dest);
-
-    if (strcmp(src, "nnnn") == 0) {
+    if (src->type == OPERAND_IMMEDIATE_WORD) {
         dest_word_union.b.l = readbyte(PC++);
         dest_word_union.b.h = readbyte(PC++);
 
         //  Write the updated word to the destination register
-        *get_word_reg_from_operand(dest) = dest_word_union.w;
-    } else if (strcmp(src, "(nnnn)") == 0) {
+        *dest_reg = dest_word_union.w;
+    } else if (src->type == OPERAND_INDIRECT_IMMEDIATE_WORD) {
         _LD16_RRNN(&dest_word_union.b.l, &dest_word_union.b.h);
 
         //  Write the updated word to the destination register
-        *get_word_reg_from_operand(dest) = dest_word_union.w;
-    } else if (strcmp(src, "HL") == 0) {
+        *dest_reg = dest_word_union.w;
+    } else if (src->type == OPERAND_REG16 || src->type == OPERAND_INDEX_REG16) {
+        //  This is LD SP,HL or LD SP,REGISTER
         perform_contend_read_no_mreq(IR, 1);
         perform_contend_read_no_mreq(IR, 1);
 
-        SP = get_word_reg_value(src);
-    } else if (is_DDFD_op()) {
-        if (strcmp(src, "REGISTER") == 0) {
-            perform_contend_read_no_mreq(IR, 1);
-            perform_contend_read_no_mreq(IR, 1);
-
-            SP = get_DDFD_word_reg_value();
-        } else {
-            ERROR("Unexpected DDFD operand 2 source word register found for LD: %s", src);
-        }
+        *dest_reg = *get_operand_word_reg(src);
 	} else {
-        ERROR("Unexpected operand 2 source word register found for LD: %s", src);
+        ERROR("Unexpected operand 2 source word register found for LD: %d", src->type);
     }
 }
 
 /*
  *  The indirect dest is always a word register.
  */
-static void ld_dest_indirect(const char *operand_1, const char *operand_2) {
-    const char *dest;
-    const char *src = operand_2;
+static void ld_dest_indirect(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
+    libspectrum_word *dest = z80_word_regs[operand_1->reg];
+    const Z80_OPERAND *src = operand_2;
 
-    dest = get_indirect_word_reg_name(operand_1);
-
-    if (strlen(dest) != 2) {
-        ERROR("Unexpected dest for indirect LD: %s", dest);
-        return;
-    }
-
-    if (strlen(src) == 1) {
-        if (strcmp(dest, "BC") == 0 || strcmp(dest, "DE") == 0) {
-            MEMPTR_L = (libspectrum_byte)(get_word_reg_value(dest)) + 1;
+    if (src->type == OPERAND_REG8) {
+        if (dest != &HL) {
+            MEMPTR_L = (libspectrum_byte)(*dest) + 1;
             MEMPTR_H = A;
         }
 
-        writebyte(get_word_reg_value(dest), get_byte_reg_value(src[0]));
-    } else if (strcmp(src, "nn") == 0) {
-        writebyte(get_word_reg_value(dest), readbyte(PC++));
+        writebyte(*dest, *z80_byte_regs[src->reg]);
+    } else if (src->type == OPERAND_IMMEDIATE_BYTE) {
+        writebyte(*dest, readbyte(PC++));
     } else {
-        ERROR("Unexpected source for indirect LD: %s", src);
+        ERROR("Unexpected source for indirect LD: %d", src->type);
     }
 }
 
-static void ld_dest_indirect_from_PC(const char *operand) {
-    const char *src = operand;
+static void ld_dest_indirect_from_PC(const Z80_OPERAND *operand) {
+    const Z80_OPERAND *src = operand;
 
-    if (strcmp(src, "A") == 0) {
+    if (src->type == OPERAND_REG8) {
         libspectrum_word wordtemp = readbyte(PC++);
 
         wordtemp |= readbyte(PC++) << 8;
@@ -932,21 +929,23 @@ static void ld_dest_indirect_from_PC(const char *operand) {
         
         writebyte(wordtemp, A);
     }
-    else if (is_word_reg_from_operand(src)) {
+    else if (src->type == OPERAND_REG16 || src->type == OPERAND_INDEX_REG16) {
         regpair src_word_union;
 
-        src_word_union.w = *get_word_reg_from_operand(src);
+        src_word_union.w = *get_operand_word_reg(src);
         _LD16_NNRR(src_word_union.b.l, src_word_union.b.h);
     }
 }
 
-static void ld_dest_DDFD_offset(const char *operand) {
-    const char *src = operand;
+static void ld_dest_DDFD_offset(const Z80_OPERAND *operand) {
+    const Z80_OPERAND *src = operand;
+
+    if (src->type == OPERAND_REG8) {
+        //  Only the address is required; the existing value at the address is not read
+        libspectrum_word address = get_DDFD_offset_address();
 
-    if (strlen(src) == 1) {
-        (void)get_DDFD_offset_value();
-        writebyte(MEMPTR_W, get_byte_reg_value(src[0]));
-    } else if (strcmp(src, "nn") == 0) {
+        writebyte(address, *z80_byte_regs[src->reg]);
+    } else if (src->type == OPERAND_IMMEDIATE_BYTE) {
         libspectrum_byte offset;
         libspectrum_byte value;
 
@@ -957,103 +956,63 @@ static void ld_dest_DDFD_offset(const char *operand) {
         perform_contend_read_no_mreq(PC, 1);
         PC++;
 
-        MEMPTR_W = get_DDFD_word_reg_value() + (libspectrum_signed_byte)offset;
+        MEMPTR_W = (*get_DDFD_word_reg()) + (libspectrum_signed_byte)offset;
         writebyte(MEMPTR_W, value);
     } else {
-        ERROR("Unexpected src for LD (REGISTER+DD) dest: %s", src);
+        ERROR("Unexpected src for LD (REGISTER+DD) dest: %d", src->type);
     }
 }
 
 /*
  *  This can be called by ADC, ADD, AND, CP, OR, SBC, SUB, XOR.
  */
-static void arithmetic_logical(Z80_MNEMONIC op, const char *operand_1, const char *operand_2) {
-    char *op_1 = strdup(operand_1);
-    char *op_2 = (operand_2 == NULL) ? NULL : strdup(operand_2);
-
+static void arithmetic_logical(Z80_MNEMONIC op, const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
     /*
      *  In Z80 assembly, if only operand_1 is provided then the code assumes that the
      *  operation uses the accumulator register A.
-     */
-    if (operand_2 == NULL || strlen(operand_2) == 0) {
-        op_2 = strdup(op_1);
-
-        strcpy(op_1, "A");
-    }
-
-    /*
+     *
      *  All the operations utilise the accumulator register A as the first operand for
      *  single byte instructions.
      */
-    if (strlen(op_1) == 1 && op_1[0] != 'A') {
-        ERROR("Unexpected single register operand 1 found, expected 'A': %s", op_1);
-
-        free(op_1);
-        free(op_2);
-        return;
-    }
-
-    if (is_byte_reg_from_operand(op_1)) {
-        arithmetic_logical_byte(op, op_2);
-    } else if (is_word_reg_from_operand(op_1)) {
-        arithmetic_logical_word(op, op_1, op_2);
+    if (operand_2->type == OPERAND_NONE) {
+        arithmetic_logical_byte(op, operand_1);
+    } else if (operand_1->type == OPERAND_REG16 || operand_1->type == OPERAND_INDEX_REG16) {
+        arithmetic_logical_word(op, operand_1, operand_2);
     } else {
-        ERROR("Unexpected operand 1 length found for %s: %s", get_mnemonic_name(op), op_1);
+        arithmetic_logical_byte(op, operand_2);
     }
-
-    free(op_1);
-    free(op_2);
 }
 
-static void arithmetic_logical_byte(Z80_MNEMONIC op, const char *operand_2) {
-    libspectrum_byte operand_2_value = 0;
-
-    if (is_DDFD_op()) {
-        operand_2_value = get_DDFD_byte_reg_value_from_operand(operand_2);
-    }
-    else if (strlen(operand_2) == 1) {
-        operand_2_value = get_byte_reg_value(operand_2[0]);
-    }
-    else {
-        if (strcmp(operand_2, "(HL)") == 0) {
-            operand_2_value = readbyte(HL);
-        } else {
-            //  The "nn" operand entails that the byte value is read from the PC address.
-            if (strlen(operand_2) > 0 && strcmp(operand_2, "nn") != 0) {
-                WARNING("Unused operand 2 found for %s: %s", get_mnemonic_name(op), operand_2);
-            }
-
-            operand_2_value = readbyte(PC++);
-        }
-    }
+static void arithmetic_logical_byte(Z80_MNEMONIC op, const Z80_OPERAND *operand) {
+    libspectrum_byte operand_value = get_operand_byte_value(operand);
 
     switch(op) {
         case ADC:
-            _ADC(operand_2_value);
+            _ADC(operand_value);
             break;
         case ADD:
-            _ADD(operand_2_value);
+            _ADD(operand_value);
             break;
         case AND:
-            _AND(operand_2_value);
+            _AND(operand_value);
             break;
         case CP:
-            _CP(operand_2_value);
+            _CP(operand_value);
             break;
         case OR:
-            _OR(operand_2_value);
+            _OR(operand_value);
             break;
         case SBC:
-            _SBC(operand_2_value);
+            _SBC(operand_value);
             break;
         case SUB:
-            _SUB(operand_2_value);
+            _SUB(operand_value);
             break;
         case XOR:
-            _XOR(operand_2_value);
+            _XOR(operand_value);
             break;
         default:
-            ERROR("Unexpected operation found with register operand for %s: %s", get_mnemonic_name(op), operand_2_value);
+            ERROR("Unexpected operation found with register operand for %s: %d", get_mnemonic_name(op), operand_value);
     }
 }
 
@@ -1061,52 +1020,23 @@ static void arithmetic_logical_byte(Z80_MNEMONIC op, const char *operand_2) {
  *  For a DDFD word operation, either of the arguments may be REGISTER.
  *  In each case, the first operand is the address of a register and the second operand is a value.
  */
-static void arithmetic_logical_word(Z80_MNEMONIC op, const char *operand_1, const char *operand_2) {
+static void arithmetic_logical_word(Z80_MNEMONIC op, const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
     perform_contend_read_no_mreq_iterations(IR, 7);
 
     if (op == ADD) {
-        libspectrum_word *reg_1;
-        libspectrum_word reg_2_value = 0;
-
-        if (is_DDFD_op() && strcmp(operand_1, "REGISTER") == 0) {
-            reg_1 = get_DDFD_word_reg();
-        } else {
-            if (strlen(operand_1) == 2) {
-                reg_1 = get_word_reg(operand_1);
-            } else {
-                ERROR("Unexpected operand 1 found for %s: %s", get_mnemonic_name(op), operand_1);
-                return;
-            }
-        }
-
-        if (is_DDFD_op() && strcmp(operand_2, "REGISTER") == 0) {
-            reg_2_value = get_DDFD_word_reg_value();
-        } else {
-            if (strlen(operand_2) == 2) {
-                reg_2_value = get_word_reg_value(operand_2);
-            } else {
-                ERROR("Unexpected operand 2 found for %s: %s", get_mnemonic_name(op), operand_2);
-                return;
-            }
-        }
-
-        _ADD16(reg_1, reg_2_value);
+        _ADD16(get_operand_word_reg(operand_1), *get_operand_word_reg(operand_2));
     } else {
-        if (strcmp(operand_1, "HL") == 0) {
-            libspectrum_word operand_2_value = get_word_reg_value(operand_2);
-
-            switch(op) {
-                case ADC:
-                    _ADC16(operand_2_value);
-                    break;
-                case SBC:
-                    _SBC16(operand_2_value);
-                    break;
-                default:
-                    ERROR("Unexpected operation found with 16-bit register operand for %s: %s", get_mnemonic_name(op), operand_2);
-            }
-        } else {
-            ERROR("Expected operand 1 to be HL for %s: Found %s", get_mnemonic_name(op), operand_1);
+        libspectrum_word operand_2_value = *z80_word_regs[operand_2->reg];
+
+        switch(op) {
+            case ADC:
+                _ADC16(operand_2_value);
+                break;
+            case SBC:
+                _SBC16(operand_2_value);
+                break;
+            default:
+                ERROR("Unexpected operation found with 16-bit register operand for %s: %d", get_mnemonic_name(op), operand_2->type);
         }
     }
 }
@@ -1114,14 +1044,13 @@ static void arithmetic_logical_word(Z80_MNEMONIC op, const char *operand_1, cons
 /*
  *  This can be called by CALL, JP.
  */
-static void call_jp(Z80_MNEMONIC op, const char *operand_1, const char *operand_2) {
-    const char *condition = operand_1;
-    const char *offset = operand_2;
+static void call_jp(Z80_MNEMONIC op, const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
+    const Z80_OPERAND *condition = operand_1;
 
     MEMPTR_L = readbyte(PC++);
     MEMPTR_H = readbyte(PC);
 
-    if (offset == NULL || strlen(offset) == 0 || is_flag_true(condition)) {
+    if (condition->type != OPERAND_CONDITION || is_condition_true(condition)) {
         switch(op) {
             case CALL:
                 _CALL();
@@ -1141,6 +1070,8 @@ static void call_jp(Z80_MNEMONIC op, const char *operand_1, const char *operand_
  *  This can be called by CPI, CPD, CPIR, CPDR.
  */
 static void cpi_cpir_cpd_cpdr(Z80_MNEMONIC op) {
+    Z80_FLAGS_SYNC();
+
     libspectrum_byte value = readbyte(HL);
     libspectrum_byte bytetemp = A - value;
     libspectrum_byte lookup;
@@ -1193,47 +1124,34 @@ static void cpi_cpir_cpd_cpdr(Z80_MNEMONIC op) {
 /*
  *  This can be called by INC, DEC.
  */
-static void inc_dec(Z80_MNEMONIC op, const char *operand) {
+static void inc_dec(Z80_MNEMONIC op, const Z80_OPERAND *operand) {
     int modifier = (op == INC) ? 1 : -1;
 
-    if (strlen(operand) == 1) {
-        libspectrum_byte *reg = get_byte_reg(operand[0]);
+    if (is_byte_reg_operand(operand)) {
+        libspectrum_byte *reg = get_operand_byte_reg(operand);
 
         (op == INC) ? _INC(reg) : _DEC(reg);
-    } else if (strlen(operand) == 2) {
+    } else if (operand->type == OPERAND_REG16 || operand->type == OPERAND_INDEX_REG16) {
         perform_contend_read_no_mreq(IR, 1);
         perform_contend_read_no_mreq(IR, 1);
 
-        (*get_word_reg(operand)) += modifier;
-    } else if (strcmp(operand, "(HL)") == 0) {
+        (*get_operand_word_reg(operand)) += modifier;
+    } else if (operand->type == OPERAND_INDIRECT_REG16) {
         libspectrum_byte bytetemp = readbyte(HL);
 
 	    perform_contend_read_no_mreq(HL, 1);
 
         (op == INC) ? _INC(&bytetemp) : _DEC(&bytetemp);
 	    writebyte(HL, bytetemp);
-    } else if (is_DDFD_op()) {
-        if (strcmp(operand, "REGISTER") == 0) {
-            libspectrum_word *reg = (current_op == CURRENT_OP_DD || current_op == CURRENT_OP_DDCB) ? &IX : &IY;
-
-            perform_contend_read_no_mreq( IR, 1 );
-	        perform_contend_read_no_mreq( IR, 1 );
-
-            (*reg) += modifier;
-        } else if (strcmp(operand, "(REGISTER+dd)") == 0) {
-            libspectrum_byte value = get_DDFD_offset_value();
-
-            perform_contend_read_no_mreq(MEMPTR_W, 1);
-            (op == INC) ? _INC(&value) : _DEC(&value);
+    } else if (operand->type == OPERAND_INDEX_OFFSET) {
+        libspectrum_byte value = get_DDFD_offset_value();
 
-        	writebyte(MEMPTR_W, value);
-        } else {
-            libspectrum_byte *reg = get_DDFD_byte_reg_from_operand(operand);
+        perform_contend_read_no_mreq(MEMPTR_W, 1);
+        (op == INC) ? _INC(&value) : _DEC(&value);
 
-            (op == INC) ? _INC(reg) : _DEC(reg);
-        }
+    	writebyte(MEMPTR_W, value);
     } else {
-        ERROR("Unexpected operand found for %s: %s", get_mnemonic_name(op), operand);
+        ERROR("Unexpected operand found for %s: %d", get_mnemonic_name(op), operand->type);
     }
 }
 
@@ -1241,6 +1159,8 @@ static void inc_dec(Z80_MNEMONIC op, const char *operand) {
  * This function can be called by INI, IND, INIR, INDR.
  */
 static void ini_inir_ind_indr(Z80_MNEMONIC op) {
+    Z80_FLAGS_SYNC();
+
     int modifier = (op == INI || op == INIR) ? 1 : -1;
 
 	libspectrum_byte initemp;
@@ -1282,6 +1202,8 @@ static void ini_inir_ind_indr(Z80_MNEMONIC op) {
  * This function can be called by LDI, LDD.
  */
 static void ldi_ldd(Z80_MNEMONIC op) {
+    Z80_FLAGS_SYNC();
+
     int modifier = (op == LDI) ? 1 : -1;
     libspectrum_byte bytetemp = readbyte(HL);
 
@@ -1304,6 +1226,8 @@ static void ldi_ldd(Z80_MNEMONIC op) {
  * This function can be called by LDIR, LDDR.
  */
 static void ldir_lddr(Z80_MNEMONIC op) {
+    Z80_FLAGS_SYNC();
+
     int modifier = (op == LDIR) ? 1 : -1;
 	libspectrum_byte bytetemp;
     
@@ -1341,6 +1265,8 @@ static void ldir_lddr(Z80_MNEMONIC op) {
  * This function can be called by OTIR, OTDR.
  */
 static void otir_otdr(Z80_MNEMONIC op) {
+    Z80_FLAGS_SYNC();
+
     int modifier = (op == OTIR) ? 1 : -1;
 	libspectrum_byte outitemp;
     libspectrum_byte outitemp2;
@@ -1373,6 +1299,8 @@ static void otir_otdr(Z80_MNEMONIC op) {
  * This function can be called by OUTI, OUTD.
  */
 static void outi_outd(Z80_MNEMONIC op) {
+    Z80_FLAGS_SYNC();
+
     int modifier = (op == OUTI) ? 1 : -1;
 	libspectrum_byte outitemp;
     libspectrum_byte outitemp2;
@@ -1394,26 +1322,115 @@ static void outi_outd(Z80_MNEMONIC op) {
 }
 
 /*
- * This function can be called by PUSH, POP.
+ *  This is called by LDIR, LDDR, CPIR, CPDR, INIR, INDR, OTIR and OTDR.
+ *  While the instruction repeats, and its op codes would be fetched again with nothing else to be done,
+ *  it is run again here rather than going back through the op code fetch for each repeat.
+ *  The repeats of the memory instructions are run in bulk first where they can be; the port instructions
+ *  are always run one at a time, as every port access can have an effect.
  */
-static void push_pop(Z80_MNEMONIC op, const char *operand) {
-    if (is_DDFD_op()) {
-        if (strcmp(operand, "REGISTER") == 0) {
-            if (current_op == CURRENT_OP_DD || current_op == CURRENT_OP_DDCB) {
-                (op == PUSH) ? _PUSH16(IXL, IXH) : _POP16(&IXL, &IXH);
-            } else {
-                (op == PUSH) ? _PUSH16(IYL, IYH) : _POP16(&IYL, &IYH);
-            }
-        } else {
-            ERROR("Unexpected DDFD register found: %s", operand);
+static void repeat_block_op(Z80_MNEMONIC op, void (*block_op)(Z80_MNEMONIC op), void (*bulk_op)(Z80_MNEMONIC op)) {
+#ifndef CORETEST
+    libspectrum_word address = PC - 2;
+#endif
+
+    block_op(op);
+
+#ifndef CORETEST
+    while (PC == address && z80_can_refetch_repeat_op(op)) {
+        if (bulk_op != NULL) {
+            bulk_op(op);
+        }
+
+        z80_refetch_repeat_op();
+        block_op(op);
+    }
+#endif
+}
+
+/*
+ *  Copy the bytes of the repeats of LDIR or LDDR which are certain to be followed by another repeat before
+ *  the next event, while nothing they access is contended so that each takes 21 tstates.
+ *  The repeat which follows is run as normal, so sets the flags as the last repeat would.
+ *  The copy stops short of writing over the instruction, through any address it is mapped at, as that would
+ *  change the repeat which follows; and of writing below 0x4000, where a peripheral can page in other memory.
+ */
+static void copy_block(Z80_MNEMONIC op) {
+    int modifier = (op == LDIR) ? 1 : -1;
+
+    while (BC > 1 && tstates + 21 < event_next_event && is_uncontended_repeat(HL, DE) &&
+           DE >= 0x4000 && !is_instruction_byte(DE)) {
+        tstates += 8;
+        R += 2;
+
+        writebyte(DE, readbyte(HL));
+        tstates += 7;
+
+        BC--;
+        HL += modifier;
+        DE += modifier;
+    }
+}
+
+/*
+ *  Compare the bytes of the repeats of CPIR or CPDR which do not find A and are certain to be followed by
+ *  another repeat before the next event, in the same way as copy_block().
+ *  The byte is looked at before it is read, so only above the ROM where no peripheral can see the read.
+ */
+static void search_block(Z80_MNEMONIC op) {
+    int modifier = (op == CPIR) ? 1 : -1;
+
+    while (BC > 1 && tstates + 21 < event_next_event && HL >= 0x4000 && is_uncontended_repeat(HL, HL) &&
+           readbyte_internal(HL) != A) {
+        tstates += 8;
+        R += 2;
+
+        readbyte(HL);
+        tstates += 10;
+
+        BC--;
+        HL += modifier;
+    }
+}
+
+//  Whether a write to the address would change either byte of the instruction at PC
+static bool is_instruction_byte(libspectrum_word address) {
+    const libspectrum_byte *written = memory_map_write[address >> MEMORY_PAGE_SIZE_LOGARITHM].page;
+
+    for (libspectrum_word pc = PC; pc != (libspectrum_word)(PC + 2); pc++) {
+        if (written == memory_map_read[pc >> MEMORY_PAGE_SIZE_LOGARITHM].page &&
+            (address & MEMORY_PAGE_SIZE_MASK) == (pc & MEMORY_PAGE_SIZE_MASK)) {
+            return true;
         }
-    } else if (strlen(operand) == 2) {
-        libspectrum_byte *reg_high = get_byte_reg(operand[0]);
-        libspectrum_byte *reg_low = get_byte_reg(operand[1]);
+    }
+
+    return false;
+}
+
+//  Whether neither the fetch of the instruction nor the addresses read and written by a repeat are contended
+static bool is_uncontended_repeat(libspectrum_word read, libspectrum_word write) {
+    return !memory_map_read[PC >> MEMORY_PAGE_SIZE_LOGARITHM].contended &&
+           !memory_map_read[(libspectrum_word)(PC + 1) >> MEMORY_PAGE_SIZE_LOGARITHM].contended &&
+           !memory_map_read[read >> MEMORY_PAGE_SIZE_LOGARITHM].contended &&
+           !memory_map_write[write >> MEMORY_PAGE_SIZE_LOGARITHM].contended;
+}
 
-        (op == PUSH) ? _PUSH16(*reg_low, *reg_high) : _POP16(reg_low, reg_high);
+/*
+ * This function can be called by PUSH, POP.
+ */
+static void push_pop(Z80_MNEMONIC op, const Z80_OPERAND *operand) {
+    libspectrum_word *reg = get_operand_word_reg(operand);
+    regpair reg_union;
+
+    if (operand->reg == Z80_REG_AF) {
+        Z80_FLAGS_SYNC();
+    }
+
+    if (op == PUSH) {
+        reg_union.w = *reg;
+        _PUSH16(reg_union.b.l, reg_union.b.h);
     } else {
-        ERROR("Unexpected operand found for %s: %s", get_mnemonic_name(op), operand);
+        _POP16(&reg_union.b.l, &reg_union.b.h);
+        *reg = reg_union.w;
     }
 }
 
@@ -1423,17 +1440,11 @@ static void push_pop(Z80_MNEMONIC op, const char *operand) {
  * This instruction is called from the CB instruction set.
  * The first operand is a bit position from 0 to 7.
  */
-static void res_set(Z80_MNEMONIC op, const char *operand_1, const char *operand_2) {
-    if (strlen(operand_1) != 1 || operand_1[0] < '0' || operand_1[0] > '7') {
-        ERROR("Expected bit position for operand 1 for %s: Found this instead %s", get_mnemonic_name(op), operand_1);
-        return;
-    }
+static void res_set(Z80_MNEMONIC op, const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2) {
+    unsigned char bit_mask = res_set_hexmask(op, operand_1->value);
 
-    unsigned char bit_position = operand_1[0] - '0';
-    unsigned char bit_mask = res_set_hexmask(op, bit_position);
-
-    if (strlen(operand_2) == 1) {
-        libspectrum_byte *reg = get_byte_reg(operand_2[0]);
+    if (operand_2->type == OPERAND_REG8) {
+        libspectrum_byte *reg = z80_byte_regs[operand_2->reg];
 
         if (op == RES) {
             *reg &= bit_mask;
@@ -1441,7 +1452,7 @@ static void res_set(Z80_MNEMONIC op, const char *operand_1, const char *operand_
             *reg |= bit_mask;
         }
     }
-    else if (strcmp(operand_2, "(HL)") == 0) {
+    else if (operand_2->type == OPERAND_INDIRECT_REG16) {
         libspectrum_byte bytetemp = readbyte(HL);
 
 	    perform_contend_read_no_mreq(HL, 1);
@@ -1452,34 +1463,23 @@ static void res_set(Z80_MNEMONIC op, const char *operand_1, const char *operand_
             writebyte(HL, bytetemp | bit_mask);
         }
     }
-    else if (is_DDFD_op()) {
-        if (strcmp(operand_2, "(REGISTER+dd)") == 0) {
-            libspectrum_byte bytetemp = readbyte(MEMPTR_W);
+    else if (operand_2->type == OPERAND_INDEX_OFFSET) {
+        libspectrum_byte bytetemp = readbyte(MEMPTR_W);
 
-	        perform_contend_read_no_mreq(MEMPTR_W, 1);
+        perform_contend_read_no_mreq(MEMPTR_W, 1);
 
-            if (op == RES) {
-    	        writebyte(MEMPTR_W, bytetemp & bit_mask);
-            } else {
-    	        writebyte(MEMPTR_W, bytetemp | bit_mask);
-            }
-        }
-        else {
-            ERROR("Unexpected DDFD operand 2 found for %s: %s", get_mnemonic_name(op), operand_2);
+        if (op == RES) {
+            writebyte(MEMPTR_W, bytetemp & bit_mask);
+        } else {
+            writebyte(MEMPTR_W, bytetemp | bit_mask);
         }
     }
     else {
-        ERROR("Unexpected operand 2 found for %s: %s", get_mnemonic_name(op), operand_2);
+        ERROR("Unexpected operand 2 found for %s: %d", get_mnemonic_name(op), operand_2->type);
     }
 }
 
-static void res_set_for_reg(Z80_MNEMONIC op, char bit_char, libspectrum_byte *reg) {
-    if (bit_char < '0' || bit_char > '7') {
-        ERROR("Expected bit position for bit char for %s: Found this instead %c", get_mnemonic_name(op), bit_char);
-        return;
-    }
-
-    unsigned char bit_position = bit_char - '0';
+static void res_set_for_reg(Z80_MNEMONIC op, libspectrum_byte bit_position, libspectrum_byte *reg) {
     unsigned char bit_mask = res_set_hexmask(op, bit_position);
 
     *reg = (op == RES) ? readbyte(MEMPTR_W) & bit_mask : readbyte(MEMPTR_W) | bit_mask;
@@ -1508,24 +1508,17 @@ static bool is_res_set_op(Z80_MNEMONIC op) {
 /*
  *  This function can be called by RL, RR, SLA, SRA, SRL, RLC, RRC.
  */
-static void rotate_shift(Z80_MNEMONIC op, const char *operand) {
-    if (strlen(operand) == 1) {
-        libspectrum_byte *reg = get_byte_reg(operand[0]);
-
-        call_rotate_shift_op(op, reg);
-    } else if (strcmp(operand, "(HL)") == 0) {
+static void rotate_shift(Z80_MNEMONIC op, const Z80_OPERAND *operand) {
+    if (operand->type == OPERAND_REG8) {
+        call_rotate_shift_op(op, z80_byte_regs[operand->reg]);
+    } else if (operand->type == OPERAND_INDIRECT_REG16) {
         call_rotate_shift_offset_op(op, HL);
     }
-    else if (is_DDFD_op()) {
-        if (strcmp(operand, "(REGISTER+dd)") == 0) {
-            call_rotate_shift_offset_op(op, MEMPTR_W);
-        }
-        else {
-            ERROR("Unexpected DDFD operand found for %s: %s", get_mnemonic_name(op), operand);
-        }
+    else if (operand->type == OPERAND_INDEX_OFFSET) {
+        call_rotate_shift_offset_op(op, MEMPTR_W);
     }
     else {
-        ERROR("Unexpected operand found for %s: %s", get_mnemonic_name(op), operand);
+        ERROR("Unexpected operand found for %s: %d", get_mnemonic_name(op), operand->type);
     }
 }
 
@@ -1592,133 +1585,87 @@ static void call_rotate_shift_op(Z80_MNEMONIC op, libspectrum_byte *reg) {
     }
 }
 
-static bool is_byte_reg_from_operand(const char *operand) {
-    bool is_byte_reg = false;
-
-    if (strlen(operand) == 1) {
-        is_byte_reg = true;
-    } else if (is_DDFD_op()) {
-        if (strcmp(operand, "REGISTERL") == 0 || strcmp(operand, "REGISTERH") == 0) {
-            is_byte_reg = true;
-        }
-    }
-
-    return is_byte_reg;
-}
-
-static libspectrum_byte *get_byte_reg_from_operand(const char *operand) {
-    libspectrum_byte *single_byte_reg = NULL;
-
-    if (strlen(operand) == 1) {
-        single_byte_reg = get_byte_reg(operand[0]);
-    } else if (is_DDFD_op()) {
-        single_byte_reg = get_DDFD_byte_reg_from_operand(operand);
-    }
-
-    return single_byte_reg;
+static bool is_byte_reg_operand(const Z80_OPERAND *operand) {
+    return (operand->type == OPERAND_REG8 || operand->type == OPERAND_REG_I || operand->type == OPERAND_REG_R ||
+            operand->type == OPERAND_INDEX_REG8_HIGH || operand->type == OPERAND_INDEX_REG8_LOW);
 }
 
 /*
- *  This will also return true for indirect word registers.
+ *  The registers are resolved when the op codes are read, apart from the index registers
+ *  which depend on whether the instruction was shifted by DD or FD.
  */
-static bool is_word_reg_from_operand(const char *operand) {
-    bool is_word_reg = false;
-
-    if (strlen(operand) == 2) {
-        is_word_reg = true;
-    } else if (is_DDFD_op()) {
-        if (strcmp(operand, "REGISTER") == 0) {
-            is_word_reg = true;
-        }
+static libspectrum_byte *get_operand_byte_reg(const Z80_OPERAND *operand) {
+    libspectrum_byte *reg = z80_byte_regs[operand->reg];
+
+    if (operand->type == OPERAND_INDEX_REG8_HIGH) {
+        reg = is_DD_op() ? &IXH : &IYH;
+    } else if (operand->type == OPERAND_INDEX_REG8_LOW) {
+        reg = is_DD_op() ? &IXL : &IYL;
     }
 
-    return is_word_reg;
+    return reg;
 }
 
 /*
- *  This will also the value for an indirect word registers.
+ *  This will also return the register for an indirect word register.
  */
-static libspectrum_word *get_word_reg_from_operand(const char *operand) {
-    libspectrum_word *word_reg = NULL;
+static libspectrum_word *get_operand_word_reg(const Z80_OPERAND *operand) {
+    libspectrum_word *reg = z80_word_regs[operand->reg];
 
-    if (strlen(operand) == 2) {
-        word_reg = get_word_reg(operand);
-    } else if (is_DDFD_op()) {
-        word_reg = get_DDFD_word_reg();
-    }
-
-    return word_reg;
-}
-
-static bool is_DDFD_op(void) {
-    return (current_op == CURRENT_OP_DD || current_op == CURRENT_OP_DDCB ||
-            current_op == CURRENT_OP_FD || current_op == CURRENT_OP_FDCB);
-}
-
-static libspectrum_byte *get_DDFD_byte_reg_from_operand(const char *operand) {
-    libspectrum_byte *reg = NULL;
-
-    if (current_op == CURRENT_OP_DD || current_op == CURRENT_OP_DDCB) {
-        if (strcmp(operand, "REGISTERL") == 0) {
-            reg = &IXL;
-        } else if (strcmp(operand, "REGISTERH") == 0) {
-            reg = &IXH;
-        } else {
-            ERROR("Unexpected DD byte register operand found: %s", operand);
-        }
-    } else if (current_op == CURRENT_OP_FD || current_op == CURRENT_OP_FDCB) {
-        if (strcmp(operand, "REGISTERL") == 0) {
-            reg = &IYL;
-        } else if (strcmp(operand, "REGISTERH") == 0) {
-            reg = &IYH;
-        } else {
-            ERROR("Unexpected FD byte register operand found: %s", operand);
-        }
-    } else {
-        ERROR("Unexpected current_op found: %d", current_op);
+    if (operand->type == OPERAND_INDEX_REG16) {
+        reg = get_DDFD_word_reg();
     }
 
     return reg;
 }
 
-static libspectrum_byte get_DDFD_byte_reg_value_from_operand(const char *operand) {
+/*
+ *  Return the value of a byte source operand; an immediate value is read from the PC address.
+ */
+static libspectrum_byte get_operand_byte_value(const Z80_OPERAND *operand) {
     libspectrum_byte value = 0;
 
-    if (current_op == CURRENT_OP_DD || current_op == CURRENT_OP_DDCB) {
-        if (strcmp(operand, "REGISTERL") == 0) {
-            value = IXL;
-        } else if (strcmp(operand, "REGISTERH") == 0) {
-            value = IXH;
-        } else if (strcmp(operand, "(REGISTER+dd)") == 0) {
-            value = get_DDFD_offset_value();
-        } else {
-            ERROR("Unexpected DD operand found: %s", operand);
-        }
-    } else if (current_op == CURRENT_OP_FD || current_op == CURRENT_OP_FDCB) {
-        if (strcmp(operand, "REGISTERL") == 0) {
-            value = IYL;
-        } else if (strcmp(operand, "REGISTERH") == 0) {
-            value = IYH;
-        } else if (strcmp(operand, "(REGISTER+dd)") == 0) {
+    switch (operand->type) {
+        case OPERAND_REG8:
+        case OPERAND_INDEX_REG8_HIGH:
+        case OPERAND_INDEX_REG8_LOW:
+            value = *get_operand_byte_reg(operand);
+            break;
+        case OPERAND_INDIRECT_REG16:
+            value = readbyte(*z80_word_regs[operand->reg]);
+            break;
+        case OPERAND_IMMEDIATE_BYTE:
+            value = readbyte(PC++);
+            break;
+        case OPERAND_INDEX_OFFSET:
             value = get_DDFD_offset_value();
-        } else {
-            ERROR("Unexpected FD operand found: %s", operand);
-        }
-    } else {
-        ERROR("Unexpected current_op found: %d", current_op);
+            break;
+        default:
+            ERROR("Unexpected byte operand found: %d", operand->type);
     }
 
     return value;
 }
 
-static libspectrum_byte get_DDFD_offset_value(void) {
+static bool is_DD_op(void) {
+    return (current_op == CURRENT_OP_DD || current_op == CURRENT_OP_DDCB);
+}
+
+/*
+ *  Read the offset for the index register and set the MEMPTR to the resulting address.
+ */
+static libspectrum_word get_DDFD_offset_address(void) {
     libspectrum_byte offset = readbyte(PC);
 
     perform_contend_read_no_mreq_iterations(PC, 5);
 
     PC++;
-	MEMPTR_W = get_DDFD_word_reg_value() + (libspectrum_signed_byte)offset;
-	return readbyte(MEMPTR_W);
+	MEMPTR_W = (*get_DDFD_word_reg()) + (libspectrum_signed_byte)offset;
+	return MEMPTR_W;
+}
+
+static libspectrum_byte get_DDFD_offset_value(void) {
+	return readbyte(get_DDFD_offset_address());
 }
 
 static libspectrum_word *get_DDFD_word_reg(void) {
@@ -1735,39 +1682,6 @@ static libspectrum_word *get_DDFD_word_reg(void) {
     return value;
 }
 
-static libspectrum_word get_DDFD_word_reg_value(void) {
-    libspectrum_word value = 0;
-
-    if (current_op == CURRENT_OP_DD || current_op == CURRENT_OP_DDCB) {
-        value = IX;
-    } else if (current_op == CURRENT_OP_FD || current_op == CURRENT_OP_FDCB) {
-        value = IY;
-    } else {
-        ERROR("Unexpected current_op found: %d", current_op);
-    }
-
-    return value;
-}
-
-static bool is_flag_true(const char *condition) {
-    FLAG_MAPPING flag_mapping = get_flag_mapping(condition);
-
-    if ((flag_mapping.is_not && !(F & flag_mapping.flag)) ||
-        (!flag_mapping.is_not && (F & flag_mapping.flag))) {
-        return true;
-    }
-
-    return false;
-}
-
-static FLAG_MAPPING get_flag_mapping(const char *condition) {
-    FLAG_MAPPING found_flag_mapping = { 0 };
-
-    for (int i = 0; flag_lookup[i].condition != NULL; i++) {
-        if (strcmp(flag_lookup[i].condition, condition) == 0) {
-            found_flag_mapping = flag_lookup[i];
-        }
-    }
-    
-    return found_flag_mapping;
+static bool is_condition_true(const Z80_OPERAND *condition) {
+    return z80_flags_is_set(condition->value) != condition->is_not;
 }
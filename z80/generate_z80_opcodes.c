@@ -0,0 +1,194 @@
+/*
+ *  Generate the built in op code tables from the dat files.
+ *
+ *  This is run when building and writes the C source of z80_built_in_ops_set[] and
+ *  z80_built_in_ops_text[] to stdout,
+ *  having parsed the dat files with the same code that is used to read them at run time;
+ *  the emulator then starts without having to find, read and parse the dat files.
+ *
+ *  Usage: generate_z80_opcodes <directory containing the dat files>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "z80.h"
+#include "z80_opcodes.h"
+#include "read_ops_from_dat_file.h"
+
+#include "../logging.h"
+
+
+#define Z80_OP_NAME_ENTRY(mnemonic, type, member) \
+    [mnemonic] = #mnemonic,
+
+//  The mnemonic names are taken from here as the display names of some of them differ from the enum
+static const char *mnemonic_names[Z80_MNEMONIC_COUNT] = {
+    Z80_OP_FUNCS(Z80_OP_NAME_ENTRY)
+};
+
+static const char *operand_type_names[] = {
+    "OPERAND_NONE",
+    "OPERAND_REG8",
+    "OPERAND_REG_I",
+    "OPERAND_REG_R",
+    "OPERAND_REG16",
+    "OPERAND_REG16_ALTERNATE",
+    "OPERAND_INDIRECT_REG16",
+    "OPERAND_INDEX_REG16",
+    "OPERAND_INDEX_REG8_HIGH",
+    "OPERAND_INDEX_REG8_LOW",
+    "OPERAND_INDEX_OFFSET",
+    "OPERAND_IMMEDIATE_BYTE",
+    "OPERAND_IMMEDIATE_WORD",
+    "OPERAND_INDIRECT_IMMEDIATE_WORD",
+    "OPERAND_PORT_IMMEDIATE",
+    "OPERAND_PORT_C",
+    "OPERAND_CONDITION",
+    "OPERAND_RELATIVE_OFFSET",
+    "OPERAND_NUMBER",
+    "OPERAND_PREFIX",
+    "OPERAND_MNEMONIC"
+};
+
+static const char *prefix_names[] = {
+    "PREFIX_CB",
+    "PREFIX_DD",
+    "PREFIX_ED",
+    "PREFIX_FD",
+    "PREFIX_DDFDCB"
+};
+
+static const char *op_set_names[] = {
+    "OP_SET_BASE",
+    "OP_SET_CB",
+    "OP_SET_DDFD",
+    "OP_SET_DDFDCB",
+    "OP_SET_ED"
+};
+
+static const char *reg_names[] = {
+    "Z80_REG_NONE",
+    "Z80_REG_A",
+    "Z80_REG_F",
+    "Z80_REG_B",
+    "Z80_REG_C",
+    "Z80_REG_D",
+    "Z80_REG_E",
+    "Z80_REG_H",
+    "Z80_REG_L",
+    "Z80_REG_I",
+    "Z80_REG_R",
+    "Z80_REG_AF",
+    "Z80_REG_BC",
+    "Z80_REG_DE",
+    "Z80_REG_HL",
+    "Z80_REG_SP",
+    "Z80_REG_IX",
+    "Z80_REG_IY",
+    "Z80_REG_AF_"
+};
+
+//  Only required as the parser can also return the register values; nothing is read from it here
+processor z80;
+
+static Z80_OPS ops_sets[OP_SET_NUM];
+static Z80_OPS_TEXT ops_texts[OP_SET_NUM];
+
+static void write_operand(const Z80_OPERAND *operand);
+static void write_op(const Z80_OP *op);
+static void write_op_text(int id, const Z80_OP_TEXT *op_text);
+
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <directory containing the dat files>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!read_op_sets(argv[1], ops_sets, ops_texts)) {
+        return EXIT_FAILURE;
+    }
+
+    printf("/* Generated by generate_z80_opcodes from the dat files; do not edit */\n\n");
+    printf("#include \"z80_opcodes.h\"\n\n\n");
+    printf("const Z80_OPS z80_built_in_ops_set[OP_SET_NUM] = {\n");
+
+    for (int set = 0; set < OP_SET_NUM; set++) {
+        printf("    [%s] = {\n", op_set_names[set]);
+        printf("        %d,\n", ops_sets[set].num_op_codes);
+        printf("        {\n");
+
+        for (int id = 0; id < MAX_OP_CODE_IDS; id++) {
+            write_op(&ops_sets[set].op_codes[id]);
+        }
+
+        printf("        }\n");
+        printf("    },\n");
+    }
+
+    printf("};\n\n");
+    printf("const Z80_OPS_TEXT z80_built_in_ops_text[OP_SET_NUM] = {\n");
+
+    for (int set = 0; set < OP_SET_NUM; set++) {
+        printf("    [%s] = {\n", op_set_names[set]);
+        printf("        {\n");
+
+        for (int id = 0; id < MAX_OP_CODE_IDS; id++) {
+            write_op_text(id, &ops_texts[set].op_texts[id]);
+        }
+
+        printf("        }\n");
+        printf("    },\n");
+    }
+
+    printf("};\n");
+
+    if (fflush(stdout) != 0 || ferror(stdout)) {
+        ERROR("Failed to write the op code tables");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static void write_operand(const Z80_OPERAND *operand) {
+    printf("{ %s", operand_type_names[operand->type]);
+
+    if (operand->reg != Z80_REG_NONE) {
+        printf(", .reg = %s", reg_names[operand->reg]);
+    }
+
+    if (operand->type == OPERAND_PREFIX) {
+        printf(", .value = %s", prefix_names[operand->value]);
+    } else if (operand->type == OPERAND_MNEMONIC) {
+        printf(", .value = %s", mnemonic_names[operand->value]);
+    } else if (operand->value != 0) {
+        printf(", .value = 0x%02x", operand->value);
+    }
+
+    if (operand->is_not) {
+        printf(", .is_not = 1");
+    }
+
+    printf(" }");
+}
+
+static void write_op(const Z80_OP *op) {
+    printf("            [0x%02x] = { 0x%02x, %s, ", op->id, op->id, mnemonic_names[op->op]);
+    write_operand(&op->operand_1);
+    printf(", ");
+    write_operand(&op->operand_2);
+    printf(", ");
+    write_operand(&op->extras);
+    printf(" },\n");
+}
+
+//  Only the op codes with operands are written as the rest of the text is empty
+static void write_op_text(int id, const Z80_OP_TEXT *op_text) {
+    if (op_text->operand_1_text[0] == '\0' && op_text->operand_2_text[0] == '\0' && op_text->extras_text[0] == '\0') {
+        return;
+    }
+
+    printf("            [0x%02x] = { \"%s\", \"%s\", \"%s\" },\n",
+           id, op_text->operand_1_text, op_text->operand_2_text, op_text->extras_text);
+}
@@ -0,0 +1,21 @@
+/*
+ *  The libspectrum types used by the op code table generator.
+ *
+ *  The generator is built for and run on the build machine, which need not have libspectrum,
+ *  so it is compiled with this on its include path in place of the host's libspectrum.h.
+ */
+#ifndef Z80_GENERATOR_LIBSPECTRUM_H
+#define Z80_GENERATOR_LIBSPECTRUM_H
+
+#include <stdint.h>
+
+typedef uint8_t libspectrum_byte;
+typedef int8_t libspectrum_signed_byte;
+typedef uint16_t libspectrum_word;
+typedef int16_t libspectrum_signed_word;
+typedef uint32_t libspectrum_dword;
+typedef int32_t libspectrum_signed_dword;
+typedef uint64_t libspectrum_qword;
+typedef int64_t libspectrum_signed_qword;
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ *  Microbenchmark of the decoded op code layout.
+ *
+ *  Compares dispatching through the built in op code tables, where an op code is accessed in
+ *  place through a pointer and its function found from the mnemonic, with the previous layout,
+ *  where each op code held its function lookup, register pointers and operand strings and was
+ *  copied by value into z80_do_opcodes() and again into call_z80_op_func().
+ *
+ *  Both loops dispatch the same pseudo-random stream of (set, opcode) pairs to functions which
+ *  only read their operands, so the difference is in the op code access alone.
+ *
+ *  Usage: opbench [<number of dispatches>]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "z80_opcodes.h"
+
+
+#define DEFAULT_DISPATCHES 200000000UL
+
+//  Enough pairs to defeat the branch predictor while staying in the cache
+#define STREAM_LENGTH 65536
+
+#ifdef __GNUC__
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+//  The layout of an op code before it was packed; MAX_OPERAND_LENGTH was 15 then
+#define OLD_MAX_OPERAND_LENGTH 15
+
+typedef struct {
+    Z80_OPERAND_TYPE type;
+
+    libspectrum_byte *byte_reg;
+    libspectrum_word *word_reg;
+
+    libspectrum_byte flag_mask;
+    bool is_not;
+
+    libspectrum_byte value;
+} OLD_Z80_OPERAND;
+
+typedef void (*OLD_OP_FUNC_ONE_PARAM)(const OLD_Z80_OPERAND *operand);
+typedef void (*OLD_OP_FUNC_TWO_PARAMS)(const OLD_Z80_OPERAND *operand_1, const OLD_Z80_OPERAND *operand_2);
+
+typedef struct {
+    Z80_MNEMONIC op;
+
+    OP_FUNC_TYPE function_type;
+    union {
+        OP_FUNC_NO_PARAMS no_params;
+        OLD_OP_FUNC_ONE_PARAM one_param;
+        OLD_OP_FUNC_TWO_PARAMS two_params;
+    } func;
+} OLD_Z80_OP_FUNC_LOOKUP;
+
+typedef struct {
+    unsigned char id;
+
+    Z80_MNEMONIC op;
+    OLD_Z80_OP_FUNC_LOOKUP op_func_lookup;
+
+    OLD_Z80_OPERAND operand_1;
+    OLD_Z80_OPERAND operand_2;
+    OLD_Z80_OPERAND extras;
+
+    char operand_1_text[OLD_MAX_OPERAND_LENGTH];
+    char operand_2_text[OLD_MAX_OPERAND_LENGTH];
+    char extras_text[OLD_MAX_OPERAND_LENGTH];
+} OLD_Z80_OP;
+
+typedef struct {
+    int num_op_codes;
+    OLD_Z80_OP op_codes[MAX_OP_CODE_IDS];
+} OLD_Z80_OPS;
+
+static OLD_Z80_OPS old_ops_set[OP_SET_NUM];
+
+//  Stand ins for the registers, so that the old operands have something to point at
+static libspectrum_byte byte_regs[Z80_REG_COUNT] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+static libspectrum_word word_regs[Z80_REG_COUNT];
+
+//  Accumulated by the op code functions so that the compiler cannot drop the loops
+static unsigned long checksum;
+
+static struct {
+    libspectrum_byte set;
+    libspectrum_byte id;
+} stream[STREAM_LENGTH];
+
+
+//  The op code functions for the current layout, finding the register from the operand as the core does
+static NOINLINE void new_no_params(void)
+{
+    checksum++;
+}
+
+static NOINLINE void new_one_param(const Z80_OPERAND *operand)
+{
+    checksum += operand->type + byte_regs[operand->reg] + operand->value;
+}
+
+static NOINLINE void new_two_params(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2)
+{
+    checksum += operand_1->type + byte_regs[operand_1->reg] + operand_2->type + operand_2->value;
+}
+
+#define NEW_FUNC_LOOKUP_ENTRY(mnemonic, type, member) \
+    [mnemonic] = { mnemonic, OP_TYPE_##type, .func.member = new_##member },
+
+static const Z80_OP_FUNC_LOOKUP new_func_lookup[Z80_MNEMONIC_COUNT] = {
+    Z80_OP_FUNCS(NEW_FUNC_LOOKUP_ENTRY)
+};
+
+//  As call_z80_op_func() does now
+static NOINLINE void new_dispatch(const Z80_OP *op)
+{
+    const Z80_OP_FUNC_LOOKUP *lookup = &new_func_lookup[op->op];
+
+    switch (lookup->function_type) {
+        case OP_TYPE_NO_PARAMS:
+            lookup->func.no_params();
+            break;
+        case OP_TYPE_ONE_PARAM:
+            lookup->func.one_param(&op->operand_1);
+            break;
+        case OP_TYPE_TWO_PARAMS:
+            lookup->func.two_params(&op->operand_1, &op->operand_2);
+            break;
+    }
+}
+
+//  The op code functions for the old layout, reading through the register pointers
+static NOINLINE void old_no_params(void)
+{
+    checksum++;
+}
+
+static NOINLINE void old_one_param(const OLD_Z80_OPERAND *operand)
+{
+    checksum += operand->type + *operand->byte_reg + operand->value;
+}
+
+static NOINLINE void old_two_params(const OLD_Z80_OPERAND *operand_1, const OLD_Z80_OPERAND *operand_2)
+{
+    checksum += operand_1->type + *operand_1->byte_reg + operand_2->type + operand_2->value;
+}
+
+//  As call_z80_op_func() did, taking the op code by value
+static NOINLINE void old_dispatch(OLD_Z80_OP op)
+{
+    switch (op.op_func_lookup.function_type) {
+        case OP_TYPE_NO_PARAMS:
+            op.op_func_lookup.func.no_params();
+            break;
+        case OP_TYPE_ONE_PARAM:
+            op.op_func_lookup.func.one_param(&op.operand_1);
+            break;
+        case OP_TYPE_TWO_PARAMS:
+            op.op_func_lookup.func.two_params(&op.operand_1, &op.operand_2);
+            break;
+    }
+}
+
+static void convert_operand(OLD_Z80_OPERAND *old, const Z80_OPERAND *operand)
+{
+    old->type = operand->type;
+    old->byte_reg = &byte_regs[operand->reg];
+    old->word_reg = &word_regs[operand->reg];
+    old->flag_mask = operand->value;
+    old->is_not = operand->is_not;
+    old->value = operand->value;
+}
+
+//  Build the old tables from the built in ones, so that both loops see the same op codes
+static void build_old_ops_set(void)
+{
+    for (int set = 0; set < OP_SET_NUM; set++) {
+        old_ops_set[set].num_op_codes = z80_built_in_ops_set[set].num_op_codes;
+
+        for (int id = 0; id < MAX_OP_CODE_IDS; id++) {
+            const Z80_OP *op = &z80_built_in_ops_set[set].op_codes[id];
+            OLD_Z80_OP *old = &old_ops_set[set].op_codes[id];
+            const Z80_OP_FUNC_LOOKUP *lookup = &new_func_lookup[op->op];
+
+            old->id = op->id;
+            old->op = op->op;
+            old->op_func_lookup.op = op->op;
+            old->op_func_lookup.function_type = lookup->function_type;
+            switch (lookup->function_type) {
+                case OP_TYPE_NO_PARAMS:
+                    old->op_func_lookup.func.no_params = old_no_params;
+                    break;
+                case OP_TYPE_ONE_PARAM:
+                    old->op_func_lookup.func.one_param = old_one_param;
+                    break;
+                case OP_TYPE_TWO_PARAMS:
+                    old->op_func_lookup.func.two_params = old_two_params;
+                    break;
+            }
+
+            convert_operand(&old->operand_1, &op->operand_1);
+            convert_operand(&old->operand_2, &op->operand_2);
+            convert_operand(&old->extras, &op->extras);
+            snprintf(old->operand_1_text, sizeof(old->operand_1_text), "%d", op->operand_1.type);
+            snprintf(old->operand_2_text, sizeof(old->operand_2_text), "%d", op->operand_2.type);
+            snprintf(old->extras_text, sizeof(old->extras_text), "%d", op->extras.type);
+        }
+    }
+}
+
+//  A fixed seed, so that every run dispatches the same op codes
+static void build_stream(void)
+{
+    unsigned long state = 0x2545f491UL;
+
+    for (int i = 0; i < STREAM_LENGTH; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        state &= 0xffffffffUL;
+
+        stream[i].set = (state >> 8) % OP_SET_NUM;
+        stream[i].id = state & 0xff;
+    }
+}
+
+static double elapsed_ns(clock_t start, unsigned long dispatches)
+{
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / dispatches;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long dispatches = DEFAULT_DISPATCHES;
+
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [<number of dispatches>]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 2) {
+        dispatches = strtoul(argv[1], NULL, 10);
+        if (!dispatches) {
+            fprintf(stderr, "%s: invalid number of dispatches '%s'\n", argv[0], argv[1]);
+            return 1;
+        }
+    }
+
+    build_old_ops_set();
+    build_stream();
+
+    printf("Op code:  old %lu bytes, new %lu bytes\n",
+           (unsigned long)sizeof(OLD_Z80_OP), (unsigned long)sizeof(Z80_OP));
+    printf("All sets: old %lu bytes, new %lu bytes\n",
+           (unsigned long)sizeof(old_ops_set), (unsigned long)sizeof(z80_built_in_ops_set));
+
+    clock_t start = clock();
+    for (unsigned long i = 0; i < dispatches; i++) {
+        OLD_Z80_OP op = old_ops_set[stream[i % STREAM_LENGTH].set].op_codes[stream[i % STREAM_LENGTH].id];
+        old_dispatch(op);
+    }
+    double old_ns = elapsed_ns(start, dispatches);
+    unsigned long old_checksum = checksum;
+
+    checksum = 0;
+    start = clock();
+    for (unsigned long i = 0; i < dispatches; i++) {
+        new_dispatch(&z80_built_in_ops_set[stream[i % STREAM_LENGTH].set].op_codes[stream[i % STREAM_LENGTH].id]);
+    }
+    double new_ns = elapsed_ns(start, dispatches);
+
+    printf("Dispatch: old %.2f ns, new %.2f ns over %lu op codes\n", old_ns, new_ns, dispatches);
+
+    //  Both loops saw the same op codes, so anything else means the old tables were built wrongly
+    if (checksum != old_checksum) {
+        fprintf(stderr, "%s: checksums differ, %lu and %lu\n", argv[0], old_checksum, checksum);
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,4 +1,6 @@
 #include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
 
 #ifdef CORETEST
 #include "coretest.h"
@@ -8,14 +10,68 @@
 #include "z80_macros.h"
 #include "logging.h"
 
-#include "../memory_pages.h"
-
 #include "parse_z80_operands.h"
 
 
 #define INDIRECT_WORD_OPERAND_LEN 4
 #define WORD_OPERAND_LEN 2
 
+
+typedef struct {
+    const char *text;
+    Z80_OPERAND_TYPE type;
+} OPERAND_MAPPING;
+
+typedef struct {
+    const char *condition;
+    unsigned char flag;
+    bool is_not;
+} FLAG_MAPPING;
+
+typedef struct {
+    const char *name;
+    Z80_PREFIX prefix;
+} PREFIX_MAPPING;
+
+static OPERAND_MAPPING operand_lookup[] = {
+    { "REGISTER", OPERAND_INDEX_REG16 },
+    { "REGISTERH", OPERAND_INDEX_REG8_HIGH },
+    { "REGISTERL", OPERAND_INDEX_REG8_LOW },
+    { "(REGISTER+dd)", OPERAND_INDEX_OFFSET },
+    { "nn", OPERAND_IMMEDIATE_BYTE },
+    { "nnnn", OPERAND_IMMEDIATE_WORD },
+    { "(nnnn)", OPERAND_INDIRECT_IMMEDIATE_WORD },
+    { "(nn)", OPERAND_PORT_IMMEDIATE },
+    { "(C)", OPERAND_PORT_C },
+    { "offset", OPERAND_RELATIVE_OFFSET },
+    { NULL, OPERAND_NONE }
+};
+
+static FLAG_MAPPING flag_lookup[] = {
+    { "C", FLAG_C, false },
+    { "NC", FLAG_C, true },
+    { "PE", FLAG_P, false },
+    { "PO", FLAG_P, true },
+    { "M", FLAG_S, false },
+    { "P", FLAG_S, true },
+    { "Z", FLAG_Z, false },
+    { "NZ", FLAG_Z, true },
+    { NULL, 0, false }
+};
+
+static PREFIX_MAPPING prefix_lookup[] = {
+    { "CB", PREFIX_CB },
+    { "DD", PREFIX_DD },
+    { "ED", PREFIX_ED },
+    { "FD", PREFIX_FD },
+    { "DDFDCB", PREFIX_DDFDCB },
+    { NULL, 0 }
+};
+
+static bool is_condition_operand(Z80_MNEMONIC op);
+static bool parse_condition(const char *text, Z80_OPERAND *operand);
+static bool parse_prefix(const char *text, Z80_OPERAND *operand);
+
 /*
  *  Use the macro for a byte register from the character name.
  */
@@ -63,41 +119,41 @@ libspectrum_byte get_byte_reg_value(char reg) {
     return value;
 }
 
-libspectrum_byte *get_byte_reg(char reg) {
-    libspectrum_byte *value = NULL;
+Z80_REGISTER get_byte_reg(char reg) {
+    Z80_REGISTER value = Z80_REG_NONE;
 
     switch (reg) {
         case 'A':
-            value = &A;
+            value = Z80_REG_A;
             break;
         case 'F':
-            value = &F;
+            value = Z80_REG_F;
             break;
         case 'B':
-            value = &B;
+            value = Z80_REG_B;
             break;
         case 'C':
-            value = &C;
+            value = Z80_REG_C;
             break;
         case 'D':
-            value = &D;
+            value = Z80_REG_D;
             break;
         case 'E':
-            value = &E;
+            value = Z80_REG_E;
             break;
         case 'H':
-            value = &H;
+            value = Z80_REG_H;
             break;
         case 'L':
-            value = &L;
+            value = Z80_REG_L;
             break;
 
         //  The I and R registers are special case registers that are not part of the main register set.
         case 'I':
-            value = &I;
+            value = Z80_REG_I;
             break;
         case 'R':
-            value = (libspectrum_byte *)&R;  // Cast to ensure lower byte is used as this 8 bit register has been defined as a word
+            value = Z80_REG_R;
             break;
         default:
             ERROR("Unexpected byte register found: %c", reg);
@@ -134,23 +190,23 @@ libspectrum_word get_word_reg_value(const char *reg) {
     return value;
 }
 
-libspectrum_word *get_word_reg(const char *reg) {
-    libspectrum_word *value = NULL;
+Z80_REGISTER get_word_reg(const char *reg) {
+    Z80_REGISTER value = Z80_REG_NONE;
 
     if (strcmp(reg, "AF") == 0) {
-        value = &AF;
+        value = Z80_REG_AF;
     } else if (strcmp(reg, "BC") == 0) {
-        value = &BC;
+        value = Z80_REG_BC;
     } else if (strcmp(reg, "DE") == 0) {
-        value = &DE;
+        value = Z80_REG_DE;
     } else if (strcmp(reg, "HL") == 0) {
-        value = &HL;
+        value = Z80_REG_HL;
     } else if (strcmp(reg, "IX") == 0) {
-        value = &IX;
+        value = Z80_REG_IX;
     } else if (strcmp(reg, "IY") == 0) {
-        value = &IY;
+        value = Z80_REG_IY;
     } else if (strcmp(reg, "SP") == 0) {
-        value = &SP;
+        value = Z80_REG_SP;
     } else {
         ERROR("Unexpected word register found: %s", reg);
     }
@@ -188,10 +244,109 @@ const char *get_indirect_word_reg_name(const char *operand) {
 }
 
 /*
- *  Perform a read contention without a memory request for a number of iterations.
+ *  Resolve an operand string from the dat files into its typed descriptor; this is only
+ *  called when the op codes are read, so the instructions never deal with the strings.
+ *
+ *  The mnemonic is required as "C" is a condition for the jump, call and return instructions.
  */
-void perform_contend_read_no_mreq_iterations(libspectrum_word address, int iterations) {
-    for(int i = 0; i < iterations; i++) {
-        perform_contend_read_no_mreq(address, 1);
+bool parse_z80_operand(Z80_MNEMONIC op, const char *text, Z80_OPERAND *operand) {
+    size_t length = strlen(text);
+
+    memset(operand, 0, sizeof(*operand));
+
+    if (length == 0) {
+        operand->type = OPERAND_NONE;
+        return true;
     }
+
+    if (op == SHIFT) {
+        return parse_prefix(text, operand);
+    }
+
+    if (is_condition_operand(op) && parse_condition(text, operand)) {
+        return true;
+    }
+
+    for (int i = 0; operand_lookup[i].text != NULL; i++) {
+        if (strcmp(operand_lookup[i].text, text) == 0) {
+            operand->type = operand_lookup[i].type;
+            return true;
+        }
+    }
+
+    //  The CB instruction in a DDFDCB LD instruction can be named like a register, eg. RL
+    Z80_MNEMONIC cb_op = get_mnemonic_enum(text);
+
+    if (cb_op != (Z80_MNEMONIC)UNKNOWN_MNEMONIC) {
+        operand->type = OPERAND_MNEMONIC;
+        operand->value = (libspectrum_byte)cb_op;
+    } else if (isdigit((unsigned char)text[0])) {
+        //  The restart addresses are given in hex; the other numbers are single digits
+        operand->type = OPERAND_NUMBER;
+        operand->value = (libspectrum_byte)strtol(text, NULL, 16);
+    } else if (length == 1) {
+        operand->reg = get_byte_reg(text[0]);
+
+        if (operand->reg == Z80_REG_NONE) {
+            return false;
+        }
+
+        if (text[0] == 'I') {
+            operand->type = OPERAND_REG_I;
+        } else if (text[0] == 'R') {
+            operand->type = OPERAND_REG_R;
+        } else {
+            operand->type = OPERAND_REG8;
+        }
+    } else if (length == WORD_OPERAND_LEN) {
+        operand->type = OPERAND_REG16;
+        operand->reg = get_word_reg(text);
+    } else if (strcmp(text, "AF'") == 0) {
+        operand->type = OPERAND_REG16_ALTERNATE;
+        operand->reg = Z80_REG_AF_;
+    } else if (is_indirect_word_reg(text)) {
+        operand->type = OPERAND_INDIRECT_REG16;
+        operand->reg = get_word_reg(get_indirect_word_reg_name(text));
+    } else {
+        ERROR("Unexpected operand found for %s: %s", get_mnemonic_name(op), text);
+        return false;
+    }
+
+    if ((operand->type == OPERAND_REG16 || operand->type == OPERAND_INDIRECT_REG16) && operand->reg == Z80_REG_NONE) {
+        return false;
+    }
+
+    return true;
+}
+
+static bool is_condition_operand(Z80_MNEMONIC op) {
+    return (op == CALL || op == JP || op == JR || op == RET);
+}
+
+static bool parse_condition(const char *text, Z80_OPERAND *operand) {
+    for (int i = 0; flag_lookup[i].condition != NULL; i++) {
+        if (strcmp(flag_lookup[i].condition, text) == 0) {
+            operand->type = OPERAND_CONDITION;
+            operand->value = flag_lookup[i].flag;
+            operand->is_not = flag_lookup[i].is_not;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool parse_prefix(const char *text, Z80_OPERAND *operand) {
+    for (int i = 0; prefix_lookup[i].name != NULL; i++) {
+        if (strcmp(prefix_lookup[i].name, text) == 0) {
+            operand->type = OPERAND_PREFIX;
+            operand->value = (libspectrum_byte)prefix_lookup[i].prefix;
+
+            return true;
+        }
+    }
+
+    ERROR("Unexpected prefix found for shift: %s", text);
+    return false;
 }
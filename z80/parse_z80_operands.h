@@ -4,15 +4,17 @@
 #include <stdbool.h>
 #include "libspectrum.h"
 
+#include "z80_opcodes.h"
+
 
 libspectrum_byte get_byte_reg_value(char reg);
-libspectrum_byte *get_byte_reg(char reg);
+Z80_REGISTER get_byte_reg(char reg);
 libspectrum_word get_word_reg_value(const char *reg);
-libspectrum_word *get_word_reg(const char *reg);
+Z80_REGISTER get_word_reg(const char *reg);
 
 bool is_indirect_word_reg(const char *operand);
 const char *get_indirect_word_reg_name(const char *operand);
 
-void perform_contend_read_no_mreq_iterations(libspectrum_word address, int iterations);
+bool parse_z80_operand(Z80_MNEMONIC op, const char *text, Z80_OPERAND *operand);
 
 #endif
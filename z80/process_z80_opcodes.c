@@ -46,6 +46,7 @@
 #include "peripherals/if1.h"
 #include "peripherals/multiface.h"
 #include "peripherals/spectranet.h"
+#include "peripherals/ttx2000s.h"
 #include "peripherals/ula.h"
 #include "peripherals/usource.h"
 
@@ -61,6 +62,9 @@
 #include "process_z80_opcodes.h"
 #include "z80_opcodes.h"
 #include "execute_z80_opcode.h"
+#include "z80_trace.h"
+#include "z80_block_cache.h"
+#include "z80_flags.h"
 #include "logging.h"
 
 
@@ -73,143 +77,608 @@
       The Q register is reset to 0 after each instruction to prepare for the next instruction's flag updates.
 */
 
-/* Execute Z80 opcodes until the next event */
-void z80_do_opcodes(void) {
-    int even_m1 = machine_current->capabilities & LIBSPECTRUM_MACHINE_CAPABILITY_EVEN_M1;
+/*
+ *  The peripheral paging checks made before an instruction's op code is fetched;
+ *  only called for the addresses flagged in periph_pc_traps[].
+ */
+static void perform_pre_fetch_traps(void) {
+    // Beta Disk Interface
+    if (beta_available) {
+        if (beta_active) {
+            if ((!(machine_current->capabilities & LIBSPECTRUM_MACHINE_CAPABILITY_128_MEMORY) ||
+                 machine_current->ram.current_rom) &&
+                PC >= 16384) {
+                beta_unpage();
+            }
+        } else if ((PC & beta_pc_mask) == beta_pc_value &&
+                   (!(machine_current->capabilities & LIBSPECTRUM_MACHINE_CAPABILITY_128_MEMORY) ||
+                    machine_current->ram.current_rom)) {
+            beta_page();
+        }
+    }
 
-    libspectrum_byte opcode_id = 0x00;
-    Z80_OP op;
+    //  Other checks (e.g., plusd, disciple, etc.)
+    if (plusd_available && (PC == PLUSD_PAGE_ADDR1 || PC == PLUSD_PAGE_ADDR2 || PC == PLUSD_PAGE_ADDR3 || PC == PLUSD_PAGE_ADDR4)) {
+        plusd_page();
+    }
 
-    /*
-     *  Execute Z80 opcodes until the next event.
-     */
-    while (tstates < event_next_event) {
-        if (profile_active) {
-            profile_map(PC);
+    if (didaktik80_available) {
+        if (PC == DIDAKTIK80_PAGE_ADDR1 || PC == DIDAKTIK80_PAGE_ADDR2) {
+            didaktik80_page();
+        } else if (PC == DIDAKTIK80_UNPAGE_ADDR) {
+            didaktik80_unpage();
         }
+    }
 
-        if (rzx_playback) {
-            if (R + rzx_instructions_offset >= rzx_instruction_count) {
-                event_add(tstates, spectrum_frame_event);
-                break;
-            }
+    if (disciple_available && (
+        PC == DISCIPLE_PAGE_ADDR1 ||
+        PC == DISCIPLE_PAGE_ADDR2 ||
+        PC == DISCIPLE_PAGE_ADDR3 ||
+        PC == DISCIPLE_PAGE_ADDR4)) {
+        disciple_page();
+    }
+
+    if (usource_available && PC == USOURCE_TOGGLE_ADDR) {
+        usource_toggle();
+    }
+
+    if (multiface_activated && PC == MULTIFACE_SETIC8_ADDR) {
+        multiface_setic8();
+    }
+
+    if (if1_available && (PC == IF1_PAGE_ADDR1 || PC == IF1_PAGE_ADDR2)) {
+        if1_page();
+    }
+
+    if (settings_current.divide_enabled && (PC & DIVIDE_AUTOMAP_ADDR_MASK) == DIVIDE_AUTOMAP_ADDR) {
+        divide_set_automap(1);
+    }
+
+    if (settings_current.divmmc_enabled && (PC & DIVMMC_AUTOMAP_ADDR_MASK) == DIVMMC_AUTOMAP_ADDR) {
+        divmmc_set_automap(1);
+    }
+
+    if (spectranet_available && !settings_current.spectranet_disable) {
+        if (PC == SPECTRANET_PAGE_ADDR1 || ((PC & SPECTRANET_PAGE_ADDR_MASK) == SPECTRANET_PAGE_ADDR2)) {
+            spectranet_page(0);
+        }
+        if (PC == spectranet_programmable_trap && spectranet_programmable_trap_active) {
+            event_add(0, z80_nmi_event);
         }
+    }
+}
 
-        if (debugger_mode != DEBUGGER_MODE_INACTIVE) {
-            if (debugger_check(DEBUGGER_BREAKPOINT_TYPE_EXECUTE, PC)) {
-                debugger_trap();
-            }
+/*
+ *  The peripheral paging checks made once an instruction's op code has been read.
+ */
+static void perform_post_fetch_traps(void) {
+    if (if1_available && PC == IF1_UNPAGE_ADDR) {
+        if1_unpage();
+    }
+
+    if (settings_current.divide_enabled) {
+        if ((PC & DIVIDE_UNPAGE_ADDR_MASK) == DIVIDE_UNPAGE_ADDR) {
+            divide_set_automap(0);
+        } else if (PC == DIVIDE_PAGE_ADDR1 || PC == DIVIDE_PAGE_ADDR2 || PC == DIVIDE_PAGE_ADDR3 || 
+                   PC == DIVIDE_PAGE_ADDR4 || PC == DIVIDE_PAGE_ADDR5 || PC == DIVIDE_PAGE_ADDR6) {
+            divide_set_automap(1);
         }
+    }
 
-        // Beta Disk Interface
-        if (beta_available) {
-            if (beta_active) {
-                if ((!(machine_current->capabilities & LIBSPECTRUM_MACHINE_CAPABILITY_128_MEMORY) ||
-                     machine_current->ram.current_rom) &&
-                    PC >= 16384) {
-                    beta_unpage();
-                }
-            } else if ((PC & beta_pc_mask) == beta_pc_value &&
-                       (!(machine_current->capabilities & LIBSPECTRUM_MACHINE_CAPABILITY_128_MEMORY) ||
-                        machine_current->ram.current_rom)) {
-                beta_page();
-            }
+    if (settings_current.divmmc_enabled) {
+        if ((PC & DIVIDE_UNPAGE_ADDR_MASK) == DIVIDE_UNPAGE_ADDR) {
+            divmmc_set_automap(0);
+        } else if (PC == DIVIDE_PAGE_ADDR1 || PC == DIVIDE_PAGE_ADDR2 || PC == DIVIDE_PAGE_ADDR3 || 
+                   PC == DIVIDE_PAGE_ADDR4 || PC == DIVIDE_PAGE_ADDR5 || PC == DIVIDE_PAGE_ADDR6) {
+            divmmc_set_automap(1);
+        }
+    }
+}
+
+/*
+ *  Perform the checks required before each instruction then fetch its op code from the base set.
+ *  Returns NULL when no further instruction is to be executed before the next event.
+ */
+static const Z80_OP *fetch_z80_op(int even_m1) {
+    libspectrum_byte opcode_id = 0x00;
+    libspectrum_byte traps;
+
+    if (tstates >= event_next_event) {
+        return NULL;
+    }
+
+    if (profile_active) {
+        profile_map(PC);
+    }
+
+    if (rzx_playback) {
+        if (R + rzx_instructions_offset >= rzx_instruction_count) {
+            event_add(tstates, spectrum_frame_event);
+            return NULL;
         }
+    }
 
-        //  Other checks (e.g., plusd, disciple, etc.)
-        if (plusd_available && (PC == 0x0008 || PC == 0x003a || PC == 0x0066 || PC == 0x028e)) {
-            plusd_page();
+    if (debugger_mode != DEBUGGER_MODE_INACTIVE) {
+        if (debugger_check(DEBUGGER_BREAKPOINT_TYPE_EXECUTE, PC)) {
+            debugger_trap();
         }
+    }
 
-        if (didaktik80_available) {
-            if (PC == 0x0000 || PC == 0x0008) {
-                didaktik80_page();
-            } else if (PC == DIDAKTIK80_UNPAGE_ADDR) {
-                didaktik80_unpage();
-            }
+    //  Only the addresses trapped by a peripheral need the paging checks
+    traps = periph_pc_traps[PC];
+
+    if (traps & PERIPH_PC_TRAP_PRE_FETCH) {
+        perform_pre_fetch_traps();
+    }
+
+    //  Perform a memory contention read of the Program Counter
+    perform_contend_read(PC, 4);
+
+    if (even_m1 && (tstates & 1)) {
+        if (++tstates == event_next_event) {
+            return NULL;
         }
+    }
+
+    //  Get the operation from the PC memory address; this is always a BASE operation
+    opcode_id = readbyte_internal(PC);
+
+    if (traps & PERIPH_PC_TRAP_POST_FETCH) {
+        perform_post_fetch_traps();
+    }
+
+    PC++;
+    R++;
+
+    op_set_last_Q(Q);
+    Q = 0;
+
+    z80_trace_op(PC - 1, OP_SET_BASE, opcode_id);
+
+    //  Retrieve the operation from the Z80 operation set given the opcode id retrieved above
+    return &z80_ops_set[OP_SET_BASE].op_codes[opcode_id];
+}
+
+#ifndef CORETEST
+
+/*
+ *  Instructions which are repeated without changing anything but the time and R are skipped up to the
+ *  next event, rather than being run; the core tester logs every op code fetch, so always runs them.
+ */
+
+//  The longest loop looked for, in bytes from its start to the jump back to it
+#define IDLE_LOOP_MAX_LENGTH 16
+
+/*
+ *  The loop last jumped back to, and the processor and time when it was.
+ *  Cleared when the op codes start running, as an interrupt or other event may change what the loop reads.
+ */
+static struct {
+    bool is_set;
+    bool is_idle;                       // The loop only reads memory and changes the registers
+    libspectrum_word start;
+    libspectrum_word jump;
+    libspectrum_word refreshes;         // The op code fetches counted by R in one pass of the loop
+    libspectrum_dword tstates;
+    libspectrum_dword contended_reads;
+    processor z80;
+} idle_loop;
+
+static bool can_skip_instructions(void);
+static void skip_repeats(libspectrum_dword start, libspectrum_word refreshes, bool is_contended);
+static bool is_idle_code(libspectrum_word start, libspectrum_word jump, libspectrum_word *refreshes);
+static const Z80_OP *decode_op(libspectrum_word address, int *length, int *fetches);
+static bool is_idle_op(const Z80_OP *op);
+static bool is_memory_operand(const Z80_OPERAND *operand);
+static bool is_same_state(const processor *state);
+
+
+/*
+ *  Whether the ED prefix and op code of a repeating block instruction can be fetched again by
+ *  z80_refetch_repeat_op(); not when the fetch has anything else to do, or the instruction has been written over.
+ */
+bool z80_can_refetch_repeat_op(Z80_MNEMONIC op) {
+    const Z80_OP *prefix;
+
+    if (tstates >= event_next_event || !can_skip_instructions() || rzx_playback || periph_pc_traps[PC]) {
+        return false;
+    }
+
+    prefix = &z80_ops_set[OP_SET_BASE].op_codes[readbyte_internal(PC)];
+
+    return prefix->op == SHIFT && prefix->operand_1.value == PREFIX_ED &&
+           z80_ops_set[OP_SET_ED].op_codes[readbyte_internal(PC + 1)].op == op;
+}
+
+//  Fetch the ED prefix and op code again as fetch_z80_op() and op_SHIFT() would, for the instruction to be run again
+void z80_refetch_repeat_op(void) {
+    perform_contend_read(PC, 4);
+    perform_contend_read(PC + 1, 4);
+
+    PC += 2;
+    R += 2;
+
+    op_set_last_Q(Q);
+    Q = 0;
+}
+
+/*
+ *  Once halted, the HALT is fetched again every 4 tstates until an interrupt; the fetches only add to R
+ *  and are contended when the HALT is in contended memory.
+ */
+void z80_skip_halt(void) {
+    if (can_skip_instructions() && !periph_pc_traps[PC]) {
+        skip_repeats(tstates - 4, 1, memory_map_read[PC >> MEMORY_PAGE_SIZE_LOGARITHM].contended);
+    }
+}
+
+/*
+ *  Called when a jump goes back to the PC from the address of the jump.
+ *  A short loop of code which only reads memory and leaves every register as it was when it last jumped
+ *  back will do the same until the next event, so the time and R are moved on by whole passes of the loop.
+ */
+void z80_skip_idle_loop(libspectrum_word jump) {
+    libspectrum_word start = PC;
+    bool is_new_loop = !idle_loop.is_set || idle_loop.start != start || idle_loop.jump != jump;
+
+    if (!can_skip_instructions() || opus_active || spectranet_paged || ttx2000s_paged) {
+        return;
+    }
+
+    if (is_new_loop) {
+        idle_loop.is_set = true;
+        idle_loop.start = start;
+        idle_loop.jump = jump;
+        idle_loop.is_idle = jump - start < IDLE_LOOP_MAX_LENGTH && is_idle_code(start, jump, &idle_loop.refreshes);
+    }
 
-        if (disciple_available && (
-            PC == DISCIPLE_PAGE_ADDR1 ||
-            PC == DISCIPLE_PAGE_ADDR2 ||
-            PC == DISCIPLE_PAGE_ADDR3 ||
-            PC == DISCIPLE_PAGE_ADDR4)) {
-            disciple_page();
+    if (!idle_loop.is_idle) {
+        return;
+    }
+
+    //  F has to be compared as it would be read
+    Z80_FLAGS_SYNC();
+
+    /*
+     *  R having been moved on by a single pass shows that the loop has not been left and come back to since.
+     *  A loop which reads the same memory each time round only has to allow for contention if it has read contended memory.
+     */
+    if (!is_new_loop && (libspectrum_word)(R - idle_loop.z80.r) == idle_loop.refreshes && is_same_state(&idle_loop.z80)) {
+        skip_repeats(idle_loop.tstates, idle_loop.refreshes, memory_contended_reads != idle_loop.contended_reads);
+    }
+
+    idle_loop.tstates = tstates;
+    idle_loop.contended_reads = memory_contended_reads;
+    idle_loop.z80 = z80;
+}
+
+//  Not while anything is to see each instruction, nor when the fetch of an op code is stretched to an even tstate
+static bool can_skip_instructions(void) {
+    return !profile_active && debugger_mode == DEBUGGER_MODE_INACTIVE && z80_trace_records == NULL &&
+           !(machine_current->capabilities & LIBSPECTRUM_MACHINE_CAPABILITY_EVEN_M1);
+}
+
+/*
+ *  The instructions have just been repeated from the start time, so as many more whole repeats as complete
+ *  before the next event are skipped; any part of a repeat left over is run as normal.
+ *  When the instructions may be contended the repeat just run, and those skipped, have to be clear of any
+ *  contended tstate to take the same time.
+ *  With RZX playback the repeats are also limited to those fetching op codes within the frame, which R counts.
+ */
+static void skip_repeats(libspectrum_dword start, libspectrum_word refreshes, bool is_contended) {
+    libspectrum_dword period = tstates - start;
+    libspectrum_dword end = event_next_event;
+    libspectrum_dword repeats;
+
+    if (is_contended) {
+        libspectrum_dword uncontended;
+
+        if (end > ULA_CONTENTION_SIZE) {
+            end = ULA_CONTENTION_SIZE;
         }
 
-        if (usource_available && PC == USOURCE_TOGGLE_ADDR) {
-            usource_toggle();
+        for (uncontended = start; uncontended < end; uncontended++) {
+            if (ula_contention[uncontended] || ula_contention_no_mreq[uncontended]) {
+                break;
+            }
         }
 
-        if (multiface_activated && PC == MULTIFACE_SETIC8_ADDR) {
-            multiface_setic8();
+        end = uncontended;
+    }
+
+    if (period == 0 || end <= tstates) {
+        return;
+    }
+
+    repeats = (end - tstates) / period;
+
+    if (rzx_playback) {
+        int fetched = R + rzx_instructions_offset;
+        long remaining;
+
+        //  As in fetch_z80_op(), a negative count of the op codes fetched, from R wrapping around, ends the frame
+        if (fetched < 0 || (size_t)fetched >= rzx_instruction_count) {
+            return;
         }
 
-        if (if1_available && (PC == IF1_PAGE_ADDR1 || PC == IF1_PAGE_ADDR2)) {
-            if1_page();
+        remaining = rzx_instruction_count - fetched;
+
+        if (remaining > 0x10000 - R) {
+            remaining = 0x10000 - R;
         }
 
-        if (settings_current.divide_enabled && (PC & DIVIDE_AUTOMAP_ADDR_MASK) == DIVIDE_AUTOMAP_ADDR) {
-            divide_set_automap(1);
+        if ((long)repeats > remaining / refreshes) {
+            repeats = remaining / refreshes;
         }
+    }
 
-        if (settings_current.divmmc_enabled && (PC & DIVMMC_AUTOMAP_ADDR_MASK) == DIVMMC_AUTOMAP_ADDR) {
-            divmmc_set_automap(1);
+    tstates += repeats * period;
+    R += repeats * refreshes;
+}
+
+/*
+ *  The code from the start of the loop up to the jump back must run straight through, with none of it trapped
+ *  by a peripheral, and only read memory.
+ */
+static bool is_idle_code(libspectrum_word start, libspectrum_word jump, libspectrum_word *refreshes) {
+    int address;
+    int length;
+    int fetches;
+
+    for (address = start; address <= jump; address++) {
+        if (periph_pc_traps[address]) {
+            return false;
         }
+    }
 
-        if (spectranet_available && !settings_current.spectranet_disable) {
-            if (PC == SPECTRANET_PAGE_ADDR1 || ((PC & SPECTRANET_PAGE_ADDR_MASK) == SPECTRANET_PAGE_ADDR2)) {
-                spectranet_page(0);
-            }
-            if (PC == spectranet_programmable_trap && spectranet_programmable_trap_active) {
-                event_add(0, z80_nmi_event);
-            }
+    //  Including the jump back
+    *refreshes = 1;
+
+    for (address = start; address < jump; address += length) {
+        const Z80_OP *op = decode_op(address, &length, &fetches);
+
+        if (op == NULL || !is_idle_op(op)) {
+            return false;
         }
 
-        //  Perform a memory contention read of the Program Counter
-        perform_contend_read(PC, 4);
+        *refreshes += fetches;
+    }
+
+    return address == jump;
+}
 
-        if (even_m1 && (tstates & 1)) {
-            if (++tstates == event_next_event) {
+/*
+ *  Returns the op code run from the address, after any prefixes, its length and the number of op code fetches.
+ *  NULL is returned for the DD and FD prefixes which are run on their own.
+ */
+static const Z80_OP *decode_op(libspectrum_word address, int *length, int *fetches) {
+    const Z80_OP *op = &z80_ops_set[OP_SET_BASE].op_codes[readbyte_internal(address)];
+    int op_length = 1;
+
+    *fetches = 1;
+
+    if (op->op == SHIFT) {
+        libspectrum_byte opcode_id = readbyte_internal(address + 1);
+
+        op_length = 2;
+        *fetches = 2;
+
+        switch (op->operand_1.value) {
+            case PREFIX_CB:
+                op = &z80_ops_set[OP_SET_CB].op_codes[opcode_id];
                 break;
-            }
-        }
+            case PREFIX_ED:
+                op = &z80_ops_set[OP_SET_ED].op_codes[opcode_id];
+                break;
+            default:
+                op = &z80_ops_set[OP_SET_DDFD].op_codes[opcode_id];
 
-        //  Get the operation from the PC memory address; this is always a BASE operation
-        opcode_id = readbyte_internal(PC);
+                if (op->op == SHIFT) {
+                    if (op->operand_1.value != PREFIX_DDFDCB) {
+                        return NULL;
+                    }
 
-        if (if1_available && PC == IF1_UNPAGE_ADDR) {
-            if1_unpage();
+                    //  The index offset comes before the op code
+                    *length = 4;
+                    return &z80_ops_set[OP_SET_DDFDCB].op_codes[readbyte_internal(address + 3)];
+                }
+
+                if (op->op == NOP) {
+                    return NULL;
+                }
         }
+    }
+
+    *length = op_length + get_operand_length(&op->operand_1) + get_operand_length(&op->operand_2);
+    return op;
+}
+
+//  Whether the op code can only change the registers, other than R, I and the interrupt state
+static bool is_idle_op(const Z80_OP *op) {
+    switch (op->op) {
+        case ADC:
+        case ADD:
+        case AND:
+        case BIT:
+        case CCF:
+        case CP:
+        case CPL:
+        case DAA:
+        case EXX:
+        case NEG:
+        case NOP:
+        case OR:
+        case RLA:
+        case RLCA:
+        case RRA:
+        case RRCA:
+        case SBC:
+        case SCF:
+        case SUB:
+        case XOR:
+            return true;
+        case DEC:
+        case EX:
+        case INC:
+        case RL:
+        case RLC:
+        case RR:
+        case RRC:
+        case SLA:
+        case SLL:
+        case SRA:
+        case SRL:
+            return !is_memory_operand(&op->operand_1);
+        case RES:
+        case SET:
+            return !is_memory_operand(&op->operand_2);
+        case LD:
+            //  The DDFDCB LD instructions also write their result to memory
+            return !is_memory_operand(&op->operand_1) && op->operand_2.type != OPERAND_MNEMONIC &&
+                   op->operand_1.type != OPERAND_REG_I && op->operand_1.type != OPERAND_REG_R &&
+                   op->operand_2.type != OPERAND_REG_I && op->operand_2.type != OPERAND_REG_R;
+        default:
+            return false;
+    }
+}
+
+static bool is_memory_operand(const Z80_OPERAND *operand) {
+    return operand->type == OPERAND_INDIRECT_REG16 ||
+           operand->type == OPERAND_INDEX_OFFSET ||
+           operand->type == OPERAND_INDIRECT_IMMEDIATE_WORD;
+}
+
+//  R is left out as it counts the op codes fetched
+static bool is_same_state(const processor *state) {
+    return state->af.w == z80.af.w && state->bc.w == z80.bc.w && state->de.w == z80.de.w && state->hl.w == z80.hl.w &&
+           state->af_.w == z80.af_.w && state->bc_.w == z80.bc_.w && state->de_.w == z80.de_.w && state->hl_.w == z80.hl_.w &&
+           state->ix.w == z80.ix.w && state->iy.w == z80.iy.w && state->sp.w == z80.sp.w &&
+           state->memptr.w == z80.memptr.w && state->i == z80.i && state->r7 == z80.r7 && state->q == z80.q &&
+           state->iff1 == z80.iff1 && state->iff2 == z80.iff2 && state->im == z80.im && state->iff2_read == z80.iff2_read;
+}
+
+#endif
 
-        if (settings_current.divide_enabled) {
-            if ((PC & DIVIDE_UNPAGE_ADDR_MASK) == DIVIDE_UNPAGE_ADDR) {
-                divide_set_automap(0);
-            } else if (PC == DIVIDE_PAGE_ADDR1 || PC == DIVIDE_PAGE_ADDR2 || PC == DIVIDE_PAGE_ADDR3 || 
-                       PC == DIVIDE_PAGE_ADDR4 || PC == DIVIDE_PAGE_ADDR5 || PC == DIVIDE_PAGE_ADDR6) {
-                divide_set_automap(1);
+#if defined(Z80_BLOCK_CACHE) && !defined(CORETEST)
+
+/*
+ *  Run the op codes from the cached blocks, which skips the checks made by fetch_z80_op() that only apply
+ *  when profiling, playing back an RZX file, debugging or at an address trapped by a peripheral.
+ *  The core tester logs the reading of each op code, so always fetches them.
+ */
+static void do_block_opcodes(void) {
+    const Z80_BLOCK *block;
+    const Z80_OP *op;
+    int i;
+
+    while (tstates < event_next_event) {
+        if (profile_active || rzx_playback || debugger_mode != DEBUGGER_MODE_INACTIVE || periph_pc_traps[PC] ||
+            (block = z80_block_cache_find(PC)) == NULL) {
+            if ((op = fetch_z80_op(0)) == NULL) {
+                return;
             }
+
+            call_z80_op_func(op);
+            continue;
         }
 
-        if (settings_current.divmmc_enabled) {
-            if ((PC & DIVIDE_UNPAGE_ADDR_MASK) == DIVIDE_UNPAGE_ADDR) {
-                divmmc_set_automap(0);
-            } else if (PC == DIVIDE_PAGE_ADDR1 || PC == DIVIDE_PAGE_ADDR2 || PC == DIVIDE_PAGE_ADDR3 || 
-                       PC == DIVIDE_PAGE_ADDR4 || PC == DIVIDE_PAGE_ADDR5 || PC == DIVIDE_PAGE_ADDR6) {
-                divmmc_set_automap(1);
+        z80_block_break = false;
+
+        for (i = 0; i < block->num_ops; i++) {
+            const Z80_BLOCK_ENTRY *entry = &block->entries[i];
+
+            if (PC != entry->pc || tstates >= event_next_event || periph_pc_traps[PC] || z80_block_break) {
+                break;
             }
+
+            perform_contend_read(PC, 4);
+
+            PC++;
+            R++;
+
+            op_set_last_Q(Q);
+            Q = 0;
+
+            z80_trace_op(PC - 1, OP_SET_BASE, entry->op->id);
+            call_z80_op_func(entry->op);
         }
+    }
+}
+
+#endif
+
+#if defined(Z80_THREADED_DISPATCH) && defined(HAVE_COMPUTED_GOTO)
 
-        PC++;
-        R++;
+#define Z80_OP_LABEL_ADDRESS(mnemonic, type, member) \
+    [mnemonic] = &&op_label_##mnemonic,
 
-        op_set_last_Q(Q);
-        Q = 0;
+/*
+ *  Every op code has its own copy of the jump to the next op code, so that the branch predictor
+ *  learns the instruction which follows each instruction instead of sharing a single jump.
+ */
+#define Z80_OP_LABEL(mnemonic, type, member) \
+    op_label_##mnemonic: \
+        Z80_OP_CALL_##type(mnemonic, op); \
+        Z80_DISPATCH_NEXT_OP();
+
+#define Z80_DISPATCH_NEXT_OP() \
+    if ((op = fetch_z80_op(even_m1)) == NULL) { \
+        return; \
+    } \
+    goto *op_labels[op->op]
+
+#elif defined(Z80_THREADED_DISPATCH)
+
+#define Z80_OP_CASE(mnemonic, type, member) \
+    case mnemonic: \
+        Z80_OP_CALL_##type(mnemonic, op); \
+        break;
+
+#endif
 
-        //  Retrieve the operation from the Z80 operation set given the opcode id retrieved above then call the associated function
-        op = z80_ops_set[OP_SET_BASE].op_codes[opcode_id];
+//  Run the op codes with the dispatch selected when configuring
+static void run_z80_opcodes(void) {
+    int even_m1 = machine_current->capabilities & LIBSPECTRUM_MACHINE_CAPABILITY_EVEN_M1;
+    const Z80_OP *op;
 
-        DEBUG("PC:0x%04x, id:0x%02x, op:%s %s,%s", PC - 1, opcode_id, get_mnemonic_name(op.op), op.operand_1, op.operand_2);
+#if defined(Z80_BLOCK_CACHE) && !defined(CORETEST)
+    //  The even M1 machines stretch the op code fetch, so are left to fetch_z80_op()
+    if (!even_m1) {
+        do_block_opcodes();
+        return;
+    }
+#endif
+
+#if defined(Z80_THREADED_DISPATCH) && defined(HAVE_COMPUTED_GOTO)
+    static const void *const op_labels[Z80_MNEMONIC_COUNT] = {
+        Z80_OP_FUNCS(Z80_OP_LABEL_ADDRESS)
+    };
+
+    Z80_DISPATCH_NEXT_OP();
+    Z80_OP_FUNCS(Z80_OP_LABEL)
+#elif defined(Z80_THREADED_DISPATCH)
+    while ((op = fetch_z80_op(even_m1)) != NULL) {
+        switch (op->op) {
+            Z80_OP_FUNCS(Z80_OP_CASE)
+            default:
+                ERROR("Unexpected mnemonic found: %d", op->op);
+        }
+    }
+#else
+    while ((op = fetch_z80_op(even_m1)) != NULL) {
         call_z80_op_func(op);
     }
+#endif
+}
+
+/* Execute Z80 opcodes until the next event */
+void z80_do_opcodes(void) {
+#ifndef CORETEST
+    idle_loop.is_set = false;
+#endif
+
+    run_z80_opcodes();
+
+    //  Anything run before the next op codes may read F
+    Z80_FLAGS_SYNC();
 }
@@ -24,6 +24,15 @@
 #ifndef FUSE_Z80_OPS_H
 #define FUSE_Z80_OPS_H
 
+#include "libspectrum.h"
+
+#define PLUSD_PAGE_ADDR1 0x0008
+#define PLUSD_PAGE_ADDR2 0x003a
+#define PLUSD_PAGE_ADDR3 0x0066
+#define PLUSD_PAGE_ADDR4 0x028e
+
+#define DIDAKTIK80_PAGE_ADDR1 0x0000
+#define DIDAKTIK80_PAGE_ADDR2 0x0008
 #define DIDAKTIK80_UNPAGE_ADDR 0x1700
 
 #define DISCIPLE_PAGE_ADDR1 0x0001
@@ -56,4 +65,13 @@
 #define SPECTRANET_PAGE_ADDR_MASK 0xfff8
 #define SPECTRANET_PAGE_ADDR2 0x3ff8
 
+#include <stdbool.h>
+
+#include "mnemonics.h"
+
+bool z80_can_refetch_repeat_op(Z80_MNEMONIC op);
+void z80_refetch_repeat_op(void);
+void z80_skip_halt(void);
+void z80_skip_idle_loop(libspectrum_word jump);
+
 #endif
\ No newline at end of file
@@ -5,35 +5,70 @@
 #include <stdbool.h>
 
 #include "read_ops_from_dat_file.h"
+#include "parse_z80_operands.h"
 #include "../logging.h"
 
 #define MAX_LINE_LENGTH 50
 #define MAX_MNEMONIC_LENGTH 10
+#define MAX_PATH_LENGTH 1024
 
 
-static void init_op_codes(Z80_OPS *ops);
+static Z80_OP_SET_NAME z80_ops_sets_list[] = {
+    { OP_SET_BASE, "opcodes_base.dat" },
+    { OP_SET_CB, "opcodes_cb.dat" },
+    { OP_SET_DDFD, "opcodes_ddfd.dat" },
+    { OP_SET_DDFDCB, "opcodes_ddfdcb.dat" },
+    { OP_SET_ED, "opcodes_ed.dat" },
+    { OP_SET_NUM, NULL }
+};
 
+static void init_op_codes(Z80_OPS *ops, Z80_OPS_TEXT *ops_text);
+static bool parse_op_operands(Z80_OP *op, const Z80_OP_TEXT *op_text);
+
+
+/*
+ *  Read all of the op code sets from the dat files in the directory.
+ *  The enum values for the Z80_OP_SET_TYPE match the index of the Z80_OP_SET_NAME in the z80_ops_sets_list.
+ */
+bool read_op_sets(const char *directory, Z80_OPS *ops_sets, Z80_OPS_TEXT *ops_texts) {
+    for (int enum_pos = 0; z80_ops_sets_list[enum_pos].name != NULL; enum_pos++) {
+        char filename[MAX_PATH_LENGTH];
+
+        if (enum_pos != (int)z80_ops_sets_list[enum_pos].set_type) {
+            FATAL("Invalid set configuration found for %s: %d", z80_ops_sets_list[enum_pos].name, z80_ops_sets_list[enum_pos].set_type);
+            return false;
+        }
+
+        snprintf(filename, sizeof(filename), "%s/%s", directory, z80_ops_sets_list[enum_pos].name);
+
+        if (!read_op_codes(filename, &ops_sets[enum_pos], &ops_texts[enum_pos])) {
+            FATAL("Failed to read op codes from %s", filename);
+            return false;
+        }
+    }
+
+    return true;
+}
 
 /*
  *  Read the op codes from the dat files and store them in the Z80_OPS struct.
  *  The files can skip op codes by leaving gaps in the ID sequence and it can also
  *  have IDs with no associated op codes.
- *  The function will return a sparse array with the identifier of the op code being
- *  used for the index of the array to avoid having to loop through to find a value.
+ *  The function will fill a sparse array with the identifier of the op code being
+ *  used for the index of the array to avoid having to loop through to find a value;
+ *  the operand text is kept apart in the same order as it is only used for debugging.
  */
-Z80_OPS read_op_codes(const char *filename) {
-    Z80_OPS ops = {0};
-
+bool read_op_codes(const char *filename, Z80_OPS *ops, Z80_OPS_TEXT *ops_text) {
     FILE *file = fopen(filename, "rt");
     char line[MAX_LINE_LENGTH];
     int line_count = 0;
 
     if (!file) {
         ERROR("Failed to open file '%s': %s", filename, strerror(errno));
-        return ops;
+        return false;
     }
 
-    init_op_codes(&ops);
+    init_op_codes(ops, ops_text);
 
     while (fgets(line, sizeof(line), file)) {
         unsigned int id;
@@ -63,11 +98,12 @@ Z80_OPS read_op_codes(const char *filename) {
         //  An id that has an id but with no command, is left as a NOP command.
         if (numFields > 1) {
             Z80_MNEMONIC op_mnemonic = UNKNOWN_MNEMONIC;
-            Z80_OP *op = NULL;
+            Z80_OP parsed_op;
+            Z80_OP_TEXT *op_text = NULL;
 
             op_mnemonic = get_mnemonic_enum(mnemonic);
 
-            if (op_mnemonic == UNKNOWN_MNEMONIC) {
+            if (op_mnemonic == (Z80_MNEMONIC)UNKNOWN_MNEMONIC) {
                 ERROR("Unknown mnemonic found at line %d: %s", line_count, mnemonic);
                 continue;
             }
@@ -84,31 +120,63 @@ Z80_OPS read_op_codes(const char *filename) {
                 }
             }
 
-            op  = &ops.op_codes[id];
+            op_text = &ops_text->op_texts[id];
+
+            strncpy(op_text->operand_1_text, operand1, MAX_OPERAND_LENGTH);
+            strncpy(op_text->operand_2_text, operand2, MAX_OPERAND_LENGTH);
+            strncpy(op_text->extras_text, extras, MAX_OPERAND_LENGTH);
 
-            op->id = (unsigned char)id;
-            op->op = op_mnemonic;
-            op->op_func_lookup = get_z80_op_func(op_mnemonic);
+            //  Only replace the NOP once the operands are known to be valid
+            parsed_op.id = (libspectrum_byte)id;
+            parsed_op.op = (libspectrum_byte)op_mnemonic;
 
-            strncpy(op->operand_1, operand1, MAX_OPERAND_LENGTH);
-            strncpy(op->operand_2, operand2, MAX_OPERAND_LENGTH);
-            strncpy(op->extras, extras, MAX_OPERAND_LENGTH);
+            if (!parse_op_operands(&parsed_op, op_text)) {
+                ERROR("Invalid operands found at line %d: %s", line_count, line);
+                memset(op_text, 0, sizeof(*op_text));
+                continue;
+            }
 
-            ops.num_op_codes++;
+            ops->op_codes[id] = parsed_op;
+            ops->num_op_codes++;
         }
     }
 
     fclose(file);
-    return ops;
+    return ops->num_op_codes > 0;
 }
 
-static void init_op_codes(Z80_OPS *ops) {
+static void init_op_codes(Z80_OPS *ops, Z80_OPS_TEXT *ops_text) {
+    memset(ops, 0, sizeof(*ops));
+    memset(ops_text, 0, sizeof(*ops_text));
+
     for (int id = 0; id < MAX_OP_CODE_IDS; id++) {
         Z80_OP *op = &ops->op_codes[id];
 
-
-        op->id = (unsigned char)id;
+        op->id = (libspectrum_byte)id;
         op->op = NOP;
-        op->op_func_lookup = get_z80_op_func(NOP);
     }
 }
+
+/*
+ *  Resolve the operand strings into their descriptors.  The extras are only used by the DDFDCB
+ *  instructions that load a register with the result of a CB instruction; for RES and SET these
+ *  start with the bit position, eg. "0,(REGISTER+dd)", otherwise they are just "(REGISTER+dd)".
+ */
+static bool parse_op_operands(Z80_OP *op, const Z80_OP_TEXT *op_text) {
+    char extras[MAX_OPERAND_LENGTH];
+    char *separator;
+
+    if (!parse_z80_operand(op->op, op_text->operand_1_text, &op->operand_1) ||
+        !parse_z80_operand(op->op, op_text->operand_2_text, &op->operand_2)) {
+        return false;
+    }
+
+    strncpy(extras, op_text->extras_text, MAX_OPERAND_LENGTH);
+    extras[MAX_OPERAND_LENGTH - 1] = '\0';
+
+    if ((separator = strchr(extras, ',')) != NULL) {
+        *separator = '\0';
+    }
+
+    return parse_z80_operand(op->op, extras, &op->extras);
+}
@@ -1,8 +1,11 @@
 #ifndef READ_OPS_FROM_DAT_FILE_H
 #define READ_OPS_FROM_DAT_FILE_H
 
+#include <stdbool.h>
+
 #include "z80_opcodes.h"
 
-Z80_OPS read_op_codes(const char *filename);
+bool read_op_codes(const char *filename, Z80_OPS *ops, Z80_OPS_TEXT *ops_text);
+bool read_op_sets(const char *directory, Z80_OPS *ops_sets, Z80_OPS_TEXT *ops_texts);
 
 #endif
@@ -41,7 +41,10 @@
 #include "z80.h"
 #include "z80_internals.h"
 #include "z80_macros.h"
+#include "z80/z80_block_cache.h"
+#include "z80/z80_flags.h"
 #include "z80/z80_opcodes.h"
+#include "z80/z80_trace.h"
 
 
 /* Whether a half carry occurred or not can be determined by looking at
@@ -110,6 +113,11 @@ z80_init( void *context )
     return 1;
   }
 
+  if (z80_trace_init() == false) {
+    ui_error(UI_ERROR_ERROR, "Failed to initialise the instruction trace");
+    return 1;
+  }
+
   z80_init_tables();
 
   z80_interrupt_event = event_register( z80_interrupt_event_fn,
@@ -124,6 +132,12 @@ z80_init( void *context )
   return 0;
 }
 
+static void
+z80_end( void )
+{
+  z80_trace_end();
+}
+
 void
 z80_register_startup( void )
 {
@@ -133,7 +147,7 @@ z80_register_startup( void )
     STARTUP_MANAGER_MODULE_SETUID,
   };
   startup_manager_register( STARTUP_MANAGER_MODULE_Z80, dependencies,
-                            ARRAY_SIZE( dependencies ), z80_init, NULL, NULL );
+                            ARRAY_SIZE( dependencies ), z80_init, NULL, z80_end );
 }
 
 /* Initalise the tables used to set flags */
@@ -169,6 +183,9 @@ z80_reset( int hard_reset )
   z80.halted=0;
   z80.iff2_read=0;
   Q = 0;
+#ifdef Z80_LAZY_FLAGS
+  z80.flags.op = Z80_FLAGS_NONE;
+#endif
 
   if( hard_reset ) {
     BC =DE =HL =0;
@@ -178,6 +195,11 @@ z80_reset( int hard_reset )
   }
 
   z80.interrupts_enabled_at = -1;
+
+#if defined( Z80_BLOCK_CACHE ) && !defined( CORETEST )
+  /* The ROMs may have been changed along with the machine */
+  z80_block_cache_flush();
+#endif
 }
 
 /* Process a z80 maskable interrupt */
@@ -291,6 +313,14 @@ z80_nmi( libspectrum_dword ts, int type, void *user_data )
   PC = 0x0066;
 }
 
+/* Work out F if it is still to be worked out from the last instruction to
+   set the flags; for anything reading F while the op codes are running */
+void
+z80_update_flags( void )
+{
+  Z80_FLAGS_SYNC();
+}
+
 /* Special peripheral processing for RETN */
 void
 z80_retn( void )
@@ -324,6 +354,10 @@ z80_from_snapshot( libspectrum_snap *snap )
     libspectrum_snap_last_instruction_ei( snap ) ? tstates : -1;
 
   Q = libspectrum_snap_last_instruction_set_f( snap ) ? F : 0;
+
+#ifdef Z80_LAZY_FLAGS
+  z80.flags.op = Z80_FLAGS_NONE;
+#endif
 }
   
 static void
@@ -331,6 +365,8 @@ z80_to_snapshot( libspectrum_snap *snap )
 {
   libspectrum_byte r_register;
 
+  Z80_FLAGS_SYNC();
+
   r_register = ( R7 & 0x80 ) | ( R & 0x7f );
 
   libspectrum_snap_set_a  ( snap, A   ); libspectrum_snap_set_f  ( snap, F   );
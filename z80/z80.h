@@ -60,6 +60,15 @@ typedef struct {
      https://www.worldofspectrum.org/forums/discussion/41704/ */
   libspectrum_byte q;
 
+#ifdef Z80_LAZY_FLAGS
+  /* The instruction which last set the flags, while F is still to be worked
+     out from it; see z80_flags.h */
+  struct {
+    libspectrum_byte op, a, value, carry;
+    libspectrum_word result;
+  } flags;
+#endif
+
   /* Interrupts were enabled at this time; do not accept any interrupts
      until tstates > this value */
   libspectrum_signed_dword interrupts_enabled_at;
@@ -72,6 +81,7 @@ void z80_reset( int hard_reset );
 
 int z80_interrupt( void );
 void z80_retn( void );
+void z80_update_flags( void );
 
 void z80_do_opcodes(void);
 
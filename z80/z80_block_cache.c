@@ -0,0 +1,173 @@
+#include <config.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "libspectrum.h"
+
+#include "memory_pages.h"
+#include "periph.h"
+
+#include "z80_opcodes.h"
+#include "z80_block_cache.h"
+
+
+/*
+ *  The instructions after which a block ends as they change the flow of the code, may repeat,
+ *  or perform I/O which can page the memory that the rest of the block would be read from.
+ */
+static const bool ends_block[Z80_MNEMONIC_COUNT] = {
+    [CALL] = true,
+    [CPDR] = true,
+    [CPIR] = true,
+    [DJNZ] = true,
+    [HALT] = true,
+    [IN] = true,
+    [IND] = true,
+    [INDR] = true,
+    [INI] = true,
+    [INIR] = true,
+    [JP] = true,
+    [JR] = true,
+    [LDDR] = true,
+    [LDIR] = true,
+    [OUT] = true,
+    [OTDR] = true,
+    [OTIR] = true,
+    [OUTD] = true,
+    [OUTI] = true,
+    [RET] = true,
+    [RETN] = true,
+    [RST] = true,
+    [SLTTRAP] = true
+};
+
+uint64_t z80_block_code_lines[Z80_BLOCK_CHUNKS];
+bool z80_block_break = false;
+
+static Z80_BLOCK blocks[Z80_BLOCK_CACHE_SIZE];
+static unsigned int generations[Z80_BLOCK_CHUNKS];
+
+static void decode_block(Z80_BLOCK *block, const memory_page *mapping, int chunk, libspectrum_word pc);
+static int get_op_length(const memory_page *mapping, libspectrum_word address, const Z80_OP *op, bool *is_end);
+
+
+/*
+ *  Returns the block starting at the address, decoding it when it is not cached or its code has changed.
+ *  NULL is returned when the memory is not cached or the first instruction has to be fetched as normal.
+ */
+const Z80_BLOCK *z80_block_cache_find(libspectrum_word pc) {
+    const memory_page *mapping = &memory_map_read[pc >> MEMORY_PAGE_SIZE_LOGARITHM];
+    int chunk = z80_block_cache_chunk(mapping);
+    Z80_BLOCK *block;
+
+    if (chunk < 0) {
+        return NULL;
+    }
+
+    block = &blocks[(pc + chunk * 0x101) & (Z80_BLOCK_CACHE_SIZE - 1)];
+
+    if (block->pc != pc || block->page != mapping->page || block->generation != generations[chunk] ||
+        block->source != mapping->source || block->page_num != mapping->page_num ||
+        block->offset != mapping->offset + (pc & MEMORY_PAGE_SIZE_MASK)) {
+        decode_block(block, mapping, chunk, pc);
+    }
+
+    return (block->num_ops > 0) ? block : NULL;
+}
+
+//  Drop the blocks decoded from a 2K chunk that has been written to
+void z80_block_cache_invalidate(int chunk) {
+    generations[chunk]++;
+    z80_block_code_lines[chunk] = 0;
+
+    z80_block_break = true;
+}
+
+//  Drop every block; for when memory is changed other than by writing through the memory map
+void z80_block_cache_flush(void) {
+    memset(blocks, 0, sizeof(blocks));
+    memset(generations, 0, sizeof(generations));
+    memset(z80_block_code_lines, 0, sizeof(z80_block_code_lines));
+
+    z80_block_break = true;
+}
+
+/*
+ *  Decode the op codes from the address up to the end of the block, which is also ended at the end of the
+ *  2K chunk and before any address trapped by a peripheral.
+ *  Only the base op code is kept; prefixed op codes and operands are still read as the op code is executed.
+ */
+static void decode_block(Z80_BLOCK *block, const memory_page *mapping, int chunk, libspectrum_word pc) {
+    int address = pc;
+    int chunk_end = (pc | MEMORY_PAGE_SIZE_MASK) + 1;
+    bool is_end = false;
+
+    block->source = mapping->source;
+    block->page_num = mapping->page_num;
+    block->offset = mapping->offset + (pc & MEMORY_PAGE_SIZE_MASK);
+    block->pc = pc;
+    block->page = mapping->page;
+    block->generation = generations[chunk];
+    block->num_ops = 0;
+
+    while (!is_end && address < chunk_end && block->num_ops < Z80_BLOCK_MAX_OPS && !periph_pc_traps[address]) {
+        const Z80_OP *op = &z80_ops_set[OP_SET_BASE].op_codes[mapping->page[address & MEMORY_PAGE_SIZE_MASK]];
+        Z80_BLOCK_ENTRY *entry = &block->entries[block->num_ops++];
+
+        entry->op = op;
+        entry->pc = address;
+
+        z80_block_code_lines[chunk] |= (uint64_t)1 << ((address & MEMORY_PAGE_SIZE_MASK) >> Z80_BLOCK_LINE_SIZE_LOGARITHM);
+
+        address += get_op_length(mapping, address, op, &is_end);
+    }
+}
+
+/*
+ *  The length only has to be right for the block to be run to its end; each op code is checked against
+ *  the PC before it is run, so the block is left early where the code does not run as it was decoded.
+ */
+static int get_op_length(const memory_page *mapping, libspectrum_word address, const Z80_OP *op, bool *is_end) {
+    const Z80_OP *shifted_op;
+    libspectrum_word next = address + 1;
+
+    if (op->op != SHIFT) {
+        *is_end = ends_block[op->op];
+        return 1 + get_operand_length(&op->operand_1) + get_operand_length(&op->operand_2);
+    }
+
+    //  The prefixed op code is in the same chunk for it to be decoded here
+    if ((next & MEMORY_PAGE_SIZE_MASK) == 0) {
+        *is_end = true;
+        return 1;
+    }
+
+    libspectrum_byte opcode_id = mapping->page[next & MEMORY_PAGE_SIZE_MASK];
+
+    switch (op->operand_1.value) {
+        case PREFIX_CB:
+            return 2;
+        case PREFIX_ED:
+            shifted_op = &z80_ops_set[OP_SET_ED].op_codes[opcode_id];
+            break;
+        default:
+            shifted_op = &z80_ops_set[OP_SET_DDFD].op_codes[opcode_id];
+
+            if (shifted_op->op == NOP) {
+                shifted_op = &z80_ops_set[OP_SET_BASE].op_codes[opcode_id];
+            }
+
+            if (shifted_op->op == SHIFT) {
+                //  The index offset and the op code follow the DDCB or FDCB prefix
+                if (shifted_op->operand_1.value == PREFIX_DDFDCB) {
+                    return 4;
+                }
+
+                *is_end = true;
+                return 1;
+            }
+    }
+
+    *is_end = ends_block[shifted_op->op];
+    return 2 + get_operand_length(&shifted_op->operand_1) + get_operand_length(&shifted_op->operand_2);
+}
@@ -0,0 +1,87 @@
+#ifndef Z80_BLOCK_CACHE_H
+#define Z80_BLOCK_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "libspectrum.h"
+
+#include "memory_pages.h"
+#include "z80_opcodes.h"
+
+
+#define Z80_BLOCK_MAX_OPS 16
+//  The number of blocks cached, which must be a power of two
+#define Z80_BLOCK_CACHE_SIZE 4096
+
+//  Code is tracked in lines of 32 bytes, so the lines holding code in a 2K chunk fit in a 64 bit mask
+#define Z80_BLOCK_LINE_SIZE_LOGARITHM 5
+
+//  Only the chunks of the system RAM and ROM are cached; any other memory is always fetched from
+#define Z80_BLOCK_RAM_CHUNKS (SPECTRUM_RAM_PAGES * MEMORY_PAGES_IN_16K)
+#define Z80_BLOCK_CHUNKS ((SPECTRUM_RAM_PAGES + SPECTRUM_ROM_PAGES) * MEMORY_PAGES_IN_16K)
+
+typedef struct {
+    const Z80_OP *op;
+    libspectrum_word pc;
+} Z80_BLOCK_ENTRY;
+
+/*
+ *  The base op codes of a run of straight line code.
+ *  A block is found from the memory page its first op code is read from, being the source,
+ *  the page number and the offset into the page, and the address it is run from.
+ */
+typedef struct {
+    int source;
+    int page_num;
+    libspectrum_word offset;
+    libspectrum_word pc;
+    const libspectrum_byte *page;
+
+    unsigned int generation;            // The generation of the 2K chunk when the block was decoded
+
+    int num_ops;
+    Z80_BLOCK_ENTRY entries[Z80_BLOCK_MAX_OPS];
+} Z80_BLOCK;
+
+//  The lines of each 2K chunk that op codes have been decoded from, so a write only invalidates on hitting code
+extern uint64_t z80_block_code_lines[Z80_BLOCK_CHUNKS];
+
+//  Set to end the block being run; when code is written to or the memory map has changed
+extern bool z80_block_break;
+
+
+const Z80_BLOCK *z80_block_cache_find(libspectrum_word pc);
+void z80_block_cache_invalidate(int chunk);
+void z80_block_cache_flush(void);
+
+//  Returns the 2K chunk of the system RAM or ROM that is mapped, or -1 for memory that is not cached
+static inline int z80_block_cache_chunk(const memory_page *mapping) {
+    int chunk = mapping->offset >> MEMORY_PAGE_SIZE_LOGARITHM;
+
+    if (chunk >= MEMORY_PAGES_IN_16K || mapping->page_num < 0) {
+        return -1;
+    }
+
+    if (mapping->source == memory_source_ram && mapping->page_num < SPECTRUM_RAM_PAGES) {
+        return mapping->page_num * MEMORY_PAGES_IN_16K + chunk;
+    }
+
+    if (mapping->source == memory_source_rom && mapping->page_num < SPECTRUM_ROM_PAGES) {
+        return Z80_BLOCK_RAM_CHUNKS + mapping->page_num * MEMORY_PAGES_IN_16K + chunk;
+    }
+
+    return -1;
+}
+
+//  Called for every write to memory; only a write to a line that code has been decoded from invalidates
+static inline void z80_block_cache_write(const memory_page *mapping, libspectrum_word address) {
+    int chunk = z80_block_cache_chunk(mapping);
+    int line = (address & MEMORY_PAGE_SIZE_MASK) >> Z80_BLOCK_LINE_SIZE_LOGARITHM;
+
+    if (chunk >= 0 && (z80_block_code_lines[chunk] >> line) & 1) {
+        z80_block_cache_invalidate(chunk);
+    }
+}
+
+#endif
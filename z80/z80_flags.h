@@ -0,0 +1,166 @@
+#ifndef Z80_FLAGS_H
+#define Z80_FLAGS_H
+
+#include <stdbool.h>
+
+#include "libspectrum.h"
+
+#include "z80.h"
+#include "z80_macros.h"
+
+
+/*
+ *  The 8 bit arithmetic and logical instructions record how F is to be worked out from their operands and
+ *  result; with lazy flags F is only worked out when it is read, otherwise it is worked out straight away.
+ *  The carry in of ADC and SBC is part of the result, so they share the flags of ADD and SUB.
+ */
+typedef enum {
+    Z80_FLAGS_NONE = 0,                 // F is up to date
+    Z80_FLAGS_ADD,
+    Z80_FLAGS_SUB,
+    Z80_FLAGS_CP,
+    Z80_FLAGS_AND,
+    Z80_FLAGS_OR,                       // Also XOR
+    Z80_FLAGS_INC,
+    Z80_FLAGS_DEC
+} Z80_FLAGS_OP;
+
+#define Z80_FLAGS_H_MASK 0x88
+#define Z80_FLAGS_CARRY_MASK 0x100
+
+
+static inline libspectrum_byte z80_flags_work_out(Z80_FLAGS_OP op, libspectrum_byte a, libspectrum_byte value,
+                                                  libspectrum_word result, libspectrum_byte carry) {
+    libspectrum_byte lookup = ( (a & Z80_FLAGS_H_MASK) >> 3 ) |
+                              ( (value & Z80_FLAGS_H_MASK) >> 2 ) |
+                              ( (result & Z80_FLAGS_H_MASK) >> 1 );
+    libspectrum_byte result_byte = result;
+
+    switch (op) {
+        case Z80_FLAGS_ADD:
+            return ( (result & Z80_FLAGS_CARRY_MASK) ? FLAG_C : 0 ) |
+                   halfcarry_add_table[lookup & 0x07] |
+                   overflow_add_table[lookup >> 4] |
+                   sz53_table[result_byte];
+        case Z80_FLAGS_SUB:
+            return ( (result & Z80_FLAGS_CARRY_MASK) ? FLAG_C : 0 ) |
+                   FLAG_N |
+                   halfcarry_sub_table[lookup & 0x07] |
+                   overflow_sub_table[lookup >> 4] |
+                   sz53_table[result_byte];
+        case Z80_FLAGS_CP:
+            //  The undocumented flags are taken from the operand rather than the result
+            return ( (result & Z80_FLAGS_CARRY_MASK) ? FLAG_C : (result ? 0 : FLAG_Z) ) |
+                   FLAG_N |
+                   halfcarry_sub_table[lookup & 0x07] |
+                   overflow_sub_table[lookup >> 4] |
+                   (value & (FLAG_3 | FLAG_5)) |
+                   (result & FLAG_S);
+        case Z80_FLAGS_AND:
+            return FLAG_H | sz53p_table[result_byte];
+        case Z80_FLAGS_OR:
+            return sz53p_table[result_byte];
+        case Z80_FLAGS_INC:
+            return carry |
+                   ( (result_byte == 0x80) ? FLAG_V : 0 ) |
+                   ( (result_byte & 0x0f) ? 0 : FLAG_H ) |
+                   sz53_table[result_byte];
+        case Z80_FLAGS_DEC:
+            return carry |
+                   ( ((result_byte & 0x0f) == 0x0f) ? FLAG_H : 0 ) |
+                   FLAG_N |
+                   ( (result_byte == 0x7f) ? FLAG_V : 0 ) |
+                   sz53_table[result_byte];
+        default:
+            return F;
+    }
+}
+
+#ifdef Z80_LAZY_FLAGS
+
+static inline void z80_flags_sync(void) {
+    F = z80_flags_work_out(z80.flags.op, z80.flags.a, z80.flags.value, z80.flags.result, z80.flags.carry);
+    z80.flags.op = Z80_FLAGS_NONE;
+}
+
+//  Called before F is read or changed other than by the instructions that set the flags lazily
+#define Z80_FLAGS_SYNC() \
+    do { \
+        if (z80.flags.op != Z80_FLAGS_NONE) { \
+            z80_flags_sync(); \
+        } \
+    } while (0)
+
+/*
+ *  Only bits 3 and 5 of Q are used, by SCF and CCF, and these can be found without working out F.
+ *  Q is worked out in full if F is worked out before the next instruction.
+ */
+static inline void z80_flags_set(Z80_FLAGS_OP op, libspectrum_byte a, libspectrum_byte value,
+                                 libspectrum_word result, libspectrum_byte carry) {
+    z80.flags.op = op;
+    z80.flags.a = a;
+    z80.flags.value = value;
+    z80.flags.result = result;
+    z80.flags.carry = carry;
+
+    Q = ((op == Z80_FLAGS_CP) ? value : result) & (FLAG_3 | FLAG_5);
+}
+
+static inline libspectrum_byte z80_flags_carry(void) {
+    switch (z80.flags.op) {
+        case Z80_FLAGS_NONE:
+            return F & FLAG_C;
+        case Z80_FLAGS_ADD:
+        case Z80_FLAGS_SUB:
+        case Z80_FLAGS_CP:
+            return (z80.flags.result & Z80_FLAGS_CARRY_MASK) ? FLAG_C : 0;
+        case Z80_FLAGS_INC:
+        case Z80_FLAGS_DEC:
+            return z80.flags.carry;
+        default:
+            return 0;
+    }
+}
+
+/*
+ *  Test a flag for a condition; zero, carry and sign are found from the result,
+ *  so a compare followed by a jump does not have to work out F.
+ */
+static inline bool z80_flags_is_set(libspectrum_byte flag) {
+    if (z80.flags.op != Z80_FLAGS_NONE) {
+        switch (flag) {
+            case FLAG_Z:
+                return (z80.flags.result & 0xff) == 0;
+            case FLAG_C:
+                return z80_flags_carry() != 0;
+            case FLAG_S:
+                return (z80.flags.result & FLAG_S) != 0;
+            default:
+                z80_flags_sync();
+        }
+    }
+
+    return (F & flag) != 0;
+}
+
+#else
+
+#define Z80_FLAGS_SYNC()
+
+static inline void z80_flags_set(Z80_FLAGS_OP op, libspectrum_byte a, libspectrum_byte value,
+                                 libspectrum_word result, libspectrum_byte carry) {
+    F = z80_flags_work_out(op, a, value, result, carry);
+    Q = F;
+}
+
+static inline libspectrum_byte z80_flags_carry(void) {
+    return F & FLAG_C;
+}
+
+static inline bool z80_flags_is_set(libspectrum_byte flag) {
+    return (F & flag) != 0;
+}
+
+#endif
+
+#endif
@@ -1,6 +1,9 @@
+#include <config.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "z80.h"
+#include "z80_macros.h"
 #include "z80_opcodes.h"
 #include "execute_z80_opcode.h"
 #include "read_ops_from_dat_file.h"
@@ -8,139 +11,130 @@
 #include "../logging.h"
 
 
-static Z80_OP_SET_NAME z80_ops_sets_list[] = {
-    { OP_SET_BASE, "./z80/opcodes_base.dat" },
-    { OP_SET_CB, "./z80/opcodes_cb.dat" },
-    { OP_SET_DDFD, "./z80/opcodes_ddfd.dat" },
-    { OP_SET_DDFDCB, "./z80/opcodes_ddfdcb.dat" },
-    { OP_SET_ED, "./z80/opcodes_ed.dat" },
-    { OP_SET_NUM, NULL }
+#ifndef Z80_THREADED_DISPATCH
+
+#define Z80_OP_FUNC_LOOKUP_ENTRY(mnemonic, type, member) \
+    [mnemonic] = { mnemonic, OP_TYPE_##type, .func.member = op_##mnemonic },
+
+//  Indexed by the mnemonic
+static const Z80_OP_FUNC_LOOKUP z80_op_func_lookup[Z80_MNEMONIC_COUNT] = {
+    Z80_OP_FUNCS(Z80_OP_FUNC_LOOKUP_ENTRY)
+};
+
+#endif
+
+libspectrum_byte *const z80_byte_regs[Z80_REG_COUNT] = {
+    [Z80_REG_A] = &A,
+    [Z80_REG_F] = &F,
+    [Z80_REG_B] = &B,
+    [Z80_REG_C] = &C,
+    [Z80_REG_D] = &D,
+    [Z80_REG_E] = &E,
+    [Z80_REG_H] = &H,
+    [Z80_REG_L] = &L,
+    [Z80_REG_I] = &I,
+    [Z80_REG_R] = (libspectrum_byte *)&R  // Cast to ensure lower byte is used as this 8 bit register has been defined as a word
 };
 
-static Z80_OP_FUNC_LOOKUP z80_op_func_lookup[] = {
-    { ADD, OP_TYPE_TWO_PARAMS, .func.two_params = op_ADD },
-    { ADC, OP_TYPE_TWO_PARAMS, .func.two_params = op_ADC },
-    { AND, OP_TYPE_TWO_PARAMS, .func.two_params = op_AND },
-    { BIT, OP_TYPE_TWO_PARAMS, .func.two_params = op_BIT },
-    { CALL, OP_TYPE_TWO_PARAMS, .func.two_params = op_CALL },
-    { CCF, OP_TYPE_NO_PARAMS, .func.no_params = op_CCF },
-    { CP, OP_TYPE_TWO_PARAMS, .func.two_params = op_CP },
-    { CPD, OP_TYPE_NO_PARAMS, .func.no_params = op_CPD },
-    { CPDR, OP_TYPE_NO_PARAMS, .func.no_params = op_CPDR },
-    { CPI, OP_TYPE_NO_PARAMS, .func.no_params = op_CPI },
-    { CPIR, OP_TYPE_NO_PARAMS, .func.no_params = op_CPIR },
-    { CPL, OP_TYPE_NO_PARAMS, .func.no_params = op_CPL },
-    { DAA, OP_TYPE_NO_PARAMS, .func.no_params = op_DAA },
-    { DEC, OP_TYPE_ONE_PARAM, .func.one_param = op_DEC },
-    { DI, OP_TYPE_NO_PARAMS, .func.no_params = op_DI },
-    { DJNZ, OP_TYPE_ONE_PARAM, .func.one_param = op_DJNZ },
-    { EI, OP_TYPE_NO_PARAMS, .func.no_params = op_EI },
-    { EX, OP_TYPE_TWO_PARAMS, .func.two_params = op_EX },
-    { EXX, OP_TYPE_NO_PARAMS, .func.no_params = op_EXX },
-    { HALT, OP_TYPE_NO_PARAMS, .func.no_params = op_HALT },
-    { IM, OP_TYPE_ONE_PARAM, .func.one_param = op_IM },
-    { IN, OP_TYPE_TWO_PARAMS, .func.two_params = op_IN },
-    { INC, OP_TYPE_ONE_PARAM, .func.one_param = op_INC },
-    { IND, OP_TYPE_NO_PARAMS, .func.no_params = op_IND },
-    { INDR, OP_TYPE_NO_PARAMS, .func.no_params = op_INDR },
-    { INI, OP_TYPE_NO_PARAMS, .func.no_params = op_INI },
-    { INIR, OP_TYPE_NO_PARAMS, .func.no_params = op_INIR },
-    { JP, OP_TYPE_TWO_PARAMS, .func.two_params = op_JP },
-    { JR, OP_TYPE_TWO_PARAMS, .func.two_params = op_JR },
-    { LD, OP_TYPE_TWO_PARAMS, .func.two_params = op_LD },
-    { LDD, OP_TYPE_NO_PARAMS, .func.no_params = op_LDD },
-    { LDDR, OP_TYPE_NO_PARAMS, .func.no_params = op_LDDR },
-    { LDI, OP_TYPE_NO_PARAMS, .func.no_params = op_LDI },
-    { LDIR, OP_TYPE_NO_PARAMS, .func.no_params = op_LDIR },
-    { NEG, OP_TYPE_NO_PARAMS, .func.no_params = op_NEG },
-    { NOP, OP_TYPE_NO_PARAMS, .func.no_params = op_NOP },
-    { OR, OP_TYPE_TWO_PARAMS, .func.two_params = op_OR },
-    { OUT, OP_TYPE_TWO_PARAMS, .func.two_params = op_OUT },
-    { OTDR, OP_TYPE_NO_PARAMS, .func.no_params = op_OTDR },
-    { OTIR, OP_TYPE_NO_PARAMS, .func.no_params = op_OTIR },
-    { OUTD, OP_TYPE_NO_PARAMS, .func.no_params = op_OUTD },
-    { OUTI, OP_TYPE_NO_PARAMS, .func.no_params = op_OUTI },
-    { POP, OP_TYPE_ONE_PARAM, .func.one_param = op_POP },
-    { PUSH, OP_TYPE_ONE_PARAM, .func.one_param = op_PUSH },
-    { RES, OP_TYPE_TWO_PARAMS, .func.two_params = op_RES },
-    { RET, OP_TYPE_ONE_PARAM, .func.one_param = op_RET },
-    { RETN, OP_TYPE_NO_PARAMS, .func.no_params = op_RETN },
-    { RL, OP_TYPE_ONE_PARAM, .func.one_param = op_RL },
-    { RLA, OP_TYPE_NO_PARAMS, .func.no_params = op_RLA },
-    { RLC, OP_TYPE_ONE_PARAM, .func.one_param = op_RLC },
-    { RLCA, OP_TYPE_NO_PARAMS, .func.no_params = op_RLCA },
-    { RLD, OP_TYPE_NO_PARAMS, .func.no_params = op_RLD },
-    { RR, OP_TYPE_ONE_PARAM, .func.one_param = op_RR },
-    { RRA, OP_TYPE_NO_PARAMS, .func.no_params = op_RRA },
-    { RRC, OP_TYPE_ONE_PARAM, .func.one_param = op_RRC },
-    { RRCA, OP_TYPE_NO_PARAMS, .func.no_params = op_RRCA },
-    { RRD, OP_TYPE_NO_PARAMS, .func.no_params = op_RRD },
-    { RST, OP_TYPE_ONE_PARAM, .func.one_param = op_RST },
-    { SBC, OP_TYPE_TWO_PARAMS, .func.two_params = op_SBC },
-    { SCF, OP_TYPE_NO_PARAMS, .func.no_params = op_SCF },
-    { SET, OP_TYPE_TWO_PARAMS, .func.two_params = op_SET },
-    { SLA, OP_TYPE_ONE_PARAM, .func.one_param = op_SLA },
-    { SLL, OP_TYPE_ONE_PARAM, .func.one_param = op_SLL },
-    { SRA, OP_TYPE_ONE_PARAM, .func.one_param = op_SRA },
-    { SRL, OP_TYPE_ONE_PARAM, .func.one_param = op_SRL },
-    { SUB, OP_TYPE_TWO_PARAMS, .func.two_params = op_SUB },
-    { XOR, OP_TYPE_TWO_PARAMS, .func.two_params = op_XOR },
-    { SLTTRAP, OP_TYPE_NO_PARAMS, .func.no_params = op_SLTTRAP },
-    { SHIFT, OP_TYPE_ONE_PARAM, .func.one_param = op_SHIFT },
-    { Z80_MNEMONIC_COUNT, 0, {NULL} } // Sentinel value to mark the end of the array
+libspectrum_word *const z80_word_regs[Z80_REG_COUNT] = {
+    [Z80_REG_AF] = &AF,
+    [Z80_REG_BC] = &BC,
+    [Z80_REG_DE] = &DE,
+    [Z80_REG_HL] = &HL,
+    [Z80_REG_SP] = &SP,
+    [Z80_REG_IX] = &IX,
+    [Z80_REG_IY] = &IY,
+    [Z80_REG_AF_] = &AF_
 };
 
-Z80_OPS z80_ops_set[OP_SET_NUM];
+static Z80_OPS z80_ops_set_from_dat_files[OP_SET_NUM];
+static Z80_OPS_TEXT z80_ops_text_from_dat_files[OP_SET_NUM];
+
+const Z80_OPS *z80_ops_set = z80_built_in_ops_set;
+const Z80_OPS_TEXT *z80_ops_text = z80_built_in_ops_text;
 
 
 /*
- *  The enum values for the Z80_OP_SET_TYPE match the index of the Z80_OP_SET_NAME in the z80_ops_sets_list.
+ *  The op code tables are built in, having been generated from the dat files when building.
+ *  The dat files are only read when the environment variable gives a directory to read them
+ *  from, which allows the instruction sets to be experimented with without rebuilding.
  */
 bool init_op_sets(void) {
-    for (int enum_pos = 0; z80_ops_sets_list[enum_pos].name != NULL; enum_pos++) {
-        if (enum_pos != z80_ops_sets_list[enum_pos].set_type) {
-            FATAL("Invalid set configuration found for %s: %d", z80_ops_sets_list[enum_pos].name, z80_ops_sets_list[enum_pos].set_type);
-            return false;
-        }
+    const char *directory = getenv(Z80_OPCODES_DIR_ENV);
 
-        Z80_OPS ops = read_op_codes(z80_ops_sets_list[enum_pos].name);
+    if (directory == NULL || *directory == '\0') {
+        z80_ops_set = z80_built_in_ops_set;
+        z80_ops_text = z80_built_in_ops_text;
+        return true;
+    }
 
-        if (ops.num_op_codes == 0) {
-            FATAL("Failed to read op codes from %s", z80_ops_sets_list[enum_pos].name);
-            return false;
-        }
+    INFO("Reading the Z80 op codes from the dat files in %s", directory);
 
-        z80_ops_set[enum_pos] = ops;
+    if (!read_op_sets(directory, z80_ops_set_from_dat_files, z80_ops_text_from_dat_files)) {
+        return false;
     }
 
+    z80_ops_set = z80_ops_set_from_dat_files;
+    z80_ops_text = z80_ops_text_from_dat_files;
     return true;
 }
 
-Z80_OP_FUNC_LOOKUP get_z80_op_func(Z80_MNEMONIC op) {
-    Z80_OP_FUNC_LOOKUP z80_op_func = { 0 };
+#ifdef Z80_THREADED_DISPATCH
 
-    for (int i = 0; z80_op_func_lookup[i].op < Z80_MNEMONIC_COUNT; i++) {
-        if (z80_op_func_lookup[i].op == op) {
-            z80_op_func = z80_op_func_lookup[i];
-            break;
-        }
+#define Z80_OP_CASE(mnemonic, type, member) \
+    case mnemonic: \
+        Z80_OP_CALL_##type(mnemonic, op); \
+        break;
+
+/*
+ *  The functions are called directly from a switch on the mnemonic, rather than through the
+ *  function pointer and a switch on its type; this is used for the shifted op codes.
+ */
+void call_z80_op_func(const Z80_OP *op) {
+    switch (op->op) {
+        Z80_OP_FUNCS(Z80_OP_CASE)
+        default:
+            ERROR("Unexpected mnemonic found: %d", op->op);
     }
-    
-    return z80_op_func;
 }
 
-void call_z80_op_func(Z80_OP op) {
-    switch (op.op_func_lookup.function_type) {
+#else
+
+/*
+ *  The op code is passed by pointer into the op code set so that it is never copied.
+ */
+void call_z80_op_func(const Z80_OP *op) {
+    const Z80_OP_FUNC_LOOKUP *op_func_lookup = &z80_op_func_lookup[op->op];
+
+    switch (op_func_lookup->function_type) {
         case OP_TYPE_NO_PARAMS:
-            op.op_func_lookup.func.no_params();
+            op_func_lookup->func.no_params();
             break;
         case OP_TYPE_ONE_PARAM:
-            op.op_func_lookup.func.one_param(op.operand_1);
+            op_func_lookup->func.one_param(&op->operand_1);
             break;
         case OP_TYPE_TWO_PARAMS:
-            op.op_func_lookup.func.two_params(op.operand_1, op.operand_2);
+            op_func_lookup->func.two_params(&op->operand_1, &op->operand_2);
             break;
         default:
-            ERROR("Unexpected function type found for %s: %d", get_mnemonic_name(op.op), op.op_func_lookup.function_type);
+            ERROR("Unexpected function type found for %s: %d", get_mnemonic_name(op->op), op_func_lookup->function_type);
+    }
+}
+
+#endif
+
+//  The number of bytes following the op code that an operand is read from
+int get_operand_length(const Z80_OPERAND *operand) {
+    switch (operand->type) {
+        case OPERAND_IMMEDIATE_BYTE:
+        case OPERAND_PORT_IMMEDIATE:
+        case OPERAND_INDEX_OFFSET:
+        case OPERAND_RELATIVE_OFFSET:
+            return 1;
+        case OPERAND_IMMEDIATE_WORD:
+        case OPERAND_INDIRECT_IMMEDIATE_WORD:
+            return 2;
+        default:
+            return 0;
     }
 }
@@ -3,22 +3,96 @@
 
 #include <stdbool.h>
 
+#include "libspectrum.h"
+
 #include "mnemonics.h"
 
 /*
  *  These can consist of larger strings than the actual operand
  *  but the operand should be at least 1 character long.
  *  eg. "(REGISTER+dd)" or "REGISTERH" are valid operands.
+ *  The longest is the extras of the DDFDCB RES and SET instructions, eg. "0,(REGISTER+dd)",
+ *  which requires room for the terminator.
  */
-#define MAX_OPERAND_LENGTH 15
+#define MAX_OPERAND_LENGTH 16
 
 //  The maximum number of op codes given the id is stored in a single byte
 #define MAX_OP_CODE_IDS 256
 
+/*
+ *  The operand strings from the dat files are resolved into these types when the op codes are read,
+ *  so that the op code functions never need to examine the strings when executing an instruction.
+ */
+typedef enum {
+    OPERAND_NONE = 0,
+    OPERAND_REG8,                       // A, B, C, D, E, F, H or L
+    OPERAND_REG_I,                      // I
+    OPERAND_REG_R,                      // R
+    OPERAND_REG16,                      // AF, BC, DE, HL or SP
+    OPERAND_REG16_ALTERNATE,            // AF'
+    OPERAND_INDIRECT_REG16,             // (BC), (DE), (HL) or (SP)
+    OPERAND_INDEX_REG16,                // REGISTER; IX or IY depending on the shift
+    OPERAND_INDEX_REG8_HIGH,            // REGISTERH
+    OPERAND_INDEX_REG8_LOW,             // REGISTERL
+    OPERAND_INDEX_OFFSET,               // (REGISTER+dd)
+    OPERAND_IMMEDIATE_BYTE,             // nn
+    OPERAND_IMMEDIATE_WORD,             // nnnn
+    OPERAND_INDIRECT_IMMEDIATE_WORD,    // (nnnn)
+    OPERAND_PORT_IMMEDIATE,             // (nn)
+    OPERAND_PORT_C,                     // (C)
+    OPERAND_CONDITION,                  // NZ, Z, NC, C, PO, PE, P or M
+    OPERAND_RELATIVE_OFFSET,            // offset
+    OPERAND_NUMBER,                     // Bit position, interrupt mode, restart address or the 0 for OUT (C),0
+    OPERAND_PREFIX,                     // DD, FD, CB, ED or DDFDCB for the shift instruction
+    OPERAND_MNEMONIC                    // The CB instruction within a DDFDCB LD instruction
+} Z80_OPERAND_TYPE;
+
+typedef enum {
+    PREFIX_CB = 0,
+    PREFIX_DD,
+    PREFIX_ED,
+    PREFIX_FD,
+    PREFIX_DDFDCB
+} Z80_PREFIX;
+
+//  The registers an operand can refer to; an index into z80_byte_regs or z80_word_regs
+typedef enum {
+    Z80_REG_NONE = 0,
+    Z80_REG_A,
+    Z80_REG_F,
+    Z80_REG_B,
+    Z80_REG_C,
+    Z80_REG_D,
+    Z80_REG_E,
+    Z80_REG_H,
+    Z80_REG_L,
+    Z80_REG_I,
+    Z80_REG_R,
+    Z80_REG_AF,
+    Z80_REG_BC,
+    Z80_REG_DE,
+    Z80_REG_HL,
+    Z80_REG_SP,
+    Z80_REG_IX,
+    Z80_REG_IY,
+    Z80_REG_AF_,
+    Z80_REG_COUNT
+} Z80_REGISTER;
+
+/*
+ *  Kept to a byte per field so that an op code is 14 bytes and all five sets fit in the L1 cache;
+ *  the types are held as bytes rather than as their enums for the same reason.
+ */
+typedef struct {
+    libspectrum_byte type;              // Z80_OPERAND_TYPE
+    libspectrum_byte reg;               // Z80_REGISTER for the register types, including the indirect ones
+    libspectrum_byte value;             // The number, the prefix, the mnemonic of the CB instruction or the flag tested by a condition
+    libspectrum_byte is_not;            // Set when the condition is true for the flag being reset
+} Z80_OPERAND;
+
 typedef void (*OP_FUNC_NO_PARAMS)(void);
-typedef void (*OP_FUNC_ONE_PARAM)(const char *value);
-typedef void (*OP_FUNC_TWO_PARAMS)(const char *value1, const char *value2);
-//  Will add extras parameter when implementing extended op codes
+typedef void (*OP_FUNC_ONE_PARAM)(const Z80_OPERAND *operand);
+typedef void (*OP_FUNC_TWO_PARAMS)(const Z80_OPERAND *operand_1, const Z80_OPERAND *operand_2);
 
 typedef enum {
     OP_TYPE_NO_PARAMS,
@@ -26,6 +100,86 @@ typedef enum {
     OP_TYPE_TWO_PARAMS
 } OP_FUNC_TYPE;
 
+/*
+ *  The function executing each mnemonic and the type of its parameters; used to build the
+ *  function lookup and by the generator of the built in op code tables.
+ */
+#define Z80_OP_FUNCS(X) \
+    X(ADD, TWO_PARAMS, two_params) \
+    X(ADC, TWO_PARAMS, two_params) \
+    X(AND, TWO_PARAMS, two_params) \
+    X(BIT, TWO_PARAMS, two_params) \
+    X(CALL, TWO_PARAMS, two_params) \
+    X(CCF, NO_PARAMS, no_params) \
+    X(CP, TWO_PARAMS, two_params) \
+    X(CPD, NO_PARAMS, no_params) \
+    X(CPDR, NO_PARAMS, no_params) \
+    X(CPI, NO_PARAMS, no_params) \
+    X(CPIR, NO_PARAMS, no_params) \
+    X(CPL, NO_PARAMS, no_params) \
+    X(DAA, NO_PARAMS, no_params) \
+    X(DEC, ONE_PARAM, one_param) \
+    X(DI, NO_PARAMS, no_params) \
+    X(DJNZ, ONE_PARAM, one_param) \
+    X(EI, NO_PARAMS, no_params) \
+    X(EX, TWO_PARAMS, two_params) \
+    X(EXX, NO_PARAMS, no_params) \
+    X(HALT, NO_PARAMS, no_params) \
+    X(IM, ONE_PARAM, one_param) \
+    X(IN, TWO_PARAMS, two_params) \
+    X(INC, ONE_PARAM, one_param) \
+    X(IND, NO_PARAMS, no_params) \
+    X(INDR, NO_PARAMS, no_params) \
+    X(INI, NO_PARAMS, no_params) \
+    X(INIR, NO_PARAMS, no_params) \
+    X(JP, TWO_PARAMS, two_params) \
+    X(JR, TWO_PARAMS, two_params) \
+    X(LD, TWO_PARAMS, two_params) \
+    X(LDD, NO_PARAMS, no_params) \
+    X(LDDR, NO_PARAMS, no_params) \
+    X(LDI, NO_PARAMS, no_params) \
+    X(LDIR, NO_PARAMS, no_params) \
+    X(NEG, NO_PARAMS, no_params) \
+    X(NOP, NO_PARAMS, no_params) \
+    X(OR, TWO_PARAMS, two_params) \
+    X(OUT, TWO_PARAMS, two_params) \
+    X(OTDR, NO_PARAMS, no_params) \
+    X(OTIR, NO_PARAMS, no_params) \
+    X(OUTD, NO_PARAMS, no_params) \
+    X(OUTI, NO_PARAMS, no_params) \
+    X(POP, ONE_PARAM, one_param) \
+    X(PUSH, ONE_PARAM, one_param) \
+    X(RES, TWO_PARAMS, two_params) \
+    X(RET, ONE_PARAM, one_param) \
+    X(RETN, NO_PARAMS, no_params) \
+    X(RL, ONE_PARAM, one_param) \
+    X(RLA, NO_PARAMS, no_params) \
+    X(RLC, ONE_PARAM, one_param) \
+    X(RLCA, NO_PARAMS, no_params) \
+    X(RLD, NO_PARAMS, no_params) \
+    X(RR, ONE_PARAM, one_param) \
+    X(RRA, NO_PARAMS, no_params) \
+    X(RRC, ONE_PARAM, one_param) \
+    X(RRCA, NO_PARAMS, no_params) \
+    X(RRD, NO_PARAMS, no_params) \
+    X(RST, ONE_PARAM, one_param) \
+    X(SBC, TWO_PARAMS, two_params) \
+    X(SCF, NO_PARAMS, no_params) \
+    X(SET, TWO_PARAMS, two_params) \
+    X(SLA, ONE_PARAM, one_param) \
+    X(SLL, ONE_PARAM, one_param) \
+    X(SRA, ONE_PARAM, one_param) \
+    X(SRL, ONE_PARAM, one_param) \
+    X(SUB, TWO_PARAMS, two_params) \
+    X(XOR, TWO_PARAMS, two_params) \
+    X(SLTTRAP, NO_PARAMS, no_params) \
+    X(SHIFT, ONE_PARAM, one_param)
+
+//  Call the function for a mnemonic directly, given the type of its parameters from Z80_OP_FUNCS
+#define Z80_OP_CALL_NO_PARAMS(mnemonic, z80_op) op_##mnemonic()
+#define Z80_OP_CALL_ONE_PARAM(mnemonic, z80_op) op_##mnemonic(&(z80_op)->operand_1)
+#define Z80_OP_CALL_TWO_PARAMS(mnemonic, z80_op) op_##mnemonic(&(z80_op)->operand_1, &(z80_op)->operand_2)
+
 typedef struct {
     Z80_MNEMONIC op;
 
@@ -37,22 +191,35 @@ typedef struct {
     } func;
 } Z80_OP_FUNC_LOOKUP;
 
+/*
+ *  The decoded op code; the function executing it is found from the mnemonic
+ *  so that the op code holds no pointers and is accessed in place.
+ */
 typedef struct {
-    unsigned char id;  // The opcode ID matches the position in the Z80_OPS sparse array
-
-    Z80_MNEMONIC op;
-    Z80_OP_FUNC_LOOKUP op_func_lookup;
+    libspectrum_byte id;                // The opcode ID matches the position in the Z80_OPS sparse array
+    libspectrum_byte op;                // Z80_MNEMONIC
 
-    char operand_1[MAX_OPERAND_LENGTH];
-    char operand_2[MAX_OPERAND_LENGTH];
-    char extras[MAX_OPERAND_LENGTH];
+    Z80_OPERAND operand_1;
+    Z80_OPERAND operand_2;
+    Z80_OPERAND extras;
 } Z80_OP;
 
+//  The operands as they were found in the dat file; these are only retained for debugging
+typedef struct {
+    char operand_1_text[MAX_OPERAND_LENGTH];
+    char operand_2_text[MAX_OPERAND_LENGTH];
+    char extras_text[MAX_OPERAND_LENGTH];
+} Z80_OP_TEXT;
+
 typedef struct {
     int num_op_codes;
     Z80_OP op_codes[MAX_OP_CODE_IDS];  // Sparse array of op codes with the opcode ID as the index
 } Z80_OPS;
 
+typedef struct {
+    Z80_OP_TEXT op_texts[MAX_OP_CODE_IDS];
+} Z80_OPS_TEXT;
+
 typedef enum {
     OP_SET_BASE = 0,
     OP_SET_CB,
@@ -67,11 +234,24 @@ typedef struct {
     const char *name;
 } Z80_OP_SET_NAME;
 
-extern Z80_OPS z80_ops_set[];
+//  Set to read the op codes from the dat files in this directory instead of using the built in tables
+#define Z80_OPCODES_DIR_ENV "FUSE_Z80_OPCODES_DIR"
+
+//  The op code sets in use, indexed by Z80_OP_SET_TYPE, and the operand text of each for debugging
+extern const Z80_OPS *z80_ops_set;
+extern const Z80_OPS_TEXT *z80_ops_text;
+
+//  Generated from the dat files when building; see generate_z80_opcodes.c
+extern const Z80_OPS z80_built_in_ops_set[OP_SET_NUM];
+extern const Z80_OPS_TEXT z80_built_in_ops_text[OP_SET_NUM];
+
+//  The registers referred to by an operand, indexed by its Z80_REGISTER
+extern libspectrum_byte *const z80_byte_regs[Z80_REG_COUNT];
+extern libspectrum_word *const z80_word_regs[Z80_REG_COUNT];
 
 
 bool init_op_sets(void);
-Z80_OP_FUNC_LOOKUP get_z80_op_func(Z80_MNEMONIC op);
-void call_z80_op_func(Z80_OP op);
+void call_z80_op_func(const Z80_OP *op);
+int get_operand_length(const Z80_OPERAND *operand);
 
 #endif // Z80_OPCODES_H
@@ -0,0 +1,135 @@
+#include <config.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libspectrum.h"
+
+#include "z80_opcodes.h"
+#include "mnemonics.h"
+#include "z80_trace.h"
+
+#include "../logging.h"
+
+
+static const char *op_set_names[OP_SET_NUM] = {
+    [OP_SET_BASE] = "base",
+    [OP_SET_CB] = "cb",
+    [OP_SET_DDFD] = "ddfd",
+    [OP_SET_DDFDCB] = "ddfdcb",
+    [OP_SET_ED] = "ed"
+};
+
+Z80_TRACE_RECORD *z80_trace_records = NULL;
+size_t z80_trace_mask = 0;
+size_t z80_trace_count = 0;
+
+static void write_record(FILE *stream, const Z80_TRACE_RECORD *record);
+
+
+/*
+ *  Tracing is turned on by giving the number of instructions to keep, which is rounded up to a power of two.
+ *  Only the most recent instructions are kept; the trace is formatted when it is dumped.
+ */
+bool z80_trace_init(void) {
+    const char *value = getenv(Z80_TRACE_ENV);
+    unsigned long requested;
+    size_t size = 1;
+    char *end;
+
+    if (value == NULL || *value == '\0') {
+        return true;
+    }
+
+    requested = strtoul(value, &end, 0);
+
+    if (*end != '\0' || requested == 0 || requested > Z80_TRACE_MAX_RECORDS) {
+        ERROR("%s must be a number of instructions from 1 to %d: %s", Z80_TRACE_ENV, Z80_TRACE_MAX_RECORDS, value);
+        return false;
+    }
+
+    while (size < requested) {
+        size <<= 1;
+    }
+
+    z80_trace_records = calloc(size, sizeof(Z80_TRACE_RECORD));
+
+    if (z80_trace_records == NULL) {
+        ERROR("Unable to allocate the trace of %lu instructions", (unsigned long)size);
+        return false;
+    }
+
+    z80_trace_mask = size - 1;
+    z80_trace_count = 0;
+
+    INFO("Tracing the last %lu instructions", (unsigned long)size);
+
+    return true;
+}
+
+void z80_trace_end(void) {
+    const char *filename = getenv(Z80_TRACE_FILE_ENV);
+    size_t records;
+
+    if (z80_trace_records == NULL) {
+        return;
+    }
+
+    if (filename != NULL && *filename != '\0') {
+        if (z80_trace_dump_file(filename, &records)) {
+            INFO("Wrote the last %lu instructions traced to %s", (unsigned long)records, filename);
+        }
+    }
+
+    free(z80_trace_records);
+    z80_trace_records = NULL;
+}
+
+//  Write the trace from the oldest instruction kept to the most recent; returns the number of instructions written
+size_t z80_trace_dump(FILE *stream) {
+    size_t size;
+    size_t first;
+    size_t i;
+
+    if (z80_trace_records == NULL) {
+        return 0;
+    }
+
+    size = z80_trace_mask + 1;
+    first = (z80_trace_count > size) ? z80_trace_count - size : 0;
+
+    for (i = first; i < z80_trace_count; i++) {
+        write_record(stream, &z80_trace_records[i & z80_trace_mask]);
+    }
+
+    return z80_trace_count - first;
+}
+
+bool z80_trace_dump_file(const char *filename, size_t *records) {
+    FILE *stream = fopen(filename, "w");
+
+    if (stream == NULL) {
+        ERROR("Unable to open %s for the trace: %s", filename, strerror(errno));
+        return false;
+    }
+
+    *records = z80_trace_dump(stream);
+
+    if (fclose(stream) != 0) {
+        ERROR("Failed to write the trace to %s", filename);
+        return false;
+    }
+
+    return true;
+}
+
+static void write_record(FILE *stream, const Z80_TRACE_RECORD *record) {
+    const Z80_OP *op = &z80_ops_set[record->op_set].op_codes[record->id];
+    const Z80_OP_TEXT *op_text = &z80_ops_text[record->op_set].op_texts[record->id];
+
+    fprintf(stream, "%10lu %04x %-6s %02x %-6s %-12s %-12s %-4s AF:%04x BC:%04x DE:%04x HL:%04x SP:%04x IX:%04x IY:%04x\n",
+            (unsigned long)record->tstates, record->pc, op_set_names[record->op_set], record->id,
+            get_mnemonic_name(op->op), op_text->operand_1_text, op_text->operand_2_text, op_text->extras_text,
+            record->af, record->bc, record->de, record->hl, record->sp, record->ix, record->iy);
+}
@@ -0,0 +1,83 @@
+#ifndef Z80_TRACE_H
+#define Z80_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "libspectrum.h"
+
+#include "z80.h"
+#include "z80_opcodes.h"
+
+#include "../spectrum.h"  // Includes tstates
+
+
+//  Set to the number of instructions to keep in the trace; tracing is off when not set
+#define Z80_TRACE_ENV "FUSE_Z80_TRACE"
+//  Set to a file to dump the trace to when the emulator ends
+#define Z80_TRACE_FILE_ENV "FUSE_Z80_TRACE_FILE"
+
+#define Z80_TRACE_MAX_RECORDS (1 << 24)
+
+/*
+ *  One executed instruction and the registers as they were before executing it.
+ *  The records are fixed in size and only formatted when the trace is dumped.
+ */
+typedef struct {
+    libspectrum_dword tstates;
+    libspectrum_word pc;
+    libspectrum_word af;
+    libspectrum_word bc;
+    libspectrum_word de;
+    libspectrum_word hl;
+    libspectrum_word sp;
+    libspectrum_word ix;
+    libspectrum_word iy;
+    libspectrum_byte op_set;
+    libspectrum_byte id;
+} Z80_TRACE_RECORD;
+
+//  The ring buffer of records, which is NULL while tracing is off; its size is a power of two
+extern Z80_TRACE_RECORD *z80_trace_records;
+extern size_t z80_trace_mask;
+extern size_t z80_trace_count;
+
+
+bool z80_trace_init(void);
+void z80_trace_end(void);
+size_t z80_trace_dump(FILE *stream);
+bool z80_trace_dump_file(const char *filename, size_t *records);
+
+/*
+ *  Called for every instruction, so the check for tracing being off is all that is done in the common case.
+ *  The registers are read from z80 directly so that this header does not bring in the register macros.
+ */
+static inline void z80_trace_op(libspectrum_word pc, Z80_OP_SET_TYPE op_set, libspectrum_byte id) {
+    Z80_TRACE_RECORD *record;
+
+    if (z80_trace_records == NULL) {
+        return;
+    }
+
+#ifdef Z80_LAZY_FLAGS
+    //  Record F as it would be read
+    z80_update_flags();
+#endif
+
+    record = &z80_trace_records[z80_trace_count++ & z80_trace_mask];
+
+    record->tstates = tstates;
+    record->pc = pc;
+    record->af = z80.af.w;
+    record->bc = z80.bc.w;
+    record->de = z80.de.w;
+    record->hl = z80.hl.w;
+    record->sp = z80.sp.w;
+    record->ix = z80.ix.w;
+    record->iy = z80.iy.w;
+    record->op_set = op_set;
+    record->id = id;
+}
+
+#endif